@@ -0,0 +1,559 @@
+#include "Cooker.h"
+#include "ModelCooker.h"
+#include "TextureCooker.h"
+#include "Globals.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "PackFile.h"
+#include "parson/parson.h"
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+//Leading fields of every cooked file header
+struct CookedFileStamp
+{
+	unsigned magic = 0;
+	unsigned version = 0;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+};
+
+static bool LessSource(const CookAsset& left, const CookAsset& right)
+{
+	return left.source < right.source;
+}
+
+static std::string GetExtension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+		return std::string();
+
+	std::string extension = path.substr(dot);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension;
+}
+
+static bool GetAssetType(const std::string& extension, CookAsset::Type& type)
+{
+	if (extension == ".obj" || extension == ".fbx" || extension == ".dae" || extension == ".3ds")
+		type = CookAsset::MODEL;
+	else if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp")
+		type = CookAsset::TEXTURE;
+	else
+		return false;
+
+	return true;
+}
+
+//Files named by the lines starting with keyword, like the mtllib lines of an OBJ or the map_Kd lines of its
+//material libraries. Relative to the folder of the source as the loaders resolve them.
+static void FindReferencedFiles(const std::string& source, const char* keyword, std::vector<std::string>& paths)
+{
+	MappedFile file;
+	if (!file.Open(source.c_str()))
+		return;
+
+	std::string folder = source.substr(0, source.find_last_of('/') + 1);
+	size_t keyword_length = strlen(keyword);
+	const char* line = file.GetData();
+	const char* end = line + file.GetSize();
+	while (line < end)
+	{
+		const char* line_end = (const char*)memchr(line, '\n', end - line);
+		if (line_end == nullptr)
+			line_end = end;
+
+		while (line < line_end && (*line == ' ' || *line == '\t'))
+			++line;
+
+		if ((size_t)(line_end - line) > keyword_length + 1 && strncmp(line, keyword, keyword_length) == 0 &&
+			(line[keyword_length] == ' ' || line[keyword_length] == '\t'))
+		{
+			const char* name = line + keyword_length + 1;
+			const char* name_end = line_end;
+			while (name < name_end && (*name == ' ' || *name == '\t'))
+				++name;
+			while (name_end > name && (name_end[-1] == ' ' || name_end[-1] == '\t' || name_end[-1] == '\r'))
+				--name_end;
+
+			std::string path = folder + std::string(name, name_end);
+			std::replace(path.begin(), path.end(), '\\', '/');
+			if (name < name_end && std::find(paths.begin(), paths.end(), path) == paths.end())
+				paths.push_back(path);
+		}
+
+		line = line_end + 1;
+	}
+}
+
+static unsigned long long HashBytes(unsigned long long hash, const char* data, unsigned long long size)
+{
+	for (unsigned long long i = 0; i < size; ++i)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+Cooker::Cooker(const char* root, unsigned num_threads, bool force, bool compress_textures) : root(root), force(force), compress_textures(compress_textures)
+{
+	std::replace(this->root.begin(), this->root.end(), '\\', '/');
+	if (this->root.empty() || this->root.back() != '/')
+		this->root.push_back('/');
+
+	//The calling thread takes ranges too
+	jobs = new JobSystem(num_threads > 1 ? num_threads - 1 : 0);
+}
+
+Cooker::~Cooker()
+{
+	RELEASE(jobs);
+}
+
+bool Cooker::Run()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	InitTextureCooker(compress_textures);
+
+	FindAssets(root);
+	std::sort(assets.begin(), assets.end(), LessSource);
+	HashAssets();
+	CompareManifest();
+	CookAssets();
+
+	unsigned num_cooked = 0;
+	unsigned num_failed = 0;
+	for (std::vector<CookAsset>::const_iterator it = assets.begin(); it != assets.end(); ++it)
+	{
+		if (it->failed)
+			++num_failed;
+		else if (it->dirty)
+			++num_cooked;
+		else
+			RestampOutputs(*it);
+	}
+
+	for (std::vector<std::string>::const_iterator it = stale_outputs.begin(); it != stale_outputs.end(); ++it)
+	{
+		if (remove(it->c_str()) == 0)
+			APPLOG("Removed %s, its source is gone", it->c_str());
+	}
+
+	bool saved = SaveManifest();
+
+	ShutdownTextureCooker();
+
+	long long elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	APPLOG("Cooked %u of %u assets, %u up to date, %u failed in %lld ms on %u threads", num_cooked, assets.size(),
+		assets.size() - num_cooked - num_failed, num_failed, elapsed_ms, jobs->GetNumWorkers() + 1);
+
+	return saved && num_failed == 0;
+}
+
+void Cooker::FindAssets(const std::string& folder)
+{
+	std::vector<std::string> files;
+	std::vector<std::string> folders;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA find_data;
+	HANDLE find = FindFirstFileA((folder + "*").c_str(), &find_data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		std::string name = find_data.cFileName;
+		if (name == "." || name == "..")
+			continue;
+
+		if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+			folders.push_back(folder + name + "/");
+		else
+			files.push_back(folder + name);
+	} while (FindNextFileA(find, &find_data));
+	FindClose(find);
+#else
+	DIR* dir = opendir(folder.c_str());
+	if (dir == nullptr)
+		return;
+
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		struct stat info;
+		if (stat((folder + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+			folders.push_back(folder + name + "/");
+		else
+			files.push_back(folder + name);
+	}
+	closedir(dir);
+#endif
+
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		if (*it != root + COOK_MANIFEST)
+			this->files.push_back(*it);
+	}
+
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		std::string extension = GetExtension(*it);
+		CookAsset asset;
+		if (!GetAssetType(extension, asset.type))
+			continue;
+
+		asset.source = *it;
+		assets.push_back(asset);
+	}
+
+	for (std::vector<std::string>::const_iterator it = folders.begin(); it != folders.end(); ++it)
+		FindAssets(*it);
+}
+
+void Cooker::HashAssets()
+{
+	std::string model_settings = GetModelCookSettings();
+	std::string texture_settings = GetTextureCookSettings();
+
+	jobs->ParallelFor(assets.size(), 1, [&](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+		{
+			CookAsset& asset = assets[i];
+			MappedFile::GetFileStamp(asset.source.c_str(), asset.source_size, asset.source_time);
+
+			//OBJ files pull their materials from the libraries they name, the HLOD atlases are made from their textures
+			if (GetExtension(asset.source) == ".obj")
+			{
+				std::vector<std::string> libraries;
+				FindReferencedFiles(asset.source, "mtllib", libraries);
+				asset.dependencies = libraries;
+				for (std::vector<std::string>::const_iterator it = libraries.begin(); it != libraries.end(); ++it)
+					FindReferencedFiles(*it, "map_Kd", asset.dependencies);
+			}
+
+			std::vector<std::string> paths(1, asset.source);
+			paths.insert(paths.end(), asset.dependencies.begin(), asset.dependencies.end());
+			asset.hash = HashFiles(paths);
+			if (asset.type == CookAsset::TEXTURE)
+			{
+				MappedFile file;
+				if (file.Open(asset.source.c_str()))
+					asset.content_hash = HashBytes(FNV_OFFSET_BASIS, file.GetData(), file.GetSize());
+			}
+			asset.settings = asset.type == CookAsset::MODEL ? model_settings : texture_settings;
+		}
+	});
+}
+
+void Cooker::CompareManifest()
+{
+	std::string manifest_path = root + COOK_MANIFEST;
+	JSON_Value* manifest = json_parse_file(manifest_path.c_str());
+	JSON_Object* manifest_object = json_value_get_object(manifest);
+	JSON_Object* entries = nullptr;
+	if (manifest_object != nullptr && json_object_get_number(manifest_object, "Version") == COOK_MANIFEST_VERSION)
+		entries = json_object_get_object(manifest_object, "Assets");
+
+	if (entries == nullptr)
+	{
+		APPLOG("No valid manifest in %s, cooking everything", manifest_path.c_str());
+		json_value_free(manifest);
+		return;
+	}
+
+	for (std::vector<CookAsset>::iterator it = assets.begin(); it != assets.end(); ++it)
+	{
+		JSON_Object* entry = json_object_get_object(entries, it->source.c_str());
+		if (force || entry == nullptr)
+			continue;
+
+		const char* hash = json_object_get_string(entry, "Hash");
+		const char* settings = json_object_get_string(entry, "Settings");
+		if (hash == nullptr || settings == nullptr || it->hash != hash || it->settings != settings)
+			continue;
+
+		//Someone may have deleted a cooked file by hand
+		bool outputs_found = true;
+		JSON_Array* outputs = json_object_get_array(entry, "Outputs");
+		for (size_t i = 0; i < json_array_get_count(outputs); ++i)
+		{
+			unsigned long long size = 0;
+			unsigned long long time = 0;
+			const char* output = json_array_get_string(outputs, i);
+			outputs_found = outputs_found && output != nullptr && MappedFile::GetFileStamp(output, size, time);
+			if (output != nullptr)
+				it->outputs.push_back(output);
+		}
+
+		it->dirty = !outputs_found;
+		if (it->dirty)
+			it->outputs.clear();
+	}
+
+	CookAsset key;
+	for (size_t i = 0; i < json_object_get_count(entries); ++i)
+	{
+		key.source = json_object_get_name(entries, i);
+		if (std::binary_search(assets.begin(), assets.end(), key, LessSource))
+			continue;
+
+		JSON_Array* outputs = json_object_get_array(json_object_get_object(entries, key.source.c_str()), "Outputs");
+		for (size_t j = 0; j < json_array_get_count(outputs); ++j)
+		{
+			if (json_array_get_string(outputs, j) != nullptr)
+				stale_outputs.push_back(json_array_get_string(outputs, j));
+		}
+	}
+
+	json_value_free(manifest);
+}
+
+void Cooker::CookAssets()
+{
+	//Textures with the content of another one take its cooked file instead of being cooked again
+	std::map<unsigned long long, CookAsset*> originals;
+	std::vector<std::pair<CookAsset*, CookAsset*> > copies;
+	std::vector<CookAsset*> dirty;
+	for (std::vector<CookAsset>::iterator it = assets.begin(); it != assets.end(); ++it)
+	{
+		if (it->type == CookAsset::TEXTURE && it->content_hash != 0)
+		{
+			std::pair<std::map<unsigned long long, CookAsset*>::iterator, bool> original = originals.insert(std::make_pair(it->content_hash, &(*it)));
+			if (!original.second && it->dirty)
+			{
+				copies.push_back(std::make_pair(&(*it), original.first->second));
+				continue;
+			}
+		}
+
+		if (it->dirty)
+			dirty.push_back(&(*it));
+	}
+
+	//Biggest first, so a large model doesn't start last and keep one thread busy alone
+	std::sort(dirty.begin(), dirty.end(), [](const CookAsset* left, const CookAsset* right) { return left->source_size > right->source_size; });
+
+	jobs->ParallelFor(dirty.size(), 1, [&](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+		{
+			CookAsset& asset = *dirty[i];
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			bool cooked = asset.type == CookAsset::MODEL ? CookModel(asset) : CookTexture(asset);
+			asset.failed = !cooked;
+
+			long long elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			if (cooked)
+			{
+				APPLOG("Cooked %s in %lld ms", asset.source.c_str(), elapsed_ms);
+			}
+			else
+			{
+				APPLOG("Error cooking %s", asset.source.c_str());
+			}
+		}
+	});
+
+	for (std::vector<std::pair<CookAsset*, CookAsset*> >::iterator it = copies.begin(); it != copies.end(); ++it)
+	{
+		it->first->failed = !CopyCookedTexture(*it->first, *it->second);
+		if (!it->first->failed)
+		{
+			APPLOG("Copied %s, same content as %s", it->first->source.c_str(), it->second->source.c_str());
+		}
+		else
+		{
+			APPLOG("Error cooking %s", it->first->source.c_str());
+		}
+	}
+}
+
+void Cooker::RestampOutputs(const CookAsset& asset) const
+{
+	//Same content with a new stamp, like after a checkout. The runtime compares stamps, the cooked data is still good.
+	for (std::vector<std::string>::const_iterator it = asset.outputs.begin(); it != asset.outputs.end(); ++it)
+	{
+		FILE* file = fopen(it->c_str(), "r+b");
+		if (file == nullptr)
+			continue;
+
+		CookedFileStamp stamp;
+		if (fread(&stamp, sizeof(stamp), 1, file) == 1 && (stamp.source_size != asset.source_size || stamp.source_time != asset.source_time))
+		{
+			stamp.source_size = asset.source_size;
+			stamp.source_time = asset.source_time;
+			fseek(file, 0, SEEK_SET);
+			fwrite(&stamp, sizeof(stamp), 1, file);
+			APPLOG("Restamped %s", it->c_str());
+		}
+		fclose(file);
+	}
+}
+
+bool Cooker::SaveManifest() const
+{
+	JSON_Value* manifest = json_value_init_object();
+	JSON_Object* manifest_object = json_value_get_object(manifest);
+	json_object_set_number(manifest_object, "Version", COOK_MANIFEST_VERSION);
+
+	JSON_Value* entries = json_value_init_object();
+	json_object_set_value(manifest_object, "Assets", entries);
+
+	//Failed assets are left out, the next run tries them again
+	for (std::vector<CookAsset>::const_iterator it = assets.begin(); it != assets.end(); ++it)
+	{
+		if (it->failed)
+			continue;
+
+		JSON_Value* entry = json_value_init_object();
+		JSON_Object* entry_object = json_value_get_object(entry);
+		json_object_set_string(entry_object, "Type", it->type == CookAsset::MODEL ? "Model" : "Texture");
+		json_object_set_string(entry_object, "Hash", it->hash.c_str());
+		json_object_set_string(entry_object, "Settings", it->settings.c_str());
+
+		JSON_Value* outputs = json_value_init_array();
+		for (std::vector<std::string>::const_iterator output = it->outputs.begin(); output != it->outputs.end(); ++output)
+			json_array_append_string(json_value_get_array(outputs), output->c_str());
+		json_object_set_value(entry_object, "Outputs", outputs);
+
+		json_object_set_value(json_value_get_object(entries), it->source.c_str(), entry);
+	}
+
+	std::string manifest_path = root + COOK_MANIFEST;
+	bool saved = json_serialize_to_file_pretty(manifest, manifest_path.c_str()) == JSONSuccess;
+	if (!saved)
+		APPLOG("Error writing %s", manifest_path.c_str());
+
+	json_value_free(manifest);
+	return saved;
+}
+
+bool Cooker::WritePack(const char* path)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	//Cooked files are written after the folder is listed, they are taken from the assets
+	std::vector<std::string> stamped;
+	std::vector<std::string> packed;
+	for (std::vector<CookAsset>::const_iterator it = assets.begin(); it != assets.end(); ++it)
+	{
+		if (it->failed || it->outputs.empty())
+			continue;
+
+		stamped.push_back(it->source);
+		packed.insert(packed.end(), it->outputs.begin(), it->outputs.end());
+	}
+	std::sort(stamped.begin(), stamped.end());
+
+	std::vector<std::string> removed = stale_outputs;
+	removed.push_back(path);
+	std::sort(removed.begin(), removed.end());
+
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		if (!std::binary_search(stamped.begin(), stamped.end(), *it) && !std::binary_search(removed.begin(), removed.end(), *it))
+			packed.push_back(*it);
+	}
+	std::sort(packed.begin(), packed.end());
+	packed.erase(std::unique(packed.begin(), packed.end()), packed.end());
+
+	struct PackedFile
+	{
+		std::vector<char> data;
+		unsigned long long size = 0;
+		unsigned long long time = 0;
+		bool compressed = false;
+		bool read = false;
+	};
+
+	std::vector<PackedFile> contents(packed.size());
+	jobs->ParallelFor(packed.size(), 1, [&](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+		{
+			PackedFile& content = contents[i];
+			MappedFile file;
+			if (!file.Open(packed[i].c_str()) || !MappedFile::GetFileStamp(packed[i].c_str(), content.size, content.time))
+				continue;
+
+			content.compressed = CompressPackData(file.GetData(), file.GetSize(), content.data);
+			if (!content.compressed)
+				content.data.assign(file.GetData(), file.GetData() + file.GetSize());
+			content.read = true;
+		}
+	});
+
+	PackFileWriter writer;
+	unsigned long long size = 0;
+	for (unsigned i = 0; i < packed.size(); ++i)
+	{
+		const PackedFile& content = contents[i];
+		if (!content.read)
+		{
+			APPLOG("%s can't be read, it is left out of %s", packed[i].c_str(), path);
+			continue;
+		}
+
+		writer.Add(packed[i], content.data.empty() ? nullptr : &content.data[0], content.data.size(), content.size, content.compressed, content.size, content.time);
+		size += content.size;
+	}
+
+	for (std::vector<std::string>::const_iterator it = stamped.begin(); it != stamped.end(); ++it)
+	{
+		unsigned long long source_size = 0;
+		unsigned long long source_time = 0;
+		if (MappedFile::GetFileStamp(it->c_str(), source_size, source_time))
+			writer.AddStamp(*it, source_size, source_time);
+	}
+
+	if (!writer.Write(path))
+		return false;
+
+	long long elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	APPLOG("Packed %u files, %llu KB in %llu KB, into %s in %lld ms", writer.entries.size(), size / 1024, (unsigned long long)writer.data.size() / 1024,
+		path, elapsed_ms);
+
+	return true;
+}
+
+std::string Cooker::HashFiles(const std::vector<std::string>& paths)
+{
+	unsigned long long hash = FNV_OFFSET_BASIS;
+	for (std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+	{
+		//The name goes in too, so renaming a dependency counts as a change
+		hash = HashBytes(hash, it->c_str(), it->size() + 1);
+
+		MappedFile file;
+		if (file.Open(it->c_str()))
+			hash = HashBytes(hash, file.GetData(), file.GetSize());
+	}
+
+	char text[17];
+	sprintf(text, "%016llx", hash);
+	return text;
+}
@@ -0,0 +1,73 @@
+#ifndef COOKER_H
+#define COOKER_H
+
+#include <string>
+#include <vector>
+
+#define COOK_MANIFEST "cook_manifest.json"
+#define COOK_MANIFEST_VERSION 1
+
+class JobSystem;
+
+struct CookAsset
+{
+	enum Type
+	{
+		MODEL,
+		TEXTURE
+	};
+
+	//Path as the runtime opens it, relative to the working directory and with '/' separators
+	std::string source;
+	Type type = MODEL;
+	//Other files the cooked result depends on, like the materials of an OBJ and their textures
+	std::vector<std::string> dependencies;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	//Content of the source and the files it pulls in, plus the import settings it is cooked with
+	std::string hash;
+	//Hash of the source alone, copies of a texture under other names have the same one
+	unsigned long long content_hash = 0;
+	std::string settings;
+	std::vector<std::string> outputs;
+	bool dirty = true;
+	bool failed = false;
+};
+
+//Converts the sources under a folder into the files the runtime reads when they match its sources.
+//Assets are only cooked again when their content hash or import settings change.
+class Cooker
+{
+public:
+	Cooker(const char* root, unsigned num_threads, bool force, bool compress_textures);
+	~Cooker();
+
+	//False if any asset failed to cook
+	bool Run();
+	//Packs every file under the folder after Run. Sources with cooked files only keep their stamp, the runtime reads the cooked files.
+	bool WritePack(const char* path);
+
+private:
+	void FindAssets(const std::string& folder);
+	void HashAssets();
+	void CompareManifest();
+	void CookAssets();
+	void RestampOutputs(const CookAsset& asset) const;
+	bool SaveManifest() const;
+
+	static std::string HashFiles(const std::vector<std::string>& paths);
+
+private:
+	std::string root;
+	bool force = false;
+	bool compress_textures = true;
+	JobSystem* jobs = nullptr;
+
+	std::vector<CookAsset> assets;
+	//Every file found under the folder, cooked or not
+	std::vector<std::string> files;
+	//Outputs of sources that are gone, removed with their manifest entries
+	std::vector<std::string> stale_outputs;
+};
+
+#endif // !COOKER_H
@@ -0,0 +1,380 @@
+#include "HLODCooker.h"
+#include "TextureCooker.h"
+#include "TextureEncoder.h"
+#include "Cooker.h"
+#include "Globals.h"
+#include "HLODFile.h"
+#include "MeshFile.h"
+#include "MeshSimplifier.h"
+#include <assimp/scene.h>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+
+//Texels kept between the used area of a tile and its neighbours, the atlas mips stop before they bleed
+#define HLOD_TILE_BORDER 4
+//Times the texture repeats across a tile in each direction, tiling triangles spanning up to this many fit unclamped
+#define HLOD_TILE_REPEATS 2
+
+//Mesh of the scene in the space of its root, sorted by the cell of its center
+struct HLODSourceMesh
+{
+	const aiMesh* mesh = nullptr;
+	aiMatrix4x4 transform;
+	unsigned index = 0;
+	int cell[3];
+
+	bool operator<(const HLODSourceMesh& other) const
+	{
+		for (unsigned i = 0; i < 3; ++i)
+			if (cell[i] != other.cell[i])
+				return cell[i] < other.cell[i];
+		return false;
+	}
+};
+
+//Materials drawing the same get one tile
+struct HLODMaterial
+{
+	std::string texture;
+	float tint[4];
+
+	bool operator==(const HLODMaterial& other) const
+	{
+		return texture == other.texture && tint[0] == other.tint[0] && tint[1] == other.tint[1] && tint[2] == other.tint[2];
+	}
+};
+
+//Corner of the cluster soup, copies only merge when every attribute matches
+struct HLODVertex
+{
+	float3 position;
+	float2 tex_coord;
+	unsigned tile;
+
+	bool operator==(const HLODVertex& other) const
+	{
+		return position.x == other.position.x && position.y == other.position.y && position.z == other.position.z &&
+			tex_coord.x == other.tex_coord.x && tex_coord.y == other.tex_coord.y && tile == other.tile;
+	}
+};
+
+struct HLODVertexHasher
+{
+	size_t operator()(const HLODVertex& vertex) const
+	{
+		const unsigned* bits = (const unsigned*)vertex.position.ptr();
+		const unsigned* uv_bits = (const unsigned*)vertex.tex_coord.ptr();
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u) ^
+			(uv_bits[0] * 2654435761u) ^ (uv_bits[1] * 40503u) ^ vertex.tile;
+	}
+};
+
+//Downsampled copies of the textures at full source resolution, shared by every cluster using them
+typedef std::map<std::string, std::vector<unsigned char> > HLODTextureTiles;
+
+//Numbers the meshes as the runtime creates their objects, see ModuleLevel::RecursiveLoadSceneNode.
+//Nodes with several meshes get one child per mesh, before the children of the node.
+static void RecursiveCollectMeshes(const aiNode* scene_node, const aiScene* scene, const aiMatrix4x4& transform, unsigned& num_meshes,
+	std::vector<HLODSourceMesh>& meshes)
+{
+	for (unsigned i = 0; i < scene_node->mNumMeshes; ++i)
+	{
+		const aiMesh* mesh = scene->mMeshes[scene_node->mMeshes[i]];
+		//Skinned meshes deform, the proxy could not follow them
+		if (!mesh->HasBones() && mesh->mNumFaces > 0)
+		{
+			HLODSourceMesh source;
+			source.mesh = mesh;
+			source.transform = transform;
+			source.index = num_meshes;
+			meshes.push_back(source);
+		}
+		++num_meshes;
+	}
+
+	for (unsigned i = 0; i < scene_node->mNumChildren; ++i)
+		RecursiveCollectMeshes(scene_node->mChildren[i], scene, transform * scene_node->mChildren[i]->mTransformation, num_meshes, meshes);
+}
+
+static float3 TransformPosition(const aiMatrix4x4& transform, const aiVector3D& position)
+{
+	aiVector3D result = transform * position;
+	return float3(result.x, result.y, result.z);
+}
+
+//Same texture and tint as ComponentMaterial::Load and CookMaterial, alpha keeps the component default
+static void GetMaterial(const aiMaterial* material, const std::string& folder, HLODMaterial& hlod_material)
+{
+	aiColor4D diffuse(1.0f, 1.0f, 1.0f, 1.0f);
+	material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+	for (unsigned i = 0; i < 3; ++i)
+		hlod_material.tint[i] = MAX(0.0f, MIN(diffuse[i], 1.0f));
+	hlod_material.tint[3] = 1.0f;
+
+	aiString path;
+	if (material->GetTextureCount(aiTextureType_DIFFUSE) >= 1 && material->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+		hlod_material.texture = folder + path.data;
+}
+
+//Box filter of the decoded source, each tile texel averages the source texels it covers
+static const std::vector<unsigned char>& GetTextureTile(const std::string& texture, unsigned tile_size, HLODTextureTiles& tiles)
+{
+	HLODTextureTiles::const_iterator it = tiles.find(texture);
+	if (it != tiles.end())
+		return it->second;
+
+	std::vector<unsigned char>& tile = tiles[texture];
+	tile.assign(tile_size * tile_size * 4, 255);
+
+	std::vector<unsigned char> pixels;
+	unsigned width = 0;
+	unsigned height = 0;
+	if (!DecodeTexture(texture, pixels, width, height) || width == 0 || height == 0)
+		return tile;
+
+	for (unsigned y = 0; y < tile_size; ++y)
+	{
+		unsigned first_y = y * height / tile_size;
+		unsigned last_y = MAX(first_y + 1, (y + 1) * height / tile_size);
+		for (unsigned x = 0; x < tile_size; ++x)
+		{
+			unsigned first_x = x * width / tile_size;
+			unsigned last_x = MAX(first_x + 1, (x + 1) * width / tile_size);
+
+			unsigned sum[4] = { 0, 0, 0, 0 };
+			for (unsigned source_y = first_y; source_y < last_y; ++source_y)
+				for (unsigned source_x = first_x; source_x < last_x; ++source_x)
+					for (unsigned c = 0; c < 4; ++c)
+						sum[c] += pixels[(source_y * width + source_x) * 4 + c];
+
+			unsigned count = (last_y - first_y) * (last_x - first_x);
+			for (unsigned c = 0; c < 4; ++c)
+				tile[(y * tile_size + x) * 4 + c] = (unsigned char)(sum[c] / count);
+		}
+	}
+
+	return tile;
+}
+
+static void CookCluster(const HLODSourceMesh* meshes, unsigned num_meshes, const aiScene* scene, const std::string& folder, HLODTextureTiles& tiles,
+	HLODFileCluster& cluster, std::vector<char>& data)
+{
+	//One atlas tile per distinct material
+	std::vector<HLODMaterial> materials;
+	std::vector<unsigned> mesh_tiles(num_meshes);
+	std::vector<HLODFileMember> members(num_meshes);
+	for (unsigned i = 0; i < num_meshes; ++i)
+	{
+		HLODMaterial material;
+		GetMaterial(scene->mMaterials[meshes[i].mesh->mMaterialIndex], folder, material);
+
+		unsigned tile = std::find(materials.begin(), materials.end(), material) - materials.begin();
+		if (tile == materials.size())
+			materials.push_back(material);
+		mesh_tiles[i] = tile;
+
+		members[i].mesh = meshes[i].index;
+		members[i].num_indices = 3 * meshes[i].mesh->mNumFaces;
+	}
+
+	cluster.num_members = members.size();
+	cluster.members_offset = AppendMeshFileData(data, &members[0], members.size() * sizeof(HLODFileMember));
+
+	unsigned columns = (unsigned)ceilf(sqrtf((float)materials.size()));
+	unsigned rows = (materials.size() + columns - 1) / columns;
+	unsigned atlas_width = columns * HLOD_TILE_SIZE;
+	unsigned atlas_height = rows * HLOD_TILE_SIZE;
+	std::vector<unsigned char> atlas(atlas_width * atlas_height * 4, 255);
+	unsigned repeat_size = MAX(1u, (HLOD_TILE_SIZE - 2 * HLOD_TILE_BORDER) / HLOD_TILE_REPEATS);
+	for (unsigned i = 0; i < materials.size(); ++i)
+	{
+		const std::vector<unsigned char>* tile = materials[i].texture.empty() ? nullptr : &GetTextureTile(materials[i].texture, repeat_size, tiles);
+
+		//The texture repeats across the tile and wraps into the border, as GL_REPEAT would sample it.
+		//Tinted with the diffuse color, as the fixed pipeline would modulate the texture.
+		unsigned tile_x = (i % columns) * HLOD_TILE_SIZE;
+		unsigned tile_y = (i / columns) * HLOD_TILE_SIZE;
+		for (unsigned y = 0; y < HLOD_TILE_SIZE; ++y)
+		{
+			int offset_y = ((int)y - HLOD_TILE_BORDER) % (int)repeat_size;
+			unsigned source_y = offset_y < 0 ? offset_y + repeat_size : offset_y;
+			for (unsigned x = 0; x < HLOD_TILE_SIZE; ++x)
+			{
+				int offset_x = ((int)x - HLOD_TILE_BORDER) % (int)repeat_size;
+				unsigned source_x = offset_x < 0 ? offset_x + repeat_size : offset_x;
+				for (unsigned c = 0; c < 4; ++c)
+				{
+					unsigned char texel = tile != nullptr ? (*tile)[(source_y * repeat_size + source_x) * 4 + c] : 255;
+					atlas[((tile_y + y) * atlas_width + tile_x + x) * 4 + c] = (unsigned char)(texel * materials[i].tint[c]);
+				}
+			}
+		}
+	}
+
+	cluster.atlas_width = atlas_width;
+	cluster.atlas_height = atlas_height;
+	std::vector<unsigned char> next_level;
+	unsigned width = atlas_width;
+	unsigned height = atlas_height;
+	while (cluster.num_atlas_mips < HLOD_ATLAS_MIPS)
+	{
+		cluster.atlas_offsets[cluster.num_atlas_mips++] = AppendMeshFileData(data, &atlas[0], width * height * 4);
+		if (width == 1 && height == 1)
+			break;
+
+		DownsampleTexture(&atlas[0], width, height, next_level);
+		atlas.swap(next_level);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	//Soup of every mesh in scene root space, copies with the same position, tile and coordinates are welded so the
+	//simplifier sees one surface. Where the attributes differ the copies form a seam it collapses on both sides.
+	std::vector<HLODVertex> vertices;
+	std::vector<float3> positions;
+	std::vector<unsigned> indices;
+	std::unordered_map<HLODVertex, unsigned, HLODVertexHasher> welded;
+	std::vector<unsigned> mesh_remap;
+	for (unsigned i = 0; i < num_meshes; ++i)
+	{
+		const aiMesh* mesh = meshes[i].mesh;
+
+		mesh_remap.resize(mesh->mNumVertices);
+		for (unsigned j = 0; j < mesh->mNumVertices; ++j)
+		{
+			HLODVertex vertex;
+			vertex.position = TransformPosition(meshes[i].transform, mesh->mVertices[j]);
+			vertex.tex_coord = mesh->HasTextureCoords(0) ? float2(mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y) : float2(0.5f, 0.5f);
+			vertex.tile = mesh_tiles[i];
+
+			std::pair<std::unordered_map<HLODVertex, unsigned, HLODVertexHasher>::iterator, bool> inserted = welded.insert(std::make_pair(vertex, (unsigned)vertices.size()));
+			if (inserted.second)
+			{
+				vertices.push_back(vertex);
+				positions.push_back(vertex.position);
+			}
+			mesh_remap[j] = inserted.first->second;
+		}
+
+		for (unsigned j = 0; j < mesh->mNumFaces; ++j)
+			for (unsigned k = 0; k < 3; ++k)
+				indices.push_back(mesh_remap[mesh->mFaces[j].mIndices[k]]);
+	}
+	cluster.num_source_triangles = indices.size() / 3;
+
+	std::vector<unsigned> simplified;
+	unsigned target_indices = MAX(3u, (unsigned)(indices.size() * HLOD_TARGET_RATIO) / 3 * 3);
+	cluster.error = SimplifyMesh(&positions[0], positions.size(), &indices[0], indices.size(), target_indices, HLOD_MAX_ERROR, simplified);
+
+	//Unindexed with flat normals, every triangle gets its own coordinates inside its tile.
+	//Collapses never cross a seam, so the three corners of a triangle share their tile.
+	cluster.num_vertices = simplified.size();
+	std::vector<float> buffer(8 * cluster.num_vertices);
+	float3* dst_positions = (float3*)&buffer[0];
+	float3* dst_normals = (float3*)&buffer[3 * cluster.num_vertices];
+	float2* dst_tex_coords = (float2*)&buffer[6 * cluster.num_vertices];
+	for (unsigned i = 0; i < simplified.size(); i += 3)
+	{
+		const HLODVertex* triangle[3] = { &vertices[simplified[i]], &vertices[simplified[i + 1]], &vertices[simplified[i + 2]] };
+
+		float3 normal = (triangle[1]->position - triangle[0]->position).Cross(triangle[2]->position - triangle[0]->position).Normalized();
+		if (!normal.IsFinite())
+			normal = float3::unitY;
+
+		//Tiling coordinates are moved next to the origin, only the part past the repeats baked in the tile is clamped
+		float2 offset(floorf(MIN(triangle[0]->tex_coord.x, MIN(triangle[1]->tex_coord.x, triangle[2]->tex_coord.x))),
+			floorf(MIN(triangle[0]->tex_coord.y, MIN(triangle[1]->tex_coord.y, triangle[2]->tex_coord.y))));
+
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			unsigned tile = triangle[j]->tile;
+			float tile_x = (float)((tile % columns) * HLOD_TILE_SIZE + HLOD_TILE_BORDER);
+			float tile_y = (float)((tile / columns) * HLOD_TILE_SIZE + HLOD_TILE_BORDER);
+
+			float2 uv = triangle[j]->tex_coord - offset;
+			uv.x = MAX(0.0f, MIN(uv.x, (float)HLOD_TILE_REPEATS));
+			uv.y = MAX(0.0f, MIN(uv.y, (float)HLOD_TILE_REPEATS));
+
+			dst_positions[i + j] = triangle[j]->position;
+			dst_normals[i + j] = normal;
+			dst_tex_coords[i + j] = float2((tile_x + uv.x * repeat_size) / atlas_width, (tile_y + uv.y * repeat_size) / atlas_height);
+		}
+	}
+
+	cluster.vertices_offset = AppendMeshFileData(data, buffer.empty() ? nullptr : &buffer[0], buffer.size() * sizeof(float));
+}
+
+bool CookHLOD(const aiScene* scene, const std::string& folder, CookAsset& asset)
+{
+	std::vector<HLODSourceMesh> meshes;
+	unsigned num_meshes = 0;
+	RecursiveCollectMeshes(scene->mRootNode, scene, aiMatrix4x4(), num_meshes, meshes);
+
+	for (std::vector<HLODSourceMesh>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		AABB box;
+		box.SetNegativeInfinity();
+		for (unsigned i = 0; i < it->mesh->mNumVertices; ++i)
+			box.Enclose(TransformPosition(it->transform, it->mesh->mVertices[i]));
+
+		float3 center = box.CenterPoint();
+		for (unsigned i = 0; i < 3; ++i)
+			it->cell[i] = (int)floorf(center[i] / HLOD_CELL_SIZE);
+	}
+
+	std::stable_sort(meshes.begin(), meshes.end());
+
+	std::vector<char> data(sizeof(HLODFileHeader), 0);
+	std::vector<HLODFileCluster> clusters;
+	HLODTextureTiles tiles;
+	unsigned num_clustered_meshes = 0;
+	unsigned num_source_triangles = 0;
+	unsigned num_proxy_triangles = 0;
+	for (unsigned first = 0; first < meshes.size();)
+	{
+		unsigned last = first + 1;
+		while (last < meshes.size() && !(meshes[first] < meshes[last]))
+			++last;
+
+		//A lone mesh gains nothing over its own LODs
+		if (last - first >= HLOD_MIN_OBJECTS)
+		{
+			HLODFileCluster cluster;
+			CookCluster(&meshes[first], last - first, scene, folder, tiles, cluster, data);
+			clusters.push_back(cluster);
+
+			num_clustered_meshes += last - first;
+			num_source_triangles += cluster.num_source_triangles;
+			num_proxy_triangles += cluster.num_vertices / 3;
+		}
+
+		first = last;
+	}
+
+	std::string path = asset.source + HLOD_FILE_EXTENSION;
+	if (clusters.empty())
+	{
+		//Settings may have changed since the last cook, a proxy left behind would still match the source stamp
+		remove(path.c_str());
+		return true;
+	}
+
+	HLODFileHeader header;
+	header.source_size = asset.source_size;
+	header.source_time = asset.source_time;
+	header.num_clusters = clusters.size();
+	header.clusters_offset = AppendMeshFileData(data, &clusters[0], clusters.size() * sizeof(HLODFileCluster));
+	memcpy(&data[0], &header, sizeof(header));
+
+	if (!WriteCookedFile(path.c_str(), data))
+		return false;
+
+	APPLOG("HLOD %s: %u meshes in %u clusters, %u triangles reduced to %u", asset.source.c_str(), num_clustered_meshes, clusters.size(),
+		num_source_triangles, num_proxy_triangles);
+
+	asset.outputs.push_back(path);
+	return true;
+}
@@ -0,0 +1,13 @@
+#ifndef HLODCOOKER_H
+#define HLODCOOKER_H
+
+#include <string>
+
+struct CookAsset;
+struct aiScene;
+
+//Writes <source>.whlod with a simplified proxy and a texture atlas for each cell of the scene holding HLOD_MIN_OBJECTS
+//or more static meshes. Scenes without any cluster get no file, an older one is removed.
+bool CookHLOD(const aiScene* scene, const std::string& folder, CookAsset& asset);
+
+#endif // !HLODCOOKER_H
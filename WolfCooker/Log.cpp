@@ -0,0 +1,20 @@
+#include "Globals.h"
+#include <cstdio>
+#include <cstdarg>
+#include <mutex>
+
+//Cook jobs log from every thread, lines must not interleave
+static std::mutex log_mutex;
+
+void log(const char file[], int line, const char* format, ...)
+{
+	char tmp_string[4096];
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(tmp_string, 4096, format, ap);
+	va_end(ap);
+
+	std::lock_guard<std::mutex> lock(log_mutex);
+	printf("%s\n", tmp_string);
+}
@@ -0,0 +1,43 @@
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include "Globals.h"
+#include "Cooker.h"
+
+//Run from the Game folder, cooked files go next to their sources where the engine looks for them.
+//WolfCooker [-force] [-uncompressed] [-threads n] [-pack file] [folder]
+int main(int argc, char ** argv)
+{
+	const char* root = "Resources/";
+	bool force = false;
+	bool compress_textures = true;
+	const char* pack_path = nullptr;
+	unsigned num_threads = std::thread::hardware_concurrency();
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-force") == 0)
+			force = true;
+		else if (strcmp(argv[i], "-uncompressed") == 0)
+			compress_textures = false;
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			num_threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-pack") == 0 && i + 1 < argc)
+			pack_path = argv[++i];
+		else if (argv[i][0] == '-')
+		{
+			APPLOG("Usage: WolfCooker [-force] [-uncompressed] [-threads n] [-pack file] [folder]");
+			return EXIT_FAILURE;
+		}
+		else
+			root = argv[i];
+	}
+
+	Cooker cooker(root, num_threads, force, compress_textures);
+
+	//The pack is written even if some assets failed, their sources go in as they are
+	bool cooked = cooker.Run();
+	bool packed = pack_path == nullptr || cooker.WritePack(pack_path);
+
+	return cooked && packed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,308 @@
+#include "ModelCooker.h"
+#include "HLODCooker.h"
+#include "Cooker.h"
+#include "Globals.h"
+#include "MeshFile.h"
+#include "AnimationFile.h"
+#include "HLODFile.h"
+#include "MeshSimplifier.h"
+#include "MeshPreparation.h"
+#include <assimp/cimport.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <cstdio>
+#include <cstring>
+
+#pragma comment(lib, "assimp/libx86/assimp-vc140-mt.lib")
+
+static void CookMesh(const aiMesh* mesh, MeshFileSubmesh& submesh, std::vector<char>& data)
+{
+	submesh.num_vertices = mesh->mNumVertices;
+	submesh.flags = (mesh->HasNormals() ? MESH_FILE_NORMALS : 0) | (mesh->HasTextureCoords(0) ? MESH_FILE_TEX_COORDS : 0);
+
+	std::vector<float3> vertices(submesh.num_vertices);
+	for (unsigned i = 0; i < submesh.num_vertices; ++i)
+		vertices[i] = float3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+	std::vector<float3> normals;
+	if (mesh->HasNormals())
+	{
+		normals.resize(submesh.num_vertices);
+		for (unsigned i = 0; i < submesh.num_vertices; ++i)
+			normals[i] = float3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+	}
+	std::vector<float2> tex_coords;
+	if (mesh->HasTextureCoords(0))
+	{
+		tex_coords.resize(submesh.num_vertices);
+		for (unsigned i = 0; i < submesh.num_vertices; ++i)
+			tex_coords[i] = float2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+	}
+
+	submesh.num_indices = 3 * mesh->mNumFaces;
+	std::vector<unsigned> indices(submesh.num_indices);
+	for (unsigned i = 0; i < mesh->mNumFaces; ++i)
+		for (unsigned j = 0; j < 3; ++j)
+			indices[i * 3 + j] = mesh->mFaces[i].mIndices[j];
+
+	//Same preparation as ComponentMesh::Load, skinned meshes deform so they get neither meshlets nor LODs
+	MeshPreparation preparation;
+	preparation.build_meshlets = !mesh->HasBones();
+	preparation.build_lods = !mesh->HasBones();
+	PrepareMesh(&vertices[0], normals.empty() ? nullptr : &normals[0], tex_coords.empty() ? nullptr : &tex_coords[0], submesh.num_vertices,
+		indices.empty() ? nullptr : &indices[0], submesh.num_indices, preparation);
+	const std::vector<unsigned>& remap = preparation.remap;
+	const std::vector<Meshlet>& meshlets = preparation.meshlets;
+	const std::vector<std::vector<unsigned> >& levels = preparation.lod_levels;
+	const std::vector<float>& errors = preparation.lod_errors;
+	if (submesh.num_indices > 0)
+		APPLOG("Mesh %s: ACMR %.3f to %.3f, ATVR %.3f to %.3f", mesh->mName.data, preparation.source_stats.acmr, preparation.stats.acmr,
+			preparation.source_stats.atvr, preparation.stats.atvr);
+
+	AABB box;
+	box.SetNegativeInfinity();
+	box.Enclose(&vertices[0], submesh.num_vertices);
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		submesh.bounds_min[i] = box.minPoint[i];
+		submesh.bounds_max[i] = box.maxPoint[i];
+	}
+
+	//Planar like the vertex buffer of ComponentMesh
+	unsigned vertex_size = sizeof(float3);
+	submesh.vertices_offset = AppendMeshFileData(data, &vertices[0], submesh.num_vertices * sizeof(float3));
+	if (!normals.empty())
+	{
+		AppendMeshFileData(data, &normals[0], submesh.num_vertices * sizeof(float3), sizeof(float));
+		vertex_size += sizeof(float3);
+	}
+	if (!tex_coords.empty())
+	{
+		AppendMeshFileData(data, &tex_coords[0], submesh.num_vertices * sizeof(float2), sizeof(float));
+		vertex_size += sizeof(float2);
+	}
+	submesh.vertices_size = submesh.num_vertices * vertex_size;
+
+	submesh.indices_offset = AppendMeshFileData(data, indices.empty() ? nullptr : &indices[0], submesh.num_indices * sizeof(unsigned));
+
+	if (!mesh->HasBones())
+	{
+		submesh.num_lods = 1 + levels.size();
+		submesh.lods[0].indices_offset = submesh.indices_offset;
+		submesh.lods[0].num_indices = submesh.num_indices;
+		for (unsigned i = 0; i < levels.size(); ++i)
+		{
+			submesh.lods[i + 1].indices_offset = AppendMeshFileData(data, &levels[i][0], levels[i].size() * sizeof(unsigned));
+			submesh.lods[i + 1].num_indices = levels[i].size();
+			submesh.lods[i + 1].error = errors[i];
+		}
+	}
+
+	submesh.num_meshlets = meshlets.size();
+	submesh.meshlets_offset = AppendMeshFileData(data, meshlets.empty() ? nullptr : &meshlets[0], meshlets.size() * sizeof(Meshlet));
+
+	if (mesh->HasBones())
+	{
+		std::vector<MeshFileBone> bones(mesh->mNumBones);
+		std::vector<MeshFileWeight> weights;
+		for (unsigned i = 0; i < mesh->mNumBones; ++i)
+		{
+			const aiBone* bone = mesh->mBones[i];
+			bones[i].name = AppendMeshFileString(data, bone->mName.data);
+			memcpy(bones[i].bind, &bone->mOffsetMatrix.a1, 16 * sizeof(float));
+
+			weights.resize(bone->mNumWeights);
+			for (unsigned j = 0; j < bone->mNumWeights; ++j)
+			{
+				weights[j].vertex = remap[bone->mWeights[j].mVertexId];
+				weights[j].weight = bone->mWeights[j].mWeight;
+			}
+			bones[i].num_weights = weights.size();
+			bones[i].weights_offset = AppendMeshFileData(data, weights.empty() ? nullptr : &weights[0], weights.size() * sizeof(MeshFileWeight));
+		}
+		submesh.num_bones = bones.size();
+		submesh.bones_offset = AppendMeshFileData(data, &bones[0], bones.size() * sizeof(MeshFileBone));
+	}
+}
+
+static void CookMaterial(const aiMaterial* material, const std::string& folder, MeshFileMaterial& file_material, std::vector<char>& data)
+{
+	//Same as ComponentMaterial::Load, alpha keeps the component default
+	aiColor4D ambient;
+	aiColor4D diffuse;
+	aiColor4D specular;
+	material->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
+	material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+	material->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+	file_material.shiness = 0.0f;
+	if (material->Get(AI_MATKEY_SHININESS, file_material.shiness) == AI_SUCCESS)
+		file_material.shiness *= 128.0f;
+	float shine_strength = 1.0f;
+	if (material->Get(AI_MATKEY_SHININESS_STRENGTH, shine_strength) == AI_SUCCESS)
+		specular *= shine_strength;
+	for (int i = 0; i < 3; i++)
+	{
+		file_material.ambient[i] = ambient[i];
+		file_material.diffuse[i] = diffuse[i];
+		file_material.specular[i] = specular[i];
+	}
+	file_material.ambient[3] = file_material.diffuse[3] = file_material.specular[3] = 1.0f;
+
+	aiString path;
+	if (material->GetTextureCount(aiTextureType_DIFFUSE) >= 1 && material->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+		file_material.texture = AppendMeshFileString(data, folder + path.data);
+}
+
+static void AddMeshNode(const char* name, int parent, const aiMesh* mesh, const aiScene* scene, const std::string& folder, MeshFileWriter& writer,
+	const float3& position, const float3& scale, const Quat& rotation)
+{
+	MeshFileNode node;
+	node.name = AppendMeshFileString(writer.data, name);
+	node.parent = parent;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		node.position[i] = position[i];
+		node.scale[i] = scale[i];
+	}
+	memcpy(node.rotation, rotation.ptr(), sizeof(node.rotation));
+
+	if (mesh != nullptr)
+	{
+		MeshFileSubmesh submesh;
+		CookMesh(mesh, submesh, writer.data);
+		node.submesh = writer.submeshes.size();
+		writer.submeshes.push_back(submesh);
+
+		MeshFileMaterial material;
+		CookMaterial(scene->mMaterials[mesh->mMaterialIndex], folder, material, writer.data);
+		node.material = writer.materials.size();
+		writer.materials.push_back(material);
+	}
+
+	writer.nodes.push_back(node);
+}
+
+//Mirrors ModuleLevel::RecursiveLoadSceneNode, nodes with several meshes get one child per mesh
+static void RecursiveCookNode(const aiNode* scene_node, const aiScene* scene, const std::string& folder, int parent, MeshFileWriter& writer)
+{
+	aiVector3D ai_position;
+	aiVector3D ai_scaling;
+	aiQuaternion ai_rotation;
+	scene_node->mTransformation.Decompose(ai_scaling, ai_rotation, ai_position);
+	float3 position = float3(ai_position.x, ai_position.y, ai_position.z);
+	float3 scaling = float3(ai_scaling.x, ai_scaling.y, ai_scaling.z);
+	Quat rotation = Quat(ai_rotation.x, ai_rotation.y, ai_rotation.z, ai_rotation.w);
+
+	int index = writer.nodes.size();
+	const aiMesh* node_mesh = scene_node->mNumMeshes == 1 ? scene->mMeshes[scene_node->mMeshes[0]] : nullptr;
+	AddMeshNode(scene_node->mName.data, parent, node_mesh, scene, folder, writer, position, scaling, rotation);
+
+	if (scene_node->mNumMeshes > 1)
+	{
+		for (unsigned i = 0; i < scene_node->mNumMeshes; ++i)
+			AddMeshNode(scene_node->mName.data, index, scene->mMeshes[scene_node->mMeshes[i]], scene, folder, writer, float3::zero, float3::one, Quat::identity);
+	}
+
+	for (unsigned i = 0; i < scene_node->mNumChildren; ++i)
+		RecursiveCookNode(scene_node->mChildren[i], scene, folder, index, writer);
+}
+
+//Same conversion as ModuleAnimations::Load
+static bool CookAnimations(const aiScene* scene, const char* path, unsigned long long source_size, unsigned long long source_time)
+{
+	std::vector<char> data(sizeof(AnimationFileHeader), 0);
+	std::vector<AnimationFileClip> clips(scene->mNumAnimations);
+	std::vector<AnimationFileChannel> channels;
+	std::vector<float3> positions;
+	std::vector<Quat> rotations;
+	for (unsigned i = 0; i < scene->mNumAnimations; ++i)
+	{
+		const aiAnimation* scene_animation = scene->mAnimations[i];
+		double ticks_per_miliseconds = scene_animation->mTicksPerSecond / 1000;
+		clips[i].duration = (unsigned)scene_animation->mDuration / ticks_per_miliseconds;
+		clips[i].num_channels = scene_animation->mNumChannels;
+
+		channels.resize(scene_animation->mNumChannels);
+		for (unsigned j = 0; j < scene_animation->mNumChannels; ++j)
+		{
+			const aiNodeAnim* scene_nodeanim = scene_animation->mChannels[j];
+			channels[j].name = AppendMeshFileString(data, scene_nodeanim->mNodeName.data);
+
+			positions.resize(scene_nodeanim->mNumPositionKeys);
+			for (unsigned k = 0; k < positions.size(); ++k)
+			{
+				const aiVector3D& position = scene_nodeanim->mPositionKeys[k].mValue;
+				positions[k] = float3(position.x, position.y, position.z);
+			}
+			channels[j].num_positions = positions.size();
+			channels[j].positions_offset = AppendMeshFileData(data, positions.empty() ? nullptr : &positions[0], positions.size() * sizeof(float3));
+
+			rotations.resize(scene_nodeanim->mNumRotationKeys);
+			for (unsigned k = 0; k < rotations.size(); ++k)
+			{
+				const aiQuaternion& rotation = scene_nodeanim->mRotationKeys[k].mValue;
+				rotations[k] = Quat(rotation.x, rotation.y, rotation.z, rotation.w);
+			}
+			channels[j].num_rotations = rotations.size();
+			channels[j].rotations_offset = AppendMeshFileData(data, rotations.empty() ? nullptr : &rotations[0], rotations.size() * sizeof(Quat));
+		}
+		clips[i].channels_offset = AppendMeshFileData(data, channels.empty() ? nullptr : &channels[0], channels.size() * sizeof(AnimationFileChannel));
+	}
+
+	AnimationFileHeader header;
+	header.source_size = source_size;
+	header.source_time = source_time;
+	header.num_clips = clips.size();
+	header.clips_offset = AppendMeshFileData(data, &clips[0], clips.size() * sizeof(AnimationFileClip));
+	memcpy(&data[0], &header, sizeof(header));
+
+	return WriteCookedFile(path, data);
+}
+
+std::string GetModelCookSettings()
+{
+	char settings[384];
+	sprintf(settings, "wmesh %u wanim %u flags %x lod %u %u %g meshlet %u %u vcache %u %g whlod %u %g %u %g %g %u %u", MESH_FILE_VERSION, ANIMATION_FILE_VERSION,
+		MESH_IMPORT_FLAGS, MESH_LOD_MAX_LEVELS, MESH_LOD_MIN_TRIANGLES, MESH_LOD_MAX_ERROR, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, VERTEX_CACHE_SIZE,
+		OVERDRAW_THRESHOLD, HLOD_FILE_VERSION, HLOD_CELL_SIZE, HLOD_MIN_OBJECTS, HLOD_TARGET_RATIO, HLOD_MAX_ERROR, HLOD_TILE_SIZE, HLOD_ATLAS_MIPS);
+	return settings;
+}
+
+bool CookModel(CookAsset& asset)
+{
+	//Each call has its own importer, assimp is safe to use from several threads this way
+	const aiScene* scene = aiImportFile(asset.source.c_str(), MESH_IMPORT_FLAGS);
+	if (scene == nullptr)
+	{
+		APPLOG("Error importing %s: %s", asset.source.c_str(), aiGetErrorString());
+		return false;
+	}
+
+	//Texture paths are stored as the runtime would build them, relative to the working directory
+	std::string folder = asset.source.substr(0, asset.source.find_last_of('/') + 1);
+	bool cooked = true;
+
+	if (scene->mNumMeshes > 0)
+	{
+		MeshFileWriter writer;
+		RecursiveCookNode(scene->mRootNode, scene, folder, -1, writer);
+
+		std::string path = asset.source + MESH_FILE_EXTENSION;
+		cooked = writer.Write(path.c_str(), asset.source_size, asset.source_time);
+		if (cooked)
+			asset.outputs.push_back(path);
+
+		//Proxies are baked from the sources here, the runtime only loads them
+		cooked = cooked && CookHLOD(scene, folder, asset);
+	}
+
+	if (cooked && scene->HasAnimations())
+	{
+		std::string path = asset.source + ANIMATION_FILE_EXTENSION;
+		cooked = CookAnimations(scene, path.c_str(), asset.source_size, asset.source_time);
+		if (cooked)
+			asset.outputs.push_back(path);
+	}
+
+	aiReleaseImport(scene);
+	return cooked;
+}
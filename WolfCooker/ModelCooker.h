@@ -0,0 +1,15 @@
+#ifndef MODELCOOKER_H
+#define MODELCOOKER_H
+
+#include <string>
+
+struct CookAsset;
+
+//Format versions and the constants that change the cooked data, a different string cooks every model again
+std::string GetModelCookSettings();
+
+//Writes <source>.wmesh with the scene as ModuleLevel::ImportScene would build it, <source>.wanim with its clips
+//and <source>.whlod with the proxies of its static meshes
+bool CookModel(CookAsset& asset);
+
+#endif // !MODELCOOKER_H
@@ -0,0 +1,167 @@
+#include "TextureCooker.h"
+#include "TextureEncoder.h"
+#include "Cooker.h"
+#include "Globals.h"
+#include "TextureFile.h"
+#include "MeshFile.h"
+#include "MappedFile.h"
+#include <IL/il.h>
+#include <IL/ilu.h>
+#include <algorithm>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+
+#pragma comment( lib, "DevIL/libx86/DevIL.lib" )
+#pragma comment( lib, "DevIL/libx86/ILU.lib" )
+
+//DevIL keeps the bound image in global state, only one thread can decode at a time
+static std::mutex devil_mutex;
+static bool compress_textures = true;
+
+//Normal maps are named like Batman_Face_N.tga, their X and Y go to BC5
+static bool IsNormalMap(const std::string& source)
+{
+	size_t dot = source.find_last_of('.');
+	std::string name = source.substr(0, dot);
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	const char* suffixes[] = { "_n", "_normal", "_nrm" };
+	for (unsigned i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i)
+	{
+		size_t length = strlen(suffixes[i]);
+		if (name.size() > length && name.compare(name.size() - length, length, suffixes[i]) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void InitTextureCooker(bool compress)
+{
+	compress_textures = compress;
+	ilInit();
+	iluInit();
+}
+
+void ShutdownTextureCooker()
+{
+	ilShutDown();
+}
+
+std::string GetTextureCookSettings()
+{
+	char settings[64];
+	sprintf(settings, "wtex %u %s", TEXTURE_FILE_VERSION, compress_textures ? "bc" : "uncompressed");
+	return settings;
+}
+
+bool DecodeTexture(const std::string& source, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height)
+{
+	std::lock_guard<std::mutex> lock(devil_mutex);
+
+	ILuint image = ilGenImage();
+	ilBindImage(image);
+	if (!ilLoadImage(source.c_str()))
+	{
+		ILenum error = ilGetError();
+		APPLOG("Error %d decoding %s: %s", error, source.c_str(), iluErrorString(error));
+		ilDeleteImage(image);
+		return false;
+	}
+
+	//ilutGLTexImage flips images stored top to bottom, the cooked rows already come bottom to top
+	if (ilGetInteger(IL_IMAGE_ORIGIN) == IL_ORIGIN_UPPER_LEFT)
+		iluFlipImage();
+
+	//Mips and blocks are made from RGBA after the decoder is released, other threads can decode meanwhile
+	ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+	width = ilGetInteger(IL_IMAGE_WIDTH);
+	height = ilGetInteger(IL_IMAGE_HEIGHT);
+	rgba.assign(ilGetData(), ilGetData() + width * height * 4);
+
+	ilDeleteImage(image);
+	return true;
+}
+
+bool CookTexture(CookAsset& asset)
+{
+	std::vector<unsigned char> level;
+	unsigned width = 0;
+	unsigned height = 0;
+	if (!DecodeTexture(asset.source, level, width, height))
+		return false;
+
+	//Many images have an alpha channel with nothing in it, those go opaque
+	bool has_alpha = false;
+	for (unsigned i = 3; i < level.size() && !has_alpha; i += 4)
+		has_alpha = level[i] != 255;
+
+	std::vector<char> data(sizeof(TextureFileHeader), 0);
+	TextureFileHeader header;
+	header.source_size = asset.source_size;
+	header.source_time = asset.source_time;
+	header.width = width;
+	header.height = height;
+	header.content_hash = asset.content_hash;
+	if (compress_textures)
+		header.format = IsNormalMap(asset.source) ? TEXTURE_FORMAT_BC5 : (has_alpha ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1);
+	else
+		header.format = has_alpha ? TEXTURE_FORMAT_RGBA8 : TEXTURE_FORMAT_RGB8;
+
+	std::vector<unsigned char> encoded;
+	std::vector<unsigned char> next_level;
+	while (header.num_mips < TEXTURE_FILE_MAX_MIPS)
+	{
+		TextureFileMip& mip = header.mips[header.num_mips++];
+		mip.width = width;
+		mip.height = height;
+		mip.size = GetTextureMipSize(header.format, width, height);
+
+		encoded.resize(mip.size);
+		EncodeTexture(header.format, &level[0], width, height, &encoded[0]);
+		mip.offset = AppendMeshFileData(data, &encoded[0], mip.size);
+
+		if (width == 1 && height == 1)
+			break;
+
+		DownsampleTexture(&level[0], width, height, next_level);
+		level.swap(next_level);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	memcpy(&data[0], &header, sizeof(header));
+
+	std::string path = asset.source + TEXTURE_FILE_EXTENSION;
+	if (!WriteCookedFile(path.c_str(), data))
+		return false;
+
+	asset.outputs.push_back(path);
+	return true;
+}
+
+bool CopyCookedTexture(CookAsset& asset, const CookAsset& original)
+{
+	if (original.failed || original.outputs.empty())
+		return false;
+
+	//Up to date originals are restamped after cooking, the stamp they have is not checked
+	MappedFile file;
+	const TextureFileHeader* original_header = file.Open(original.outputs[0].c_str()) ? (const TextureFileHeader*)file.GetData() : nullptr;
+	if (original_header == nullptr || file.GetSize() < sizeof(TextureFileHeader) ||
+		ValidateTextureFile(file.GetData(), file.GetSize(), original_header->source_size, original_header->source_time) == nullptr)
+		return false;
+
+	std::vector<char> data(file.GetData(), file.GetData() + file.GetSize());
+	TextureFileHeader* header = (TextureFileHeader*)&data[0];
+	header->source_size = asset.source_size;
+	header->source_time = asset.source_time;
+
+	std::string path = asset.source + TEXTURE_FILE_EXTENSION;
+	if (!WriteCookedFile(path.c_str(), data))
+		return false;
+
+	asset.outputs.push_back(path);
+	return true;
+}
@@ -0,0 +1,24 @@
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include <string>
+#include <vector>
+
+struct CookAsset;
+
+//Without compression textures are cooked as RGB8 or RGBA8, for drivers without BC support
+void InitTextureCooker(bool compress);
+void ShutdownTextureCooker();
+
+//Format version and compression of the cooked images, a different string cooks every texture again
+std::string GetTextureCookSettings();
+
+//RGBA8 rows bottom to top, as the cooked mips store them. Safe to call from several threads.
+bool DecodeTexture(const std::string& source, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height);
+
+//Writes <source>.wtex with the mip chain of the image, block compressed unless disabled
+bool CookTexture(CookAsset& asset);
+//Writes the cooked file of a texture with the same content as original, which is cooked already
+bool CopyCookedTexture(CookAsset& asset, const CookAsset& original);
+
+#endif // !TEXTURECOOKER_H
@@ -0,0 +1,271 @@
+#include "TextureEncoder.h"
+#include "TextureFile.h"
+#include "Globals.h"
+#include <emmintrin.h>
+#include <cstring>
+
+//Iterations that find the main axis of the colors in a block, more barely move it
+#define COLOR_AXIS_ITERATIONS 4
+
+void DownsampleTexture(const unsigned char* rgba, unsigned width, unsigned height, std::vector<unsigned char>& mip)
+{
+	unsigned mip_width = width > 1 ? width / 2 : 1;
+	unsigned mip_height = height > 1 ? height / 2 : 1;
+	mip.resize(mip_width * mip_height * 4);
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i rounding = _mm_set1_epi16(2);
+	for (unsigned y = 0; y < mip_height; ++y)
+	{
+		const unsigned char* top = rgba + 2 * y * width * 4;
+		const unsigned char* bottom = rgba + MIN(2 * y + 1, height - 1) * width * 4;
+		unsigned char* out = &mip[y * mip_width * 4];
+
+		//Two texels of the mip at a time from four of each row, channels widened to 16 bits for the sums
+		unsigned x = 0;
+		for (; x + 2 <= mip_width; x += 2)
+		{
+			__m128i top_texels = _mm_loadu_si128((const __m128i*)(top + x * 8));
+			__m128i bottom_texels = _mm_loadu_si128((const __m128i*)(bottom + x * 8));
+			__m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top_texels, zero), _mm_unpacklo_epi8(bottom_texels, zero));
+			__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top_texels, zero), _mm_unpackhi_epi8(bottom_texels, zero));
+			left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+			right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+
+			__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), rounding), 2);
+			_mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, sum));
+		}
+
+		for (; x < mip_width; ++x)
+		{
+			unsigned left = 2 * x * 4;
+			unsigned right = MIN(2 * x + 1, width - 1) * 4;
+			for (unsigned c = 0; c < 4; ++c)
+				out[x * 4 + c] = (unsigned char)((top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2) / 4);
+		}
+	}
+}
+
+static unsigned short PackColor(const float* color)
+{
+	int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((MIN(MAX(r, 0), 31) << 11) | (MIN(MAX(g, 0), 63) << 5) | MIN(MAX(b, 0), 31));
+}
+
+static void UnpackColor(unsigned short packed, int* color)
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+//BC1 block of the 16 texels, always in the four color mode BC3 needs too
+static void EncodeColorBlock(const unsigned char* block, unsigned char* out)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (unsigned i = 0; i < 16; ++i)
+		for (unsigned c = 0; c < 3; ++c)
+			mean[c] += block[i * 4 + c] / 16.0f;
+
+	//Covariance as rr, rg, rb, gg, gb, bb
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		float r = block[i * 4] - mean[0];
+		float g = block[i * 4 + 1] - mean[1];
+		float b = block[i * 4 + 2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	//Power iteration from the covariance of the channel that varies the most, the colors spread the most along the axis it converges to
+	unsigned channel = covariance[0] >= covariance[3] && covariance[0] >= covariance[5] ? 0 : (covariance[3] >= covariance[5] ? 1 : 2);
+	const unsigned columns[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+	float axis[3] = { covariance[columns[channel][0]], covariance[columns[channel][1]], covariance[columns[channel][2]] };
+	for (unsigned i = 0; i < COLOR_AXIS_ITERATIONS; ++i)
+	{
+		float r = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float g = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float b = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = MAX(MAX(r < 0.0f ? -r : r, g < 0.0f ? -g : g), b < 0.0f ? -b : b);
+		if (length < 1e-6f)
+			break;
+
+		axis[0] = r / length;
+		axis[1] = g / length;
+		axis[2] = b / length;
+	}
+
+	unsigned min_texel = 0;
+	unsigned max_texel = 0;
+	float min_dot = 0.0f;
+	float max_dot = 0.0f;
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		float dot = block[i * 4] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+		if (i == 0 || dot < min_dot)
+		{
+			min_dot = dot;
+			min_texel = i;
+		}
+		if (i == 0 || dot > max_dot)
+		{
+			max_dot = dot;
+			max_texel = i;
+		}
+	}
+
+	//The ends move a sixteenth of the range inwards, the interpolated colors cover the texels between them better
+	float max_color[3];
+	float min_color[3];
+	for (unsigned c = 0; c < 3; ++c)
+	{
+		float inset = (block[max_texel * 4 + c] - block[min_texel * 4 + c]) / 16.0f;
+		max_color[c] = block[max_texel * 4 + c] - inset;
+		min_color[c] = block[min_texel * 4 + c] + inset;
+	}
+
+	unsigned short color0 = PackColor(max_color);
+	unsigned short color1 = PackColor(min_color);
+	if (color0 < color1)
+	{
+		unsigned short swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+
+	unsigned indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		UnpackColor(color0, palette[0]);
+		UnpackColor(color1, palette[1]);
+		for (unsigned c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (unsigned i = 0; i < 16; ++i)
+		{
+			unsigned best = 0;
+			int best_distance = 0;
+			for (unsigned j = 0; j < 4; ++j)
+			{
+				int r = block[i * 4] - palette[j][0];
+				int g = block[i * 4 + 1] - palette[j][1];
+				int b = block[i * 4 + 2] - palette[j][2];
+				int distance = r * r + g * g + b * b;
+				if (j == 0 || distance < best_distance)
+				{
+					best = j;
+					best_distance = distance;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+
+	out[0] = (unsigned char)(color0 & 0xFF);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xFF);
+	out[3] = (unsigned char)(color1 >> 8);
+	for (unsigned i = 0; i < 4; ++i)
+		out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+//BC4 block of one channel of the 16 texels, in the mode with six values between the ends
+static void EncodeChannelBlock(const unsigned char* block, unsigned channel, unsigned char* out)
+{
+	unsigned char min_value = block[channel];
+	unsigned char max_value = block[channel];
+	for (unsigned i = 1; i < 16; ++i)
+	{
+		min_value = MIN(min_value, block[i * 4 + channel]);
+		max_value = MAX(max_value, block[i * 4 + channel]);
+	}
+
+	out[0] = max_value;
+	out[1] = min_value;
+
+	unsigned long long indices = 0;
+	if (max_value != min_value)
+	{
+		int palette[8] = { max_value, min_value };
+		for (unsigned i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * max_value + i * min_value + 3) / 7;
+
+		for (unsigned i = 0; i < 16; ++i)
+		{
+			unsigned best = 0;
+			int best_distance = 256;
+			for (unsigned j = 0; j < 8; ++j)
+			{
+				int distance = block[i * 4 + channel] - palette[j];
+				distance = distance < 0 ? -distance : distance;
+				if (distance < best_distance)
+				{
+					best = j;
+					best_distance = distance;
+				}
+			}
+			indices |= (unsigned long long)best << (3 * i);
+		}
+	}
+
+	for (unsigned i = 0; i < 6; ++i)
+		out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+void EncodeTexture(unsigned format, const unsigned char* rgba, unsigned width, unsigned height, unsigned char* encoded)
+{
+	if (format == TEXTURE_FORMAT_RGBA8)
+	{
+		memcpy(encoded, rgba, width * height * 4);
+		return;
+	}
+
+	if (format == TEXTURE_FORMAT_RGB8)
+	{
+		for (unsigned i = 0; i < width * height; ++i)
+			memcpy(encoded + i * 3, rgba + i * 4, 3);
+		return;
+	}
+
+	unsigned block_size = format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+	unsigned char block[16 * 4];
+	for (unsigned block_y = 0; block_y < height; block_y += 4)
+	{
+		for (unsigned block_x = 0; block_x < width; block_x += 4)
+		{
+			for (unsigned y = 0; y < 4; ++y)
+				for (unsigned x = 0; x < 4; ++x)
+					memcpy(block + (y * 4 + x) * 4, rgba + (MIN(block_y + y, height - 1) * width + MIN(block_x + x, width - 1)) * 4, 4);
+
+			switch (format)
+			{
+			case TEXTURE_FORMAT_BC1:
+				EncodeColorBlock(block, encoded);
+				break;
+			case TEXTURE_FORMAT_BC3:
+				EncodeChannelBlock(block, 3, encoded);
+				EncodeColorBlock(block, encoded + 8);
+				break;
+			case TEXTURE_FORMAT_BC5:
+				EncodeChannelBlock(block, 0, encoded);
+				EncodeChannelBlock(block, 1, encoded + 8);
+				break;
+			}
+			encoded += block_size;
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#ifndef TEXTUREENCODER_H
+#define TEXTUREENCODER_H
+
+#include <vector>
+
+//Next mip level of an RGBA8 image, 2x2 box filter. Odd sides drop their last row or column like glGenerateMipmap.
+void DownsampleTexture(const unsigned char* rgba, unsigned width, unsigned height, std::vector<unsigned char>& mip);
+
+//Writes GetTextureMipSize(format, width, height) bytes of the RGBA8 image in one of the TEXTURE_FORMAT_ formats.
+//BC formats take edge texels again to fill the blocks past the sides.
+void EncodeTexture(unsigned format, const unsigned char* rgba, unsigned width, unsigned height, unsigned char* encoded);
+
+#endif // !TEXTUREENCODER_H
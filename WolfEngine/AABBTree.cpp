@@ -0,0 +1,511 @@
+#include "AABBTree.h"
+#include "SpatialQuery.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "Color.h"
+#include "TraversalStack.h"
+#include "Brofiler/include/Brofiler.h"
+
+typedef TraversalStack<AABB_TREE_STACK_SIZE> AABBTreeStack;
+
+static AABB Union(const AABB& first, const AABB& second)
+{
+	AABB ret = first;
+	ret.Enclose(second);
+	return ret;
+}
+
+AABBTree::AABBTree()
+{
+}
+
+AABBTree::~AABBTree()
+{
+}
+
+unsigned AABBTree::Insert(GameObject* object, const AABB& box)
+{
+	if (!box.IsFinite())
+		return INVALID_AABB_NODE;
+
+	unsigned leaf = AllocateNode();
+	nodes[leaf].object = object;
+	nodes[leaf].object_box = box;
+	nodes[leaf].box = FattenBox(box);
+	nodes[leaf].height = 0;
+	InsertLeaf(leaf);
+	++num_objects;
+
+	return leaf;
+}
+
+void AABBTree::Remove(unsigned leaf)
+{
+	if (leaf == INVALID_AABB_NODE)
+		return;
+
+	RemoveLeaf(leaf);
+	ReleaseNode(leaf);
+	--num_objects;
+}
+
+void AABBTree::Update(unsigned leaf, const AABB& box)
+{
+	if (leaf == INVALID_AABB_NODE || !box.IsFinite())
+		return;
+
+	AABBTreeNode& node = nodes[leaf];
+	node.object_box = box;
+
+	if (!node.moved && !node.box.Contains(box))
+	{
+		node.moved = true;
+		moved_leaves.push_back(leaf);
+	}
+}
+
+void AABBTree::Refit()
+{
+	BROFILER_CATEGORY("AABBTree-Refit", Profiler::Color::Blue);
+
+	for (std::vector<unsigned>::const_iterator it = moved_leaves.begin(); it != moved_leaves.end(); ++it)
+	{
+		unsigned leaf = *it;
+
+		//The node may have been removed or reused since it was queued
+		if (nodes[leaf].height != 0 || !nodes[leaf].moved)
+			continue;
+
+		nodes[leaf].moved = false;
+		AABB fat_box = FattenBox(nodes[leaf].object_box);
+
+		if (!fat_box.Intersects(nodes[leaf].box))
+		{
+			//Jumped away: refitting would stretch every ancestor, reinsert instead
+			RemoveLeaf(leaf);
+			nodes[leaf].box = fat_box;
+			InsertLeaf(leaf);
+		}
+		else
+		{
+			//Refit upwards until an ancestor already encloses the change
+			nodes[leaf].box = fat_box;
+			for (unsigned index = nodes[leaf].parent; index != INVALID_AABB_NODE; index = nodes[index].parent)
+			{
+				AABB previous = nodes[index].box;
+				FitNode(index);
+				Rotate(index);
+
+				if (previous.Contains(nodes[index].box))
+					break;
+			}
+		}
+	}
+
+	moved_leaves.clear();
+}
+
+void AABBTree::Clear()
+{
+	nodes.clear();
+	moved_leaves.clear();
+	free_nodes = INVALID_AABB_NODE;
+	root = INVALID_AABB_NODE;
+	num_objects = 0;
+}
+
+void AABBTree::Draw() const
+{
+	if (root == INVALID_AABB_NODE)
+		return;
+
+	AABBTreeStack stack;
+	stack.Push(root);
+	while (!stack.Empty())
+	{
+		const AABBTreeNode& node = nodes[stack.Pop()];
+		App->renderer->debug_drawer->DrawBoundingBox(node.box, node.IsLeaf() ? Colors::Yellow : Colors::Fuchsia);
+
+		if (!node.IsLeaf())
+		{
+			stack.Push(node.left);
+			stack.Push(node.right);
+		}
+	}
+}
+
+void AABBTree::IntersectCandidates(std::vector<GameObject*>& candidates, const Frustum& frustum) const
+{
+	if (root == INVALID_AABB_NODE)
+		return;
+
+	AABBTreeStack stack;
+	stack.Push(root);
+	while (!stack.Empty())
+	{
+		const AABBTreeNode& node = nodes[stack.Pop()];
+		if (IsOutsideFrustum(frustum, node.box))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			if (!IsOutsideFrustum(frustum, node.object_box))
+				candidates.push_back(node.object);
+		}
+		else
+		{
+			stack.Push(node.left);
+			stack.Push(node.right);
+		}
+	}
+}
+
+void AABBTree::Query(SpatialQuery& query) const
+{
+	if (root == INVALID_AABB_NODE)
+		return;
+
+	AABBTreeStack stack;
+	float distance = query.TestBounds(nodes[root].box);
+	if (distance < 0.0f)
+		return;
+
+	stack.Push(root, distance);
+	while (!stack.Empty())
+	{
+		unsigned node_index = stack.Pop(&distance);
+		//The query may have shrunk its range since the node was pushed
+		if (distance > query.GetMaxDistance())
+			continue;
+
+		const AABBTreeNode& node = nodes[node_index];
+		if (node.IsLeaf())
+		{
+			query.TestObject(node.object, node.object_box);
+			continue;
+		}
+
+		float left_distance = query.TestBounds(nodes[node.left].box);
+		float right_distance = query.TestBounds(nodes[node.right].box);
+
+		//Push the furthest child first so the closest one is visited next
+		unsigned children[2] = { node.left, node.right };
+		float children_distances[2] = { left_distance, right_distance };
+		if (left_distance < right_distance)
+		{
+			Swap(children[0], children[1]);
+			Swap(children_distances[0], children_distances[1]);
+		}
+
+		for (unsigned i = 0; i < 2; ++i)
+		{
+			if (children_distances[i] >= 0.0f)
+				stack.Push(children[i], children_distances[i]);
+		}
+	}
+}
+
+unsigned AABBTree::AllocateNode()
+{
+	unsigned index;
+	if (free_nodes != INVALID_AABB_NODE)
+	{
+		index = free_nodes;
+		free_nodes = nodes[index].parent;
+		nodes[index] = AABBTreeNode();
+	}
+	else
+	{
+		index = nodes.size();
+		nodes.push_back(AABBTreeNode());
+	}
+
+	return index;
+}
+
+void AABBTree::ReleaseNode(unsigned node)
+{
+	nodes[node] = AABBTreeNode();
+	nodes[node].parent = free_nodes;
+	free_nodes = node;
+}
+
+void AABBTree::InsertLeaf(unsigned leaf)
+{
+	if (root == INVALID_AABB_NODE)
+	{
+		root = leaf;
+		nodes[leaf].parent = INVALID_AABB_NODE;
+		return;
+	}
+
+	//Descend towards the sibling with the lowest surface area cost
+	AABB leaf_box = nodes[leaf].box;
+	unsigned index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		unsigned left = nodes[index].left;
+		unsigned right = nodes[index].right;
+
+		float area = nodes[index].box.SurfaceArea();
+		float combined_area = Union(nodes[index].box, leaf_box).SurfaceArea();
+
+		//Cost of a new parent for this node and the leaf, and the cost pushed down to the children
+		float cost = 2.0f * combined_area;
+		float inheritance_cost = 2.0f * (combined_area - area);
+
+		float cost_left = Union(leaf_box, nodes[left].box).SurfaceArea() + inheritance_cost;
+		if (!nodes[left].IsLeaf())
+			cost_left -= nodes[left].box.SurfaceArea();
+
+		float cost_right = Union(leaf_box, nodes[right].box).SurfaceArea() + inheritance_cost;
+		if (!nodes[right].IsLeaf())
+			cost_right -= nodes[right].box.SurfaceArea();
+
+		if (cost < cost_left && cost < cost_right)
+			break;
+
+		index = cost_left < cost_right ? left : right;
+	}
+
+	unsigned sibling = index;
+	unsigned old_parent = nodes[sibling].parent;
+	unsigned new_parent = AllocateNode();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+	nodes[new_parent].box = Union(leaf_box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	if (old_parent != INVALID_AABB_NODE)
+	{
+		if (nodes[old_parent].left == sibling)
+			nodes[old_parent].left = new_parent;
+		else
+			nodes[old_parent].right = new_parent;
+	}
+	else
+		root = new_parent;
+
+	for (index = nodes[leaf].parent; index != INVALID_AABB_NODE; index = nodes[index].parent)
+	{
+		index = Balance(index);
+		FitNode(index);
+	}
+}
+
+void AABBTree::RemoveLeaf(unsigned leaf)
+{
+	if (leaf == root)
+	{
+		root = INVALID_AABB_NODE;
+		return;
+	}
+
+	unsigned parent = nodes[leaf].parent;
+	unsigned grand_parent = nodes[parent].parent;
+	unsigned sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	if (grand_parent != INVALID_AABB_NODE)
+	{
+		if (nodes[grand_parent].left == parent)
+			nodes[grand_parent].left = sibling;
+		else
+			nodes[grand_parent].right = sibling;
+		nodes[sibling].parent = grand_parent;
+		ReleaseNode(parent);
+
+		for (unsigned index = grand_parent; index != INVALID_AABB_NODE; index = nodes[index].parent)
+		{
+			index = Balance(index);
+			FitNode(index);
+		}
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = INVALID_AABB_NODE;
+		ReleaseNode(parent);
+	}
+
+	nodes[leaf].parent = INVALID_AABB_NODE;
+}
+
+void AABBTree::FitNode(unsigned node)
+{
+	AABBTreeNode& fit = nodes[node];
+	fit.box = Union(nodes[fit.left].box, nodes[fit.right].box);
+	fit.height = 1 + MAX(nodes[fit.left].height, nodes[fit.right].height);
+}
+
+unsigned AABBTree::Balance(unsigned a)
+{
+	//AVL style rotation of the taller child above its parent
+	if (nodes[a].IsLeaf() || nodes[a].height < 2)
+		return a;
+
+	unsigned b = nodes[a].left;
+	unsigned c = nodes[a].right;
+	int balance = nodes[c].height - nodes[b].height;
+
+	if (balance > 1)
+	{
+		unsigned f = nodes[c].left;
+		unsigned g = nodes[c].right;
+
+		nodes[c].left = a;
+		nodes[c].parent = nodes[a].parent;
+		nodes[a].parent = c;
+
+		if (nodes[c].parent != INVALID_AABB_NODE)
+		{
+			if (nodes[nodes[c].parent].left == a)
+				nodes[nodes[c].parent].left = c;
+			else
+				nodes[nodes[c].parent].right = c;
+		}
+		else
+			root = c;
+
+		if (nodes[f].height > nodes[g].height)
+		{
+			nodes[c].right = f;
+			nodes[a].right = g;
+			nodes[g].parent = a;
+		}
+		else
+		{
+			nodes[c].right = g;
+			nodes[a].right = f;
+			nodes[f].parent = a;
+		}
+
+		FitNode(a);
+		FitNode(c);
+		return c;
+	}
+
+	if (balance < -1)
+	{
+		unsigned d = nodes[b].left;
+		unsigned e = nodes[b].right;
+
+		nodes[b].left = a;
+		nodes[b].parent = nodes[a].parent;
+		nodes[a].parent = b;
+
+		if (nodes[b].parent != INVALID_AABB_NODE)
+		{
+			if (nodes[nodes[b].parent].left == a)
+				nodes[nodes[b].parent].left = b;
+			else
+				nodes[nodes[b].parent].right = b;
+		}
+		else
+			root = b;
+
+		if (nodes[d].height > nodes[e].height)
+		{
+			nodes[b].right = d;
+			nodes[a].left = e;
+			nodes[e].parent = a;
+		}
+		else
+		{
+			nodes[b].right = e;
+			nodes[a].left = d;
+			nodes[d].parent = a;
+		}
+
+		FitNode(a);
+		FitNode(b);
+		return b;
+	}
+
+	return a;
+}
+
+void AABBTree::Rotate(unsigned node)
+{
+	//Swap a child with a grandchild on the other side when it shrinks the surface area of that side
+	unsigned left = nodes[node].left;
+	unsigned right = nodes[node].right;
+
+	float best_gain = 0.0f;
+	unsigned best_child = INVALID_AABB_NODE;
+	unsigned best_grand_child = INVALID_AABB_NODE;
+
+	if (!nodes[right].IsLeaf())
+	{
+		float area = nodes[right].box.SurfaceArea();
+		float gain = area - Union(nodes[left].box, nodes[nodes[right].right].box).SurfaceArea();
+		if (gain > best_gain)
+		{
+			best_gain = gain;
+			best_child = left;
+			best_grand_child = nodes[right].left;
+		}
+
+		gain = area - Union(nodes[left].box, nodes[nodes[right].left].box).SurfaceArea();
+		if (gain > best_gain)
+		{
+			best_gain = gain;
+			best_child = left;
+			best_grand_child = nodes[right].right;
+		}
+	}
+
+	if (!nodes[left].IsLeaf())
+	{
+		float area = nodes[left].box.SurfaceArea();
+		float gain = area - Union(nodes[right].box, nodes[nodes[left].right].box).SurfaceArea();
+		if (gain > best_gain)
+		{
+			best_gain = gain;
+			best_child = right;
+			best_grand_child = nodes[left].left;
+		}
+
+		gain = area - Union(nodes[right].box, nodes[nodes[left].left].box).SurfaceArea();
+		if (gain > best_gain)
+		{
+			best_gain = gain;
+			best_child = right;
+			best_grand_child = nodes[left].right;
+		}
+	}
+
+	if (best_child != INVALID_AABB_NODE)
+	{
+		unsigned other_child = nodes[best_grand_child].parent;
+		SwapSubtrees(best_child, best_grand_child);
+		FitNode(other_child);
+		FitNode(node);
+	}
+}
+
+void AABBTree::SwapSubtrees(unsigned first, unsigned second)
+{
+	unsigned first_parent = nodes[first].parent;
+	unsigned second_parent = nodes[second].parent;
+
+	if (nodes[first_parent].left == first)
+		nodes[first_parent].left = second;
+	else
+		nodes[first_parent].right = second;
+
+	if (nodes[second_parent].left == second)
+		nodes[second_parent].left = first;
+	else
+		nodes[second_parent].right = first;
+
+	nodes[first].parent = second_parent;
+	nodes[second].parent = first_parent;
+}
+
+AABB AABBTree::FattenBox(const AABB& box) const
+{
+	return AABB(box.minPoint - float3(AABB_TREE_MARGIN), box.maxPoint + float3(AABB_TREE_MARGIN));
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include "Math.h"
+#include "Globals.h"
+#include <vector>
+
+#define INVALID_AABB_NODE 0xFFFFFFFF
+//Leaves are enlarged by this margin so small motions don't touch the tree
+#define AABB_TREE_MARGIN 0.25f
+//Traversals keep this many nodes on the call stack, degenerate trees spill the rest to the heap
+#define AABB_TREE_STACK_SIZE 256
+
+class GameObject;
+class SpatialQuery;
+
+struct AABBTreeNode
+{
+	bool IsLeaf() const { return left == INVALID_AABB_NODE; }
+
+	AABB box;
+	//Tight box of the object, leaves only
+	AABB object_box;
+	GameObject* object = nullptr;
+
+	//Next free node while the node is in the free list
+	unsigned parent = INVALID_AABB_NODE;
+	unsigned left = INVALID_AABB_NODE;
+	unsigned right = INVALID_AABB_NODE;
+
+	//0 for leaves, -1 for free nodes
+	int height = -1;
+	bool moved = false;
+};
+
+class AABBTree
+{
+public:
+	AABBTree();
+	~AABBTree();
+
+	unsigned Insert(GameObject* object, const AABB& box);
+	void Remove(unsigned leaf);
+	void Update(unsigned leaf, const AABB& box);
+	void Refit();
+	void Clear();
+
+	void Draw() const;
+	void IntersectCandidates(std::vector<GameObject*>& candidates, const Frustum& frustum) const;
+	void Query(SpatialQuery& query) const;
+
+	unsigned GetNumObjects() const { return num_objects; }
+	int GetHeight() const { return root != INVALID_AABB_NODE ? nodes[root].height : 0; }
+
+private:
+	unsigned AllocateNode();
+	void ReleaseNode(unsigned node);
+
+	void InsertLeaf(unsigned leaf);
+	void RemoveLeaf(unsigned leaf);
+	void FitNode(unsigned node);
+	unsigned Balance(unsigned node);
+	void Rotate(unsigned node);
+	void SwapSubtrees(unsigned first, unsigned second);
+
+	AABB FattenBox(const AABB& box) const;
+
+private:
+	std::vector<AABBTreeNode> nodes;
+	unsigned free_nodes = INVALID_AABB_NODE;
+	unsigned root = INVALID_AABB_NODE;
+	unsigned num_objects = 0;
+
+	//Leaves that left their fat box since the last Refit
+	std::vector<unsigned> moved_leaves;
+};
+
+#endif // !AABBTREE_H
\ No newline at end of file
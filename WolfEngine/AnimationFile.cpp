@@ -0,0 +1,18 @@
+#include "AnimationFile.h"
+
+const AnimationFileHeader* ValidateAnimationFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time)
+{
+	if (data == nullptr || size < sizeof(AnimationFileHeader))
+		return nullptr;
+
+	const AnimationFileHeader* header = (const AnimationFileHeader*)data;
+	if (header->magic != ANIMATION_FILE_MAGIC || header->version != ANIMATION_FILE_VERSION ||
+		header->source_size != source_size || header->source_time != source_time)
+		return nullptr;
+
+	//Clip table must be inside the file, the channels and keys it points to are trusted
+	if (header->clips_offset + (unsigned long long)header->num_clips * sizeof(AnimationFileClip) > size)
+		return nullptr;
+
+	return header;
+}
@@ -0,0 +1,40 @@
+#ifndef ANIMATIONFILE_H
+#define ANIMATIONFILE_H
+
+#define ANIMATION_FILE_EXTENSION ".wanim"
+#define ANIMATION_FILE_MAGIC 0x4D4E4157
+#define ANIMATION_FILE_VERSION 1
+
+//Clips of an imported file with their keys already converted, offsets count from the start of the file
+struct AnimationFileHeader
+{
+	unsigned magic = ANIMATION_FILE_MAGIC;
+	unsigned version = ANIMATION_FILE_VERSION;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	unsigned num_clips = 0;
+	unsigned clips_offset = 0;
+};
+
+struct AnimationFileClip
+{
+	//Milliseconds
+	unsigned duration = 0;
+	unsigned num_channels = 0;
+	unsigned channels_offset = 0;
+};
+
+//Positions are 3 floats and rotations 4 (x, y, z, w) per key
+struct AnimationFileChannel
+{
+	unsigned name = 0;
+	unsigned num_positions = 0;
+	unsigned positions_offset = 0;
+	unsigned num_rotations = 0;
+	unsigned rotations_offset = 0;
+};
+
+//Null if the file is not valid or was made from a different source
+const AnimationFileHeader* ValidateAnimationFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time);
+
+#endif // !ANIMATIONFILE_H
@@ -5,10 +5,13 @@
 #include "ModuleLevel.h"
 #include "ModuleCamera.h"
 #include "ModuleTextures.h"
+#include "ModuleResources.h"
 #include "ModuleAnimations.h"
 #include "ModulePhysics.h"
 #include "ModuleAudio.h"
 #include "JsonHandler.h"
+#include "JobSystem.h"
+#include "FileSystem.h"
 #include "TimerUs.h"
 #include "ModuleSceneIni.h"
 #include "ModuleEditor.h"
@@ -26,11 +29,26 @@ Application::Application()
 
 	parser = new JSONParser(CONFIGJSON);
 
+	//The main thread takes part in every job, so one worker less than hardware threads
+	unsigned hardware_threads = std::thread::hardware_concurrency();
+	jobs = new JobSystem(hardware_threads > 1 ? hardware_threads - 1 : 0);
+
+	//Mounted before any module loads, the config itself stays a loose file
+	files = new FileSystem();
+	if (parser->LoadObject(APP_SECTION))
+	{
+		const char* pack = parser->GetString("PackFile");
+		if (pack != nullptr && pack[0] != '\0')
+			files->Mount(pack);
+		parser->UnloadObject();
+	}
+
 	modules.push_back(input = new ModuleInput(parser));
 	modules.push_back(time_controller = new ModuleTimeController());
 	modules.push_back(window = new ModuleWindow());
 	modules.push_back(renderer = new ModuleRender());
 	modules.push_back(camera = new ModuleCamera());
+	modules.push_back(resources = new ModuleResources());
 	modules.push_back(animations = new ModuleAnimations());
 	modules.push_back(physics = new ModulePhysics());
 	modules.push_back(level = new ModuleLevel());
@@ -51,6 +69,8 @@ Application::~Application()
 	for (std::list<Module*>::iterator it = modules.begin(); it != modules.end(); ++it)
 		RELEASE(*it);
 
+	RELEASE(files);
+	RELEASE(jobs);
 	RELEASE(parser);
 }
 
@@ -9,12 +9,15 @@
 #define APP_SECTION "Config.App"
 
 class JSONParser;
+class JobSystem;
+class FileSystem;
 
 class ModuleInput;
 class ModuleWindow;
 class ModuleRender;
 class ModuleCamera;
 class ModuleTextures;
+class ModuleResources;
 class ModuleLevel;
 class ModuleAnimations;
 class ModuleAudio;
@@ -43,6 +46,7 @@ public:
 	ModuleAnimations* animations;
 	ModuleCamera* camera;
 	ModuleTextures* textures;
+	ModuleResources* resources;
 	ModuleAudio* audio;
 	ModuleTimeController* time_controller;
 	ModulePhysics* physics;
@@ -52,6 +56,8 @@ public:
 	ModuleSceneIni* scene_ini;
 
 	JSONParser* parser;
+	JobSystem* jobs;
+	FileSystem* files;
 
 private:
 	std::list<Module*> modules;
@@ -3,16 +3,19 @@
 #include "ModuleRender.h"
 #include "Color.h"
 #include "ModuleTextures.h"
+#include "ModuleResources.h"
 #include "OpenGL.h"
 
 
 Billboard::Billboard(aiString & texture, float3 position, float up, float right) : position(position), up(up), right(right)
 {
-	this->texture = App->textures->LoadTexture(texture);
+	texture_resource = App->textures->LoadTexture(texture);
+	this->texture = App->textures->GetTextureId(texture_resource);
 }
 
 Billboard::~Billboard()
 {
+	App->resources->Release(texture_resource);
 }
 
 void Billboard::ComputeQuad(float3 camera)
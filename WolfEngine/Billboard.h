@@ -20,6 +20,7 @@ public:
 private:
 	const float3 up_vector = float3(0.0f, 1.0f, 0.0f);
 	unsigned int texture;
+	unsigned int texture_resource;
 	float3 vertices[4];
 	float up, right;
 };
@@ -24,11 +24,13 @@ void Collider::SetShapeOnMeshes()
 
 	float3* vert_total = new float3[numvert_total];
 	unsigned offset = 0;
+	std::vector<float3> vertices;
 	for (std::vector<ComponentMesh*>::iterator it = meshes.begin(); it != meshes.end(); ++it)
 	{
 		unsigned num_vertices = (*it)->GetNumVertices();
+		(*it)->ReadVertices(vertices);
 		float3* vertex_pointer = &(vert_total[offset]);
-		memcpy(vertex_pointer, (*it)->GetVertices(), num_vertices * sizeof(float3));
+		memcpy(vertex_pointer, vertices.data(), num_vertices * sizeof(float3));
 		offset += num_vertices;
 	}
 
@@ -40,6 +42,10 @@ void Collider::SetShapeOnMeshes()
 void Collider::SetMeshes(std::vector<ComponentMesh*>& meshes)
 {
 	this->meshes = meshes;
+
+	//Mesh shapes are built from the positions again whenever the collider changes
+	for (std::vector<ComponentMesh*>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+		(*it)->KeepCpuCopies();
 }
 
 void Collider::RecalculateLocalTransform(const float3& position)
@@ -1,10 +1,14 @@
 #include "ComponentAnim.h"
 #include "Application.h"
 #include "ModuleAnimations.h"
+#include "ModuleResources.h"
+#include "ModuleCamera.h"
 #include "ComponentTransform.h"
 #include "GameObject.h"
+#include "Skeleton.h"
 #include "Interface.h"
 #include <vector>
+#include <climits>
 #include <assimp/scene.h>
 
 
@@ -14,6 +18,10 @@ ComponentAnim::ComponentAnim(GameObject * parent) : Component(Component::Type::A
 
 ComponentAnim::~ComponentAnim()
 {
+	StopCurrent();
+
+	for (std::vector<unsigned>::iterator it = animation_resources.begin(); it != animation_resources.end(); ++it)
+		App->resources->Release(*it);
 }
 
 bool ComponentAnim::OnEditor()
@@ -21,6 +29,10 @@ bool ComponentAnim::OnEditor()
 	if (ImGui::CollapsingHeader("Animator"))
 	{
 		ImGui::Checkbox("Show bones", &draw_bones);
+		ImGui::Checkbox("Animation LOD", &use_lod);
+
+		const char* lod_names[] = { "Full rate", "Half rate", "Quarter rate", "Culled" };
+		ImGui::Text("LOD: %s", lod_names[lod]);
 
 		ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.50f);
 		ImGui::SliderInt("Blend Time", &blend_time, 10, 1000);
@@ -28,7 +40,7 @@ bool ComponentAnim::OnEditor()
 		ImGui::TextWrapped("Current animation:");
 		ImGui::TextWrapped("%s", current_animation.data);
 
-		if (anim_id != -1)
+		if (IsPlaying())
 		{
 			if (ImGui::Button("Stop"))
 				StopCurrent();
@@ -69,23 +81,37 @@ bool ComponentAnim::OnAnimationUpdate()
 {
 	BROFILER_CATEGORY("ComponentAnimation-OnAnimationUpdate", Profiler::Color::Aquamarine);
 
-	if (anim_id != -1)
+	pose_changed = false;
+
+	if (IsPlaying())
 	{
-		std::vector<GameObject*> nodes;
-		nodes.push_back(parent);
-		while (nodes.size() != 0)
+		if (nodes.empty())
+			CollectNodes();
+
+		LOD new_lod = (use_lod && App->animations->LOD_ENABLED) ? SelectLOD() : FULL_RATE;
+		bool catch_up = (lod == CULLED && new_lod != CULLED);
+		lod = new_lod;
+
+		//Instance time keeps advancing while culled, so re-entry samples the current pose
+		if (lod == CULLED)
+			return true;
+
+		unsigned rate = 1 << lod;
+		unsigned max_depth = (lod == QUARTER_RATE) ? App->animations->LOD_FAR_JOINT_DEPTH : UINT_MAX;
+
+		++frames_since_sample;
+		if (catch_up || frames_since_sample >= sample_rate || rate < sample_rate)
 		{
-			GameObject* node = nodes.back();
-			nodes.pop_back();
-			for (std::vector<GameObject*>::const_iterator it = node->childs.begin(); it != node->childs.end(); ++it)
-				nodes.push_back((*it));
-			float3 position;
-			Quat rotation;
-			bool exits = App->animations->GetTransform(anim_id, node->name.c_str(), position, rotation);
-			if (exits)
-			{
-				node->SetLocalTransform(position, rotation);
-			}
+			bool snap = catch_up || rate == 1 || !App->animations->LOD_INTERPOLATE;
+			sample_rate = rate;
+			frames_since_sample = 0;
+			interpolating = !snap;
+			SampleNodes(max_depth, snap);
+			ApplyNodes(snap ? 1.0f : 1.0f / float(sample_rate), max_depth);
+		}
+		else if (interpolating)
+		{
+			ApplyNodes(float(frames_since_sample + 1) / float(sample_rate), max_depth);
 		}
 	}
 	return true;
@@ -96,6 +122,7 @@ void ComponentAnim::LoadAnimations(const char* animation)
 	aiString new_animation = aiString();
 	new_animation.Append(animation);
 	this->animations.push_back(new_animation);
+	animation_resources.push_back(App->animations->AcquireClip(animation));
 
 	current_animation = *(animations.begin());
 }
@@ -107,6 +134,7 @@ void ComponentAnim::LoadAnimations(const std::list<std::string>& animations)
 		aiString new_animation = aiString();
 		new_animation.Append(it->c_str());
 		this->animations.push_back(new_animation);
+		animation_resources.push_back(App->animations->AcquireClip(it->c_str()));
 	}
 
 	current_animation = *(this->animations.begin());
@@ -120,7 +148,7 @@ void ComponentAnim::SetName(const char * name)
 
 void ComponentAnim::PlayAnimation(const char* name, bool loop)
 {
-	if (anim_id == -1)
+	if (!IsPlaying())
 	{
 		SetName(name);
 		PlayCurrent(loop);
@@ -134,18 +162,26 @@ void ComponentAnim::PlayAnimation(const char* name, bool loop)
 void ComponentAnim::PlayCurrent(bool loop)
 {
 	anim_id = App->animations->Play(current_animation.data, loop);
+
+	//Stagger reduced rate updates so characters don't all sample on the same frame
+	nodes.clear();
+	lod = FULL_RATE;
+	sample_rate = 1;
+	frames_since_sample = anim_id % 4;
+	interpolating = false;
 }
 
 void ComponentAnim::StopCurrent()
 {
-	if (anim_id != -1)
+	if (anim_id != INVALID_ANIM_HANDLE)
 		App->animations->Stop(anim_id);
-	anim_id = -1;
+	anim_id = INVALID_ANIM_HANDLE;
+	pose_changed = false;
 }
 
 bool ComponentAnim::IsPlaying() const
 {
-	return anim_id != -1;
+	return anim_id != INVALID_ANIM_HANDLE && App->animations->IsAlive(anim_id);
 }
 
 void ComponentAnim::BlendTo(const char* name, unsigned int duration)
@@ -156,3 +192,105 @@ void ComponentAnim::BlendTo(const char* name, unsigned int duration)
 	App->animations->BlendTo(anim_id, name, duration);
 }
 
+void ComponentAnim::CollectNodes()
+{
+	nodes.clear();
+
+	std::vector<AnimNode> stack;
+	AnimNode root_node;
+	root_node.node = parent;
+	stack.push_back(root_node);
+	while (!stack.empty())
+	{
+		AnimNode anim_node = stack.back();
+		stack.pop_back();
+		for (std::vector<GameObject*>::const_reverse_iterator it = anim_node.node->childs.rbegin(); it != anim_node.node->childs.rend(); ++it)
+		{
+			AnimNode child;
+			child.node = *it;
+			child.depth = anim_node.depth + 1;
+			stack.push_back(child);
+		}
+		anim_node.has_mesh = anim_node.node->GetComponent(Component::Type::MESH) != nullptr;
+		nodes.push_back(anim_node);
+	}
+}
+
+ComponentAnim::LOD ComponentAnim::SelectLOD() const
+{
+	AABB bounds;
+	bounds.SetNegativeInfinity();
+	for (std::vector<AnimNode>::const_iterator it = nodes.cbegin(); it != nodes.cend(); ++it)
+		if (it->has_mesh && it->node->bbox.IsFinite())
+			bounds.Enclose(it->node->bbox);
+
+	if (!bounds.IsFinite())
+		return FULL_RATE;
+
+	if (App->animations->PAUSE_CULLED && !App->camera->InsideCulling(bounds))
+		return CULLED;
+
+	float distance = bounds.Distance(App->camera->GetPosition());
+	if (distance >= App->animations->LOD_QUARTER_RATE_DISTANCE)
+		return QUARTER_RATE;
+	if (distance >= App->animations->LOD_HALF_RATE_DISTANCE)
+		return HALF_RATE;
+
+	return FULL_RATE;
+}
+
+void ComponentAnim::SampleNodes(unsigned max_depth, bool snap)
+{
+	for (std::vector<AnimNode>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+	{
+		if (it->depth > max_depth)
+			continue;
+
+		//Imported empties and bones that lost their transform have nothing to animate
+		if (it->node->transform == nullptr)
+		{
+			it->has_channel = false;
+			continue;
+		}
+
+		it->has_channel = App->animations->GetTransform(anim_id, it->node->name.c_str(), it->to_position, it->to_rotation);
+		if (it->has_channel)
+		{
+			if (snap)
+			{
+				it->from_position = it->to_position;
+				it->from_rotation = it->to_rotation;
+			}
+			else
+			{
+				it->from_position = it->node->transform->GetPosition();
+				it->from_rotation = it->node->transform->GetRotation();
+			}
+		}
+	}
+}
+
+void ComponentAnim::ApplyNodes(float lambda, unsigned max_depth)
+{
+	for (std::vector<AnimNode>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+	{
+		if (it->depth > max_depth || !it->has_channel)
+			continue;
+
+		if (lambda >= 1.0f)
+			it->node->SetLocalTransform(it->to_position, it->to_rotation);
+		else
+			it->node->SetLocalTransform(it->from_position.Lerp(it->to_position, lambda), it->from_rotation.Slerp(it->to_rotation, lambda));
+	}
+
+	//Refresh the character's global transforms so skinning this frame sees the new pose
+	if (parent->GetParent() != nullptr)
+		parent->RecursiveUpdateTransforms(parent->GetParent()->GetGlobalTransformMatrix());
+	else
+		parent->RecursiveUpdateTransforms();
+
+	if (parent->skeleton != nullptr)
+		parent->skeleton->Invalidate();
+
+	pose_changed = true;
+}
@@ -6,9 +6,30 @@
 #include <vector>
 #include <assimp/types.h>
 #include "Math.h"
+#include "ModuleAnimations.h"
 
 class ComponentAnim : public Component
 {
+public:
+	enum LOD
+	{
+		FULL_RATE = 0,
+		HALF_RATE,
+		QUARTER_RATE,
+		CULLED
+	};
+
+	struct AnimNode
+	{
+		GameObject* node = nullptr;
+		unsigned depth = 0;
+		bool has_mesh = false;
+		bool has_channel = false;
+		float3 from_position = float3::zero;
+		Quat from_rotation = Quat::identity;
+		float3 to_position = float3::zero;
+		Quat to_rotation = Quat::identity;
+	};
 
 public:
 	ComponentAnim(GameObject* parent);
@@ -30,14 +51,32 @@ public:
 	bool IsPlaying() const;
 	void BlendTo(const char* name, unsigned int duration);
 
+	LOD GetLOD() const { return lod; }
+	bool IsPoseChanged() const { return pose_changed; }
+
+private:
+	void CollectNodes();
+	LOD SelectLOD() const;
+	void SampleNodes(unsigned max_depth, bool snap);
+	void ApplyNodes(float lambda, unsigned max_depth);
+
 public:
 	bool draw_bones = true;
+	bool use_lod = true;
 
 private:
-	std::vector<GameObject*> nodes;
+	std::vector<AnimNode> nodes;
+	LOD lod = FULL_RATE;
+	unsigned frames_since_sample = 0;
+	unsigned sample_rate = 1;
+	bool interpolating = false;
+	bool pose_changed = false;
+
 	std::list<aiString> animations;
+	//Every listed clip stays loaded while the component exists, switching never waits for a load
+	std::vector<unsigned> animation_resources;
 	aiString current_animation;
-	int anim_id = -1;
+	unsigned int anim_id = INVALID_ANIM_HANDLE;
 	int blend_time = 200;
 
 	aiString backed_animation;
@@ -4,17 +4,20 @@
 #include "FreeType.h"
 #include "Application.h"
 #include "ModuleTextures.h"
+#include "ModuleResources.h"
 #include "ComponentRectTransform.h"
 #include "GameObject.h"
 
 ComponentImage::ComponentImage(GameObject* parent) : Component(Component::Type::IMAGE, parent)
 {
-	texture = App->textures->LoadTexture(aiString(path));
+	texture_resource = App->textures->LoadTexture(aiString(path));
+	texture = App->textures->GetTextureId(texture_resource);
 	rect_transform = (ComponentRectTransform*)parent->GetComponent(Component::Type::RECT_TRANSFORM);
 }
 
 ComponentImage::~ComponentImage()
 {
+	App->resources->Release(texture_resource);
 }
 
 void ComponentImage::OnDraw() const
@@ -89,7 +92,10 @@ bool ComponentImage::OnEditor()
 		if (ImGui::Button("Apply"))
 		{
 			//strcpy(path, buf);
-			texture = App->textures->LoadTexture(aiString(buf));
+			unsigned previous_resource = texture_resource;
+			texture_resource = App->textures->LoadTexture(aiString(buf));
+			texture = App->textures->GetTextureId(texture_resource);
+			App->resources->Release(previous_resource);
 			//strcpy(buf, path);
 		}
 	}
@@ -17,6 +17,7 @@ public:
 public:
 	char* path = "Resources/Default.png";
 	GLuint texture;
+	unsigned texture_resource = 0;
 	ComponentRectTransform* rect_transform = nullptr;
 };
 
@@ -1,14 +1,18 @@
 #include "ComponentMaterial.h"
 #include "Application.h"
 #include "ModuleTextures.h"
+#include "ModuleResources.h"
 #include "ModuleProgramShaders.h"
 #include "ModuleCamera.h"
+#include "ModuleLevel.h"
 #include <assimp/scene.h>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
 #include "OpenGL.h"
 #include "GameObject.h"
 #include "Interface.h"
+#include "MeshFile.h"
+#include "ObjLoader.h"
 
 ComponentMaterial::ComponentMaterial(GameObject* parent) : Component(Component::Type::MATERIAL, parent)
 {
@@ -16,6 +20,7 @@ ComponentMaterial::ComponentMaterial(GameObject* parent) : Component(Component::
 
 ComponentMaterial::~ComponentMaterial()
 {
+	App->resources->Release(texture_resource);
 }
 
 void ComponentMaterial::Load(aiMaterial* material, const aiString& folder_path)
@@ -52,21 +57,94 @@ void ComponentMaterial::Load(aiMaterial* material, const aiString& folder_path)
 	}
 }
 
+void ComponentMaterial::Load(const ObjMaterial& material, const aiString& folder_path)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		ambient[i] = material.ambient[i];
+		diffuse[i] = material.diffuse[i];
+		specular[i] = material.specular[i];
+	}
+	//Same scale the assimp path gives Ns
+	shiness = material.shininess * 128.0f;
+
+	if (!material.diffuse_map.empty())
+	{
+		aiString full_path = aiString(folder_path);
+		full_path.Append(material.diffuse_map.c_str());
+
+		LoadTexture(full_path);
+	}
+}
+
 void ComponentMaterial::LoadTexture(const aiString& texture_path)
 {
-	texture = App->textures->LoadTexture(texture_path);
+	//Released after loading the new one, so reloading the same path doesn't unload it
+	unsigned previous_resource = texture_resource;
+	texture_resource = App->textures->LoadTexture(texture_path, true);
+	texture = App->textures->GetTextureId(texture_resource);
+	texture_file = texture_path.data;
+	App->resources->Release(previous_resource);
+}
+
+void ComponentMaterial::Load(const MeshFileMaterial& material, const char* file_data)
+{
+	memcpy(ambient, material.ambient, sizeof(ambient));
+	memcpy(diffuse, material.diffuse, sizeof(diffuse));
+	memcpy(specular, material.specular, sizeof(specular));
+	shiness = material.shiness;
+
+	if (material.texture != MESH_FILE_NONE)
+	{
+		aiString path;
+		path.Set(file_data + material.texture);
+		LoadTexture(path);
+	}
+}
+
+void ComponentMaterial::Save(MeshFileMaterial& material, std::vector<char>& file_data) const
+{
+	memcpy(material.ambient, ambient, sizeof(ambient));
+	memcpy(material.diffuse, diffuse, sizeof(diffuse));
+	memcpy(material.specular, specular, sizeof(specular));
+	material.shiness = shiness;
+
+	if (!texture_file.empty())
+		material.texture = AppendMeshFileString(file_data, texture_file);
 }
 
 void ComponentMaterial::OnDraw() const
 {
-	glMaterialfv(GL_FRONT, GL_AMBIENT, ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, specular);
-	glMaterialf(GL_FRONT, GL_SHININESS, shiness);
+	MaterialDrawState state;
+	GetDrawState(state);
+	ApplyDrawState(state);
+
+	//Streamed textures get the mips for the size the object covers on screen
+	if (parent->bbox.IsFinite())
+		App->textures->UseTexture(texture_resource, 2.0f * App->camera->GetProjectedRadius(parent->bbox.MinimalEnclosingSphere()));
+}
+
+void ComponentMaterial::GetDrawState(MaterialDrawState& state) const
+{
+	memcpy(state.ambient, ambient, sizeof(ambient));
+	memcpy(state.diffuse, diffuse, sizeof(diffuse));
+	memcpy(state.specular, specular, sizeof(specular));
+	state.shiness = shiness;
+	state.texture = texture;
+	state.texture_resource = texture_resource;
+	state.has_shader = has_shader;
+}
+
+void ComponentMaterial::ApplyDrawState(const MaterialDrawState& state)
+{
+	glMaterialfv(GL_FRONT, GL_AMBIENT, state.ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, state.diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, state.specular);
+	glMaterialf(GL_FRONT, GL_SHININESS, state.shiness);
 
-	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindTexture(GL_TEXTURE_2D, state.texture);
 
-	if (has_shader) {
+	if (state.has_shader) {
 		App->program_shaders->UseProgram("Prueba");
 		glUniform4f(App->program_shaders->GetUniformLocation("Prueba", "light_position"), 1, 1, 1, 0);
 		float3 camera = App->camera->GetPosition();
@@ -75,25 +153,40 @@ void ComponentMaterial::OnDraw() const
 	}
 }
 
+bool ComponentMaterial::IsBatchCompatible(const ComponentMaterial& other) const
+{
+	return texture == other.texture && has_shader == other.has_shader && shiness == other.shiness &&
+		memcmp(ambient, other.ambient, sizeof(ambient)) == 0 &&
+		memcmp(diffuse, other.diffuse, sizeof(diffuse)) == 0 &&
+		memcmp(specular, other.specular, sizeof(specular)) == 0;
+}
+
 bool ComponentMaterial::OnEditor()
 {
 	if (on_editor)
 	{
 		if (ImGui::CollapsingHeader("Material"))
 		{
-			ImGui::Checkbox("Active##Material", &enable);
+			bool changed = ImGui::Checkbox("Active##Material", &enable);
 
 			ImGui::SameLine();
 
 			if (ImGui::Button("Delete##Material"))
+			{
 				parent->DeleteComponent(this);
+				return false;
+			}
+
+			changed |= ImGui::Checkbox("Has Shader", &has_shader);
 
-			ImGui::Checkbox("Has Shader", &has_shader);
+			changed |= ImGui::DragFloat4("Ambient", (float*)&ambient, 0.01f, 0.0f, 1.0f);
+			changed |= ImGui::DragFloat4("Diffuse", (float*)&diffuse, 0.01f, 0.0f, 1.0f);
+			changed |= ImGui::DragFloat4("Specular", (float*)&specular, 0.01f, 0.0f, 1.0f);
+			changed |= ImGui::DragFloat("Shiness", (float*)&shiness, 1.0f, 0.0f, 128.0f);
 
-			ImGui::DragFloat4("Ambient", (float*)&ambient, 0.01f, 0.0f, 1.0f);
-			ImGui::DragFloat4("Diffuse", (float*)&diffuse, 0.01f, 0.0f, 1.0f);
-			ImGui::DragFloat4("Specular", (float*)&specular, 0.01f, 0.0f, 1.0f);
-			ImGui::DragFloat("Shiness", (float*)&shiness, 1.0f, 0.0f, 128.0f);
+			//Batches copied the material when baked
+			if (changed && parent->batched)
+				App->level->InvalidateStaticBatches();
 		}
 
 		return ImGui::IsItemClicked();
@@ -2,9 +2,25 @@
 #define COMPONENTMATERIAL_H
 
 #include "Component.h"
+#include <vector>
+#include <string>
 
 struct aiMaterial;
 struct aiString;
+struct MeshFileMaterial;
+struct ObjMaterial;
+
+//What a material sets when drawn, copied by draws that outlive the component
+struct MaterialDrawState
+{
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float shiness = 0.0f;
+	unsigned texture = 0;
+	unsigned texture_resource = 0;
+	bool has_shader = false;
+};
 
 class ComponentMaterial : public Component
 {
@@ -13,11 +29,25 @@ public:
 	~ComponentMaterial();
 
 	void Load(aiMaterial* material, const aiString& folder_path);
+	void Load(const ObjMaterial& material, const aiString& folder_path);
 	void LoadTexture(const aiString& texture_path);
+	void Load(const MeshFileMaterial& material, const char* file_data);
+	void Save(MeshFileMaterial& material, std::vector<char>& file_data) const;
 
 	void OnDraw() const;
+	void GetDrawState(MaterialDrawState& state) const;
+	//Texture streaming is left to the caller, it needs the size the draw covers on screen
+	static void ApplyDrawState(const MaterialDrawState& state);
 	bool OnEditor();
 
+	//Both materials set the same state, meshes using either can share a draw call
+	bool IsBatchCompatible(const ComponentMaterial& other) const;
+
+	unsigned GetTexture() const { return texture; }
+	unsigned GetTextureResource() const { return texture_resource; }
+	const float* GetDiffuse() const { return diffuse; }
+	bool HasShader() const { return has_shader; }
+
 	void SaveComponent();
 	void RestoreComponent();
 
@@ -27,6 +57,8 @@ private:
 	float specular[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	float shiness = 0.0f;
 	unsigned texture = 0;
+	unsigned texture_resource = 0;
+	std::string texture_file;
 	bool has_shader = false;
 	char* shader = nullptr;
 
@@ -1,4 +1,5 @@
 #include "ComponentMesh.h"
+#include "ComponentMaterial.h"
 #include <assimp/scene.h>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
@@ -8,8 +9,31 @@
 #include "Application.h"
 #include "ModuleRender.h"
 #include "ModuleLevel.h"
+#include "ModuleCamera.h"
+#include "ModuleAnimations.h"
+#include "ModuleProgramShaders.h"
+#include "ModuleResources.h"
 #include "Primitive.h"
 #include "Interface.h"
+#include "JobSystem.h"
+#include "TimerUs.h"
+#include "MeshFile.h"
+#include "MeshPreparation.h"
+#include "VertexQuantization.h"
+#include "ObjLoader.h"
+#include <cstddef>
+
+template<class T>
+static void ReadBufferData(GLenum target, unsigned buffer, unsigned offset, unsigned count, std::vector<T>& result)
+{
+	result.resize(count);
+	if (count == 0)
+		return;
+
+	glBindBuffer(target, buffer);
+	glGetBufferSubData(target, offset, count * sizeof(T), &result[0]);
+	glBindBuffer(target, 0);
+}
 
 ComponentMesh::ComponentMesh(GameObject* parent) : Component(Component::Type::MESH, parent)
 {
@@ -17,11 +41,19 @@ ComponentMesh::ComponentMesh(GameObject* parent) : Component(Component::Type::ME
 
 ComponentMesh::~ComponentMesh()
 {
+	if (float_buffer_id != 0)
+		glDeleteBuffers(1, (GLuint*) &(float_buffer_id));
+
+	if (mesh_resource != INVALID_RESOURCE_HANDLE)
+	{
+		App->resources->Release(mesh_resource);
+		return;
+	}
+
 	RELEASE_ARRAY(vertices);
 	RELEASE_ARRAY(normals);
 	RELEASE_ARRAY(tex_coords);
 	RELEASE_ARRAY(indices);
-	RELEASE_ARRAY(buffer);
 
 	if (has_bones)
 	{
@@ -30,14 +62,22 @@ ComponentMesh::~ComponentMesh()
 			RELEASE_ARRAY(bones[i].weights);
 		}
 		RELEASE_ARRAY(bones);
+		RELEASE_ARRAY(influences);
+		RELEASE_ARRAY(skinned);
+
+		if (skin_buffer_id != 0)
+			glDeleteBuffers(1, (GLuint*) &(skin_buffer_id));
 	}
 
+	glDeleteBuffers(1, (GLuint*) &(buffer_id));
 	glDeleteBuffers(1, (GLuint*) &(vertices_id));
 	if (has_normals)
 		glDeleteBuffers(1, (GLuint*) &(normals_id));
 	if (has_tex_coords)
 		glDeleteBuffers(1, (GLuint*) &(texture_id));
 	glDeleteBuffers(1, (GLuint*) &(indices_id));
+	for (unsigned i = 1; i < lods.size(); ++i)
+		glDeleteBuffers(1, (GLuint*) &(lods[i].indices_id));
 }
 
 void ComponentMesh::Load(aiMesh* mesh, bool is_dynamic)
@@ -45,70 +85,50 @@ void ComponentMesh::Load(aiMesh* mesh, bool is_dynamic)
 	if (is_dynamic)
 		draw_mode = GL_DYNAMIC_DRAW;
 
-	int float_dimension = 3;
 	has_normals = mesh->HasNormals();
-	if (has_normals)
-		float_dimension += 3;
 	has_tex_coords = mesh->HasTextureCoords(0);
-	if (has_tex_coords)
-		float_dimension += 2;
+	has_bones = mesh->HasBones();
 
 	num_vertices = mesh->mNumVertices;
-	buffer = new float[float_dimension * num_vertices];
 	vertices = new float3[num_vertices];
-	unsigned c = 0;
 	for (size_t i = 0; i < num_vertices; ++i)
 		for (size_t j = 0; j < 3; ++j)
-		{
-			buffer[c++] = mesh->mVertices[i][j];
 			vertices[i][j] = mesh->mVertices[i][j];
-		}
 
 	SetAABB();
 
-	normals = new float3[num_vertices];
 	if (has_normals)
 	{
+		normals = new float3[num_vertices];
 		for (size_t i = 0; i < num_vertices; ++i)
 			for (size_t j = 0; j < 3; ++j)
-			{
-				buffer[c++] = mesh->mNormals[i][j];
 				normals[i][j] = mesh->mNormals[i][j];
-			}
 	}
 
-	tex_coords = new float2[num_vertices];
 	if (has_tex_coords)
 	{
+		tex_coords = new float2[num_vertices];
 		for (size_t i = 0; i < num_vertices; ++i)
 			for (size_t j = 0; j < 2; ++j)
-			{
-				buffer[c++] = mesh->mTextureCoords[0][i][j];
 				tex_coords[i][j] = mesh->mTextureCoords[0][i][j];
-			}
 	}
 
-	glGenBuffers(1, (GLuint*) &(buffer_id));
-	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-	glBufferData(GL_ARRAY_BUFFER, float_dimension * sizeof(float) * num_vertices, buffer, draw_mode);
-
 	num_indices = 3 * mesh->mNumFaces;
 	indices = new unsigned[num_indices];
 
-	c = 0;
+	unsigned c = 0;
 	for (size_t j = 0; j < mesh->mNumFaces; ++j)
 		for (size_t k = 0; k < 3; ++k)
 			indices[c++] = mesh->mFaces[j].mIndices[k];
 	if (c != 3 * mesh->mNumFaces)
 		APPLOG("Error loading meshes: Incorrect number of indices");
 
-	glGenBuffers(1, (GLuint*) &(indices_id));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * num_indices, indices, draw_mode);
+	//Skinned and dynamic meshes deform, their error bounds wouldn't hold
+	std::vector<unsigned> remap;
+	OptimizeAndUpload(!is_dynamic && !mesh->HasBones(), !is_dynamic && !mesh->HasBones(), remap);
 
-	if (mesh->HasBones())
+	if (has_bones)
 	{
-		has_bones = true;
 		num_bones = mesh->mNumBones;
 		bones = new Bone[num_bones];
 		for (int i = 0; i < mesh->mNumBones; i++)
@@ -123,13 +143,16 @@ void ComponentMesh::Load(aiMesh* mesh, bool is_dynamic)
 			for (int j = 0; j < bones[i].num_weights; j++)
 			{
 				bones[i].weights[j].weight = scene_bone->mWeights[j].mWeight;
-				bones[i].weights[j].vertex = scene_bone->mWeights[j].mVertexId;
+				bones[i].weights[j].vertex = remap[scene_bone->mWeights[j].mVertexId];
 			}
 		}
 	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	ReportFormats();
+	ReleaseCpuCopies();
 }
 
 void ComponentMesh::Load(const Primitive& primitive)
@@ -137,14 +160,9 @@ void ComponentMesh::Load(const Primitive& primitive)
 	num_vertices = primitive.GetNumVertices();
 	num_indices = primitive.GetNumIndices();
 
-	int float_dimension = 3;
 	has_normals = true;
 	has_tex_coords = true;
-	if (has_normals)
-		float_dimension += 3;
-	if (has_tex_coords)
-		float_dimension += 2;
-	buffer = new float[float_dimension * num_vertices];
+	has_bones = false;
 
 	vertices = new float3[num_vertices];
 	normals = new float3[num_vertices];
@@ -153,43 +171,357 @@ void ComponentMesh::Load(const Primitive& primitive)
 
 	primitive.LoadMesh(vertices, tex_coords, normals, indices);
 
-	unsigned c = 0;
-	for (size_t i = 0; i < num_vertices; ++i)
-		for (size_t j = 0; j < 3; ++j)
+	SetAABB();
+
+	UploadVertices(vertices, normals, tex_coords);
+	indices_id = UploadIndices(indices, num_indices, draw_mode);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	ReportFormats();
+	ReleaseCpuCopies();
+}
+
+void ComponentMesh::Load(const ObjMesh& mesh, bool is_dynamic)
+{
+	if (is_dynamic)
+		draw_mode = GL_DYNAMIC_DRAW;
+
+	has_normals = !mesh.normals.empty();
+	has_tex_coords = !mesh.tex_coords.empty();
+	has_bones = false;
+
+	num_vertices = mesh.positions.size();
+	vertices = new float3[num_vertices];
+	memcpy(vertices, &mesh.positions[0], num_vertices * sizeof(float3));
+
+	SetAABB();
+
+	if (has_normals)
+	{
+		normals = new float3[num_vertices];
+		memcpy(normals, &mesh.normals[0], num_vertices * sizeof(float3));
+	}
+
+	if (has_tex_coords)
+	{
+		tex_coords = new float2[num_vertices];
+		memcpy(tex_coords, &mesh.tex_coords[0], num_vertices * sizeof(float2));
+	}
+
+	num_indices = mesh.indices.size();
+	indices = new unsigned[num_indices];
+	memcpy(indices, &mesh.indices[0], num_indices * sizeof(unsigned));
+
+	std::vector<unsigned> remap;
+	OptimizeAndUpload(!is_dynamic, !is_dynamic, remap);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	ReportFormats();
+	ReleaseCpuCopies();
+}
+
+void ComponentMesh::Load(const MeshFileSubmesh& submesh, const char* file_data, bool is_dynamic)
+{
+	if (is_dynamic)
+		draw_mode = GL_DYNAMIC_DRAW;
+
+	has_normals = (submesh.flags & MESH_FILE_NORMALS) != 0;
+	has_tex_coords = (submesh.flags & MESH_FILE_TEX_COORDS) != 0;
+	num_vertices = submesh.num_vertices;
+	num_indices = submesh.num_indices;
+
+	//The planar stream is the float vertex buffer as is, the CPU copies are block copies of its parts
+	const float* stream = (const float*)(file_data + submesh.vertices_offset);
+	const float3* file_vertices = (const float3*)stream;
+	const float3* file_normals = has_normals ? (const float3*)(stream + 3 * num_vertices) : nullptr;
+	const float2* file_tex_coords = has_tex_coords ? (const float2*)(stream + (has_normals ? 6 : 3) * num_vertices) : nullptr;
+	has_bones = submesh.num_bones > 0;
+	if (has_bones)
+	{
+		vertices = new float3[num_vertices];
+		memcpy(vertices, file_vertices, num_vertices * sizeof(float3));
+	}
+
+	//Only what ReleaseCpuCopies would keep is copied, the bind pose for skinning
+	if (has_bones && has_normals)
+	{
+		normals = new float3[num_vertices];
+		memcpy(normals, file_normals, num_vertices * sizeof(float3));
+	}
+
+	SetAABB(AABB(float3(submesh.bounds_min), float3(submesh.bounds_max)));
+
+	UploadVertices(file_vertices, file_normals, file_tex_coords);
+
+	const unsigned* file_indices = (const unsigned*)(file_data + submesh.indices_offset);
+	indices_id = UploadIndices(file_indices, num_indices, draw_mode);
+
+	//Cooked files are built for static use, a dynamic mesh deforms and can't rely on their bounds
+	unsigned num_lods = is_dynamic ? 0 : submesh.num_lods;
+	for (unsigned i = 0; i < num_lods; ++i)
+	{
+		MeshLod lod;
+		lod.num_indices = submesh.lods[i].num_indices;
+		lod.error = submesh.lods[i].error;
+		if (i == 0)
+			lod.indices_id = indices_id;
+		else
+			lod.indices_id = UploadIndices((const unsigned*)(file_data + submesh.lods[i].indices_offset), lod.num_indices, GL_STATIC_DRAW);
+		lods.push_back(lod);
+	}
+
+	const Meshlet* file_meshlets = (const Meshlet*)(file_data + submesh.meshlets_offset);
+	if (!is_dynamic)
+		meshlets.assign(file_meshlets, file_meshlets + submesh.num_meshlets);
+
+	if (has_bones)
+	{
+		const MeshFileBone* file_bones = (const MeshFileBone*)(file_data + submesh.bones_offset);
+		num_bones = submesh.num_bones;
+		bones = new Bone[num_bones];
+		for (int i = 0; i < num_bones; i++)
 		{
-			buffer[c++] = vertices[i][j];
+			bones[i].name.Set(file_data + file_bones[i].name);
+			memcpy(bones[i].bind.v, file_bones[i].bind, 16 * sizeof(float));
+			bones[i].num_weights = file_bones[i].num_weights;
+			bones[i].weights = new Weight[bones[i].num_weights];
+			memcpy(bones[i].weights, file_data + file_bones[i].weights_offset, bones[i].num_weights * sizeof(Weight));
 		}
-	for (size_t i = 0; i < num_vertices; ++i)
-		for (size_t j = 0; j < 3; ++j)
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	ReportFormats();
+}
+
+void ComponentMesh::Save(MeshFileSubmesh& submesh, std::vector<char>& file_data) const
+{
+	submesh.flags = (has_normals ? MESH_FILE_NORMALS : 0) | (has_tex_coords ? MESH_FILE_TEX_COORDS : 0);
+	submesh.num_vertices = num_vertices;
+	submesh.num_indices = num_indices;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		submesh.bounds_min[i] = parent->initial_bbox.minPoint[i];
+		submesh.bounds_max[i] = parent->initial_bbox.maxPoint[i];
+	}
+
+	//The bind pose, the vertex buffer of a skinned mesh may hold a skinned frame
+	std::vector<float3> file_vertices;
+	std::vector<float3> file_normals;
+	std::vector<float2> file_tex_coords;
+	std::vector<unsigned> file_indices;
+	ReadVertices(file_vertices);
+	ReadNormals(file_normals);
+	ReadTexCoords(file_tex_coords);
+	ReadIndices(file_indices);
+
+	unsigned vertex_size = sizeof(float3);
+	submesh.vertices_offset = AppendMeshFileData(file_data, &file_vertices[0], num_vertices * sizeof(float3));
+	if (has_normals)
+	{
+		AppendMeshFileData(file_data, &file_normals[0], num_vertices * sizeof(float3), sizeof(float));
+		vertex_size += sizeof(float3);
+	}
+	if (has_tex_coords)
+	{
+		AppendMeshFileData(file_data, &file_tex_coords[0], num_vertices * sizeof(float2), sizeof(float));
+		vertex_size += sizeof(float2);
+	}
+	submesh.vertices_size = num_vertices * vertex_size;
+
+	submesh.indices_offset = AppendMeshFileData(file_data, &file_indices[0], num_indices * sizeof(unsigned));
+
+	//Only the GL buffers keep the coarser levels
+	std::vector<unsigned> lod_indices;
+	submesh.num_lods = lods.size();
+	for (unsigned i = 0; i < lods.size(); ++i)
+	{
+		submesh.lods[i].num_indices = lods[i].num_indices;
+		submesh.lods[i].error = lods[i].error;
+		if (i == 0)
 		{
-			buffer[c++] = normals[i][j];
+			submesh.lods[i].indices_offset = submesh.indices_offset;
+			continue;
 		}
-	for (size_t i = 0; i < num_vertices; ++i)
-		for (size_t j = 0; j < 2; ++j)
+
+		ReadIndexBuffer(lods[i].indices_id, lods[i].num_indices, lod_indices);
+		submesh.lods[i].indices_offset = AppendMeshFileData(file_data, &lod_indices[0], lods[i].num_indices * sizeof(unsigned));
+	}
+
+	submesh.num_meshlets = meshlets.size();
+	submesh.meshlets_offset = AppendMeshFileData(file_data, meshlets.empty() ? nullptr : &meshlets[0], meshlets.size() * sizeof(Meshlet));
+
+	if (has_bones)
+	{
+		std::vector<MeshFileBone> file_bones(num_bones);
+		for (int i = 0; i < num_bones; i++)
 		{
-			buffer[c++] = tex_coords[i][j];
+			file_bones[i].name = AppendMeshFileString(file_data, bones[i].name.data);
+			memcpy(file_bones[i].bind, bones[i].bind.v, 16 * sizeof(float));
+			file_bones[i].num_weights = bones[i].num_weights;
+			file_bones[i].weights_offset = AppendMeshFileData(file_data, bones[i].weights, bones[i].num_weights * sizeof(Weight));
 		}
+		submesh.num_bones = num_bones;
+		submesh.bones_offset = AppendMeshFileData(file_data, &file_bones[0], num_bones * sizeof(MeshFileBone));
+	}
+}
 
-	SetAABB();
+void ComponentMesh::ReadVertices(std::vector<float3>& result) const
+{
+	if (vertices != nullptr)
+		result.assign(vertices, vertices + num_vertices);
+	else if (quantized)
+	{
+		//Positions on the grid, as the program draws them
+		std::vector<short> quantized_vertices;
+		ReadBufferData(GL_ARRAY_BUFFER, buffer_id, 0, 4 * num_vertices, quantized_vertices);
+		result.resize(num_vertices);
+		for (unsigned i = 0; i < num_vertices; ++i)
+			for (unsigned j = 0; j < 3; ++j)
+				result[i][j] = position_offset[j] + quantized_vertices[4 * i + j] * position_scale[j];
+	}
+	else
+		ReadBufferData(GL_ARRAY_BUFFER, buffer_id, 0, num_vertices, result);
+}
 
-	glGenBuffers(1, (GLuint*) &(buffer_id));
-	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-	glBufferData(GL_ARRAY_BUFFER, float_dimension * sizeof(float) * num_vertices, buffer, draw_mode);
+void ComponentMesh::ReadNormals(std::vector<float3>& result) const
+{
+	if (!has_normals)
+		result.clear();
+	else if (normals != nullptr)
+		result.assign(normals, normals + num_vertices);
+	else if (quantized)
+	{
+		std::vector<short> encoded;
+		ReadBufferData(GL_ARRAY_BUFFER, buffer_id, num_vertices * 4 * sizeof(short), 2 * num_vertices, encoded);
+		result.resize(num_vertices);
+		for (unsigned i = 0; i < num_vertices; ++i)
+			result[i] = DecodeOctahedral(&encoded[2 * i]);
+	}
+	else
+		ReadBufferData(GL_ARRAY_BUFFER, buffer_id, num_vertices * sizeof(float3), num_vertices, result);
+}
 
-	glGenBuffers(1, (GLuint*) &(indices_id));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * num_indices, indices, draw_mode);
+void ComponentMesh::ReadTexCoords(std::vector<float2>& result) const
+{
+	//Skinning never writes the texture coordinates, the buffer always has the imported ones
+	if (!has_tex_coords)
+		result.clear();
+	else if (quantized)
+	{
+		std::vector<unsigned short> halfs;
+		unsigned offset = num_vertices * (4 + (has_normals ? 2 : 0)) * sizeof(short);
+		ReadBufferData(GL_ARRAY_BUFFER, buffer_id, offset, 2 * num_vertices, halfs);
+		result.resize(num_vertices);
+		for (unsigned i = 0; i < num_vertices; ++i)
+			result[i] = float2(HalfToFloat(halfs[2 * i]), HalfToFloat(halfs[2 * i + 1]));
+	}
+	else
+		ReadBufferData(GL_ARRAY_BUFFER, buffer_id, num_vertices * (has_normals ? 2 : 1) * sizeof(float3), num_vertices, result);
+}
 
-	has_bones = false;
+void ComponentMesh::ReadIndices(std::vector<unsigned>& result) const
+{
+	if (indices != nullptr)
+		result.assign(indices, indices + num_indices);
+	else
+		ReadIndexBuffer(indices_id, num_indices, result);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void ComponentMesh::ReadIndexBuffer(unsigned id, unsigned count, std::vector<unsigned>& result) const
+{
+	if (index_type == GL_UNSIGNED_SHORT)
+	{
+		std::vector<unsigned short> short_indices;
+		ReadBufferData(GL_ELEMENT_ARRAY_BUFFER, id, 0, count, short_indices);
+		result.assign(short_indices.begin(), short_indices.end());
+	}
+	else
+		ReadBufferData(GL_ELEMENT_ARRAY_BUFFER, id, 0, count, result);
+}
+
+unsigned ComponentMesh::GetVertexSize() const
+{
+	if (quantized)
+		return GetQuantizedVertexSize(has_normals, has_tex_coords);
+
+	return sizeof(float3) + (has_normals ? sizeof(float3) : 0) + (has_tex_coords ? sizeof(float2) : 0);
+}
+
+unsigned ComponentMesh::GetIndexSize() const
+{
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned);
+}
+
+bool ComponentMesh::LoadShared(const std::string& source)
+{
+	mesh_resource = App->resources->Find(Resource::Type::MESH, source, MESH_SETTINGS);
+	const ResourceMesh* resource = App->resources->GetMesh(mesh_resource);
+	if (resource == nullptr)
+		return false;
+
+	buffer_id = resource->buffer_id;
+	indices_id = resource->indices_id;
+	quantized = resource->quantized;
+	position_offset = resource->position_offset;
+	position_scale = resource->position_scale;
+	index_type = resource->short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	vertices = resource->vertices;
+	normals = resource->normals;
+	tex_coords = resource->tex_coords;
+	indices = resource->indices;
+	num_vertices = resource->num_vertices;
+	num_indices = resource->num_indices;
+	has_normals = resource->has_normals;
+	has_tex_coords = resource->has_tex_coords;
+	lods = resource->lods;
+	meshlets = resource->meshlets;
+
+	SetAABB(resource->bbox);
+
+	return true;
+}
+
+void ComponentMesh::Share(const std::string& source)
+{
+	//Skinning writes the vertex buffer and dynamic meshes move their vertices, neither can be shared
+	if (has_bones || draw_mode != GL_STATIC_DRAW || mesh_resource != INVALID_RESOURCE_HANDLE)
+		return;
+
+	ResourceMesh* resource = new ResourceMesh(source, MESH_SETTINGS);
+	resource->buffer_id = buffer_id;
+	resource->indices_id = indices_id;
+	resource->quantized = quantized;
+	resource->position_offset = position_offset;
+	resource->position_scale = position_scale;
+	resource->short_indices = index_type == GL_UNSIGNED_SHORT;
+	resource->vertices = vertices;
+	resource->normals = normals;
+	resource->tex_coords = tex_coords;
+	resource->indices = indices;
+	resource->num_vertices = num_vertices;
+	resource->num_indices = num_indices;
+	resource->has_normals = has_normals;
+	resource->has_tex_coords = has_tex_coords;
+	resource->lods = lods;
+	resource->meshlets = meshlets;
+	resource->bbox = parent->initial_bbox;
+
+	mesh_resource = App->resources->Add(resource);
 }
 
 void ComponentMesh::LoadBones()
 {
 	if (has_bones)
 	{
+		if (parent->root->skeleton == nullptr)
+			parent->root->skeleton = new Skeleton(parent->root);
+
 		for (int i = 0; i < num_bones; i++)
 		{
 			GameObject* bone = parent->root->FindByName(bones[i].name.data);
@@ -197,8 +529,57 @@ void ComponentMesh::LoadBones()
 			{
 				bones[i].bone_object = bone;
 				bones[i].bone_object->is_bone = true;
+				bones[i].joint = parent->root->skeleton->AddJoint(bone, bones[i].bind);
+			}
+		}
+
+		//Bone-major weights to vertex-major influences so each vertex is skinned and written once
+		RELEASE_ARRAY(influences);
+		influences = new VertexInfluences[num_vertices];
+		for (int i = 0; i < num_bones; i++)
+		{
+			if (bones[i].joint == INVALID_JOINT)
+				continue;
+
+			for (int j = 0; j < bones[i].num_weights; j++)
+				influences[bones[i].weights[j].vertex].Add(bones[i].joint, bones[i].weights[j].weight);
+		}
+
+		for (unsigned i = 0; i < num_vertices; ++i)
+			influences[i].Normalize();
+
+		if (skinned == nullptr)
+			skinned = new float3[2 * num_vertices];
+
+		//Influences become static vertex attributes when every joint fits in the shader palette
+		bool gpu_skinnable = true;
+		SkinAttributes* attributes = new SkinAttributes[num_vertices];
+		for (unsigned i = 0; i < num_vertices && gpu_skinnable; ++i)
+		{
+			for (unsigned j = 0; j < MAX_VERTEX_INFLUENCES; ++j)
+			{
+				if (influences[i].joints[j] >= MAX_SKINNING_JOINTS)
+				{
+					gpu_skinnable = false;
+					break;
+				}
+				attributes[i].joints[j] = influences[i].joints[j];
+				attributes[i].weights[j] = influences[i].weights[j];
 			}
 		}
+
+		if (gpu_skinnable)
+		{
+			if (skin_buffer_id == 0)
+				glGenBuffers(1, (GLuint*) &(skin_buffer_id));
+			glBindBuffer(GL_ARRAY_BUFFER, skin_buffer_id);
+			glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(SkinAttributes), attributes, GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		else
+			APPLOG("Mesh %s uses more than %d joints, skinning it on the CPU", parent->name.c_str(), MAX_SKINNING_JOINTS);
+
+		RELEASE_ARRAY(attributes);
 	}
 }
 
@@ -206,81 +587,99 @@ void ComponentMesh::OnUpdate()
 {
 	BROFILER_CATEGORY("ComponentMesh-OnUpdate", Profiler::Color::Aqua);
 
-	float3* vertex_pointer;
-	float3* normals_pointer = nullptr;
+	SelectLod();
+	CullMeshlets();
+	UpdateFloatFallback();
 
-	if (has_bones && parent->root->IsPlayingAnimation())
+	if (has_bones && influences != nullptr && parent->root->skeleton != nullptr && parent->root->IsPlayingAnimation())
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-		float* buffer_pointer = (float*) glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-		vertex_pointer = (float3*)buffer_pointer;
-		memset(vertex_pointer, 0, num_vertices * sizeof(float3));
-		if (has_normals)
+		if (IsGPUSkinned())
 		{
-			normals_pointer = (float3*) &(buffer_pointer[3 * num_vertices]);
-			memset(normals_pointer, 0, num_vertices * sizeof(float3));
+			//Vertex data stays static, only the palette changes
+			if (vbo_skinned)
+				ResetMesh();
+			parent->root->skeleton->UpdatePalette();
 		}
-			
-		float4x4 animation_transform = float4x4::identity;
-
-		for (int i = 0; i < num_bones; i++)
+		else if (parent->root->IsAnimationPoseChanged() || !vbo_skinned)
 		{
-			animation_transform = bones[i].bone_object->GetGlobalTransformMatrix();
-			animation_transform = bones[i].bone_object->root->GetLocalTransformMatrix().Inverted() * animation_transform;
-			animation_transform = animation_transform * bones[i].bind;
-
-			float3x3 rotation = animation_transform.Float3x3Part();
-
-			for (int j = 0; j < bones[i].num_weights; j++)
-			{
-				vertex_pointer[bones[i].weights[j].vertex] += animation_transform.TransformPos(vertices[bones[i].weights[j].vertex]) * bones[i].weights[j].weight;
-
-				if (has_normals)
-					normals_pointer[bones[i].weights[j].vertex] += rotation * normals[bones[i].weights[j].vertex] * bones[i].weights[j].weight;
-			}
+			float3* skinned_normals = has_normals ? skinned + num_vertices : nullptr;
+			SkinVertexMajor(skinned, skinned_normals);
+			UploadSkinnedMesh(skinned, skinned_normals);
+			vbo_skinned = true;
 		}
-
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-
 	}
 }
 
 void ComponentMesh::OnDraw() const
 {
+	bool gpu_skinned = IsGPUSkinned();
+	if (gpu_skinned)
+		BindSkinning(SKINNING_PROGRAM);
+
+	bool draw_quantized = quantized && float_buffer_id == 0;
+
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-	float* buffer_pointer = (float*)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-	
-	glVertexPointer(3, GL_FLOAT, 0, NULL);
-	int offset = 3;
+	glBindBuffer(GL_ARRAY_BUFFER, float_buffer_id != 0 ? float_buffer_id : buffer_id);
 
-	if (use_normals)
+	if (draw_quantized)
+		BindQuantized();
+	else
 	{
-		glEnableClientState(GL_NORMAL_ARRAY);
-		glEnable(GL_LIGHTING);
-		glNormalPointer(GL_FLOAT, 0, (char*) (offset * num_vertices * sizeof(float)));
-		offset += 3;
+		glVertexPointer(3, GL_FLOAT, 0, NULL);
+		int offset = 3;
+
+		if (use_normals)
+		{
+			//Skinned normals are scaled by the blended matrix, the skinning program normalizes them too
+			if (vbo_skinned)
+				glEnable(GL_NORMALIZE);
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glEnable(GL_LIGHTING);
+			glNormalPointer(GL_FLOAT, 0, (char*) (offset * num_vertices * sizeof(float)));
+			offset += 3;
+		}
+		else
+			glDisable(GL_LIGHTING);
+
+		if (has_tex_coords)
+		{
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glTexCoordPointer(2, GL_FLOAT, 0, (char*)(offset * num_vertices * sizeof(float)));
+			offset += 2;
+		}
 	}
-	else
-		glDisable(GL_LIGHTING);
 
-	if (has_tex_coords)
+	unsigned lod_indices_id = indices_id;
+	unsigned lod_num_indices = num_indices;
+	if (current_lod < lods.size())
 	{
-		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glTexCoordPointer(2, GL_FLOAT, 0, (char*)(offset * num_vertices * sizeof(float)));
-		offset += 2;
+		lod_indices_id = lods[current_lod].indices_id;
+		lod_num_indices = lods[current_lod].num_indices;
 	}
 
-	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod_indices_id);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-
-	glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, NULL);
+	if (use_meshlet_ranges)
+	{
+		App->level->ReportMeshDraw(current_lod, lod_num_indices / 3, meshlet_num_indices / 3);
+		if (!meshlet_counts.empty())
+			glMultiDrawElements(GL_TRIANGLES, &meshlet_counts[0], index_type, (const GLvoid**) &meshlet_offsets[0], meshlet_counts.size());
+	}
+	else
+	{
+		App->level->ReportMeshDraw(current_lod, lod_num_indices / 3, lod_num_indices / 3);
+		glDrawElements(GL_TRIANGLES, lod_num_indices, index_type, NULL);
+	}
 
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_NORMAL_ARRAY);
 	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisable(GL_NORMALIZE);
+
+	if (gpu_skinned)
+		UnbindSkinning(SKINNING_PROGRAM);
+	else if (draw_quantized)
+		UnbindQuantized();
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -311,6 +710,32 @@ bool ComponentMesh::OnEditor()
 			ImGui::Checkbox("Draw normals", &draw_normals);
 
 			ImGui::Checkbox("Draw mesh", &draw_mesh);
+
+			if (has_bones && influences != nullptr)
+			{
+				if (skin_buffer_id != 0)
+				{
+					ImGui::Checkbox("GPU skinning", &use_gpu_skinning);
+					ImGui::SameLine();
+					if (ImGui::Button("Compare CPU/GPU"))
+						CompareSkinning();
+				}
+
+				if (ImGui::Button("Benchmark skinning"))
+					BenchmarkSkinning(100);
+			}
+
+			if (meshlets.size() > 1)
+				ImGui::Text("Meshlets: %u (%u of %u triangles submitted)", meshlets.size(), use_meshlet_ranges ? meshlet_num_indices / 3 : num_indices / 3, num_indices / 3);
+
+			ImGui::Text("Format: %s vertices (%u bytes), %u bit indices", quantized ? "quantized" : "float", GetVertexSize(), 8 * GetIndexSize());
+
+			if (lods.size() > 1)
+			{
+				ImGui::Text("LOD: %u", current_lod);
+				for (unsigned i = 0; i < lods.size(); ++i)
+					ImGui::Text("- Level %u: %u triangles, error %.4f", i, lods[i].num_indices / 3, lods[i].error);
+			}
 		}
 
 		return ImGui::IsItemClicked();
@@ -337,30 +762,123 @@ void ComponentMesh::ResetMesh()
 {
 	if (has_bones)
 	{
-		float3* vertex_pointer;
-		float3* normals_pointer;
+		UploadSkinnedMesh(vertices, has_normals ? normals : nullptr);
+		vbo_skinned = false;
+	}
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-		float* buffer_pointer = (float*)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-		vertex_pointer = (float3*)buffer_pointer;
-		memcpy(vertex_pointer, vertices, num_vertices * sizeof(float3));
-		if (has_normals)
+void ComponentMesh::BenchmarkSkinning(unsigned iterations) const
+{
+	Skeleton* skeleton = parent->root->skeleton;
+	if (skeleton == nullptr || influences == nullptr || iterations == 0)
+		return;
+
+	skeleton->UpdatePalette();
+
+	float3* dst_vertices = new float3[num_vertices];
+	float3* dst_normals = has_normals ? new float3[num_vertices] : nullptr;
+	TimerUs timer;
+
+	timer.Start();
+	for (unsigned i = 0; i < iterations; ++i)
+		SkinBoneMajor(dst_vertices, dst_normals);
+	Uint64 bone_major_us = timer.GetTimeInUs();
+
+	timer.Start();
+	for (unsigned i = 0; i < iterations; ++i)
+		SkinVertices(skeleton->GetPalette(), influences, vertices, has_normals ? normals : nullptr, dst_vertices, dst_normals, 0, num_vertices);
+	Uint64 vertex_major_us = timer.GetTimeInUs();
+
+	timer.Start();
+	for (unsigned i = 0; i < iterations; ++i)
+		SkinVertexMajor(dst_vertices, dst_normals);
+	Uint64 parallel_us = timer.GetTimeInUs();
+
+	APPLOG("Skinning benchmark (%s): %u vertices, %u bones, %u iterations", parent->name.c_str(), num_vertices, num_bones, iterations);
+	APPLOG("- Bone-major scalar: %llu us/iteration", bone_major_us / iterations);
+	APPLOG("- Vertex-major SIMD: %llu us/iteration", vertex_major_us / iterations);
+	APPLOG("- Vertex-major SIMD on %u workers + main thread: %llu us/iteration", App->jobs->GetNumWorkers(), parallel_us / iterations);
+
+	RELEASE_ARRAY(dst_vertices);
+	RELEASE_ARRAY(dst_normals);
+}
+
+void ComponentMesh::CompareSkinning()
+{
+	Skeleton* skeleton = parent->root->skeleton;
+	if (skeleton == nullptr || influences == nullptr || skin_buffer_id == 0 || !App->program_shaders->HasProgram(SKINNING_CAPTURE_PROGRAM))
+		return;
+
+	//The vertex program skins the bind pose, so the buffer can't hold CPU results
+	if (vbo_skinned)
+		ResetMesh();
+
+	float3* cpu_vertices = new float3[num_vertices];
+	float3* gpu_vertices = new float3[num_vertices];
+	SkinVertexMajor(cpu_vertices, nullptr);
+
+	//Capture the skinned positions written by the vertex program with transform feedback
+	unsigned feedback_id = 0;
+	glGenBuffers(1, (GLuint*) &(feedback_id));
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedback_id);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, num_vertices * sizeof(float3), nullptr, GL_STATIC_READ);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedback_id);
+
+	BindSkinning(SKINNING_CAPTURE_PROGRAM);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+	glVertexPointer(3, GL_FLOAT, 0, NULL);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, num_vertices);
+	glEndTransformFeedback();
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	UnbindSkinning(SKINNING_CAPTURE_PROGRAM);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, num_vertices * sizeof(float3), gpu_vertices);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	glDeleteBuffers(1, (GLuint*) &(feedback_id));
+
+	float max_error = 0.0f;
+	unsigned worst_vertex = 0;
+	for (unsigned i = 0; i < num_vertices; ++i)
+	{
+		float error = cpu_vertices[i].Distance(gpu_vertices[i]);
+		if (error > max_error)
 		{
-			normals_pointer = (float3*) &(buffer_pointer[3 * num_vertices]);
-			memcpy(normals_pointer, normals, num_vertices * sizeof(float3));
+			max_error = error;
+			worst_vertex = i;
 		}
 	}
+
+	APPLOG("Skinning comparison (%s): max CPU/GPU position difference %f at vertex %u of %u", parent->name.c_str(), max_error, worst_vertex, num_vertices);
+
+	RELEASE_ARRAY(cpu_vertices);
+	RELEASE_ARRAY(gpu_vertices);
 }
 
 void ComponentMesh::DrawNormals() const
 {
+	if (!has_normals)
+		return;
+
+	std::vector<float3> debug_vertices;
+	std::vector<float3> debug_normals;
+	ReadVertices(debug_vertices);
+	ReadNormals(debug_normals);
+
 	App->renderer->debug_drawer->SetColor(Colors::Yellow);
 
 	for (int i = 0; i < num_vertices; i++)
 	{
 		glBegin(GL_LINES);
-		glVertex3f(vertices[i].x, vertices[i].y, vertices[i].z);
-		glVertex3f(vertices[i].x + normals[i].x, vertices[i].y + normals[i].y, vertices[i].z + normals[i].z);
+		glVertex3f(debug_vertices[i].x, debug_vertices[i].y, debug_vertices[i].z);
+		glVertex3f(debug_vertices[i].x + debug_normals[i].x, debug_vertices[i].y + debug_normals[i].y, debug_vertices[i].z + debug_normals[i].z);
 		glEnd();
 	}
 
@@ -369,24 +887,29 @@ void ComponentMesh::DrawNormals() const
 
 void ComponentMesh::DrawMesh() const
 {
+	std::vector<float3> debug_vertices;
+	std::vector<unsigned> debug_indices;
+	ReadVertices(debug_vertices);
+	ReadIndices(debug_indices);
+
 	App->renderer->debug_drawer->SetColor(Colors::Fuchsia);
 
 	unsigned num_triangles = num_indices / 3;
 	for (int i = 0; i < num_triangles; i++)
 	{
-		unsigned first = indices[3 *i];
-		unsigned second = indices[3 * i + 1];
-		unsigned third = indices[3 * i + 2];
+		unsigned first = debug_indices[3 *i];
+		unsigned second = debug_indices[3 * i + 1];
+		unsigned third = debug_indices[3 * i + 2];
 
 		glBegin(GL_LINES);
-		glVertex3f(vertices[first].x, vertices[first].y, vertices[first].z);
-		glVertex3f(vertices[second].x, vertices[second].y, vertices[second].z);
+		glVertex3f(debug_vertices[first].x, debug_vertices[first].y, debug_vertices[first].z);
+		glVertex3f(debug_vertices[second].x, debug_vertices[second].y, debug_vertices[second].z);
 
-		glVertex3f(vertices[second].x, vertices[second].y, vertices[second].z);
-		glVertex3f(vertices[third].x, vertices[third].y, vertices[third].z);
+		glVertex3f(debug_vertices[second].x, debug_vertices[second].y, debug_vertices[second].z);
+		glVertex3f(debug_vertices[third].x, debug_vertices[third].y, debug_vertices[third].z);
 
-		glVertex3f(vertices[third].x, vertices[third].y, vertices[third].z);
-		glVertex3f(vertices[first].x, vertices[first].y, vertices[first].z);
+		glVertex3f(debug_vertices[third].x, debug_vertices[third].y, debug_vertices[third].z);
+		glVertex3f(debug_vertices[first].x, debug_vertices[first].y, debug_vertices[first].z);
 		glEnd();
 	}
 
@@ -396,8 +919,446 @@ void ComponentMesh::DrawMesh() const
 void ComponentMesh::SetAABB() const
 {
 	//Creating BoundingBox from vertices points
-	parent->initial_bbox.SetNegativeInfinity();
-	parent->initial_bbox.Enclose((float3*)vertices, num_vertices);
+	AABB box;
+	box.SetNegativeInfinity();
+	box.Enclose((float3*)vertices, num_vertices);
+	SetAABB(box);
+}
+
+void ComponentMesh::SetAABB(const AABB& box) const
+{
+	parent->initial_bbox = box;
 	parent->bbox = parent->initial_bbox;
-	App->level->InsertGameObjectQuadTree(parent);
+	App->level->InsertGameObjectSpatialIndex(parent);
 }
+
+void ComponentMesh::UploadVertices(const float3* src_vertices, const float3* src_normals, const float2* src_tex_coords)
+{
+	//Skinning writes float positions and normals into the buffer, those meshes keep the float layout
+	quantized = !has_bones && App->level->CanQuantizeMeshes();
+	index_type = num_vertices <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	glGenBuffers(1, (GLuint*) &(buffer_id));
+	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+
+	if (quantized)
+	{
+		GetPositionQuantization(parent->initial_bbox, position_offset, position_scale);
+
+		std::vector<char> stream;
+		QuantizeVertices(src_vertices, src_normals, src_tex_coords, num_vertices, position_offset, position_scale, stream);
+		glBufferData(GL_ARRAY_BUFFER, stream.size(), stream.empty() ? nullptr : &stream[0], draw_mode);
+	}
+	else
+	{
+		//Planar: positions, then normals, then texture coordinates
+		glBufferData(GL_ARRAY_BUFFER, num_vertices * GetVertexSize(), nullptr, draw_mode);
+		unsigned offset = 0;
+		glBufferSubData(GL_ARRAY_BUFFER, offset, num_vertices * sizeof(float3), src_vertices);
+		offset += num_vertices * sizeof(float3);
+		if (has_normals)
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, offset, num_vertices * sizeof(float3), src_normals);
+			offset += num_vertices * sizeof(float3);
+		}
+		if (has_tex_coords)
+			glBufferSubData(GL_ARRAY_BUFFER, offset, num_vertices * sizeof(float2), src_tex_coords);
+	}
+}
+
+void ComponentMesh::OptimizeAndUpload(bool build_meshlets, bool build_lods, std::vector<unsigned>& remap)
+{
+	BROFILER_CATEGORY("ComponentMesh-OptimizeAndUpload", Profiler::Color::Aqua);
+
+	TimerUs timer;
+	timer.Start();
+
+	MeshPreparation preparation;
+	preparation.build_meshlets = build_meshlets;
+	preparation.build_lods = build_lods;
+	PrepareMesh(vertices, has_normals ? normals : nullptr, has_tex_coords ? tex_coords : nullptr, num_vertices, indices, num_indices, preparation);
+	remap.swap(preparation.remap);
+	meshlets.swap(preparation.meshlets);
+
+	APPLOG("Mesh %s: ACMR %.3f to %.3f, ATVR %.3f to %.3f", parent->name.c_str(), preparation.source_stats.acmr, preparation.stats.acmr,
+		preparation.source_stats.atvr, preparation.stats.atvr);
+
+	UploadVertices(vertices, normals, tex_coords);
+	indices_id = UploadIndices(indices, num_indices, draw_mode);
+
+	if (!build_lods)
+		return;
+
+	MeshLod base;
+	base.indices_id = indices_id;
+	base.num_indices = num_indices;
+	lods.push_back(base);
+
+	for (unsigned i = 0; i < preparation.lod_levels.size(); ++i)
+	{
+		MeshLod lod;
+		lod.num_indices = preparation.lod_levels[i].size();
+		lod.error = preparation.lod_errors[i];
+		lod.indices_id = UploadIndices(&preparation.lod_levels[i][0], lod.num_indices, GL_STATIC_DRAW);
+		lods.push_back(lod);
+	}
+
+	if (lods.size() > 1)
+		APPLOG("Mesh %s: %u LOD levels, %u to %u triangles, prepared in %llu us", parent->name.c_str(), lods.size(), num_indices / 3, lods.back().num_indices / 3, timer.GetTimeInUs());
+}
+
+unsigned ComponentMesh::UploadIndices(const unsigned* src_indices, unsigned count, GLenum usage) const
+{
+	unsigned id = 0;
+	glGenBuffers(1, (GLuint*) &id);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id);
+
+	if (index_type == GL_UNSIGNED_SHORT)
+	{
+		std::vector<unsigned short> short_indices(src_indices, src_indices + count);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned short), short_indices.empty() ? nullptr : &short_indices[0], usage);
+	}
+	else
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned), src_indices, usage);
+
+	return id;
+}
+
+void ComponentMesh::ReportFormats() const
+{
+	unsigned total_indices = num_indices;
+	for (unsigned i = 1; i < lods.size(); ++i)
+		total_indices += lods[i].num_indices;
+
+	unsigned float_vertex_size = sizeof(float3) + (has_normals ? sizeof(float3) : 0) + (has_tex_coords ? sizeof(float2) : 0);
+	unsigned float_bytes = num_vertices * float_vertex_size + total_indices * sizeof(unsigned);
+	unsigned bytes = num_vertices * GetVertexSize() + total_indices * GetIndexSize();
+	APPLOG("Mesh %s: %u bytes in buffers, %u saved with %s vertices and %u bit indices", parent->name.c_str(), bytes, float_bytes - bytes,
+		quantized ? "quantized" : "float", 8 * GetIndexSize());
+}
+
+void ComponentMesh::ReleaseCpuCopies()
+{
+	//Texture coordinates are only read back for baking
+	RELEASE_ARRAY(tex_coords);
+
+	//Skinning reads the bind pose every frame
+	if (has_bones)
+	{
+		RELEASE_ARRAY(indices);
+		return;
+	}
+
+	//Everything else is in the buffers, the meshes occluders and mesh colliders use get their copies back with KeepCpuCopies
+	RELEASE_ARRAY(normals);
+	RELEASE_ARRAY(vertices);
+	RELEASE_ARRAY(indices);
+}
+
+void ComponentMesh::KeepCpuCopies()
+{
+	if (vertices != nullptr && indices != nullptr)
+		return;
+
+	//Shared meshes keep the copies in the resource, the first instance reads them back for all of them
+	ResourceMesh* resource = mesh_resource != INVALID_RESOURCE_HANDLE ? App->resources->GetMesh(mesh_resource) : nullptr;
+	if (resource != nullptr && resource->vertices != nullptr && resource->indices != nullptr)
+	{
+		vertices = resource->vertices;
+		indices = resource->indices;
+		return;
+	}
+
+	if (vertices == nullptr)
+	{
+		std::vector<float3> read_vertices;
+		ReadVertices(read_vertices);
+		vertices = new float3[num_vertices];
+		memcpy(vertices, read_vertices.data(), num_vertices * sizeof(float3));
+	}
+
+	if (indices == nullptr)
+	{
+		std::vector<unsigned> read_indices;
+		ReadIndices(read_indices);
+		indices = new unsigned[num_indices];
+		memcpy(indices, read_indices.data(), num_indices * sizeof(unsigned));
+	}
+
+	if (resource != nullptr)
+	{
+		resource->vertices = vertices;
+		resource->indices = indices;
+	}
+}
+
+void ComponentMesh::SelectLod()
+{
+	if (lods.size() < 2 || !App->level->MESH_LOD || !parent->bbox.IsFinite())
+	{
+		current_lod = 0;
+		return;
+	}
+
+	//Relative errors scale with the bounding sphere, so the projected radius gives the error in pixels
+	float projected_radius = App->camera->GetProjectedRadius(parent->bbox.MinimalEnclosingSphere());
+	float pixel_error = App->level->MESH_LOD_PIXEL_ERROR;
+
+	//Switching to a coarser level needs some margin, otherwise meshes near a threshold swap every frame
+	unsigned lod = 0;
+	for (unsigned i = lods.size() - 1; i > 0; --i)
+	{
+		float threshold = i > current_lod ? pixel_error * (1.0f - App->level->MESH_LOD_HYSTERESIS) : pixel_error;
+		if (lods[i].error * projected_radius <= threshold)
+		{
+			lod = i;
+			break;
+		}
+	}
+
+	current_lod = lod;
+}
+
+void ComponentMesh::CullMeshlets()
+{
+	BROFILER_CATEGORY("ComponentMesh-CullMeshlets", Profiler::Color::Aqua);
+
+	meshlet_counts.clear();
+	meshlet_offsets.clear();
+	meshlet_num_indices = 0;
+
+	//Meshlets only cover the full detail level
+	use_meshlet_ranges = meshlets.size() > 1 && current_lod == 0 && App->level->MESHLET_CULLING;
+	if (!use_meshlet_ranges)
+		return;
+
+	const float4x4& transform = parent->GetGlobalTransformMatrix();
+	float3 scale = transform.ExtractScale();
+	float max_scale = MAX(scale.x, MAX(scale.y, scale.z));
+	float min_scale = MIN(scale.x, MIN(scale.y, scale.z));
+
+	//Cones survive rotation and uniform scale, a mirrored mesh also has its culled winding swapped
+	bool cone_culling = transform.Determinant3() > 0.0f && max_scale - min_scale <= 0.01f * max_scale;
+	float3 camera_position = App->camera->GetPosition();
+
+	const Frustum* frustum = App->camera->GetCullingFrustum();
+	Plane planes[6];
+	if (frustum != nullptr)
+		frustum->GetPlanes(planes);
+
+	unsigned range_end = 0;
+	for (std::vector<Meshlet>::const_iterator it = meshlets.begin(); it != meshlets.end(); ++it)
+	{
+		float3 center = transform.TransformPos(it->center);
+		float radius = it->radius * max_scale;
+
+		bool visible = true;
+		for (unsigned i = 0; i < 6 && frustum != nullptr && visible; ++i)
+			visible = planes[i].SignedDistance(center) <= radius;
+
+		if (visible && cone_culling && it->cone_cutoff <= 1.0f)
+			visible = !IsMeshletBackfacing(center, radius, transform.TransformDir(it->cone_axis).Normalized(), it->cone_cutoff, camera_position);
+
+		if (!visible)
+			continue;
+
+		//Consecutive visible meshlets extend the previous range
+		if (!meshlet_counts.empty() && range_end == it->first_index)
+			meshlet_counts.back() += it->num_indices;
+		else
+		{
+			meshlet_offsets.push_back((const GLvoid*)(it->first_index * GetIndexSize()));
+			meshlet_counts.push_back(it->num_indices);
+		}
+		range_end = it->first_index + it->num_indices;
+		meshlet_num_indices += it->num_indices;
+	}
+}
+
+void ComponentMesh::SkinBoneMajor(float3* dst_vertices, float3* dst_normals) const
+{
+	//Previous path, kept as the benchmark reference: scatters every bone over its vertices
+	memset(dst_vertices, 0, num_vertices * sizeof(float3));
+	if (dst_normals != nullptr)
+		memset(dst_normals, 0, num_vertices * sizeof(float3));
+
+	const float4x4* palette = parent->root->skeleton->GetPalette();
+
+	for (int i = 0; i < num_bones; i++)
+	{
+		if (bones[i].joint == INVALID_JOINT)
+			continue;
+
+		const float4x4& animation_transform = palette[bones[i].joint];
+
+		for (int j = 0; j < bones[i].num_weights; j++)
+		{
+			unsigned vertex = bones[i].weights[j].vertex;
+			dst_vertices[vertex] += animation_transform.TransformPos(vertices[vertex]) * bones[i].weights[j].weight;
+
+			if (dst_normals != nullptr)
+				dst_normals[vertex] += animation_transform.TransformDir(normals[vertex]) * bones[i].weights[j].weight;
+		}
+	}
+}
+
+void ComponentMesh::SkinVertexMajor(float3* dst_vertices, float3* dst_normals) const
+{
+	//Palette is computed once per skeleton and shared by every mesh bound to it
+	Skeleton* skeleton = parent->root->skeleton;
+	skeleton->UpdatePalette();
+	const float4x4* palette = skeleton->GetPalette();
+	const float3* src_normals = dst_normals != nullptr ? normals : nullptr;
+	const VertexInfluences* vertex_influences = influences;
+	const float3* src_vertices = vertices;
+
+	App->jobs->ParallelFor(num_vertices, SKINNING_GRAIN, [=](unsigned first, unsigned last)
+	{
+		SkinVertices(palette, vertex_influences, src_vertices, src_normals, dst_vertices, dst_normals, first, last);
+	});
+}
+
+void ComponentMesh::UploadSkinnedMesh(const float3* src_vertices, const float3* src_normals) const
+{
+	//Write-only upload, the driver never has to hand back the buffer contents
+	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * sizeof(float3), src_vertices);
+	if (src_normals != nullptr)
+		glBufferSubData(GL_ARRAY_BUFFER, num_vertices * sizeof(float3), num_vertices * sizeof(float3), src_normals);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool ComponentMesh::IsGPUSkinned() const
+{
+	return use_gpu_skinning && skin_buffer_id != 0 && App->animations->IsGPUSkinningAvailable()
+		&& parent->root->skeleton != nullptr && parent->root->IsPlayingAnimation();
+}
+
+void ComponentMesh::BindSkinning(const char* program) const
+{
+	Skeleton* skeleton = parent->root->skeleton;
+	skeleton->UpdatePalette();
+	unsigned num_joints = skeleton->GetNumJoints() < MAX_SKINNING_JOINTS ? skeleton->GetNumJoints() : MAX_SKINNING_JOINTS;
+
+	App->program_shaders->UseProgram(program);
+
+	//MathGeoLib matrices are row-major, GL transposes them on upload
+	glUniformMatrix4fv(App->program_shaders->GetUniformLocation(program, "palette"), num_joints, GL_TRUE, skeleton->GetPalette()->ptr());
+
+	GLint texture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+	glUniform1i(App->program_shaders->GetUniformLocation(program, "diffuse_texture"), 0);
+	glUniform1i(App->program_shaders->GetUniformLocation(program, "use_texture"), texture != 0);
+	glUniform1i(App->program_shaders->GetUniformLocation(program, "use_lighting"), use_normals);
+
+	int joints_location = App->program_shaders->GetAttribLocation(program, "joint_indices");
+	int weights_location = App->program_shaders->GetAttribLocation(program, "joint_weights");
+
+	glBindBuffer(GL_ARRAY_BUFFER, skin_buffer_id);
+	if (joints_location >= 0)
+	{
+		glEnableVertexAttribArray(joints_location);
+		glVertexAttribPointer(joints_location, MAX_VERTEX_INFLUENCES, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(SkinAttributes), (char*) offsetof(SkinAttributes, joints));
+	}
+	if (weights_location >= 0)
+	{
+		glEnableVertexAttribArray(weights_location);
+		glVertexAttribPointer(weights_location, MAX_VERTEX_INFLUENCES, GL_FLOAT, GL_FALSE, sizeof(SkinAttributes), (char*) offsetof(SkinAttributes, weights));
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ComponentMesh::UnbindSkinning(const char* program) const
+{
+	int joints_location = App->program_shaders->GetAttribLocation(program, "joint_indices");
+	int weights_location = App->program_shaders->GetAttribLocation(program, "joint_weights");
+	if (joints_location >= 0)
+		glDisableVertexAttribArray(joints_location);
+	if (weights_location >= 0)
+		glDisableVertexAttribArray(weights_location);
+
+	App->program_shaders->UnuseProgram();
+}
+
+void ComponentMesh::BindQuantized() const
+{
+	App->program_shaders->UseProgram(QUANTIZED_MESH_PROGRAM);
+
+	GLint texture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+	glUniform1i(App->program_shaders->GetUniformLocation(QUANTIZED_MESH_PROGRAM, "diffuse_texture"), 0);
+	glUniform1i(App->program_shaders->GetUniformLocation(QUANTIZED_MESH_PROGRAM, "use_texture"), texture != 0);
+	glUniform1i(App->program_shaders->GetUniformLocation(QUANTIZED_MESH_PROGRAM, "use_lighting"), use_normals);
+	glUniform3fv(App->program_shaders->GetUniformLocation(QUANTIZED_MESH_PROGRAM, "position_offset"), 1, position_offset.ptr());
+	glUniform3fv(App->program_shaders->GetUniformLocation(QUANTIZED_MESH_PROGRAM, "position_scale"), 1, position_scale.ptr());
+
+	//Raw grid coordinates, the program moves them onto the mesh box
+	glVertexPointer(4, GL_SHORT, 0, NULL);
+	unsigned offset = num_vertices * 4 * sizeof(short);
+
+	int normal_location = App->program_shaders->GetAttribLocation(QUANTIZED_MESH_PROGRAM, "octahedral_normal");
+	if (use_normals && normal_location >= 0)
+	{
+		glEnable(GL_LIGHTING);
+		glEnableVertexAttribArray(normal_location);
+		glVertexAttribPointer(normal_location, 2, GL_SHORT, GL_TRUE, 0, (char*) offset);
+	}
+	else
+		glDisable(GL_LIGHTING);
+	if (has_normals)
+		offset += num_vertices * 2 * sizeof(short);
+
+	if (has_tex_coords)
+	{
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_HALF_FLOAT, 0, (char*) offset);
+	}
+}
+
+void ComponentMesh::UpdateFloatFallback()
+{
+	const ComponentMaterial* material = (const ComponentMaterial*)parent->GetComponent(Component::Type::MATERIAL);
+	bool needed = quantized && material != nullptr && material->IsActive() && material->HasShader();
+	if (needed == (float_buffer_id != 0))
+		return;
+
+	if (!needed)
+	{
+		glDeleteBuffers(1, (GLuint*) &(float_buffer_id));
+		float_buffer_id = 0;
+		return;
+	}
+
+	std::vector<float3> float_vertices;
+	std::vector<float3> float_normals;
+	std::vector<float2> float_tex_coords;
+	ReadVertices(float_vertices);
+	ReadNormals(float_normals);
+	ReadTexCoords(float_tex_coords);
+
+	//Same planar layout as the float vertex buffers
+	unsigned size = num_vertices * (sizeof(float3) + (has_normals ? sizeof(float3) : 0) + (has_tex_coords ? sizeof(float2) : 0));
+	glGenBuffers(1, (GLuint*) &(float_buffer_id));
+	glBindBuffer(GL_ARRAY_BUFFER, float_buffer_id);
+	glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+	unsigned offset = 0;
+	glBufferSubData(GL_ARRAY_BUFFER, offset, num_vertices * sizeof(float3), &float_vertices[0]);
+	offset += num_vertices * sizeof(float3);
+	if (has_normals)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, offset, num_vertices * sizeof(float3), &float_normals[0]);
+		offset += num_vertices * sizeof(float3);
+	}
+	if (has_tex_coords)
+		glBufferSubData(GL_ARRAY_BUFFER, offset, num_vertices * sizeof(float2), &float_tex_coords[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ComponentMesh::UnbindQuantized() const
+{
+	int normal_location = App->program_shaders->GetAttribLocation(QUANTIZED_MESH_PROGRAM, "octahedral_normal");
+	if (normal_location >= 0)
+		glDisableVertexAttribArray(normal_location);
+
+	App->program_shaders->UnuseProgram();
+}
\ No newline at end of file
@@ -3,13 +3,27 @@
 
 #include "Component.h"
 #include "Math.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "ResourceMesh.h"
 #include <vector>
+#include <string>
 #include <assimp/types.h>
 #include "Glew/include/GL/glew.h"
 
+#define SKINNING_GRAIN 2048
+//Processing applied to shared static geometry, part of the resource key
+#define MESH_SETTINGS "static,lods,meshlets"
+#define QUANTIZED_MESH_PROGRAM "QuantizedMesh"
+#define QUANTIZED_VERTEX_SHADER "Resources/Shaders/quantized_vertex_shader.txt"
+
 class Primitive;
 
 struct aiMesh;
+struct MeshFileSubmesh;
+struct ObjMesh;
 //struct aiString;
 
 struct Weight
@@ -25,6 +39,7 @@ struct Bone
 	Weight* weights = nullptr;
 	unsigned num_weights = 0;
 	float4x4 bind;
+	unsigned joint = INVALID_JOINT;
 };
 
 class ComponentMesh : public Component
@@ -35,6 +50,14 @@ public:
 
 	void Load(aiMesh* mesh, bool is_dynamic = false);
 	void Load(const Primitive& primitive);
+	void Load(const ObjMesh& mesh, bool is_dynamic = false);
+	//Buffers are filled straight from the mapped file
+	void Load(const MeshFileSubmesh& submesh, const char* file_data, bool is_dynamic = false);
+	void Save(MeshFileSubmesh& submesh, std::vector<char>& file_data) const;
+	//Uses the geometry another static mesh loaded from the same source, false if none is loaded
+	bool LoadShared(const std::string& source);
+	//Hands the loaded geometry to a resource so the next meshes from the same source reuse it
+	void Share(const std::string& source);
 	void LoadBones();
 
 	void OnUpdate();
@@ -47,6 +70,9 @@ public:
 
 	void ResetMesh();
 
+	void BenchmarkSkinning(unsigned iterations) const;
+	void CompareSkinning();
+
 	void DrawNormals() const;
 	void DrawMesh() const;
 
@@ -54,13 +80,67 @@ public:
 
 	unsigned GetNumVertices() const { return num_vertices; }
 	unsigned GetNumIndices() const { return num_indices; }
+	//CPU copies, null once released after the upload
 	const float3* GetVertices() const { return vertices; }
 	const unsigned* GetIndices() const { return indices; }
+	const float3* GetNormals() const { return normals; }
+	const float2* GetTexCoords() const { return tex_coords; }
+	//Reads positions and indices back once and keeps them, for the meshes occluders and mesh colliders use.
+	//Main thread only, the read back waits for the GPU.
+	void KeepCpuCopies();
+	//Read back from the buffers when there is no CPU copy, for baking and debugging only
+	void ReadVertices(std::vector<float3>& result) const;
+	void ReadNormals(std::vector<float3>& result) const;
+	void ReadTexCoords(std::vector<float2>& result) const;
+	void ReadIndices(std::vector<unsigned>& result) const;
+	bool HasNormals() const { return has_normals; }
+	bool HasTexCoords() const { return has_tex_coords; }
+	bool HasBones() const { return has_bones; }
+	bool IsQuantized() const { return quantized; }
+	//Bytes per vertex and per index in the GL buffers
+	unsigned GetVertexSize() const;
+	unsigned GetIndexSize() const;
+
+	unsigned GetNumLods() const { return lods.size(); }
+	unsigned GetCurrentLod() const { return current_lod; }
 
 private:
 	void SetAABB() const;
+	void SetAABB(const AABB& box) const;
+
+	//Reorders the CPU copies with PrepareMesh, fills the buffers and uploads the meshlets and LODs it built.
+	//remap gets the new place of every source vertex.
+	void OptimizeAndUpload(bool build_meshlets, bool build_lods, std::vector<unsigned>& remap);
+
+	//Picks the vertex and index formats and fills the vertex buffer, normals and texture coordinates may be null
+	void UploadVertices(const float3* src_vertices, const float3* src_normals, const float2* src_tex_coords);
+	//New index buffer in the index format of the mesh, left bound
+	unsigned UploadIndices(const unsigned* src_indices, unsigned count, GLenum usage) const;
+	void ReadIndexBuffer(unsigned id, unsigned count, std::vector<unsigned>& result) const;
+	void ReportFormats() const;
+
+	//Static meshes keep nothing until KeepCpuCopies, skinned meshes only their bind pose
+	void ReleaseCpuCopies();
+
+	void SelectLod();
+	void CullMeshlets();
+
+	void SkinBoneMajor(float3* dst_vertices, float3* dst_normals) const;
+	void SkinVertexMajor(float3* dst_vertices, float3* dst_normals) const;
+	void UploadSkinnedMesh(const float3* src_vertices, const float3* src_normals) const;
+
+	bool IsGPUSkinned() const;
+	void BindSkinning(const char* program) const;
+	void UnbindSkinning(const char* program) const;
+	void BindQuantized() const;
+	void UnbindQuantized() const;
+	//Material shaders read float attributes, quantized meshes under one draw from a decoded copy
+	void UpdateFloatFallback();
 
 private:
+	//Set when the buffers and arrays below belong to a shared resource
+	unsigned mesh_resource = 0;
+
 	unsigned buffer_id = 0;
 
 	unsigned vertices_id = 0;
@@ -68,7 +148,14 @@ private:
 	unsigned texture_id = 0;
 	unsigned indices_id = 0;
 
-	float* buffer = nullptr;
+	//Set when the vertex buffer holds positions on a grid over the mesh box, octahedral normals and half texture coordinates
+	bool quantized = false;
+	float3 position_offset = float3::zero;
+	float3 position_scale = float3::one;
+	//Planar float copy of a quantized vertex buffer, owned by this mesh even when the quantized one is shared
+	unsigned float_buffer_id = 0;
+	//GL_UNSIGNED_SHORT when it can address every vertex, the LOD buffers use the same type
+	GLenum index_type = GL_UNSIGNED_INT;
 
 	float3* vertices = nullptr;
 	bool has_tex_coords = false;
@@ -79,10 +166,32 @@ private:
 	unsigned* indices = nullptr;
 	unsigned num_indices = 0;
 
+	//Level 0 is the imported index buffer, each next one has about half the triangles
+	std::vector<MeshLod> lods;
+	unsigned current_lod = 0;
+
+	//Level 0 indices are sorted by meshlet, the visible ones are drawn as merged index ranges
+	std::vector<Meshlet> meshlets;
+	std::vector<GLsizei> meshlet_counts;
+	std::vector<const GLvoid*> meshlet_offsets;
+	unsigned meshlet_num_indices = 0;
+	bool use_meshlet_ranges = false;
+
 	bool has_bones = false;
 	int num_bones;
 	Bone* bones;
 
+	//Per vertex joints and weights, built from the bone weights once the skeleton is known
+	VertexInfluences* influences = nullptr;
+	//Skinned positions followed by skinned normals, uploaded with a single call
+	float3* skinned = nullptr;
+	//Set while the vertex buffer holds CPU skinned data instead of the bind pose
+	bool vbo_skinned = false;
+
+	//Joint indices and weights for the vertex program, 0 if the mesh can't be skinned on the GPU
+	unsigned skin_buffer_id = 0;
+	bool use_gpu_skinning = true;
+
 	bool use_normals = false;
 
 	bool draw_normals = false;
@@ -2,8 +2,11 @@
 #include "Billboard.h"
 #include "Application.h"
 #include "ModuleCamera.h"
+#include "ModuleLevel.h"
+#include "GameObject.h"
 #include "Interface.h"
 #include "OpenGL.h"
+#include "Brofiler/include/Brofiler.h"
 #include <stdlib.h>
 
 ComponentParticleSystem::ComponentParticleSystem(GameObject * parent) : Component(Component::Type::PARTICLE, parent)
@@ -12,6 +15,7 @@ ComponentParticleSystem::ComponentParticleSystem(GameObject * parent) : Componen
 
 ComponentParticleSystem::~ComponentParticleSystem()
 {
+	Clear();
 }
 
 void ComponentParticleSystem::Init(unsigned max_particles, const float2 & _emit_size, unsigned _falling_time, float falling_height, const char * texture_file, const float2 & psize)
@@ -19,7 +23,7 @@ void ComponentParticleSystem::Init(unsigned max_particles, const float2 & _emit_
 	this->emit_area = _emit_size;
 	this->falling_time = _falling_time;
 	this->falling_height = falling_height;
-	particles.clear();
+	Clear();
 
 	for (int i = 0; i < max_particles; ++i)
 	{
@@ -36,6 +40,10 @@ void ComponentParticleSystem::Init(unsigned max_particles, const float2 & _emit_
 
 void ComponentParticleSystem::Clear()
 {
+	//Each billboard holds a reference to the particle texture
+	for (ParticlePool::iterator it = particles.begin(); it != particles.end(); ++it)
+		RELEASE(it->billboard);
+	particles.clear();
 }
 
 void ComponentParticleSystem::Rain(Billboard* b)
@@ -52,13 +60,68 @@ void ComponentParticleSystem::Rain(Billboard* b)
 	b->position.y -= 0.1f / scale.y;
 }
 
+void ComponentParticleSystem::Collide()
+{
+	BROFILER_CATEGORY("ComponentParticleSystem-Collide", Profiler::Color::Aqua);
+
+	//Billboards are drawn scaled, the grid works on world positions
+	AABB bounds;
+	bounds.SetNegativeInfinity();
+	positions.resize(particles.size());
+	for (unsigned i = 0; i < particles.size(); ++i)
+	{
+		positions[i] = particles[i].billboard->position.Mul(scale);
+		bounds.Enclose(positions[i]);
+	}
+
+	grid.Build(positions.empty() ? nullptr : &positions[0], positions.size(), App->jobs);
+
+	if (!collisions || positions.empty())
+		return;
+
+	//Few colliders against many particles: each collider box is a cell range query on the grid
+	colliders.clear();
+	GameObject* emitter = parent;
+	App->level->QueryAABB(bounds, colliders, [emitter](const GameObject* game_object)
+	{
+		return game_object != emitter && game_object->IsActive() && game_object->GetComponent(Component::Type::MESH, true) != nullptr;
+	});
+
+	for (std::vector<GameObject*>::const_iterator it = colliders.begin(); it != colliders.end(); ++it)
+	{
+		hits.clear();
+		grid.QueryAABB((*it)->bbox, hits);
+
+		//Drops that hit something are respawned by the next Rain
+		for (std::vector<unsigned>::const_iterator hit = hits.begin(); hit != hits.end(); ++hit)
+			particles[*hit].billboard->position.y = 0.0f;
+	}
+}
+
+void ComponentParticleSystem::GetParticlesNear(const float3& point, float radius, std::vector<unsigned>& results) const
+{
+	grid.QuerySphere(Sphere(point, radius), results);
+}
+
+void ComponentParticleSystem::GetNeighbours(unsigned particle, float radius, std::vector<unsigned>& results) const
+{
+	grid.QueryNeighbours(particle, radius, results);
+}
+
+void ComponentParticleSystem::OnUpdate()
+{
+	for (int i = 0; i < particles.size(); ++i)
+		Rain(particles[i].billboard);
+
+	Collide();
+}
+
 void ComponentParticleSystem::OnDraw()
 {
 	glEnable(GL_ALPHA_TEST);
 	glAlphaFunc(GL_GREATER, 0.1f);
 	for (int i = 0; i < particles.size(); ++i)
 	{
-		Rain(particles[i].billboard);
 		particles[i].billboard->ComputeQuad(App->camera->GetPosition());
 		particles[i].billboard->Draw(scale, texture_scale);
 	}
@@ -77,6 +140,7 @@ bool ComponentParticleSystem::OnEditor()
 			this->~ComponentParticleSystem();
 
 		ImGui::SliderInt("Max particles", (int*)&maxparticles, 1, 1000);
+		ImGui::Checkbox("Collisions", &collisions);
 		ImGui::DragFloat2("Emit area", (float*)&emit_area.x, 1, -100, 100);
 		ImGui::DragInt("Falling time", (int*)&falling_time, 1.0f);
 		/*char buf[1024];
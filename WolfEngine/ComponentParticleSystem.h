@@ -6,9 +6,11 @@
 #include <list>
 #include <vector>
 #include "Math.h"
+#include "SpatialHashGrid.h"
 
 class ComponentCamera;
 class Billboard;
+class GameObject;
 
 struct Particle
 {
@@ -31,9 +33,16 @@ public:
 	void Init(unsigned max_particles, const float2& _emit_size, unsigned _falling_time, float falling_height, const char* texture_file, const float2& psize);
 	void Clear();
 	void Rain(Billboard* b);
+	void Collide();
+	//Moves and collides the particles, drawing only reads them
+	void OnUpdate();
 	void OnDraw();
 	bool OnEditor();
 
+	//Particle indices from the grid built this frame, appended to the caller buffer
+	void GetParticlesNear(const float3& point, float radius, std::vector<unsigned>& results) const;
+	void GetNeighbours(unsigned particle, float radius, std::vector<unsigned>& results) const;
+
 public:
 	typedef std::vector<Billboard> BillboardList;
 	typedef std::vector<Particle> ParticlePool;
@@ -57,6 +66,14 @@ public:
 	float2* text_coords = nullptr;
 	float4* colors = nullptr;
 	unsigned* indices = nullptr;
+
+	bool collisions = true;
+
+private:
+	SpatialHashGrid grid;
+	std::vector<float3> positions;
+	std::vector<unsigned> hits;
+	std::vector<GameObject*> colliders;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "Compression.h"
+#include <vector>
+#include <cstring>
+
+//The format wants the last 5 bytes as literals and no match starting in the last 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_LIMIT 12
+
+static unsigned ReadSequence(const unsigned char* bytes)
+{
+	unsigned sequence;
+	memcpy(&sequence, bytes, sizeof(sequence));
+	return sequence;
+}
+
+static unsigned HashSequence(unsigned sequence)
+{
+	return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+//Lengths over the 4 bits of the token go on in bytes of 255 and a last one below it
+static unsigned char* WriteLength(unsigned char* out, unsigned length)
+{
+	for (; length >= 255; length -= 255)
+		*out++ = 255;
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+static unsigned char* WriteSequence(unsigned char* out, const unsigned char* literals, unsigned num_literals, unsigned offset, unsigned match_length)
+{
+	unsigned char* token = out++;
+	*token = (unsigned char)((num_literals >= 15 ? 15 : num_literals) << 4);
+	if (num_literals >= 15)
+		out = WriteLength(out, num_literals - 15);
+	memcpy(out, literals, num_literals);
+	out += num_literals;
+
+	//The last sequence has literals only
+	if (match_length == 0)
+		return out;
+
+	*out++ = (unsigned char)(offset & 0xFF);
+	*out++ = (unsigned char)(offset >> 8);
+	unsigned length = match_length - LZ4_MIN_MATCH;
+	*token |= (unsigned char)(length >= 15 ? 15 : length);
+	if (length >= 15)
+		out = WriteLength(out, length - 15);
+
+	return out;
+}
+
+unsigned Lz4CompressBound(unsigned size)
+{
+	return size + size / 255 + 16;
+}
+
+unsigned Lz4Compress(const char* src, unsigned src_size, char* dst)
+{
+	const unsigned char* in = (const unsigned char*)src;
+	unsigned char* out = (unsigned char*)dst;
+	unsigned literal_start = 0;
+
+	if (src_size > LZ4_MATCH_LIMIT)
+	{
+		//Positions are stored plus one, 0 is an empty slot
+		std::vector<unsigned> table(1 << LZ4_HASH_BITS, 0);
+		unsigned match_end_limit = src_size - LZ4_LAST_LITERALS;
+		unsigned position = 0;
+		while (position + LZ4_MATCH_LIMIT <= src_size)
+		{
+			unsigned sequence = ReadSequence(in + position);
+			unsigned& slot = table[HashSequence(sequence)];
+			unsigned candidate = slot;
+			slot = position + 1;
+
+			if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET || ReadSequence(in + candidate - 1) != sequence)
+			{
+				++position;
+				continue;
+			}
+
+			unsigned match = candidate - 1;
+			unsigned length = LZ4_MIN_MATCH;
+			while (position + length < match_end_limit && in[match + length] == in[position + length])
+				++length;
+
+			//Matches grow backwards over literals that repeat too
+			while (position > literal_start && match > 0 && in[position - 1] == in[match - 1])
+			{
+				--position;
+				--match;
+				++length;
+			}
+
+			out = WriteSequence(out, in + literal_start, position - literal_start, position - match, length);
+			position += length;
+			literal_start = position;
+
+			//Keeps the table useful inside long matches without hashing every byte of them
+			if (position + LZ4_MATCH_LIMIT <= src_size)
+				table[HashSequence(ReadSequence(in + position - 2))] = position - 1;
+		}
+	}
+
+	out = WriteSequence(out, in + literal_start, src_size - literal_start, 0, 0);
+	return out - (unsigned char*)dst;
+}
+
+bool Lz4Decompress(const char* src, unsigned src_size, char* dst, unsigned dst_size)
+{
+	const unsigned char* in = (const unsigned char*)src;
+	const unsigned char* in_end = in + src_size;
+	unsigned char* out = (unsigned char*)dst;
+	unsigned char* out_end = out + dst_size;
+
+	while (in < in_end)
+	{
+		unsigned token = *in++;
+
+		unsigned num_literals = token >> 4;
+		if (num_literals == 15)
+		{
+			unsigned char extra;
+			do
+			{
+				if (in == in_end)
+					return false;
+				extra = *in++;
+				num_literals += extra;
+			} while (extra == 255);
+		}
+
+		if (num_literals > (unsigned)(in_end - in) || num_literals > (unsigned)(out_end - out))
+			return false;
+		memcpy(out, in, num_literals);
+		in += num_literals;
+		out += num_literals;
+
+		if (in == in_end)
+			break;
+
+		if (in_end - in < 2)
+			return false;
+		unsigned offset = in[0] | (in[1] << 8);
+		in += 2;
+
+		unsigned length = (token & 15) + LZ4_MIN_MATCH;
+		if ((token & 15) == 15)
+		{
+			unsigned char extra;
+			do
+			{
+				if (in == in_end)
+					return false;
+				extra = *in++;
+				length += extra;
+			} while (extra == 255);
+		}
+
+		if (offset == 0 || offset > (unsigned)(out - (unsigned char*)dst) || length > (unsigned)(out_end - out))
+			return false;
+
+		//A match closer than its length repeats what it is writing, that one is copied byte by byte
+		const unsigned char* match = out - offset;
+		if (offset >= length)
+		{
+			memcpy(out, match, length);
+			out += length;
+		}
+		else
+		{
+			for (unsigned i = 0; i < length; ++i)
+				*out++ = match[i];
+		}
+	}
+
+	return out == out_end;
+}
@@ -0,0 +1,19 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+//LZ4 block format, readable by any LZ4 decoder: decompression runs at memory speed and the cooker
+//pays for the compression. Up to 4 GB per block.
+#define LZ4_HASH_BITS 16
+#define LZ4_MIN_MATCH 4
+#define LZ4_MAX_OFFSET 65535
+
+//Compressed size in the worst case, incompressible data grows by about 1/255
+unsigned Lz4CompressBound(unsigned size);
+
+//Greedy match search over a hash of 4 byte sequences. Returns the compressed size, dst must hold Lz4CompressBound bytes.
+unsigned Lz4Compress(const char* src, unsigned src_size, char* dst);
+
+//False if the block is damaged or doesn't decompress to exactly dst_size bytes
+bool Lz4Decompress(const char* src, unsigned src_size, char* dst, unsigned dst_size);
+
+#endif // !COMPRESSION_H
@@ -0,0 +1,167 @@
+#include "FileSystem.h"
+#include "PackFile.h"
+#include "Globals.h"
+#include <cstring>
+
+//Open file handed to assimp, reads go straight to the file data
+struct AssimpFile
+{
+	aiFile file;
+	VirtualFile data;
+	size_t position = 0;
+};
+
+static size_t AssimpRead(aiFile* file, char* buffer, size_t size, size_t count)
+{
+	AssimpFile* assimp_file = (AssimpFile*)file->UserData;
+	if (size == 0)
+		return 0;
+
+	size_t available = (size_t)assimp_file->data.GetSize() - assimp_file->position;
+	size_t num_read = count * size <= available ? count : available / size;
+	memcpy(buffer, assimp_file->data.GetData() + assimp_file->position, num_read * size);
+	assimp_file->position += num_read * size;
+
+	return num_read;
+}
+
+static size_t AssimpWrite(aiFile* file, const char* buffer, size_t size, size_t count)
+{
+	return 0;
+}
+
+static size_t AssimpTell(aiFile* file)
+{
+	return ((AssimpFile*)file->UserData)->position;
+}
+
+static size_t AssimpFileSize(aiFile* file)
+{
+	return (size_t)((AssimpFile*)file->UserData)->data.GetSize();
+}
+
+static aiReturn AssimpSeek(aiFile* file, size_t offset, aiOrigin origin)
+{
+	AssimpFile* assimp_file = (AssimpFile*)file->UserData;
+	size_t size = (size_t)assimp_file->data.GetSize();
+	size_t base = origin == aiOrigin_SET ? 0 : (origin == aiOrigin_CUR ? assimp_file->position : size);
+	if (base + offset > size)
+		return aiReturn_FAILURE;
+
+	assimp_file->position = base + offset;
+	return aiReturn_SUCCESS;
+}
+
+static void AssimpFlush(aiFile* file)
+{
+}
+
+static aiFile* AssimpOpen(aiFileIO* io, const char* path, const char* mode)
+{
+	//Imports only read, there is nothing to write to inside a pack
+	if (strchr(mode, 'w') != nullptr || strchr(mode, 'a') != nullptr)
+		return nullptr;
+
+	AssimpFile* assimp_file = new AssimpFile();
+	if (!((const FileSystem*)io->UserData)->ReadFile(path, assimp_file->data))
+	{
+		RELEASE(assimp_file);
+		return nullptr;
+	}
+
+	aiFile& file = assimp_file->file;
+	file.ReadProc = AssimpRead;
+	file.WriteProc = AssimpWrite;
+	file.TellProc = AssimpTell;
+	file.FileSizeProc = AssimpFileSize;
+	file.SeekProc = AssimpSeek;
+	file.FlushProc = AssimpFlush;
+	file.UserData = (aiUserData)assimp_file;
+
+	return &file;
+}
+
+static void AssimpClose(aiFileIO* io, aiFile* file)
+{
+	AssimpFile* assimp_file = (AssimpFile*)file->UserData;
+	RELEASE(assimp_file);
+}
+
+FileSystem::FileSystem()
+{
+	assimp_io.OpenProc = AssimpOpen;
+	assimp_io.CloseProc = AssimpClose;
+	assimp_io.UserData = (aiUserData)this;
+}
+
+FileSystem::~FileSystem()
+{
+	for (std::vector<PackFile*>::iterator it = packs.begin(); it != packs.end(); ++it)
+		RELEASE(*it);
+}
+
+bool FileSystem::Mount(const char* pack_path)
+{
+	PackFile* pack = new PackFile();
+	if (!pack->Open(pack_path))
+	{
+		APPLOG("Pack %s not mounted, files are read from disk", pack_path);
+		RELEASE(pack);
+		return false;
+	}
+
+	APPLOG("Mounted pack %s with %u entries", pack_path, pack->GetNumEntries());
+	packs.push_back(pack);
+	return true;
+}
+
+bool FileSystem::ReadFile(const char* path, VirtualFile& file) const
+{
+	const PackFile* pack = nullptr;
+	const PackFileEntry* entry = FindPacked(path, pack);
+	//Cooked sources only have their stamp packed, the source itself is still read from disk
+	if (entry != nullptr && (entry->flags & PACK_ENTRY_STAMP_ONLY) == 0)
+	{
+		file.data = pack->Read(*entry, file.buffer);
+		file.size = entry->size;
+		file.packed = true;
+		return file.data != nullptr;
+	}
+
+	if (!file.file.Open(path))
+		return false;
+
+	file.data = file.file.GetData();
+	file.size = file.file.GetSize();
+	file.packed = false;
+	return true;
+}
+
+bool FileSystem::GetFileStamp(const char* path, unsigned long long& size, unsigned long long& time) const
+{
+	const PackFile* pack = nullptr;
+	const PackFileEntry* entry = FindPacked(path, pack);
+	if (entry != nullptr)
+	{
+		size = entry->source_size;
+		time = entry->source_time;
+		return true;
+	}
+
+	return MappedFile::GetFileStamp(path, size, time);
+}
+
+const PackFileEntry* FileSystem::FindPacked(const char* path, const PackFile*& pack) const
+{
+	for (std::vector<PackFile*>::const_reverse_iterator it = packs.rbegin(); it != packs.rend(); ++it)
+	{
+		const PackFileEntry* entry = (*it)->Find(path);
+		if (entry != nullptr)
+		{
+			pack = *it;
+			return entry;
+		}
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,57 @@
+#ifndef FILESYSTEM_H
+#define FILESYSTEM_H
+
+#include "MappedFile.h"
+#include <vector>
+#include <assimp/cfileio.h>
+
+class PackFile;
+struct PackFileEntry;
+
+//Whole file read through the file system, from a pack or from disk. The data stays valid while the object lives.
+class VirtualFile
+{
+public:
+	bool IsOpen() const { return data != nullptr; }
+	const char* GetData() const { return data; }
+	unsigned long long GetSize() const { return size; }
+	//True if the data came from a pack
+	bool IsPacked() const { return packed; }
+
+private:
+	friend class FileSystem;
+
+	MappedFile file;
+	std::vector<char> buffer;
+	const char* data = nullptr;
+	unsigned long long size = 0;
+	bool packed = false;
+};
+
+//Paths are looked up in the mounted packs first, the last one mounted wins, and then on disk.
+//Sources packed as a stamp only are read from disk, their stamp still comes from the pack.
+//Read only and safe to use from several threads once the packs are mounted.
+class FileSystem
+{
+public:
+	FileSystem();
+	~FileSystem();
+
+	bool Mount(const char* pack_path);
+
+	bool ReadFile(const char* path, VirtualFile& file) const;
+	//Size and modification time the file had when packed or has on disk, false if it can't be found
+	bool GetFileStamp(const char* path, unsigned long long& size, unsigned long long& time) const;
+
+	//For aiImportFileEx, so the files assimp pulls in like materials come from the same place
+	aiFileIO* GetAssimpIO() { return &assimp_io; }
+
+private:
+	const PackFileEntry* FindPacked(const char* path, const PackFile*& pack) const;
+
+private:
+	std::vector<PackFile*> packs;
+	aiFileIO assimp_io;
+};
+
+#endif // !FILESYSTEM_H
@@ -1,4 +1,6 @@
 #include "FreeType.h"
+#include "Application.h"
+#include "FileSystem.h"
 
 namespace freetype {
 	// This Function Gets The First Power Of 2 >= The
@@ -138,9 +140,11 @@ namespace freetype {
 
 		// This Is Where We Load In The Font Information From The File.
 		// Of All The Places Where The Code Might Die, This Is The Most Likely,
-		// As FT_New_Face Will Fail If The Font File Does Not Exist Or Is Somehow Broken.
-		if (FT_New_Face(library, fname, 0, &face))
-			throw std::runtime_error("FT_New_Face failed (there is probably a problem with your font file)");
+		// As FT_New_Memory_Face Will Fail If The Font File Does Not Exist Or Is Somehow Broken.
+		// The File Comes Through The File System, Its Data Must Outlive The Face.
+		VirtualFile file;
+		if (!App->files->ReadFile(fname, file) || FT_New_Memory_Face(library, (const FT_Byte*)file.GetData(), (FT_Long)file.GetSize(), 0, &face))
+			throw std::runtime_error("FT_New_Memory_Face failed (there is probably a problem with your font file)");
 
 		// For Some Twisted Reason, FreeType Measures Font Size
 		// In Terms Of 1/64ths Of Pixels.  Thus, To Make A Font
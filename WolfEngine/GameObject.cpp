@@ -26,6 +26,7 @@
 #include "OpenGL.h"
 #include "Color.h"
 #include "Primitive.h"
+#include "Skeleton.h"
 #include "Interface.h"
 #include "Brofiler/include/Brofiler.h"
 
@@ -39,6 +40,8 @@ GameObject::GameObject(GameObject* parent, GameObject* root_object, const std::s
 
 	//Init BoundingBox (in case some GameObjects don't have a MeshComponent)
 	initial_bbox.SetNegativeInfinity();
+	bbox.SetNegativeInfinity();
+	subtree_bbox.SetNegativeInfinity();
 }
 
 GameObject::~GameObject()
@@ -49,25 +52,39 @@ GameObject::~GameObject()
 	for (std::vector<GameObject*>::iterator it = childs.begin(); it != childs.end(); ++it)
 		RELEASE(*it);
 
+	RELEASE(skeleton);
+
+	if (batched)
+		App->level->InvalidateStaticBatches();
+	App->level->RemoveGameObjectSpatialIndex(this);
 }
 
 bool GameObject::Update()
 {
-	if (App->camera->InsideCulling(bbox))
+	//One test rejects the whole hierarchy below this object
+	if (!IsSubtreeInsideCulling())
+		return true;
+
+	if (IsInsideCulling())
 	{
 		for (std::vector<Component*>::const_iterator it = components.cbegin(); it != components.cend(); ++it)
 			if ((*it)->IsActive())
 				(*it)->OnUpdate();
-		for (std::vector<GameObject*>::const_iterator it = childs.cbegin(); it != childs.cend(); ++it)
-			if ((*it)->IsActive())
-				(*it)->Update();
 	}
+
+	for (std::vector<GameObject*>::const_iterator it = childs.cbegin(); it != childs.cend(); ++it)
+		if ((*it)->IsActive())
+			(*it)->Update();
+
 	return true;
 }
 
 void GameObject::Draw() const
 {
-	if (App->camera->InsideCulling(bbox))
+	if (!IsSubtreeInsideCulling())
+		return;
+
+	if (IsInsideCulling())
 	{
 		glPushMatrix();
 
@@ -92,7 +109,7 @@ void GameObject::Draw() const
 		}
 			
 		ComponentMesh* mesh = (ComponentMesh*) GetComponent(Component::MESH);
-		if (mesh != nullptr)
+		if (mesh != nullptr && !batched && !App->level->IsHLODProxied(hlod_cluster))
 		{
 			mesh->SetUseNormals(material_on);
 			if (mesh->IsActive())
@@ -139,12 +156,11 @@ void GameObject::Draw() const
 			if (canvas->IsActive())
 				canvas->OnDraw();
 		}
-
-		for (std::vector<GameObject*>::const_iterator it = childs.begin(); it != childs.end(); ++it)
-			if ((*it)->IsActive())
-				(*it)->Draw();
-
 	}
+
+	for (std::vector<GameObject*>::const_iterator it = childs.begin(); it != childs.end(); ++it)
+		if ((*it)->IsActive())
+			(*it)->Draw();
 }
 
 void GameObject::DebugDraw() const
@@ -242,7 +258,8 @@ void GameObject::DrawHierarchy() const
 
 void GameObject::OnEditor()
 {
-	ImGui::Checkbox("##Active", &active);
+	if (ImGui::Checkbox("##Active", &active) && batched)
+		App->level->InvalidateStaticBatches();
 	ImGui::SameLine();
 
 	static char buf[64] = "";
@@ -250,7 +267,9 @@ void GameObject::OnEditor()
 	ImGui::InputText("##Name", buf, IM_ARRAYSIZE(buf)); //WARNING: Don't delete space
 	name = buf;
 
-	ImGui::Checkbox("Static", &is_static);
+	bool state = is_static;
+	if (ImGui::Checkbox("Static", &state))
+		SetStatic(state);
 
 	for (std::vector<Component*>::iterator it = components.begin(); it != components.end(); ++it)
 		(*it)->OnEditor();
@@ -299,8 +318,12 @@ void GameObject::SetParent(GameObject * parent)
 		}
 	}
 
+	if (this->parent != nullptr)
+		this->parent->subtree_bbox_dirty = true;
+
 	this->parent = parent;
 	parent->childs.push_back(this);
+	parent->subtree_bbox_dirty = true;
 }
 
 Component* GameObject::CreateComponent(Component::Type type)
@@ -370,10 +393,12 @@ Component* GameObject::CreateComponent(Component::Type type)
 		ret = new ComponentBillboard(this, 1, 1);
 		ret->Enable();
 		billboard = (ComponentBillboard*)ret;
+		subtree_bbox_dirty = true;
 		break;
 	case Component::PARTICLE:
 		ret = new ComponentParticleSystem(this);
 		particle_system = (ComponentParticleSystem*)ret;
+		subtree_bbox_dirty = true;
 		particle_system->Init(500, float2(0, 0), 100, 10, "Resources/rainSprite.tga", float2(1.0f,1.0));
 		break;
 	case Component::RIGIDBODY:
@@ -410,6 +435,9 @@ Component* GameObject::CreateComponent(Component::Type type)
 
 void GameObject::DeleteComponent(Component* component)
 {
+	if (batched)
+		App->level->InvalidateStaticBatches();
+
 	for (std::vector<Component*>::iterator it = components.begin(); it != components.end(); ++it)
 	{
 		if (*it == component)
@@ -490,6 +518,26 @@ GameObject* GameObject::FindByName(const std::string& name) const
 	return ret;
 }
 
+bool GameObject::IsInsideCulling() const
+{
+	//Objects without geometry are only culled through their subtree
+	if (!bbox.IsFinite())
+		return true;
+
+	if (aabb_tree_leaf != INVALID_AABB_NODE)
+		return App->level->IsInsideDynamicCulling(this) && !App->level->IsOccluded(bbox);
+
+	return App->camera->InsideCulling(bbox) && !App->level->IsOccluded(bbox);
+}
+
+bool GameObject::IsSubtreeInsideCulling() const
+{
+	if (unbounded_subtree || !subtree_bbox.IsFinite())
+		return true;
+
+	return App->camera->InsideCulling(subtree_bbox) && !App->level->IsOccluded(subtree_bbox);
+}
+
 bool GameObject::IsPlayingAnimation() const
 {
 	bool ret = false;
@@ -502,6 +550,18 @@ bool GameObject::IsPlayingAnimation() const
 	return ret;
 }
 
+bool GameObject::IsAnimationPoseChanged() const
+{
+	bool ret = false;
+
+	const ComponentAnim* anim = (ComponentAnim*)GetComponent(Component::Type::ANIMATION);
+
+	if (anim != nullptr)
+		ret = anim->IsPoseChanged();
+
+	return ret;
+}
+
 void GameObject::SetLocalTransform(const float3& position, const float3& scaling, const Quat& rotation)
 {
 	if (transform == nullptr)
@@ -541,10 +601,44 @@ void GameObject::SetActive(bool state)
 	}
 }
 
-void GameObject::LoadMesh(aiMesh* scene_mesh, const aiScene* scene, const aiString& folder_path, bool is_dynamic)
+void GameObject::SetStatic(bool state)
+{
+	if (is_static != state)
+	{
+		is_static = state;
+
+		//Move the object between the static octree and the dynamic tree
+		if (octree_entry != INVALID_OCTREE_INDEX || aabb_tree_leaf != INVALID_AABB_NODE)
+		{
+			App->level->RemoveGameObjectSpatialIndex(this);
+			App->level->InsertGameObjectSpatialIndex(this);
+		}
+
+		//Baked batches would keep drawing an object that is now dynamic, or miss one that is now static
+		App->level->InvalidateStaticBatches();
+	}
+
+	for (std::vector<GameObject*>::iterator it = childs.begin(); it != childs.end(); ++it)
+		(*it)->SetStatic(state);
+}
+
+void GameObject::LoadMesh(aiMesh* scene_mesh, const aiScene* scene, const aiString& file_path, bool is_dynamic)
 {
 	ComponentMesh* mesh = (ComponentMesh*)CreateComponent(Component::Type::MESH);
+
+	//Every node using the same scene mesh, in this scene or a reload of it, gets the same geometry
+	unsigned mesh_index = 0;
+	while (mesh_index < scene->mNumMeshes && scene->mMeshes[mesh_index] != scene_mesh)
+		++mesh_index;
+	std::string source = std::string(file_path.data) + "#" + std::to_string(mesh_index);
+
+	bool shareable = !is_dynamic && !scene_mesh->HasBones();
+	if (shareable && mesh->LoadShared(source))
+		return;
+
 	mesh->Load(scene_mesh, is_dynamic);
+	if (shareable)
+		mesh->Share(source);
 }
 
 void GameObject::LoadMesh(const Primitive& primitive)
@@ -553,6 +647,17 @@ void GameObject::LoadMesh(const Primitive& primitive)
 	mesh->Load(primitive);
 }
 
+void GameObject::LoadMesh(const ObjMesh& obj_mesh, const std::string& source, bool is_dynamic)
+{
+	ComponentMesh* mesh = (ComponentMesh*)CreateComponent(Component::Type::MESH);
+	if (!is_dynamic && mesh->LoadShared(source))
+		return;
+
+	mesh->Load(obj_mesh, is_dynamic);
+	if (!is_dynamic)
+		mesh->Share(source);
+}
+
 void GameObject::LoadMaterial(aiMesh* scene_mesh, const aiScene* scene, const aiString& folder_path)
 {
 	ComponentMaterial* material = (ComponentMaterial*)CreateComponent(Component::Type::MATERIAL);
@@ -566,6 +671,12 @@ void GameObject::LoadMaterial(const aiString& path)
 	material->LoadTexture(path);
 }
 
+void GameObject::LoadMaterial(const ObjMaterial& obj_material, const aiString& folder_path)
+{
+	ComponentMaterial* material = (ComponentMaterial*)CreateComponent(Component::Type::MATERIAL);
+	material->Load(obj_material, folder_path);
+}
+
 void GameObject::LoadAnimation(const char* name)
 {
 	ComponentAnim* anim = (ComponentAnim*)CreateComponent(Component::Type::ANIMATION);
@@ -646,6 +757,9 @@ void GameObject::SetAABB(AABB box)
 	initial_bbox = box;
 	transform_bbox.SetFrom(initial_bbox, GetGlobalTransformMatrix());
 	bbox.SetFrom(transform_bbox);
+	subtree_bbox_dirty = true;
+
+	App->level->UpdateGameObjectSpatialIndex(this);
 }
 
 void GameObject::ChangeAnim(const char* name, unsigned int duration)
@@ -662,7 +776,7 @@ void GameObject::RecursiveUpdateTransforms(const float4x4& parent)
 		(*it)->RecursiveUpdateTransforms(global);
 }
 
-void GameObject::RecursiveUpdateBoundingBox(bool force_recalculation)
+bool GameObject::RecursiveUpdateBoundingBox(bool force_recalculation)
 {
 	bool child_recalc = false;
 
@@ -672,10 +786,45 @@ void GameObject::RecursiveUpdateBoundingBox(bool force_recalculation)
 		bbox.SetFrom(transform_bbox);
 		transform->transform_change = false;
 		child_recalc = true;
+
+		//The batch still holds the old world positions
+		if (batched)
+			App->level->InvalidateStaticBatches();
+
+		App->level->UpdateGameObjectSpatialIndex(this);
 	}
 
+	//Subtree bounds are only merged again along the branches that changed
+	bool subtree_change = child_recalc || subtree_bbox_dirty;
 	for (std::vector<GameObject*>::iterator it = childs.begin(); it != childs.end(); ++it)
-		(*it)->RecursiveUpdateBoundingBox(child_recalc);
+		if ((*it)->RecursiveUpdateBoundingBox(child_recalc))
+			subtree_change = true;
+
+	if (subtree_change)
+		UpdateSubtreeBoundingBox();
+
+	return subtree_change;
+}
+
+void GameObject::UpdateSubtreeBoundingBox()
+{
+	if (bbox.IsFinite())
+		subtree_bbox = bbox;
+	else
+		subtree_bbox.SetNegativeInfinity();
+
+	//Billboards and particles draw outside any box, their ancestors can't be culled
+	unbounded_subtree = !bbox.IsFinite() && (billboard != nullptr || particle_system != nullptr);
+
+	for (std::vector<GameObject*>::const_iterator it = childs.cbegin(); it != childs.cend(); ++it)
+	{
+		if ((*it)->unbounded_subtree)
+			unbounded_subtree = true;
+		else if ((*it)->subtree_bbox.IsFinite())
+			subtree_bbox.Enclose((*it)->subtree_bbox);
+	}
+
+	subtree_bbox_dirty = false;
 }
 
 void GameObject::RecursiveOnPlay()
@@ -7,6 +7,8 @@
 #include "Component.h"
 #include "Math.h"
 #include "ComponentRigidBody.h"
+#include "LooseOctree.h"
+#include "AABBTree.h"
 
 class Component;
 class ComponentTransform;
@@ -15,11 +17,14 @@ class ComponentMaterial;
 class ComponentBillboard;
 class ComponentParticleSystem;
 class Primitive;
+class Skeleton;
 
 struct aiMesh;
 struct aiNode;
 struct aiScene;
 struct aiString;
+struct ObjMesh;
+struct ObjMaterial;
 
 class GameObject
 {
@@ -50,17 +55,25 @@ public:
 
 	bool IsActive() const { return active; }
 	bool IsStatic() const { return is_static; }
+	bool IsInsideCulling() const;
+	bool IsSubtreeInsideCulling() const;
 	bool IsPlayingAnimation() const;
+	bool IsAnimationPoseChanged() const;
 
 	void SetLocalTransform(const float3& position, const float3& scaling, const Quat& rotation);
 	void SetLocalTransform(const float3& position, const Quat& rotation);
 	void SetLocalTransform(const float3& position);
 	void SetActive(bool state);
+	//Applies to the whole subtree, static objects go in the octree and are baked by the batcher and HLOD
+	void SetStatic(bool state);
 
-	void LoadMesh(aiMesh* scene_mesh, const aiScene* scene, const aiString& folder_path, bool is_dynamic = false);
+	void LoadMesh(aiMesh* scene_mesh, const aiScene* scene, const aiString& file_path, bool is_dynamic = false);
 	void LoadMesh(const Primitive& primitive);
+	//source names the mesh in its file, static meshes with the same one share their geometry
+	void LoadMesh(const ObjMesh& obj_mesh, const std::string& source, bool is_dynamic = false);
 	void LoadMaterial(aiMesh* scene_mesh, const aiScene* scene, const aiString& folder_path);
 	void LoadMaterial(const aiString& path);
+	void LoadMaterial(const ObjMaterial& obj_material, const aiString& folder_path);
 	void LoadAnimation(const char * name);
 	void LoadAnimation(const std::list<std::string>& animations);
 	void LoadBones();
@@ -73,7 +86,7 @@ public:
 	void ChangeAnim(const char* name, unsigned int duration);
 
 	void RecursiveUpdateTransforms(const float4x4& parent = float4x4::identity);
-	void RecursiveUpdateBoundingBox(bool force_recalculation = false);
+	bool RecursiveUpdateBoundingBox(bool force_recalculation = false);
 	void RecursiveOnPlay();
 	void RecursiveOnStop();
 
@@ -84,11 +97,14 @@ private:
 	void RecursiveDrawHierarchy() const;
 
 	void CollectMeshesOnChilds(std::vector<ComponentMesh*>& meshes);
+	void UpdateSubtreeBoundingBox();
 
 public:
 	AABB initial_bbox;
 	OBB transform_bbox;
 	AABB bbox;
+	//Encloses the object and all its descendants, negative infinity if none has geometry
+	AABB subtree_bbox;
 	std::string name = "GameObject";
 	std::vector<Component*> components;
 	std::vector<GameObject*> childs;
@@ -96,9 +112,19 @@ public:
 	ComponentTransform* transform = nullptr;
 	ComponentBillboard* billboard = nullptr;
 	ComponentParticleSystem* particle_system = nullptr;
+	Skeleton* skeleton = nullptr;
+	unsigned octree_entry = INVALID_OCTREE_INDEX;
+	unsigned aabb_tree_leaf = INVALID_AABB_NODE;
+	unsigned visible_frame = 0;
 
 	bool selected = false;
 	bool is_bone = false;
+	//The mesh is drawn by a static batch instead
+	bool batched = false;
+	//Index of the HLOD cluster whose proxy replaces the mesh from far away, -1 if none
+	int hlod_cluster = -1;
+	//Source of the static scene imported with this object as its root, its cooked HLOD clusters are loaded on Play
+	std::string hlod_source;
 
 	GameObject* root = nullptr;
 
@@ -106,6 +132,8 @@ private:
 	GameObject* parent = nullptr;
 	bool active = true;
 	bool is_static = false;
+	bool subtree_bbox_dirty = true;
+	bool unbounded_subtree = false;
 };
 
 #endif // !GAMEOBJECT_H
\ No newline at end of file
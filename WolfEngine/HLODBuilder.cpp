@@ -0,0 +1,270 @@
+#include "HLODBuilder.h"
+#include "Application.h"
+#include "ModuleCamera.h"
+#include "ModuleLevel.h"
+#include "ModuleRender.h"
+#include "GameObject.h"
+#include "ComponentMesh.h"
+#include "ComponentMaterial.h"
+#include "HLODFile.h"
+#include "FileSystem.h"
+#include "Color.h"
+#include "OpenGL.h"
+#include "TimerUs.h"
+#include "Brofiler/include/Brofiler.h"
+
+HLODBuilder::HLODBuilder()
+{
+}
+
+HLODBuilder::~HLODBuilder()
+{
+	Clear(nullptr);
+}
+
+void HLODBuilder::Load(GameObject* root)
+{
+	BROFILER_CATEGORY("HLODBuilder-Load", Profiler::Color::Blue);
+
+	TimerUs timer;
+	timer.Start();
+
+	Clear(root);
+	RecursiveLoad(root);
+
+	unsigned num_source_triangles = 0;
+	unsigned num_proxy_triangles = 0;
+	for (std::vector<HLODCluster*>::const_iterator it = clusters.begin(); it != clusters.end(); ++it)
+	{
+		num_source_triangles += (*it)->num_source_triangles;
+		num_proxy_triangles += (*it)->num_vertices / 3;
+	}
+
+	APPLOG("HLOD: %u objects in %u clusters, %u triangles reduced to %u, loaded in %llu us", num_clustered_objects, clusters.size(),
+		num_source_triangles, num_proxy_triangles, timer.GetTimeInUs());
+}
+
+void HLODBuilder::Clear(GameObject* root)
+{
+	for (std::vector<HLODCluster*>::iterator it = clusters.begin(); it != clusters.end(); ++it)
+	{
+		glDeleteBuffers(1, (GLuint*) &((*it)->buffer_id));
+		glDeleteTextures(1, (GLuint*) &((*it)->atlas_id));
+		RELEASE(*it);
+	}
+	clusters.clear();
+
+	num_clustered_objects = 0;
+	num_proxied = 0;
+	num_drawn_proxies = 0;
+
+	if (root != nullptr)
+		RecursiveClearCluster(root);
+}
+
+void HLODBuilder::Update(const float3& position, float distance)
+{
+	BROFILER_CATEGORY("HLODBuilder-Update", Profiler::Color::Blue);
+
+	num_proxied = 0;
+	for (std::vector<HLODCluster*>::iterator it = clusters.begin(); it != clusters.end(); ++it)
+	{
+		//Coming back needs some margin, otherwise clusters at the threshold swap every frame
+		float cluster_distance = (*it)->box.Distance(position);
+		if ((*it)->proxied)
+			(*it)->proxied = cluster_distance > distance * (1.0f - HLOD_HYSTERESIS);
+		else
+			(*it)->proxied = cluster_distance > distance;
+
+		if ((*it)->proxied)
+			++num_proxied;
+	}
+}
+
+void HLODBuilder::Draw()
+{
+	BROFILER_CATEGORY("HLODBuilder-Draw", Profiler::Color::GreenYellow);
+
+	//The tint of every material is already in the atlas
+	static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	static const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	num_drawn_proxies = 0;
+	if (num_proxied == 0)
+		return;
+
+	//Meshes drawn after the proxies expect the lighting and material they left
+	glPushAttrib(GL_LIGHTING_BIT | GL_ENABLE_BIT);
+
+	for (std::vector<HLODCluster*>::const_iterator it = clusters.begin(); it != clusters.end(); ++it)
+	{
+		const HLODCluster* cluster = *it;
+		if (!cluster->proxied || !App->camera->InsideCulling(cluster->box) || App->level->IsOccluded(cluster->box))
+			continue;
+
+		++num_drawn_proxies;
+
+		glMaterialfv(GL_FRONT, GL_AMBIENT, white);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, white);
+		glMaterialfv(GL_FRONT, GL_SPECULAR, black);
+		glBindTexture(GL_TEXTURE_2D, cluster->atlas_id);
+		glEnable(GL_LIGHTING);
+
+		glPushMatrix();
+		glMultMatrixf((GLfloat*)cluster->transform.Transposed().ptr());
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, cluster->buffer_id);
+
+		glVertexPointer(3, GL_FLOAT, 0, NULL);
+		glNormalPointer(GL_FLOAT, 0, (char*)(3 * cluster->num_vertices * sizeof(float)));
+		glTexCoordPointer(2, GL_FLOAT, 0, (char*)(6 * cluster->num_vertices * sizeof(float)));
+
+		glDrawArrays(GL_TRIANGLES, 0, cluster->num_vertices);
+
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		glPopMatrix();
+	}
+
+	glPopAttrib();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void HLODBuilder::DrawDebug() const
+{
+	for (std::vector<HLODCluster*>::const_iterator it = clusters.begin(); it != clusters.end(); ++it)
+		App->renderer->debug_drawer->DrawBoundingBox((*it)->box, (*it)->proxied ? Colors::Red : Colors::Green);
+}
+
+void HLODBuilder::RecursiveLoad(GameObject* game_object)
+{
+	if (!game_object->hlod_source.empty())
+		LoadScene(game_object);
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		RecursiveLoad(*it);
+}
+
+void HLODBuilder::LoadScene(GameObject* scene_root)
+{
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	std::string path = scene_root->hlod_source + HLOD_FILE_EXTENSION;
+	VirtualFile file;
+	if (!App->files->GetFileStamp(scene_root->hlod_source.c_str(), source_size, source_time) || !App->files->ReadFile(path.c_str(), file))
+		return;
+
+	if (ValidateHLODFile(file.GetData(), file.GetSize(), source_size, source_time) == nullptr)
+	{
+		APPLOG("HLOD file %s is outdated, cook %s again", path.c_str(), scene_root->hlod_source.c_str());
+		return;
+	}
+
+	const char* data = file.GetData();
+	const HLODFileHeader* header = (const HLODFileHeader*)data;
+	const HLODFileCluster* file_clusters = (const HLODFileCluster*)(data + header->clusters_offset);
+
+	std::vector<GameObject*> mesh_objects;
+	CollectMeshObjects(scene_root, mesh_objects);
+
+	unsigned num_skipped = 0;
+	for (unsigned i = 0; i < header->num_clusters; ++i)
+	{
+		const HLODFileCluster& file_cluster = file_clusters[i];
+		const HLODFileMember* members = (const HLODFileMember*)(data + file_cluster.members_offset);
+
+		bool valid = true;
+		for (unsigned j = 0; j < file_cluster.num_members && valid; ++j)
+			valid = members[j].mesh < mesh_objects.size() && CanProxy(mesh_objects[members[j].mesh], members[j].num_indices);
+
+		if (!valid)
+		{
+			++num_skipped;
+			continue;
+		}
+
+		HLODCluster* cluster = new HLODCluster();
+		cluster->transform = scene_root->GetGlobalTransformMatrix();
+		cluster->box.SetNegativeInfinity();
+		for (unsigned j = 0; j < file_cluster.num_members; ++j)
+		{
+			GameObject* member = mesh_objects[members[j].mesh];
+			member->hlod_cluster = clusters.size();
+			cluster->box.Enclose(member->bbox);
+		}
+
+		LoadCluster(cluster, file_cluster, data);
+		clusters.push_back(cluster);
+
+		num_clustered_objects += cluster->num_objects;
+	}
+
+	if (num_skipped > 0)
+		APPLOG("HLOD: %u of %u clusters of %s left out, their objects changed since they were cooked", num_skipped, header->num_clusters, path.c_str());
+}
+
+void HLODBuilder::CollectMeshObjects(GameObject* game_object, std::vector<GameObject*>& objects) const
+{
+	//Same numbering as the cooker, every object with a mesh in creation order
+	if (game_object->GetComponent(Component::Type::MESH) != nullptr)
+		objects.push_back(game_object);
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		CollectMeshObjects(*it, objects);
+}
+
+bool HLODBuilder::CanProxy(const GameObject* game_object, unsigned num_indices) const
+{
+	const ComponentMesh* mesh = (const ComponentMesh*)game_object->GetComponent(Component::Type::MESH);
+	const Component* material = game_object->GetComponent(Component::Type::MATERIAL);
+
+	//An object belongs to one cluster at most, a scene imported inside another could claim it twice
+	return game_object->hlod_cluster < 0 && game_object->IsActive() && game_object->IsStatic() && mesh->IsActive() && !mesh->HasBones() &&
+		mesh->GetNumIndices() == num_indices && (material == nullptr || material->IsActive());
+}
+
+void HLODBuilder::LoadCluster(HLODCluster* cluster, const HLODFileCluster& file_cluster, const char* data) const
+{
+	cluster->num_objects = file_cluster.num_members;
+	cluster->num_source_triangles = file_cluster.num_source_triangles;
+	cluster->num_vertices = file_cluster.num_vertices;
+	cluster->error = file_cluster.error;
+
+	glGenBuffers(1, (GLuint*) &(cluster->buffer_id));
+	glBindBuffer(GL_ARRAY_BUFFER, cluster->buffer_id);
+	glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float) * cluster->num_vertices, data + file_cluster.vertices_offset, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//Every level comes cooked from the full resolution sources, the last one stops before the tiles bleed
+	glGenTextures(1, (GLuint*) &(cluster->atlas_id));
+	glBindTexture(GL_TEXTURE_2D, cluster->atlas_id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX(1u, file_cluster.num_atlas_mips) - 1);
+	unsigned width = file_cluster.atlas_width;
+	unsigned height = file_cluster.atlas_height;
+	for (unsigned i = 0; i < file_cluster.num_atlas_mips; ++i)
+	{
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data + file_cluster.atlas_offsets[i]);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HLODBuilder::RecursiveClearCluster(GameObject* game_object) const
+{
+	game_object->hlod_cluster = -1;
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		RecursiveClearCluster(*it);
+}
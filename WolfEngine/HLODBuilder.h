@@ -0,0 +1,66 @@
+#ifndef HLODBUILDER_H
+#define HLODBUILDER_H
+
+#include "Math.h"
+#include <vector>
+
+#define HLOD_HYSTERESIS 0.1f
+
+class GameObject;
+struct HLODFileCluster;
+
+//Simplified proxy of the static meshes in one cell of an imported scene, textured from a per cluster atlas.
+//Both are baked by WolfCooker into the .whlod file next to the source.
+struct HLODCluster
+{
+	AABB box;
+	//Global transform of the scene root, the proxy is baked in its space
+	float4x4 transform = float4x4::identity;
+	unsigned buffer_id = 0;
+	unsigned atlas_id = 0;
+	unsigned num_vertices = 0;
+	unsigned num_objects = 0;
+	unsigned num_source_triangles = 0;
+	float error = 0.0f;
+	bool proxied = false;
+};
+
+class HLODBuilder
+{
+public:
+	HLODBuilder();
+	~HLODBuilder();
+
+	//Loads the cooked clusters of the scenes imported under root, each object keeps the index of its cluster.
+	//A cluster is left out if any of its objects is no longer static, active or the mesh it was cooked from.
+	void Load(GameObject* root);
+	void Clear(GameObject* root);
+
+	//Clusters farther than distance from the point draw their proxy instead of their objects
+	void Update(const float3& position, float distance);
+	void Draw();
+	void DrawDebug() const;
+
+	bool IsProxied(int cluster) const { return cluster >= 0 && cluster < (int)clusters.size() && clusters[cluster]->proxied; }
+
+	unsigned GetNumClusters() const { return clusters.size(); }
+	unsigned GetNumClusteredObjects() const { return num_clustered_objects; }
+	unsigned GetNumProxied() const { return num_proxied; }
+	unsigned GetNumDrawnProxies() const { return num_drawn_proxies; }
+
+private:
+	void RecursiveLoad(GameObject* game_object);
+	void LoadScene(GameObject* scene_root);
+	void CollectMeshObjects(GameObject* game_object, std::vector<GameObject*>& objects) const;
+	bool CanProxy(const GameObject* game_object, unsigned num_indices) const;
+	void LoadCluster(HLODCluster* cluster, const HLODFileCluster& file_cluster, const char* data) const;
+	void RecursiveClearCluster(GameObject* game_object) const;
+
+private:
+	std::vector<HLODCluster*> clusters;
+	unsigned num_clustered_objects = 0;
+	unsigned num_proxied = 0;
+	unsigned num_drawn_proxies = 0;
+};
+
+#endif // !HLODBUILDER_H
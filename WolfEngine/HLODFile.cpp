@@ -0,0 +1,18 @@
+#include "HLODFile.h"
+
+const HLODFileHeader* ValidateHLODFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time)
+{
+	if (data == nullptr || size < sizeof(HLODFileHeader))
+		return nullptr;
+
+	const HLODFileHeader* header = (const HLODFileHeader*)data;
+	if (header->magic != HLOD_FILE_MAGIC || header->version != HLOD_FILE_VERSION ||
+		header->source_size != source_size || header->source_time != source_time)
+		return nullptr;
+
+	//Cluster table must be inside the file, the members, vertices and mips it points to are trusted
+	if (header->clusters_offset + (unsigned long long)header->num_clusters * sizeof(HLODFileCluster) > size)
+		return nullptr;
+
+	return header;
+}
@@ -0,0 +1,57 @@
+#ifndef HLODFILE_H
+#define HLODFILE_H
+
+#define HLOD_FILE_EXTENSION ".whlod"
+#define HLOD_FILE_MAGIC 0x444F4C48
+#define HLOD_FILE_VERSION 1
+#define HLOD_FILE_MAX_MIPS 4
+
+//Baked by WolfCooker, a different value cooks every model again
+#define HLOD_CELL_SIZE 200.0f
+#define HLOD_MIN_OBJECTS 2
+#define HLOD_TARGET_RATIO 0.1f
+#define HLOD_MAX_ERROR 0.02f
+#define HLOD_TILE_SIZE 128
+//Levels of the atlas, they stop before the tile borders bleed into each other
+#define HLOD_ATLAS_MIPS 3
+
+//Proxies of the static meshes of an imported file, one per cell of the scene with enough meshes.
+//Offsets count from the start of the file.
+struct HLODFileHeader
+{
+	unsigned magic = HLOD_FILE_MAGIC;
+	unsigned version = HLOD_FILE_VERSION;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	unsigned num_clusters = 0;
+	unsigned clusters_offset = 0;
+};
+
+//Meshes are numbered in the order the scene creates their objects, depth first from its root
+struct HLODFileMember
+{
+	unsigned mesh = 0;
+	//Checked against the loaded mesh, a different count means the scene no longer matches
+	unsigned num_indices = 0;
+};
+
+//Unindexed proxy in the space of the scene root, planar positions, normals and texture coordinates.
+//The atlas is RGBA8 with the diffuse color of each material already applied.
+struct HLODFileCluster
+{
+	unsigned num_members = 0;
+	unsigned members_offset = 0;
+	unsigned num_source_triangles = 0;
+	float error = 0.0f;
+	unsigned num_vertices = 0;
+	unsigned vertices_offset = 0;
+	unsigned atlas_width = 0;
+	unsigned atlas_height = 0;
+	unsigned num_atlas_mips = 0;
+	unsigned atlas_offsets[HLOD_FILE_MAX_MIPS] = {};
+};
+
+//Null if the file is not valid or was made from a different source
+const HLODFileHeader* ValidateHLODFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time);
+
+#endif // !HLODFILE_H
@@ -0,0 +1,104 @@
+#include "JobSystem.h"
+
+JobSystem::JobSystem(unsigned num_workers)
+{
+	next_range = 0;
+
+	for (unsigned i = 0; i < num_workers; ++i)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+		it->join();
+}
+
+void JobSystem::ParallelFor(unsigned count, unsigned grain, const RangeJob& job)
+{
+	if (count == 0)
+		return;
+
+	if (grain == 0)
+		grain = 1;
+
+	if (workers.empty() || count <= grain)
+	{
+		job(0, count);
+		return;
+	}
+
+	{
+		//Workers that woke late for the previous batch must be gone before its state is replaced
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return active_workers == 0; });
+		this->job = &job;
+		this->count = count;
+		this->grain = grain;
+		next_range = 0;
+		++batch;
+	}
+	wake.notify_all();
+
+	while (RunNextRange(job, count, grain)) {}
+
+	//Every range has been taken, wait for the workers still processing theirs
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return active_workers == 0; });
+	this->job = nullptr;
+}
+
+void JobSystem::WorkerLoop()
+{
+	unsigned last_batch = 0;
+
+	while (true)
+	{
+		//The batch is copied under the lock, it only changes once every active worker is done
+		const RangeJob* batch_job = nullptr;
+		unsigned batch_count = 0;
+		unsigned batch_grain = 1;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, last_batch] { return quit || batch != last_batch; });
+			if (quit)
+				return;
+			last_batch = batch;
+
+			//Woke after the batch was finished by the others
+			if (job == nullptr)
+				continue;
+
+			batch_job = job;
+			batch_count = count;
+			batch_grain = grain;
+			++active_workers;
+		}
+
+		while (RunNextRange(*batch_job, batch_count, batch_grain)) {}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--active_workers;
+		}
+		done.notify_all();
+	}
+}
+
+bool JobSystem::RunNextRange(const RangeJob& job, unsigned count, unsigned grain)
+{
+	unsigned first = (next_range++) * grain;
+	if (first >= count)
+		return false;
+
+	unsigned last = first + grain < count ? first + grain : count;
+	job(first, last);
+
+	return true;
+}
\ No newline at end of file
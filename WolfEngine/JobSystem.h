@@ -0,0 +1,46 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+//Range job: processes the elements in [first, last)
+typedef std::function<void(unsigned first, unsigned last)> RangeJob;
+
+class JobSystem
+{
+public:
+	JobSystem(unsigned num_workers);
+	~JobSystem();
+
+	//Splits [0, count) in ranges of grain elements and runs them on the workers and the calling thread.
+	//Blocks until every range is done. Must be called from the main thread only.
+	void ParallelFor(unsigned count, unsigned grain, const RangeJob& job);
+
+	unsigned GetNumWorkers() const { return workers.size(); }
+
+private:
+	void WorkerLoop();
+	bool RunNextRange(const RangeJob& job, unsigned count, unsigned grain);
+
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned batch = 0;
+	unsigned active_workers = 0;
+	bool quit = false;
+
+	const RangeJob* job = nullptr;
+	unsigned count = 0;
+	unsigned grain = 1;
+	std::atomic<unsigned> next_range;
+};
+
+#endif // !JOBSYSTEM_H
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "LooseOctree.h"
+#include "SpatialQuery.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "Color.h"
+#include "TraversalStack.h"
+
+static unsigned Octant(const float3& center, const float3& point)
+{
+	return (point.x >= center.x ? 1 : 0) | (point.y >= center.y ? 2 : 0) | (point.z >= center.z ? 4 : 0);
+}
+
+static float3 OctantCenter(const float3& center, float half_size, unsigned octant)
+{
+	float quarter = 0.5f * half_size;
+	return float3(center.x + (octant & 1 ? quarter : -quarter), center.y + (octant & 2 ? quarter : -quarter), center.z + (octant & 4 ? quarter : -quarter));
+}
+
+//The root doubles outwards as objects fall outside it, which adds a level above cells that may already be
+//OCTREE_MAX_DEPTH deep, so the depth has no fixed bound and traversals may spill to the heap
+typedef TraversalStack<OCTREE_STACK_SIZE> OctreeStack;
+
+LooseOctree::LooseOctree()
+{
+}
+
+LooseOctree::~LooseOctree()
+{
+}
+
+unsigned LooseOctree::Insert(GameObject* object, const AABB& box)
+{
+	//Objects without geometry keep a negative infinity box and are not indexed
+	if (!box.IsFinite())
+		return INVALID_OCTREE_INDEX;
+
+	if (!Fits(root, box))
+		GrowRoot(box);
+
+	unsigned entry = AllocateEntry();
+	entries[entry].object = object;
+	entries[entry].box = box;
+	Link(entry, FindNode(root, box));
+	++num_objects;
+
+	return entry;
+}
+
+void LooseOctree::Update(unsigned entry, const AABB& box)
+{
+	if (entry == INVALID_OCTREE_INDEX || !box.IsFinite())
+		return;
+
+	entries[entry].box = box;
+
+	//Still inside the loose bounds and not small enough to go down: nothing to do
+	unsigned node = entries[entry].node;
+	if (Fits(node, box) && !FitsInChild(node, box))
+		return;
+
+	if (!Fits(root, box))
+		GrowRoot(box);
+
+	//Climb to the first cell that contains the object and descend from there
+	unsigned target = node;
+	while (target != root && !Fits(target, box))
+		target = nodes[target].parent;
+	target = FindNode(target, box);
+
+	if (target != node)
+	{
+		Unlink(entry);
+		Link(entry, target);
+		Prune(node);
+	}
+}
+
+void LooseOctree::Remove(unsigned entry)
+{
+	if (entry == INVALID_OCTREE_INDEX)
+		return;
+
+	unsigned node = entries[entry].node;
+	Unlink(entry);
+	Prune(node);
+
+	entries[entry].object = nullptr;
+	entries[entry].next = free_entries;
+	free_entries = entry;
+	--num_objects;
+}
+
+void LooseOctree::Clear()
+{
+	nodes.clear();
+	free_nodes.clear();
+	entries.clear();
+	free_entries = INVALID_OCTREE_INDEX;
+	root = INVALID_OCTREE_INDEX;
+	num_objects = 0;
+}
+
+void LooseOctree::Draw() const
+{
+	if (root == INVALID_OCTREE_INDEX)
+		return;
+
+	OctreeStack stack;
+	stack.Push(root);
+	while (!stack.Empty())
+	{
+		const OctreeNode& node = nodes[stack.Pop()];
+		App->renderer->debug_drawer->DrawBoundingBox(AABB(node.center - float3(node.half_size), node.center + float3(node.half_size)), Colors::Aqua);
+
+		for (unsigned i = 0; i < 8; ++i)
+			if (node.children[i] != INVALID_OCTREE_INDEX)
+				stack.Push(node.children[i]);
+	}
+}
+
+void LooseOctree::IntersectCandidates(std::vector<GameObject*>& candidates, const AABB& primitive) const
+{
+	if (root == INVALID_OCTREE_INDEX)
+		return;
+
+	OctreeStack stack;
+	stack.Push(root);
+	while (!stack.Empty())
+	{
+		unsigned node_index = stack.Pop();
+		if (!primitive.Intersects(GetLooseBounds(node_index)))
+			continue;
+
+		const OctreeNode& node = nodes[node_index];
+		for (unsigned entry = node.first_entry; entry != INVALID_OCTREE_INDEX; entry = entries[entry].next)
+			if (primitive.Intersects(entries[entry].box))
+				candidates.push_back(entries[entry].object);
+
+		for (unsigned i = 0; i < 8; ++i)
+			if (node.children[i] != INVALID_OCTREE_INDEX)
+				stack.Push(node.children[i]);
+	}
+}
+
+void LooseOctree::Query(SpatialQuery& query) const
+{
+	if (root == INVALID_OCTREE_INDEX)
+		return;
+
+	float distance = query.TestBounds(GetLooseBounds(root));
+	if (distance < 0.0f)
+		return;
+
+	OctreeStack stack;
+	stack.Push(root, distance);
+	while (!stack.Empty())
+	{
+		unsigned node_index = stack.Pop(&distance);
+		//The query may have shrunk its range since the node was pushed
+		if (distance > query.GetMaxDistance())
+			continue;
+
+		const OctreeNode& node = nodes[node_index];
+		for (unsigned entry = node.first_entry; entry != INVALID_OCTREE_INDEX; entry = entries[entry].next)
+			query.TestObject(entries[entry].object, entries[entry].box);
+
+		//Insertion sorted from the furthest child, pushed in that order the closest one is visited next
+		unsigned children[8];
+		float children_distances[8];
+		unsigned num_children = 0;
+		for (unsigned i = 0; i < 8; ++i)
+		{
+			if (node.children[i] == INVALID_OCTREE_INDEX)
+				continue;
+
+			distance = query.TestBounds(GetLooseBounds(node.children[i]));
+			if (distance < 0.0f)
+				continue;
+
+			unsigned j = num_children++;
+			for (; j > 0 && children_distances[j - 1] < distance; --j)
+			{
+				children[j] = children[j - 1];
+				children_distances[j] = children_distances[j - 1];
+			}
+			children[j] = node.children[i];
+			children_distances[j] = distance;
+		}
+
+		for (unsigned i = 0; i < num_children; ++i)
+			stack.Push(children[i], children_distances[i]);
+	}
+}
+
+unsigned LooseOctree::AllocateNode(const float3& center, float half_size, unsigned parent)
+{
+	unsigned index;
+	if (!free_nodes.empty())
+	{
+		index = free_nodes.back();
+		free_nodes.pop_back();
+		nodes[index] = OctreeNode();
+	}
+	else
+	{
+		index = nodes.size();
+		nodes.push_back(OctreeNode());
+	}
+
+	nodes[index].center = center;
+	nodes[index].half_size = half_size;
+	nodes[index].parent = parent;
+
+	return index;
+}
+
+void LooseOctree::ReleaseNode(unsigned node)
+{
+	free_nodes.push_back(node);
+}
+
+unsigned LooseOctree::AllocateEntry()
+{
+	if (free_entries != INVALID_OCTREE_INDEX)
+	{
+		unsigned index = free_entries;
+		free_entries = entries[index].next;
+		entries[index] = OctreeEntry();
+		return index;
+	}
+
+	entries.push_back(OctreeEntry());
+	return entries.size() - 1;
+}
+
+bool LooseOctree::Fits(unsigned node, const AABB& box) const
+{
+	if (node == INVALID_OCTREE_INDEX)
+		return false;
+
+	//Centre inside the cell and extents no larger than the cell keeps the box inside the loose bounds
+	const OctreeNode& cell = nodes[node];
+	float3 offset = (box.CenterPoint() - cell.center).Abs();
+	float3 half_extents = box.HalfSize();
+
+	return offset.x <= cell.half_size && offset.y <= cell.half_size && offset.z <= cell.half_size
+		&& half_extents.x <= cell.half_size && half_extents.y <= cell.half_size && half_extents.z <= cell.half_size;
+}
+
+bool LooseOctree::FitsInChild(unsigned node, const AABB& box) const
+{
+	float child_half_size = 0.5f * nodes[node].half_size;
+	if (child_half_size < nodes[root].half_size / (1 << OCTREE_MAX_DEPTH))
+		return false;
+
+	float3 half_extents = box.HalfSize();
+	return half_extents.x <= child_half_size && half_extents.y <= child_half_size && half_extents.z <= child_half_size;
+}
+
+unsigned LooseOctree::FindNode(unsigned node, const AABB& box)
+{
+	float3 center = box.CenterPoint();
+
+	while (FitsInChild(node, box))
+	{
+		unsigned octant = Octant(nodes[node].center, center);
+		if (nodes[node].children[octant] == INVALID_OCTREE_INDEX)
+		{
+			unsigned child = AllocateNode(OctantCenter(nodes[node].center, nodes[node].half_size, octant), 0.5f * nodes[node].half_size, node);
+			nodes[node].children[octant] = child;
+			++nodes[node].num_children;
+		}
+		node = nodes[node].children[octant];
+	}
+
+	return node;
+}
+
+void LooseOctree::GrowRoot(const AABB& box)
+{
+	float3 target = box.CenterPoint();
+	float3 half_extents = box.HalfSize();
+	float needed_half_size = MAX(MAX(half_extents.x, half_extents.y), half_extents.z);
+
+	//An empty tree is simply recentred on the object
+	if (root == INVALID_OCTREE_INDEX || (nodes[root].num_entries == 0 && nodes[root].num_children == 0))
+	{
+		float half_size = OCTREE_MIN_ROOT_HALF_SIZE;
+		while (half_size < needed_half_size)
+			half_size *= 2.0f;
+
+		if (root == INVALID_OCTREE_INDEX)
+			root = AllocateNode(target, half_size, INVALID_OCTREE_INDEX);
+		else
+		{
+			nodes[root].center = target;
+			nodes[root].half_size = half_size;
+		}
+		return;
+	}
+
+	//Double the root towards the object, the old root becomes one of the new octants
+	while (!Fits(root, box))
+	{
+		const float3 old_center = nodes[root].center;
+		float half_size = nodes[root].half_size;
+		float3 new_center = float3(old_center.x + (target.x >= old_center.x ? half_size : -half_size),
+			old_center.y + (target.y >= old_center.y ? half_size : -half_size),
+			old_center.z + (target.z >= old_center.z ? half_size : -half_size));
+
+		unsigned new_root = AllocateNode(new_center, 2.0f * half_size, INVALID_OCTREE_INDEX);
+		nodes[new_root].children[Octant(new_center, old_center)] = root;
+		nodes[new_root].num_children = 1;
+		nodes[root].parent = new_root;
+		root = new_root;
+	}
+}
+
+void LooseOctree::Prune(unsigned node)
+{
+	while (node != root && nodes[node].num_entries == 0 && nodes[node].num_children == 0)
+	{
+		unsigned parent = nodes[node].parent;
+		for (unsigned i = 0; i < 8; ++i)
+		{
+			if (nodes[parent].children[i] == node)
+			{
+				nodes[parent].children[i] = INVALID_OCTREE_INDEX;
+				--nodes[parent].num_children;
+				break;
+			}
+		}
+
+		ReleaseNode(node);
+		node = parent;
+	}
+}
+
+void LooseOctree::Link(unsigned entry, unsigned node)
+{
+	OctreeEntry& object = entries[entry];
+	object.node = node;
+	object.prev = INVALID_OCTREE_INDEX;
+	object.next = nodes[node].first_entry;
+	if (object.next != INVALID_OCTREE_INDEX)
+		entries[object.next].prev = entry;
+
+	nodes[node].first_entry = entry;
+	++nodes[node].num_entries;
+}
+
+void LooseOctree::Unlink(unsigned entry)
+{
+	OctreeEntry& object = entries[entry];
+	if (object.prev != INVALID_OCTREE_INDEX)
+		entries[object.prev].next = object.next;
+	else
+		nodes[object.node].first_entry = object.next;
+
+	if (object.next != INVALID_OCTREE_INDEX)
+		entries[object.next].prev = object.prev;
+
+	--nodes[object.node].num_entries;
+	object.node = INVALID_OCTREE_INDEX;
+	object.prev = INVALID_OCTREE_INDEX;
+	object.next = INVALID_OCTREE_INDEX;
+}
+
+AABB LooseOctree::GetLooseBounds(unsigned node) const
+{
+	float3 loose_half_size = float3(2.0f * nodes[node].half_size);
+	return AABB(nodes[node].center - loose_half_size, nodes[node].center + loose_half_size);
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef LOOSEOCTREE_H
+#define LOOSEOCTREE_H
+
+#include "Math.h"
+#include "Globals.h"
+#include <vector>
+
+#define INVALID_OCTREE_INDEX 0xFFFFFFFF
+//Cells deeper than the root half size / 2^OCTREE_MAX_DEPTH are not created
+#define OCTREE_MAX_DEPTH 8
+#define OCTREE_MIN_ROOT_HALF_SIZE 1.0f
+//Traversals keep this many nodes on the call stack, trees grown deeper spill the rest to the heap
+#define OCTREE_STACK_SIZE 512
+
+class GameObject;
+class SpatialQuery;
+
+//Cubic cell, objects are stored in the deepest cell whose loose bounds (twice the cell) contain them
+struct OctreeNode
+{
+	float3 center = float3::zero;
+	float half_size = 0.0f;
+
+	unsigned parent = INVALID_OCTREE_INDEX;
+	unsigned children[8] = { INVALID_OCTREE_INDEX, INVALID_OCTREE_INDEX, INVALID_OCTREE_INDEX, INVALID_OCTREE_INDEX,
+		INVALID_OCTREE_INDEX, INVALID_OCTREE_INDEX, INVALID_OCTREE_INDEX, INVALID_OCTREE_INDEX };
+	unsigned num_children = 0;
+
+	unsigned first_entry = INVALID_OCTREE_INDEX;
+	unsigned num_entries = 0;
+};
+
+//Intrusive list of the objects in a node, free entries are chained through next
+struct OctreeEntry
+{
+	GameObject* object = nullptr;
+	AABB box;
+	unsigned node = INVALID_OCTREE_INDEX;
+	unsigned prev = INVALID_OCTREE_INDEX;
+	unsigned next = INVALID_OCTREE_INDEX;
+};
+
+class LooseOctree
+{
+public:
+	LooseOctree();
+	~LooseOctree();
+
+	unsigned Insert(GameObject* object, const AABB& box);
+	void Update(unsigned entry, const AABB& box);
+	void Remove(unsigned entry);
+	void Clear();
+
+	void Draw() const;
+	void IntersectCandidates(std::vector<GameObject*>& candidates, const AABB& primitive) const;
+	void Query(SpatialQuery& query) const;
+
+	unsigned GetNumObjects() const { return num_objects; }
+	unsigned GetNumNodes() const { return nodes.size() - free_nodes.size(); }
+
+private:
+	unsigned AllocateNode(const float3& center, float half_size, unsigned parent);
+	void ReleaseNode(unsigned node);
+	unsigned AllocateEntry();
+
+	bool Fits(unsigned node, const AABB& box) const;
+	bool FitsInChild(unsigned node, const AABB& box) const;
+	unsigned FindNode(unsigned node, const AABB& box);
+	void GrowRoot(const AABB& box);
+	void Prune(unsigned node);
+
+	void Link(unsigned entry, unsigned node);
+	void Unlink(unsigned entry);
+
+	AABB GetLooseBounds(unsigned node) const;
+
+private:
+	std::vector<OctreeNode> nodes;
+	std::vector<unsigned> free_nodes;
+	std::vector<OctreeEntry> entries;
+	unsigned free_entries = INVALID_OCTREE_INDEX;
+
+	unsigned root = INVALID_OCTREE_INDEX;
+	unsigned num_objects = 0;
+};
+
+#endif // !LOOSEOCTREE_H
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE)
+		return false;
+	file = file_handle;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	size = file_size.QuadPart;
+#else
+	file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* view = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	data = view != MAP_FAILED ? (const char*)view : nullptr;
+	size = file_stat.st_size;
+#endif
+
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != nullptr)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data != nullptr)
+		munmap((void*)data, size);
+	if (file >= 0)
+		close(file);
+	file = -1;
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+bool MappedFile::GetFileStamp(const char* path, unsigned long long& size, unsigned long long& time)
+{
+	struct stat file_stat;
+	if (stat(path, &file_stat) != 0)
+		return false;
+
+	size = file_stat.st_size;
+	time = file_stat.st_mtime;
+	return true;
+}
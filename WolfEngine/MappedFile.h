@@ -0,0 +1,33 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+//Read only view of a whole file, pages are loaded by the OS as they are touched
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	const char* GetData() const { return data; }
+	unsigned long long GetSize() const { return size; }
+
+	//Size and modification time, false if the file can't be found
+	static bool GetFileStamp(const char* path, unsigned long long& size, unsigned long long& time);
+
+private:
+	const char* data = nullptr;
+	unsigned long long size = 0;
+
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+#endif // !MAPPEDFILE_H
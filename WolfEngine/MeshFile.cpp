@@ -0,0 +1,81 @@
+#include "MeshFile.h"
+#include "Globals.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+MeshFileWriter::MeshFileWriter() : data(sizeof(MeshFileHeader), 0)
+{
+}
+
+bool MeshFileWriter::Write(const char* path, unsigned long long source_size, unsigned long long source_time)
+{
+	MeshFileHeader header;
+	header.source_size = source_size;
+	header.source_time = source_time;
+	header.num_nodes = nodes.size();
+	header.nodes_offset = AppendMeshFileData(data, nodes.empty() ? nullptr : &nodes[0], nodes.size() * sizeof(MeshFileNode));
+	header.num_submeshes = submeshes.size();
+	header.submeshes_offset = AppendMeshFileData(data, submeshes.empty() ? nullptr : &submeshes[0], submeshes.size() * sizeof(MeshFileSubmesh));
+	header.num_materials = materials.size();
+	header.materials_offset = AppendMeshFileData(data, materials.empty() ? nullptr : &materials[0], materials.size() * sizeof(MeshFileMaterial));
+	memcpy(&data[0], &header, sizeof(header));
+
+	return WriteCookedFile(path, data);
+}
+
+unsigned AppendMeshFileData(std::vector<char>& data, const void* block, unsigned size, unsigned alignment)
+{
+	unsigned offset = (data.size() + alignment - 1) / alignment * alignment;
+	data.resize(offset + size, 0);
+	if (size > 0)
+		memcpy(&data[offset], block, size);
+
+	return offset;
+}
+
+unsigned AppendMeshFileString(std::vector<char>& data, const std::string& string)
+{
+	return AppendMeshFileData(data, string.c_str(), string.size() + 1, 1);
+}
+
+bool WriteCookedFile(const char* path, const std::vector<char>& data)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+	{
+		APPLOG("Error writing %s: %s", path, strerror(errno));
+		return false;
+	}
+
+	bool written = fwrite(&data[0], 1, data.size(), file) == data.size();
+	fclose(file);
+
+	//A truncated file would still pass the stamp check
+	if (!written)
+	{
+		APPLOG("Error writing %s", path);
+		remove(path);
+	}
+
+	return written;
+}
+
+const MeshFileHeader* ValidateMeshFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time)
+{
+	if (data == nullptr || size < sizeof(MeshFileHeader))
+		return nullptr;
+
+	const MeshFileHeader* header = (const MeshFileHeader*)data;
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION ||
+		header->source_size != source_size || header->source_time != source_time || header->num_nodes == 0)
+		return nullptr;
+
+	//Tables must be inside the file, the streams they point to are trusted
+	if (header->nodes_offset + (unsigned long long)header->num_nodes * sizeof(MeshFileNode) > size ||
+		header->submeshes_offset + (unsigned long long)header->num_submeshes * sizeof(MeshFileSubmesh) > size ||
+		header->materials_offset + (unsigned long long)header->num_materials * sizeof(MeshFileMaterial) > size)
+		return nullptr;
+
+	return header;
+}
@@ -0,0 +1,122 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include "MeshSimplifier.h"
+#include <vector>
+#include <string>
+
+#define MESH_FILE_EXTENSION ".wmesh"
+#define MESH_FILE_MAGIC 0x48534D57
+#define MESH_FILE_VERSION 2
+//Streams start aligned so they can go to the driver or SIMD code straight from the mapping
+#define MESH_FILE_ALIGNMENT 16
+#define MESH_FILE_NONE 0xFFFFFFFF
+
+#define MESH_FILE_NORMALS 1
+#define MESH_FILE_TEX_COORDS 2
+
+//Post processing of every imported scene, cooked files have to match what the runtime import builds
+#define MESH_IMPORT_FLAGS (aiProcess_Triangulate | aiProcessPreset_TargetRealtime_MaxQuality)
+
+//Engine ready copy of an imported scene. Every offset counts from the start of the file.
+//Cooked files all start with the magic, the version and the source stamp laid out like this.
+struct MeshFileHeader
+{
+	unsigned magic = MESH_FILE_MAGIC;
+	unsigned version = MESH_FILE_VERSION;
+	//Stamp of the source file it was imported from, a different one means the file is stale
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	unsigned num_nodes = 0;
+	unsigned nodes_offset = 0;
+	unsigned num_submeshes = 0;
+	unsigned submeshes_offset = 0;
+	unsigned num_materials = 0;
+	unsigned materials_offset = 0;
+};
+
+//Nodes are stored parents first
+struct MeshFileNode
+{
+	unsigned name = 0;
+	int parent = -1;
+	float position[3];
+	float scale[3];
+	float rotation[4];
+	unsigned submesh = MESH_FILE_NONE;
+	unsigned material = MESH_FILE_NONE;
+};
+
+struct MeshFileLod
+{
+	unsigned indices_offset = 0;
+	unsigned num_indices = 0;
+	float error = 0.0f;
+};
+
+struct MeshFileSubmesh
+{
+	unsigned flags = 0;
+	unsigned num_vertices = 0;
+	unsigned num_indices = 0;
+	float bounds_min[3];
+	float bounds_max[3];
+	//Positions, then normals, then texture coordinates, the layout of the vertex buffer
+	unsigned vertices_offset = 0;
+	unsigned vertices_size = 0;
+	//Sorted by meshlet, level 0 of the LODs
+	unsigned indices_offset = 0;
+	unsigned num_lods = 0;
+	MeshFileLod lods[MESH_LOD_MAX_LEVELS];
+	unsigned num_meshlets = 0;
+	unsigned meshlets_offset = 0;
+	unsigned num_bones = 0;
+	unsigned bones_offset = 0;
+};
+
+//Same layout as the Weight of a mesh bone
+struct MeshFileWeight
+{
+	unsigned vertex = 0;
+	float weight = 0.0f;
+};
+
+struct MeshFileBone
+{
+	unsigned name = 0;
+	float bind[16];
+	unsigned num_weights = 0;
+	unsigned weights_offset = 0;
+};
+
+struct MeshFileMaterial
+{
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float shiness = 0.0f;
+	unsigned texture = MESH_FILE_NONE;
+};
+
+//Streams are appended to data while the nodes are added, the tables and the header are written at the end
+struct MeshFileWriter
+{
+	MeshFileWriter();
+
+	bool Write(const char* path, unsigned long long source_size, unsigned long long source_time);
+
+	std::vector<char> data;
+	std::vector<MeshFileNode> nodes;
+	std::vector<MeshFileSubmesh> submeshes;
+	std::vector<MeshFileMaterial> materials;
+};
+
+//Pads the file to the alignment and appends the block, returns its offset
+unsigned AppendMeshFileData(std::vector<char>& data, const void* block, unsigned size, unsigned alignment = MESH_FILE_ALIGNMENT);
+unsigned AppendMeshFileString(std::vector<char>& data, const std::string& string);
+bool WriteCookedFile(const char* path, const std::vector<char>& data);
+
+//Null if the file is not valid or was made from a different source
+const MeshFileHeader* ValidateMeshFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time);
+
+#endif // !MESHFILE_H
@@ -0,0 +1,271 @@
+#include "MeshOptimizer.h"
+#include "Globals.h"
+#include <algorithm>
+
+#define INVALID_VERTEX 0xFFFFFFFF
+
+struct OverdrawCluster
+{
+	unsigned first_index;
+	unsigned num_indices;
+	float sort_key;
+
+	bool operator<(const OverdrawCluster& other) const { return sort_key > other.sort_key; }
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned* indices, unsigned num_indices, unsigned num_vertices, unsigned cache_size)
+{
+	VertexCacheStats stats;
+	if (num_indices < 3)
+		return stats;
+
+	//Time each vertex entered the cache, a vertex is still there if fewer than cache_size misses happened since
+	std::vector<unsigned> cache_time(num_vertices, 0);
+	std::vector<unsigned char> used(num_vertices, 0);
+	unsigned misses = 0;
+	unsigned num_used = 0;
+	for (unsigned i = 0; i < num_indices; ++i)
+	{
+		unsigned vertex = indices[i];
+		if (cache_time[vertex] == 0 || misses - cache_time[vertex] >= cache_size)
+			cache_time[vertex] = ++misses;
+
+		if (!used[vertex])
+		{
+			used[vertex] = 1;
+			++num_used;
+		}
+	}
+
+	stats.acmr = (float)misses / (num_indices / 3);
+	stats.atvr = (float)misses / num_used;
+	return stats;
+}
+
+static unsigned SkipDeadEnd(const std::vector<unsigned>& live_triangles, std::vector<unsigned>& dead_ends, unsigned& cursor, unsigned num_vertices, bool& cold)
+{
+	//Recently used vertices first, they may still be in the cache
+	while (!dead_ends.empty())
+	{
+		unsigned vertex = dead_ends.back();
+		dead_ends.pop_back();
+		if (live_triangles[vertex] > 0)
+			return vertex;
+	}
+
+	cold = true;
+	for (; cursor < num_vertices; ++cursor)
+		if (live_triangles[cursor] > 0)
+			return cursor;
+
+	return INVALID_VERTEX;
+}
+
+void OptimizeVertexCache(unsigned* indices, unsigned num_indices, unsigned num_vertices, std::vector<unsigned>* clusters)
+{
+	if (clusters != nullptr)
+		clusters->clear();
+
+	unsigned num_triangles = num_indices / 3;
+	if (num_triangles == 0)
+		return;
+
+	//Triangles around each vertex
+	std::vector<unsigned> adjacency_offsets(num_vertices + 1, 0);
+	std::vector<unsigned> adjacency(3 * num_triangles);
+	for (unsigned i = 0; i < 3 * num_triangles; ++i)
+		++adjacency_offsets[indices[i] + 1];
+	for (unsigned i = 0; i < num_vertices; ++i)
+		adjacency_offsets[i + 1] += adjacency_offsets[i];
+	std::vector<unsigned> live_triangles(num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+		live_triangles[i] = adjacency_offsets[i + 1] - adjacency_offsets[i];
+	std::vector<unsigned> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (unsigned i = 0; i < 3 * num_triangles; ++i)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	std::vector<unsigned char> emitted(num_triangles, 0);
+	std::vector<unsigned> cache_time(num_vertices, 0);
+	std::vector<unsigned> dead_ends;
+	std::vector<unsigned> candidates;
+	std::vector<unsigned> reordered;
+	reordered.reserve(3 * num_triangles);
+
+	//Timestamps start above the cache size so untouched vertices never look cached
+	unsigned time = VERTEX_CACHE_SIZE + 1;
+	unsigned cursor = 0;
+	bool cold = true;
+	unsigned fan = SkipDeadEnd(live_triangles, dead_ends, cursor, num_vertices, cold);
+	while (fan != INVALID_VERTEX)
+	{
+		if (cold && clusters != nullptr)
+			clusters->push_back(reordered.size());
+		cold = false;
+
+		candidates.clear();
+		for (unsigned i = adjacency_offsets[fan]; i < adjacency_offsets[fan + 1]; ++i)
+		{
+			unsigned triangle = adjacency[i];
+			if (emitted[triangle])
+				continue;
+
+			emitted[triangle] = 1;
+			for (unsigned j = 0; j < 3; ++j)
+			{
+				unsigned vertex = indices[3 * triangle + j];
+				reordered.push_back(vertex);
+				dead_ends.push_back(vertex);
+				candidates.push_back(vertex);
+				--live_triangles[vertex];
+				if (time - cache_time[vertex] > VERTEX_CACHE_SIZE)
+					cache_time[vertex] = time++;
+			}
+		}
+
+		//Next fan around the vertex that will stay cached the longest once its triangles are emitted
+		fan = INVALID_VERTEX;
+		int best_priority = -1;
+		for (std::vector<unsigned>::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
+		{
+			if (live_triangles[*it] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cache_time[*it] + 2 * live_triangles[*it] <= VERTEX_CACHE_SIZE)
+				priority = time - cache_time[*it];
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				fan = *it;
+			}
+		}
+
+		if (fan == INVALID_VERTEX)
+			fan = SkipDeadEnd(live_triangles, dead_ends, cursor, num_vertices, cold);
+	}
+
+	memcpy(indices, &reordered[0], 3 * num_triangles * sizeof(unsigned));
+}
+
+void OptimizeOverdraw(const float3* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices, const std::vector<unsigned>& clusters)
+{
+	unsigned num_triangles = num_indices / 3;
+	if (num_triangles == 0)
+		return;
+
+	float threshold = AnalyzeVertexCache(indices, num_indices, num_vertices).acmr * OVERDRAW_THRESHOLD;
+
+	//Cold starts always split, any other cluster ends once it would cost about the same drawn on its own,
+	//so the cache starts empty at each cluster as it may when they are sorted
+	std::vector<unsigned> offsets;
+	std::vector<unsigned> cache_time(num_vertices, 0);
+	unsigned next_cold = 0;
+	unsigned misses = 0;
+	unsigned cluster_start = 0;
+	unsigned cluster_misses = 0;
+	unsigned cluster_triangles = 0;
+	for (unsigned i = 0; i < num_triangles; ++i)
+	{
+		bool split = cluster_triangles > 0 && (float)cluster_misses / cluster_triangles <= threshold;
+		if (next_cold < clusters.size() && clusters[next_cold] == 3 * i)
+		{
+			split = true;
+			++next_cold;
+		}
+		if (i == 0 || split)
+		{
+			offsets.push_back(3 * i);
+			cluster_start = misses;
+			cluster_misses = 0;
+			cluster_triangles = 0;
+		}
+
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			unsigned vertex = indices[3 * i + j];
+			if (cache_time[vertex] <= cluster_start || misses - cache_time[vertex] >= VERTEX_CACHE_SIZE)
+			{
+				cache_time[vertex] = ++misses;
+				++cluster_misses;
+			}
+		}
+		++cluster_triangles;
+	}
+	offsets.push_back(num_indices);
+
+	if (offsets.size() < 3)
+		return;
+
+	//Area weighted centroids and normals, the mesh centroid is the reference every cluster faces away from
+	float3 mesh_centroid = float3::zero;
+	float mesh_area = 0.0f;
+	std::vector<OverdrawCluster> sorted(offsets.size() - 1);
+	std::vector<float3> cluster_centroids(sorted.size());
+	std::vector<float3> cluster_normals(sorted.size());
+	for (unsigned i = 0; i < sorted.size(); ++i)
+	{
+		sorted[i].first_index = offsets[i];
+		sorted[i].num_indices = offsets[i + 1] - offsets[i];
+
+		float3 centroid = float3::zero;
+		float3 normal = float3::zero;
+		float area = 0.0f;
+		for (unsigned j = offsets[i]; j < offsets[i + 1]; j += 3)
+		{
+			const float3& a = vertices[indices[j]];
+			const float3& b = vertices[indices[j + 1]];
+			const float3& c = vertices[indices[j + 2]];
+			float3 cross = (b - a).Cross(c - a);
+			float triangle_area = cross.Length();
+			centroid += (a + b + c) * (triangle_area / 3.0f);
+			normal += cross;
+			area += triangle_area;
+		}
+
+		mesh_centroid += centroid;
+		mesh_area += area;
+		cluster_centroids[i] = area > 0.0f ? centroid / area : vertices[indices[offsets[i]]];
+		cluster_normals[i] = normal.Normalized();
+	}
+	if (mesh_area > 0.0f)
+		mesh_centroid /= mesh_area;
+
+	//Clusters with no area or normals that cancel out have no side to face
+	for (unsigned i = 0; i < sorted.size(); ++i)
+		sorted[i].sort_key = cluster_normals[i].IsFinite() ? (cluster_centroids[i] - mesh_centroid).Dot(cluster_normals[i]) : 0.0f;
+
+	std::stable_sort(sorted.begin(), sorted.end());
+
+	std::vector<unsigned> reordered;
+	reordered.reserve(num_indices);
+	for (std::vector<OverdrawCluster>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+		reordered.insert(reordered.end(), indices + it->first_index, indices + it->first_index + it->num_indices);
+
+	memcpy(indices, &reordered[0], num_indices * sizeof(unsigned));
+}
+
+void OptimizeVertexFetch(unsigned* indices, unsigned num_indices, unsigned num_vertices, std::vector<unsigned>& remap)
+{
+	remap.assign(num_vertices, INVALID_VERTEX);
+
+	unsigned next = 0;
+	for (unsigned i = 0; i < num_indices; ++i)
+	{
+		unsigned vertex = indices[i];
+		if (remap[vertex] == INVALID_VERTEX)
+			remap[vertex] = next++;
+		indices[i] = remap[vertex];
+	}
+
+	for (unsigned i = 0; i < num_vertices; ++i)
+		if (remap[i] == INVALID_VERTEX)
+			remap[i] = next++;
+}
+
+void OptimizeMesh(const float3* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices, std::vector<unsigned>& remap)
+{
+	std::vector<unsigned> clusters;
+	OptimizeVertexCache(indices, num_indices, num_vertices, &clusters);
+	OptimizeOverdraw(vertices, num_vertices, indices, num_indices, clusters);
+	OptimizeVertexFetch(indices, num_indices, num_vertices, remap);
+}
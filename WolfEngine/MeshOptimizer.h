@@ -0,0 +1,45 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "Math.h"
+#include <vector>
+
+//Post transform cache the orders are tuned for and measured with
+#define VERTEX_CACHE_SIZE 16
+//A cluster ends once its cache miss ratio is within this factor of the mesh one
+#define OVERDRAW_THRESHOLD 1.05f
+
+struct VertexCacheStats
+{
+	//Cache misses per triangle, 0.5 is the ideal for a regular grid and 3 the worst
+	float acmr = 0.0f;
+	//Cache misses per vertex, 1 is the ideal
+	float atvr = 0.0f;
+};
+
+//FIFO cache simulation of the index buffer
+VertexCacheStats AnalyzeVertexCache(const unsigned* indices, unsigned num_indices, unsigned num_vertices, unsigned cache_size = VERTEX_CACHE_SIZE);
+
+//Tipsify: fans triangles around the vertex that will stay the longest in the cache. clusters gets the
+//index offsets where the order had to restart cold, the first one is always 0.
+void OptimizeVertexCache(unsigned* indices, unsigned num_indices, unsigned num_vertices, std::vector<unsigned>* clusters = nullptr);
+
+//Splits the cache order further where it costs little and sorts the clusters so the ones facing away from
+//the mesh center, which tend to hide the rest, are drawn first
+void OptimizeOverdraw(const float3* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices, const std::vector<unsigned>& clusters);
+
+//Vertices in order of first use, unused ones go last. Rewrites the indices, the attributes are moved with RemapVertices.
+void OptimizeVertexFetch(unsigned* indices, unsigned num_indices, unsigned num_vertices, std::vector<unsigned>& remap);
+
+//The three passes in order, positions must be in the order before remap
+void OptimizeMesh(const float3* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices, std::vector<unsigned>& remap);
+
+template<class T>
+void RemapVertices(T* stream, unsigned num_vertices, const std::vector<unsigned>& remap)
+{
+	std::vector<T> source(stream, stream + num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+		stream[remap[i]] = source[i];
+}
+
+#endif // !MESHOPTIMIZER_H
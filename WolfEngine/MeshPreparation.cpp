@@ -0,0 +1,33 @@
+#include "MeshPreparation.h"
+#include "MeshSimplifier.h"
+
+void PrepareMesh(float3* vertices, float3* normals, float2* tex_coords, unsigned num_vertices, unsigned* indices, unsigned num_indices,
+	MeshPreparation& preparation)
+{
+	//Point clouds and empty meshes keep their order
+	if (num_indices == 0)
+	{
+		preparation.remap.resize(num_vertices);
+		for (unsigned i = 0; i < num_vertices; ++i)
+			preparation.remap[i] = i;
+		return;
+	}
+
+	//The file order is whatever the exporter and the import steps left, the vertices follow the new index order
+	preparation.source_stats = AnalyzeVertexCache(indices, num_indices, num_vertices);
+	OptimizeMesh(vertices, num_vertices, indices, num_indices, preparation.remap);
+	RemapVertices(vertices, num_vertices, preparation.remap);
+	if (normals != nullptr)
+		RemapVertices(normals, num_vertices, preparation.remap);
+	if (tex_coords != nullptr)
+		RemapVertices(tex_coords, num_vertices, preparation.remap);
+
+	//Reorders the indices before they are uploaded and the LODs are built from them
+	if (preparation.build_meshlets)
+		BuildMeshlets(vertices, num_vertices, indices, num_indices, preparation.meshlets);
+
+	if (preparation.build_lods)
+		GenerateLodChain(vertices, num_vertices, indices, num_indices, preparation.lod_levels, preparation.lod_errors);
+
+	preparation.stats = AnalyzeVertexCache(indices, num_indices, num_vertices);
+}
@@ -0,0 +1,31 @@
+#ifndef MESHPREPARATION_H
+#define MESHPREPARATION_H
+
+#include "Math.h"
+#include "MeshOptimizer.h"
+#include "Meshlet.h"
+#include <vector>
+
+//What is built from a mesh before it is uploaded, the same in the engine and the cooker
+struct MeshPreparation
+{
+	bool build_meshlets = false;
+	bool build_lods = false;
+
+	//New place of every source vertex, for data indexed by them like bone weights
+	std::vector<unsigned> remap;
+	std::vector<Meshlet> meshlets;
+	//levels[0] is LOD 1, see GenerateLodChain
+	std::vector<std::vector<unsigned> > lod_levels;
+	std::vector<float> lod_errors;
+
+	VertexCacheStats source_stats;
+	VertexCacheStats stats;
+};
+
+//Vertex cache, overdraw and fetch order, then the meshlets sort the indices the LODs are built from.
+//The arrays are reordered in place, normals and texture coordinates may be null.
+void PrepareMesh(float3* vertices, float3* normals, float2* tex_coords, unsigned num_vertices, unsigned* indices, unsigned num_indices,
+	MeshPreparation& preparation);
+
+#endif // !MESHPREPARATION_H
@@ -0,0 +1,400 @@
+#include "MeshSimplifier.h"
+#include "Globals.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+//Border planes weigh more than faces so open edges stay in place
+#define BORDER_QUADRIC_WEIGHT 10.0f
+//A collapse is rejected if it turns a face more than this (cosine)
+#define MAX_FACE_ROTATION 0.25f
+
+enum VertexKind
+{
+	VERTEX_MANIFOLD,
+	VERTEX_BORDER,
+	VERTEX_SEAM,
+	VERTEX_LOCKED
+};
+
+struct Collapse
+{
+	unsigned from;
+	unsigned to;
+	float error;
+
+	bool operator<(const Collapse& other) const { return error < other.error; }
+};
+
+struct PositionHasher
+{
+	size_t operator()(const float3& position) const
+	{
+		const unsigned* bits = (const unsigned*)position.ptr();
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+struct PositionEqual
+{
+	bool operator()(const float3& first, const float3& second) const
+	{
+		return first.x == second.x && first.y == second.y && first.z == second.z;
+	}
+};
+
+static unsigned long long EdgeKey(unsigned first, unsigned second)
+{
+	return ((unsigned long long)first << 32) | second;
+}
+
+void Quadric::AddPlane(const float3& normal, float distance, float weight)
+{
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	a00 += weight * a * a; a01 += weight * a * b; a02 += weight * a * c; a03 += weight * a * d;
+	a11 += weight * b * b; a12 += weight * b * c; a13 += weight * b * d;
+	a22 += weight * c * c; a23 += weight * c * d;
+	a33 += weight * d * d;
+	this->weight += weight;
+}
+
+void Quadric::Add(const Quadric& other)
+{
+	a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+	a11 += other.a11; a12 += other.a12; a13 += other.a13;
+	a22 += other.a22; a23 += other.a23;
+	a33 += other.a33;
+	weight += other.weight;
+}
+
+double Quadric::Evaluate(const float3& point) const
+{
+	double x = point.x, y = point.y, z = point.z;
+	double error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+		+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+		+ a22 * z * z + 2.0 * a23 * z
+		+ a33;
+
+	return weight > 0.0 ? fabs(error) / weight : 0.0;
+}
+
+//True if a remaining face has the edge from first to second, looked up around first
+static bool HasEdge(const unsigned* indices, const unsigned* adjacency_offsets, const unsigned* adjacency, unsigned first, unsigned second)
+{
+	for (unsigned i = adjacency_offsets[first]; i < adjacency_offsets[first + 1]; ++i)
+	{
+		const unsigned* triangle = indices + adjacency[i] * 3;
+		for (unsigned j = 0; j < 3; ++j)
+			if (triangle[j] == first && triangle[(j + 1) % 3] == second)
+				return true;
+	}
+
+	return false;
+}
+
+//True if moving from onto to flips or folds any of the remaining faces around from
+static bool FlipsFaces(const float3* positions, const unsigned* indices, const unsigned* adjacency_offsets, const unsigned* adjacency,
+	unsigned from, unsigned to)
+{
+	for (unsigned i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i)
+	{
+		const unsigned* triangle = indices + adjacency[i] * 3;
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			continue;
+
+		float3 before[3], after[3];
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			before[j] = positions[triangle[j]];
+			after[j] = triangle[j] == from ? positions[to] : before[j];
+		}
+
+		float3 normal_before = (before[1] - before[0]).Cross(before[2] - before[0]);
+		float3 normal_after = (after[1] - after[0]).Cross(after[2] - after[0]);
+		//Faces that are already degenerate, like the ones at the poles of a sphere, have nothing to flip.
+		//The others can't become degenerate either, later collapses would fold them.
+		float length_before = normal_before.Length();
+		if (length_before > 0.0f && normal_before.Dot(normal_after) <= MAX_FACE_ROTATION * length_before * normal_after.Length())
+			return true;
+	}
+
+	return false;
+}
+
+unsigned WeldPositions(const float3* vertices, unsigned num_vertices, unsigned* remap)
+{
+	std::unordered_map<float3, unsigned, PositionHasher, PositionEqual> ids;
+	ids.reserve(num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+	{
+		std::unordered_map<float3, unsigned, PositionHasher, PositionEqual>::iterator it = ids.insert(std::make_pair(vertices[i], (unsigned)ids.size())).first;
+		remap[i] = it->second;
+	}
+
+	return ids.size();
+}
+
+float SimplifyMesh(const float3* vertices, unsigned num_vertices, const unsigned* indices, unsigned num_indices,
+	unsigned target_indices, float target_error, std::vector<unsigned>& dst_indices)
+{
+	dst_indices.assign(indices, indices + num_indices);
+	if (num_indices <= target_indices || num_vertices == 0)
+		return 0.0f;
+
+	//Work in a space where the bounding box half diagonal is one, errors come out relative to it
+	AABB bounds;
+	bounds.SetFrom(vertices, num_vertices);
+	float3 center = bounds.CenterPoint();
+	float scale = bounds.HalfDiagonal().Length();
+	scale = scale > 0.0f ? 1.0f / scale : 1.0f;
+
+	std::vector<float3> positions(num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+		positions[i] = (vertices[i] - center) * scale;
+
+	//Vertices sharing a position but not attributes form seams, each side only moves together with the other
+	std::vector<unsigned> copies(num_vertices, 0);
+	std::vector<unsigned> position_ids(num_vertices);
+	unsigned num_positions = WeldPositions(vertices, num_vertices, &position_ids[0]);
+
+	std::unordered_set<unsigned long long> edges;
+	for (unsigned i = 0; i < num_indices; ++i)
+	{
+		edges.insert(EdgeKey(dst_indices[i], dst_indices[i - i % 3 + (i + 1) % 3]));
+	}
+
+	//Open edges leaving and entering each vertex, a seam or border passing through has one of each
+	std::vector<unsigned> open_out(num_vertices, 0);
+	std::vector<unsigned> open_in(num_vertices, 0);
+	for (std::unordered_set<unsigned long long>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		unsigned first = (unsigned)(*it >> 32), second = (unsigned)*it;
+		if (edges.find(EdgeKey(second, first)) == edges.end())
+		{
+			++open_out[first];
+			++open_in[second];
+		}
+	}
+
+	//The other copy of a vertex on a seam between two sides
+	std::vector<unsigned> wedges(num_vertices);
+	std::vector<unsigned> first_copies(num_positions, num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+	{
+		++copies[position_ids[i]];
+		if (first_copies[position_ids[i]] == num_vertices)
+			first_copies[position_ids[i]] = i;
+		wedges[i] = first_copies[position_ids[i]];
+	}
+	for (unsigned i = 0; i < num_vertices; ++i)
+		if (wedges[i] != i)
+			wedges[wedges[i]] = i;
+
+	//Seam corners, ends and vertices where more than two sides meet stay where they are
+	std::vector<unsigned char> kinds(num_vertices, VERTEX_MANIFOLD);
+	std::vector<Quadric> quadrics(num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+	{
+		if (copies[position_ids[i]] == 2 && open_out[i] == 1 && open_in[i] == 1 &&
+			open_out[wedges[i]] == 1 && open_in[wedges[i]] == 1)
+			kinds[i] = VERTEX_SEAM;
+		else if (copies[position_ids[i]] > 1)
+			kinds[i] = VERTEX_LOCKED;
+	}
+
+	for (unsigned i = 0; i < num_indices; i += 3)
+	{
+		const unsigned* triangle = &dst_indices[i];
+		float3 normal = (positions[triangle[1]] - positions[triangle[0]]).Cross(positions[triangle[2]] - positions[triangle[0]]);
+		float area = normal.Length();
+		if (area <= 0.0f)
+			continue;
+
+		normal /= area;
+		for (unsigned j = 0; j < 3; ++j)
+			quadrics[triangle[j]].AddPlane(normal, -normal.Dot(positions[triangle[0]]), area);
+
+		//Edges without a twin are open borders, a plane through them keeps them from moving inwards
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			unsigned first = triangle[j], second = triangle[(j + 1) % 3];
+			if (edges.find(EdgeKey(second, first)) != edges.end())
+				continue;
+
+			if (kinds[first] == VERTEX_MANIFOLD)
+				kinds[first] = VERTEX_BORDER;
+			if (kinds[second] == VERTEX_MANIFOLD)
+				kinds[second] = VERTEX_BORDER;
+
+			float3 edge = positions[second] - positions[first];
+			float length = edge.Length();
+			float3 border_normal = edge.Cross(normal).Normalized();
+			if (!border_normal.IsFinite())
+				continue;
+
+			float border_weight = length * length * BORDER_QUADRIC_WEIGHT;
+			quadrics[first].AddPlane(border_normal, -border_normal.Dot(positions[first]), border_weight);
+			quadrics[second].AddPlane(border_normal, -border_normal.Dot(positions[first]), border_weight);
+		}
+	}
+
+	float max_error_sq = target_error * target_error;
+	double applied_error_sq = 0.0;
+
+	std::vector<unsigned> adjacency_offsets(num_vertices + 1);
+	std::vector<unsigned> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned> remap(num_vertices);
+	std::vector<bool> touched(num_vertices);
+
+	while (dst_indices.size() > target_indices)
+	{
+		//Vertex to triangle adjacency of the current indices
+		unsigned num_triangles = dst_indices.size() / 3;
+		std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+		for (unsigned i = 0; i < dst_indices.size(); ++i)
+			++adjacency_offsets[dst_indices[i] + 1];
+		for (unsigned i = 1; i <= num_vertices; ++i)
+			adjacency_offsets[i] += adjacency_offsets[i - 1];
+
+		adjacency.resize(dst_indices.size());
+		std::vector<unsigned> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (unsigned i = 0; i < dst_indices.size(); ++i)
+			adjacency[fill[dst_indices[i]]++] = i / 3;
+
+		collapses.clear();
+		for (unsigned i = 0; i < dst_indices.size(); ++i)
+		{
+			unsigned from = dst_indices[i], to = dst_indices[i - i % 3 + (i + 1) % 3];
+			for (unsigned j = 0; j < 2; ++j, Swap(from, to))
+			{
+				bool allowed = kinds[from] == VERTEX_MANIFOLD;
+				if (!allowed && kinds[from] != VERTEX_LOCKED && kinds[to] != VERTEX_MANIFOLD)
+				{
+					//Collapses create new edges, open ones are looked up in the current faces
+					bool forward = HasEdge(&dst_indices[0], &adjacency_offsets[0], &adjacency[0], from, to);
+					bool backward = HasEdge(&dst_indices[0], &adjacency_offsets[0], &adjacency[0], to, from);
+
+					//Borders can only collapse along themselves, onto another border or a seam.
+					//Seams collapse along themselves onto the next seam vertex, the other side takes the same edge reversed.
+					if (kinds[from] == VERTEX_BORDER)
+						allowed = forward != backward;
+					else if (kinds[to] == VERTEX_SEAM && forward != backward)
+						allowed = forward ? HasEdge(&dst_indices[0], &adjacency_offsets[0], &adjacency[0], wedges[to], wedges[from]) :
+							HasEdge(&dst_indices[0], &adjacency_offsets[0], &adjacency[0], wedges[from], wedges[to]);
+				}
+
+				if (!allowed)
+					continue;
+
+				Quadric quadric = quadrics[from];
+				quadric.Add(quadrics[to]);
+
+				Collapse collapse;
+				collapse.from = from;
+				collapse.to = to;
+				collapse.error = (float)quadric.Evaluate(positions[to]);
+
+				if (kinds[from] == VERTEX_SEAM)
+				{
+					Quadric wedge_quadric = quadrics[wedges[from]];
+					wedge_quadric.Add(quadrics[wedges[to]]);
+					collapse.error = MAX(collapse.error, (float)wedge_quadric.Evaluate(positions[to]));
+				}
+
+				collapses.push_back(collapse);
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end());
+
+		//Each collapse removes about two triangles, stop once enough are gone this pass
+		unsigned triangles_to_remove = (dst_indices.size() - target_indices) / 3;
+		unsigned removed_triangles = 0;
+		unsigned num_collapses = 0;
+		for (unsigned i = 0; i < num_vertices; ++i)
+			remap[i] = i;
+		std::fill(touched.begin(), touched.end(), false);
+
+		for (std::vector<Collapse>::const_iterator it = collapses.begin(); it != collapses.end() && removed_triangles < triangles_to_remove; ++it)
+		{
+			if (it->error > max_error_sq)
+				break;
+
+			if (touched[it->from] || touched[it->to])
+				continue;
+
+			if (FlipsFaces(&positions[0], &dst_indices[0], &adjacency_offsets[0], &adjacency[0], it->from, it->to))
+				continue;
+
+			bool seam = kinds[it->from] == VERTEX_SEAM;
+			if (seam && (touched[wedges[it->from]] || touched[wedges[it->to]] ||
+				FlipsFaces(&positions[0], &dst_indices[0], &adjacency_offsets[0], &adjacency[0], wedges[it->from], wedges[it->to])))
+				continue;
+
+			remap[it->from] = it->to;
+			quadrics[it->to].Add(quadrics[it->from]);
+			if (seam)
+			{
+				remap[wedges[it->from]] = wedges[it->to];
+				quadrics[wedges[it->to]].Add(quadrics[wedges[it->from]]);
+			}
+			applied_error_sq = MAX(applied_error_sq, (double)it->error);
+			++num_collapses;
+			removed_triangles += 2;
+
+			//The whole ring moves, nothing around it can collapse again until adjacency is rebuilt
+			for (unsigned j = 0; j < (seam ? 2u : 1u); ++j)
+			{
+				unsigned from = j == 0 ? it->from : wedges[it->from];
+				for (unsigned k = adjacency_offsets[from]; k < adjacency_offsets[from + 1]; ++k)
+					for (unsigned l = 0; l < 3; ++l)
+						touched[dst_indices[adjacency[k] * 3 + l]] = true;
+			}
+		}
+
+		if (num_collapses == 0)
+			break;
+
+		unsigned write = 0;
+		for (unsigned i = 0; i < num_triangles; ++i)
+		{
+			unsigned a = remap[dst_indices[i * 3]], b = remap[dst_indices[i * 3 + 1]], c = remap[dst_indices[i * 3 + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			dst_indices[write++] = a;
+			dst_indices[write++] = b;
+			dst_indices[write++] = c;
+		}
+		dst_indices.resize(write);
+	}
+
+	return (float)sqrt(applied_error_sq);
+}
+
+void GenerateLodChain(const float3* vertices, unsigned num_vertices, const unsigned* indices, unsigned num_indices,
+	std::vector<std::vector<unsigned> >& levels, std::vector<float>& errors)
+{
+	std::vector<unsigned> src_indices(indices, indices + num_indices);
+	std::vector<unsigned> dst_indices;
+	float error = 0.0f;
+	while (levels.size() + 1 < MESH_LOD_MAX_LEVELS && src_indices.size() / 3 > MESH_LOD_MIN_TRIANGLES)
+	{
+		unsigned target_indices = (src_indices.size() / 6) * 3;
+		float level_error = SimplifyMesh(vertices, num_vertices, &src_indices[0], src_indices.size(), target_indices, MESH_LOD_MAX_ERROR - error, dst_indices);
+
+		//Not worth another buffer when most triangles are locked on borders and seams
+		if (dst_indices.empty() || dst_indices.size() * 10 > src_indices.size() * 9)
+			break;
+
+		//Collapses leave the surviving triangles in source order with holes in the fans
+		error += level_error;
+		OptimizeVertexCache(&dst_indices[0], dst_indices.size(), num_vertices);
+		levels.push_back(dst_indices);
+		errors.push_back(error);
+
+		src_indices.swap(dst_indices);
+	}
+}
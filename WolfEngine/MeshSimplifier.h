@@ -0,0 +1,42 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include "Math.h"
+#include <vector>
+
+#define MESH_LOD_MAX_LEVELS 4
+#define MESH_LOD_MIN_TRIANGLES 64
+#define MESH_LOD_MAX_ERROR 0.1f
+
+//Sum of squared distances to a set of planes, symmetric 4x4 matrix stored as its upper triangle
+struct Quadric
+{
+	void AddPlane(const float3& normal, float distance, float weight);
+	void Add(const Quadric& other);
+	//Mean squared distance of the point to the accumulated planes
+	double Evaluate(const float3& point) const;
+
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+	double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+	double a22 = 0.0, a23 = 0.0;
+	double a33 = 0.0;
+	double weight = 0.0;
+};
+
+//Gives every vertex the id of its position, ids are compact and in order of first appearance.
+//Returns the number of distinct positions.
+unsigned WeldPositions(const float3* vertices, unsigned num_vertices, unsigned* remap);
+
+//Quadric edge collapse onto existing vertices, only the index buffer changes so every level shares the
+//vertex buffer. Open borders only slide along themselves and both sides of an attribute seam collapse
+//together along it, which keeps the silhouette without cracks. Stops at target_indices or when the next collapse would exceed target_error.
+//Errors are relative to half the diagonal of the mesh bounding box, returns the largest one applied.
+float SimplifyMesh(const float3* vertices, unsigned num_vertices, const unsigned* indices, unsigned num_indices,
+	unsigned target_indices, float target_error, std::vector<unsigned>& dst_indices);
+
+//Coarser levels of the mesh, each one simplified from the previous with about half its triangles, until
+//MESH_LOD_MAX_LEVELS or MESH_LOD_MIN_TRIANGLES. levels[0] is LOD 1, the errors add up along the chain.
+void GenerateLodChain(const float3* vertices, unsigned num_vertices, const unsigned* indices, unsigned num_indices,
+	std::vector<std::vector<unsigned> >& levels, std::vector<float>& errors);
+
+#endif // !MESHSIMPLIFIER_H
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "Meshlet.h"
+#include "Globals.h"
+#include <algorithm>
+
+#define INVALID_TRIANGLE 0xFFFFFFFF
+
+static void ComputeMeshletBounds(Meshlet& meshlet, const float3* vertices, const unsigned* indices)
+{
+	AABB box;
+	box.SetNegativeInfinity();
+	for (unsigned i = 0; i < meshlet.num_indices; ++i)
+		box.Enclose(vertices[indices[meshlet.first_index + i]]);
+
+	meshlet.center = box.CenterPoint();
+	meshlet.radius = 0.0f;
+	for (unsigned i = 0; i < meshlet.num_indices; ++i)
+		meshlet.radius = MAX(meshlet.radius, meshlet.center.Distance(vertices[indices[meshlet.first_index + i]]));
+
+	float3 axis = float3::zero;
+	for (unsigned i = 0; i < meshlet.num_indices; i += 3)
+	{
+		const unsigned* triangle = &indices[meshlet.first_index + i];
+		float3 normal = (vertices[triangle[1]] - vertices[triangle[0]]).Cross(vertices[triangle[2]] - vertices[triangle[0]]).Normalized();
+		if (normal.IsFinite())
+			axis += normal;
+	}
+	axis.Normalize();
+	if (!axis.IsFinite())
+		return;
+
+	float min_dot = 1.0f;
+	for (unsigned i = 0; i < meshlet.num_indices; i += 3)
+	{
+		const unsigned* triangle = &indices[meshlet.first_index + i];
+		float3 normal = (vertices[triangle[1]] - vertices[triangle[0]]).Cross(vertices[triangle[2]] - vertices[triangle[0]]).Normalized();
+		if (normal.IsFinite())
+			min_dot = MIN(min_dot, axis.Dot(normal));
+	}
+
+	//Normals spread over a half space or more, some triangle always faces the camera
+	if (min_dot <= 0.0f)
+		return;
+
+	meshlet.cone_axis = axis;
+	meshlet.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+void BuildMeshlets(const float3* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	unsigned num_triangles = num_indices / 3;
+	if (num_triangles == 0)
+		return;
+
+	//Triangles around each vertex
+	std::vector<unsigned> adjacency_offsets(num_vertices + 1, 0);
+	std::vector<unsigned> adjacency(3 * num_triangles);
+	for (unsigned i = 0; i < 3 * num_triangles; ++i)
+		++adjacency_offsets[indices[i] + 1];
+	for (unsigned i = 0; i < num_vertices; ++i)
+		adjacency_offsets[i + 1] += adjacency_offsets[i];
+	std::vector<unsigned> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (unsigned i = 0; i < 3 * num_triangles; ++i)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	std::vector<unsigned char> emitted(num_triangles, 0);
+	//Last meshlet that used each vertex
+	std::vector<unsigned> vertex_meshlet(num_vertices, INVALID_TRIANGLE);
+	std::vector<unsigned> meshlet_vertices;
+	std::vector<unsigned> meshlet_triangles;
+	std::vector<unsigned> reordered;
+	reordered.reserve(3 * num_triangles);
+
+	unsigned seed = 0;
+	while (reordered.size() < 3 * num_triangles)
+	{
+		while (emitted[seed])
+			++seed;
+
+		Meshlet meshlet;
+		meshlet.first_index = reordered.size();
+		unsigned id = meshlets.size();
+		meshlet_vertices.clear();
+		meshlet_triangles.clear();
+
+		unsigned triangle = seed;
+		while (triangle != INVALID_TRIANGLE)
+		{
+			emitted[triangle] = 1;
+			meshlet_triangles.push_back(triangle);
+			for (unsigned i = 0; i < 3; ++i)
+			{
+				unsigned vertex = indices[3 * triangle + i];
+				if (vertex_meshlet[vertex] != id)
+				{
+					vertex_meshlet[vertex] = id;
+					meshlet_vertices.push_back(vertex);
+				}
+			}
+
+			if (meshlet_triangles.size() == MESHLET_MAX_TRIANGLES)
+				break;
+
+			//Grow through shared vertices, the neighbour adding the fewest new ones keeps the meshlet compact
+			triangle = INVALID_TRIANGLE;
+			unsigned best_new_vertices = 4;
+			for (unsigned i = 0; i < meshlet_vertices.size() && best_new_vertices > 0; ++i)
+			{
+				unsigned vertex = meshlet_vertices[i];
+				for (unsigned j = adjacency_offsets[vertex]; j < adjacency_offsets[vertex + 1]; ++j)
+				{
+					unsigned candidate = adjacency[j];
+					if (emitted[candidate])
+						continue;
+
+					unsigned new_vertices = 0;
+					for (unsigned k = 0; k < 3; ++k)
+						if (vertex_meshlet[indices[3 * candidate + k]] != id)
+							++new_vertices;
+
+					if (new_vertices < best_new_vertices && meshlet_vertices.size() + new_vertices <= MESHLET_MAX_VERTICES)
+					{
+						triangle = candidate;
+						best_new_vertices = new_vertices;
+						if (new_vertices == 0)
+							break;
+					}
+				}
+			}
+		}
+
+		//Triangles keep their relative order, so a cache optimized index buffer stays mostly optimized
+		std::sort(meshlet_triangles.begin(), meshlet_triangles.end());
+		for (std::vector<unsigned>::const_iterator it = meshlet_triangles.begin(); it != meshlet_triangles.end(); ++it)
+			reordered.insert(reordered.end(), indices + 3 * (*it), indices + 3 * (*it) + 3);
+
+		meshlet.num_indices = reordered.size() - meshlet.first_index;
+		meshlets.push_back(meshlet);
+	}
+
+	memcpy(indices, &reordered[0], 3 * num_triangles * sizeof(unsigned));
+
+	for (std::vector<Meshlet>::iterator it = meshlets.begin(); it != meshlets.end(); ++it)
+		ComputeMeshletBounds(*it, vertices, indices);
+}
+
+bool IsMeshletBackfacing(const float3& center, float radius, const float3& cone_axis, float cone_cutoff, const float3& camera_position)
+{
+	//Every point of the sphere is seen from behind every normal in the cone
+	float3 view = center - camera_position;
+	return view.Dot(cone_axis) >= cone_cutoff * view.Length() + radius;
+}
@@ -0,0 +1,29 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "Math.h"
+#include <vector>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+//Range of the index buffer with the bounds needed to cull it as a whole
+struct Meshlet
+{
+	unsigned first_index = 0;
+	unsigned num_indices = 0;
+	float3 center = float3::zero;
+	float radius = 0.0f;
+	//Every triangle normal is within the cone, cutoff is the sine of its half angle, above 1 if it can't be culled
+	float3 cone_axis = float3::unitY;
+	float cone_cutoff = 2.0f;
+};
+
+//Groups connected triangles into meshlets and reorders the indices so each one is a contiguous range.
+//Meshlets start in index order and keep the order of their triangles.
+void BuildMeshlets(const float3* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices, std::vector<Meshlet>& meshlets);
+
+//Bounds and cone must be in the same space as the camera position
+bool IsMeshletBackfacing(const float3& center, float radius, const float3& cone_axis, float cone_cutoff, const float3& camera_position);
+
+#endif // !MESHLET_H
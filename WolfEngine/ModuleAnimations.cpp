@@ -3,6 +3,14 @@
 #include "ModuleLevel.h"
 #include "GameObject.h"
 #include "ComponentAnim.h"
+#include "JsonHandler.h"
+#include "ModuleProgramShaders.h"
+#include "ModuleResources.h"
+#include "ResourceAnimation.h"
+#include "OpenGL.h"
+#include "FileSystem.h"
+#include "AnimationFile.h"
+#include "MeshFile.h"
 #include <assimp/scene.h>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
@@ -17,6 +25,45 @@ ModuleAnimations::~ModuleAnimations()
 {
 }
 
+bool ModuleAnimations::Init()
+{
+	if (App->parser->LoadObject(ANIMATION_SECTION))
+	{
+		LOD_ENABLED = App->parser->GetBool("LodEnabled");
+		LOD_HALF_RATE_DISTANCE = App->parser->GetFloat("LodHalfRateDistance");
+		LOD_QUARTER_RATE_DISTANCE = App->parser->GetFloat("LodQuarterRateDistance");
+		LOD_FAR_JOINT_DEPTH = App->parser->GetInt("LodFarJointDepth");
+		LOD_INTERPOLATE = App->parser->GetBool("LodInterpolate");
+		PAUSE_CULLED = App->parser->GetBool("PauseCulled");
+		GPU_SKINNING = App->parser->GetBool("GpuSkinning");
+		App->parser->UnloadObject();
+	}
+
+	instances.reserve(ANIM_INSTANCES_RESERVE);
+	holes.reserve(ANIM_INSTANCES_RESERVE);
+
+	return true;
+}
+
+bool ModuleAnimations::Start()
+{
+	//The palette plus the built-in matrices have to fit in the vertex uniforms, otherwise meshes keep skinning on the CPU
+	GLint max_uniform_components = 0;
+	glGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS, &max_uniform_components);
+
+	if (max_uniform_components >= MAX_SKINNING_JOINTS * 16 + 128)
+	{
+		App->program_shaders->Load(SKINNING_PROGRAM, SKINNING_VERTEX_SHADER, FIXED_FRAGMENT_SHADER, nullptr, FIXED_LIGHTING_SHADER);
+		App->program_shaders->Load(SKINNING_CAPTURE_PROGRAM, SKINNING_VERTEX_SHADER, FIXED_FRAGMENT_SHADER, "skinned_position", FIXED_LIGHTING_SHADER);
+		gpu_skinning_supported = App->program_shaders->HasProgram(SKINNING_PROGRAM);
+	}
+
+	if (!gpu_skinning_supported)
+		APPLOG("GPU skinning not available, falling back to CPU skinning");
+
+	return true;
+}
+
 update_status ModuleAnimations::Update(float dt)
 {
 	BROFILER_CATEGORY("ModuleAnimation-Update", Profiler::Color::Red);
@@ -30,21 +77,11 @@ update_status ModuleAnimations::Update(float dt)
 
 bool ModuleAnimations::CleanUp()
 {
-	for (AnimMap::iterator it = animations.begin(); it != animations.end(); ++it)
-	{
-		for (NodeAnimMap::iterator it2 = it->second->channels.begin(); it2 != it->second->channels.end(); ++it2)
-		{
-			RELEASE_ARRAY(it2->second->positions);
-			RELEASE_ARRAY(it2->second->rotations);
-			RELEASE(it2->second);
-		}
-		it->second->channels.clear();
-		RELEASE(it->second);
-	}
+	//Clip data belongs to ModuleResources, playing instances only drop their references
 	for (InstanceList::iterator it = instances.begin(); it != instances.end(); ++it)
-	{
-		RELEASE(*it);
-	}
+		if (it->used)
+			App->resources->Release(it->resource);
+
 	animations.clear();
 	instances.clear();
 	holes.clear();
@@ -56,46 +93,83 @@ void ModuleAnimations::Load(const char* name, const char* file)
 	aiString animation_name = aiString();
 	animation_name.Append(name);
 
+	//The name only remembers the file, the clip stays loaded while someone holds a reference to it
+	AnimClip& clip = animations[animation_name];
+	clip.file = file;
+	clip.resource = LoadClip(file);
+	App->resources->Release(clip.resource);
+}
+
+unsigned int ModuleAnimations::AcquireClip(const char* name)
+{
+	aiString animation_name = aiString();
+	animation_name.Append(name);
+	AnimMap::iterator it = animations.find(animation_name);
+	if (it == animations.end())
+		return INVALID_RESOURCE_HANDLE;
+
+	if (App->resources->GetAnimation(it->second.resource) != nullptr)
+		App->resources->AddReference(it->second.resource);
+	else
+		it->second.resource = LoadClip(it->second.file.c_str());
+
+	return it->second.resource;
+}
+
+unsigned int ModuleAnimations::LoadClip(const char* file) const
+{
+	unsigned int handle = App->resources->Find(Resource::Type::ANIMATION, file, ANIMATION_SETTINGS);
+	if (handle != INVALID_RESOURCE_HANDLE)
+		return handle;
+
+	Anim* anim = LoadCooked(file);
+	if (anim == nullptr)
+		anim = Import(file);
+	if (anim == nullptr)
+		return INVALID_RESOURCE_HANDLE;
+
+	return App->resources->Add(new ResourceAnimation(file, ANIMATION_SETTINGS, anim));
+}
+
+Anim* ModuleAnimations::Import(const char* file) const
+{
+	Anim* anim = nullptr;
 	aiString file_path = aiString();
 	file_path.Append(file);
 
-	const aiScene* scene = aiImportFile(file_path.data, aiProcess_Triangulate | aiProcessPreset_TargetRealtime_MaxQuality);
+	const aiScene* scene = aiImportFileEx(file_path.data, MESH_IMPORT_FLAGS, App->files->GetAssimpIO());
 
 	if (scene != nullptr)
 	{
+		//A name maps to a single clip, the last one in the file
 		if (scene->HasAnimations())
 		{
-			for (unsigned int i = 0; i < scene->mNumAnimations; ++i)
+			aiAnimation* scene_animation = scene->mAnimations[scene->mNumAnimations - 1];
+			anim = new Anim();
+			double ticks_per_miliseconds = scene_animation->mTicksPerSecond / 1000;
+			anim->duration = (unsigned int)scene_animation->mDuration / ticks_per_miliseconds;
+			anim->num_channels = scene_animation->mNumChannels;
+			for (unsigned int j = 0; j < anim->num_channels; ++j)
 			{
-				aiAnimation* scene_animation = scene->mAnimations[i];
-				Anim* anim = new Anim();
-				double ticks_per_miliseconds = scene_animation->mTicksPerSecond / 1000;
-				anim->duration = (unsigned int)scene_animation->mDuration / ticks_per_miliseconds;
-				anim->num_channels = scene_animation->mNumChannels;
-				for (unsigned int j = 0; j < anim->num_channels; ++j)
+				aiNodeAnim* scene_nodeanim = scene_animation->mChannels[j];
+				NodeAnim* node_anim = new NodeAnim();
+				node_anim->name = scene_nodeanim->mNodeName.data;
+				node_anim->num_positions = scene_nodeanim->mNumPositionKeys;
+				node_anim->positions = new float3[node_anim->num_positions];
+				for (unsigned int k = 0; k < node_anim->num_positions; ++k)
 				{
-
-					aiNodeAnim* scene_nodeanim = scene_animation->mChannels[j];
-					NodeAnim* node_anim = new NodeAnim();
-					node_anim->name = scene_nodeanim->mNodeName.data;
-					node_anim->num_positions = scene_nodeanim->mNumPositionKeys;
-					node_anim->positions = new float3[node_anim->num_positions];
-					for (unsigned int k = 0; k < node_anim->num_positions; ++k)
-					{
-						aiVector3D position_aux = scene->mAnimations[i]->mChannels[j]->mPositionKeys[k].mValue;
-						node_anim->positions[k] = { position_aux.x, position_aux.y, position_aux.z };
-					}
-					node_anim->num_rotations = scene_nodeanim->mNumRotationKeys;
-					node_anim->rotations = new Quat[node_anim->num_rotations];
-					for (unsigned int k = 0; k < node_anim->num_rotations; ++k) 
-					{
-						aiQuaternion rotation_aux = scene->mAnimations[i]->mChannels[j]->mRotationKeys[k].mValue;
-						node_anim->rotations[k] = { rotation_aux.x, rotation_aux.y, rotation_aux.z, rotation_aux.w };
-					}
-						
-					anim->channels[node_anim->name] = node_anim;
+					aiVector3D position_aux = scene_nodeanim->mPositionKeys[k].mValue;
+					node_anim->positions[k] = { position_aux.x, position_aux.y, position_aux.z };
 				}
-				animations[animation_name] = anim;
+				node_anim->num_rotations = scene_nodeanim->mNumRotationKeys;
+				node_anim->rotations = new Quat[node_anim->num_rotations];
+				for (unsigned int k = 0; k < node_anim->num_rotations; ++k) 
+				{
+					aiQuaternion rotation_aux = scene_nodeanim->mRotationKeys[k].mValue;
+					node_anim->rotations[k] = { rotation_aux.x, rotation_aux.y, rotation_aux.z, rotation_aux.w };
+				}
+
+				anim->channels[node_anim->name] = node_anim;
 			}
 		}
 	}
@@ -105,99 +179,150 @@ void ModuleAnimations::Load(const char* name, const char* file)
 	}
 	
 	aiReleaseImport(scene);
+	return anim;
+}
+
+Anim* ModuleAnimations::LoadCooked(const char* file) const
+{
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	if (!App->files->GetFileStamp(file, source_size, source_time))
+		return nullptr;
+
+	std::string cooked_path = std::string(file) + ANIMATION_FILE_EXTENSION;
+	VirtualFile cooked;
+	if (!App->files->ReadFile(cooked_path.c_str(), cooked))
+		return nullptr;
+
+	const AnimationFileHeader* header = ValidateAnimationFile(cooked.GetData(), cooked.GetSize(), source_size, source_time);
+	if (header == nullptr || header->num_clips == 0)
+		return nullptr;
+
+	const char* data = cooked.GetData();
+	const AnimationFileClip& clip = ((const AnimationFileClip*)(data + header->clips_offset))[header->num_clips - 1];
+	Anim* anim = new Anim();
+	anim->duration = clip.duration;
+	anim->num_channels = clip.num_channels;
+
+	const AnimationFileChannel* channels = (const AnimationFileChannel*)(data + clip.channels_offset);
+	for (unsigned int j = 0; j < anim->num_channels; ++j)
+	{
+		NodeAnim* node_anim = new NodeAnim();
+		node_anim->name.Set(data + channels[j].name);
+		node_anim->num_positions = channels[j].num_positions;
+		node_anim->positions = new float3[node_anim->num_positions];
+		memcpy(node_anim->positions, data + channels[j].positions_offset, node_anim->num_positions * sizeof(float3));
+		node_anim->num_rotations = channels[j].num_rotations;
+		node_anim->rotations = new Quat[node_anim->num_rotations];
+		memcpy(node_anim->rotations, data + channels[j].rotations_offset, node_anim->num_rotations * sizeof(Quat));
+
+		anim->channels[node_anim->name] = node_anim;
+	}
+
+	APPLOG("Loaded animation from %s", cooked_path.c_str());
+	return anim;
 }
 
 unsigned int ModuleAnimations::Play(const char * name, bool loop)
 {
-	unsigned int id = 0;
-	aiString animation_name = aiString();
-	animation_name.Append(name);
-	AnimMap::iterator it = animations.find(animation_name);
-	if (it != animations.end())
+	unsigned int handle = INVALID_ANIM_HANDLE;
+	unsigned int resource = AcquireClip(name);
+	if (resource != INVALID_RESOURCE_HANDLE)
 	{
-		AnimInstance* anim_instance = new AnimInstance();
-		anim_instance->anim = it->second;
-		anim_instance->time = 0;
-		anim_instance->loop = loop;
-		if (!holes.empty()) 
+		unsigned int slot = AllocateSlot();
+		if (slot == INVALID_ANIM_SLOT)
 		{
-			id = holes.back();
-			holes.pop_back();
-			instances[id] = anim_instance;
-		}
-		else 
-		{
-			id = anim_next_id++;
-			instances.push_back(anim_instance);
+			App->resources->Release(resource);
+			return handle;
 		}
+
+		AnimInstance& anim_instance = instances[slot];
+		anim_instance.anim = App->resources->GetAnimation(resource)->anim;
+		anim_instance.resource = resource;
+		anim_instance.time = 0;
+		anim_instance.loop = loop;
+		handle = (anim_instance.generation << ANIM_HANDLE_INDEX_BITS) | slot;
 	}
-	return id;
+	return handle;
 }
 
-void ModuleAnimations::Stop(unsigned int id)
+void ModuleAnimations::Stop(unsigned int handle)
 {
-	if (instances[id] != nullptr)
-	{
-		RELEASE(instances[id]);
-		holes.push_back(id);
-	}
+	unsigned int slot = FindSlot(handle);
+	if (slot != INVALID_ANIM_SLOT)
+		ReleaseSlot(slot);
 }
 
-void ModuleAnimations::BlendTo(unsigned int id, const char * name, unsigned int blend_time)
+void ModuleAnimations::BlendTo(unsigned int handle, const char * name, unsigned int blend_time)
 {
-	AnimInstance* instance = instances[id];
-	if (instance != nullptr)
+	unsigned int slot = FindSlot(handle);
+	if (slot != INVALID_ANIM_SLOT)
 	{
-		aiString animation_name = aiString();
-		animation_name.Append(name);
-		AnimMap::iterator it = animations.find(animation_name);
-		if (it != animations.end())
+		unsigned int resource = AcquireClip(name);
+		if (resource != INVALID_RESOURCE_HANDLE)
 		{
-			AnimInstance* new_instance = new AnimInstance();
-			new_instance->anim = it->second;
-			new_instance->time = 0;
-			new_instance->loop = instance->loop;
-			new_instance->next = instance;
-			new_instance->blend_duration = blend_time;
-			new_instance->blend_time = 0;
-			instances[id] = new_instance;
+			//The outgoing animation moves to a new slot so the handle keeps pointing to the head of the blend
+			unsigned int blend_slot = AllocateSlot();
+			if (blend_slot == INVALID_ANIM_SLOT)
+			{
+				App->resources->Release(resource);
+				return;
+			}
+
+			AnimInstance& instance = instances[slot];
+			AnimInstance& blend_instance = instances[blend_slot];
+			unsigned int blend_generation = blend_instance.generation;
+			blend_instance = instance;
+			blend_instance.generation = blend_generation;
+
+			instance.anim = App->resources->GetAnimation(resource)->anim;
+			instance.resource = resource;
+			instance.time = 0;
+			instance.next = blend_slot;
+			instance.blend_duration = blend_time;
+			instance.blend_time = 0;
 		}
 	}
 }
 
-bool ModuleAnimations::GetTransform(unsigned int id, const char * channel, float3 & position, Quat & rotation) const
+bool ModuleAnimations::IsAlive(unsigned int handle) const
 {
-	bool res = true;
-	AnimInstance* instance = instances[id];
-	if (res = instance != nullptr)
+	return FindSlot(handle) != INVALID_ANIM_SLOT;
+}
+
+bool ModuleAnimations::GetTransform(unsigned int handle, const char * channel, float3 & position, Quat & rotation) const
+{
+	bool res = false;
+	unsigned int slot = FindSlot(handle);
+	if (slot != INVALID_ANIM_SLOT)
 	{
-		res = GetTransform(instance, channel, position, rotation);
+		res = GetTransform(instances[slot], channel, position, rotation);
 	}
 	
 	return res;
 }
 
-bool ModuleAnimations::GetTransform(AnimInstance * instance, const char * channel, float3 & position, Quat & rotation) const
+bool ModuleAnimations::GetTransform(const AnimInstance& instance, const char * channel, float3 & position, Quat & rotation) const
 {
 	bool res = true;
-	Anim* animation = instance->anim;
+	Anim* animation = instance.anim;
 	aiString channel_name = aiString();
 	channel_name.Append(channel);
 	NodeAnimMap::iterator it = animation->channels.find(channel_name);
 	NodeAnim* node = (it != animation->channels.end()) ? it->second : nullptr;
 	if (res = node != nullptr)
 	{
-		if (instance->next == nullptr)
+		if (instance.next == INVALID_ANIM_SLOT)
 		{
-			if (!instance->loop && (instance->time >= animation->duration))
+			if (!instance.loop && (instance.time >= animation->duration))
 			{
 				position = node->positions[node->num_positions - 1];
 				rotation = node->rotations[node->num_rotations - 1];
 			}
 			else
 			{
-				float pos_key = float(instance->time * (node->num_positions - 1)) / float(animation->duration);
-				float rot_key = float(instance->time * (node->num_rotations - 1)) / float(animation->duration);
+				float pos_key = float(instance.time * (node->num_positions - 1)) / float(animation->duration);
+				float rot_key = float(instance.time * (node->num_rotations - 1)) / float(animation->duration);
 
 				unsigned int pos_index = unsigned(pos_key);
 				unsigned int rot_index = unsigned(rot_key);
@@ -216,8 +341,8 @@ bool ModuleAnimations::GetTransform(AnimInstance * instance, const char * channe
 		}
 		else
 		{
-			float lambda = float(instance->blend_time) / float(instance->blend_duration);
-			res = GetTransform(instance->next, channel, position, rotation);
+			float lambda = float(instance.blend_time) / float(instance.blend_duration);
+			res = GetTransform(instances[instance.next], channel, position, rotation);
 			position = InterpFloat3(position, node->positions[0], lambda);
 			rotation = InterpQuaternion(rotation, node->rotations[0], lambda);
 		}
@@ -264,34 +389,91 @@ void ModuleAnimations::UpdateInstances(float dt)
 	unsigned int dt_ms = 1000 * dt;
 	for (InstanceList::iterator it = instances.begin(); it != instances.end(); ++it)
 	{
-		if (*it != nullptr)
+		if (it->used)
 		{
-			AnimInstance* instance = (*it);
-			if (instance->next != nullptr)
+			if (it->next != INVALID_ANIM_SLOT)
 			{
-				while (instance->next != nullptr)
+				it->blend_time += dt_ms;
+				if (it->blend_time > it->blend_duration)
 				{
-					instance->blend_time += dt_ms;
-					if (instance->blend_time > instance->blend_duration)
-					{
-						unsigned int dt = instance->blend_time - instance->blend_duration;
-						instance->time = dt;
-						RELEASE(instance->next);
-					}
-					else
-					{
-						instance = instance->next;
-					}
+					it->time = it->blend_time - it->blend_duration;
+					unsigned int next = it->next;
+					it->next = INVALID_ANIM_SLOT;
+					ReleaseSlot(next);
 				}
 			}
 			else
 			{
-				instance->time += dt_ms;
+				it->time += dt_ms;
 			}
 		}
 	}
 }
 
+unsigned int ModuleAnimations::AllocateSlot()
+{
+	unsigned int slot = 0;
+	if (!holes.empty())
+	{
+		slot = holes.back();
+		holes.pop_back();
+	}
+	else
+	{
+		//Handles only have room for ANIM_HANDLE_INDEX_BITS of slot index
+		if (instances.size() > ANIM_HANDLE_INDEX_MASK)
+		{
+			APPLOG("Animation instance limit of %u reached", ANIM_HANDLE_INDEX_MASK + 1);
+			return INVALID_ANIM_SLOT;
+		}
+
+		slot = instances.size();
+		instances.push_back(AnimInstance());
+	}
+
+	AnimInstance& instance = instances[slot];
+	unsigned int generation = instance.generation;
+	instance = AnimInstance();
+	instance.generation = generation;
+	instance.used = true;
+
+	return slot;
+}
+
+void ModuleAnimations::ReleaseSlot(unsigned int slot)
+{
+	//Releasing a blending instance also releases the instances it was blending from
+	while (slot != INVALID_ANIM_SLOT)
+	{
+		AnimInstance& instance = instances[slot];
+		unsigned int next = instance.next;
+		App->resources->Release(instance.resource);
+		instance.resource = INVALID_RESOURCE_HANDLE;
+		instance.used = false;
+		instance.next = INVALID_ANIM_SLOT;
+		instance.generation = (instance.generation + 1) & ANIM_HANDLE_INDEX_MASK;
+		if (instance.generation == 0)
+			instance.generation = 1;
+		holes.push_back(slot);
+		slot = next;
+	}
+}
+
+unsigned int ModuleAnimations::FindSlot(unsigned int handle) const
+{
+	unsigned int slot = handle & ANIM_HANDLE_INDEX_MASK;
+	unsigned int generation = handle >> ANIM_HANDLE_INDEX_BITS;
+
+	if (handle == INVALID_ANIM_HANDLE || slot >= instances.size())
+		return INVALID_ANIM_SLOT;
+
+	const AnimInstance& instance = instances[slot];
+	if (!instance.used || instance.generation != generation)
+		return INVALID_ANIM_SLOT;
+
+	return slot;
+}
+
 void ModuleAnimations::RecursiveUpdateAnimation(GameObject* game_object)
 {
 	for (std::vector<GameObject*>::iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
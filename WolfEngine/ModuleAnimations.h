@@ -4,10 +4,27 @@
 #include "Module.h"
 #include <map>
 #include <vector>
+#include <string>
 #include <assimp/types.h>
 #include "Math.h"
 
 #define MODULE_ANIMATION "ModuleAnimation"
+#define ANIMATION_SECTION "Config.Modules.Animations"
+
+// Instance handles pack the slot index in the low bits and the slot generation in the high bits
+#define ANIM_HANDLE_INDEX_BITS 16
+#define ANIM_HANDLE_INDEX_MASK 0xFFFF
+#define INVALID_ANIM_HANDLE 0
+#define INVALID_ANIM_SLOT 0xFFFFFFFF
+#define ANIM_INSTANCES_RESERVE 256
+//Clip data depends on how the keys are read, part of the resource key
+#define ANIMATION_SETTINGS "last_clip,ms"
+
+// GPU skinning programs, the joint count must match MAX_SKINNING_JOINTS in the vertex shader
+#define SKINNING_PROGRAM "Skinning"
+#define SKINNING_CAPTURE_PROGRAM "SkinningCapture"
+#define SKINNING_VERTEX_SHADER "Resources/Shaders/skinning_vertex_shader.txt"
+#define MAX_SKINNING_JOINTS 64
 
 class GameObject;
 
@@ -37,56 +54,89 @@ struct Anim
 	NodeAnimMap channels;
 };
 
-struct AnimInstance
+//Loaded clip resource, stale once the clip is unloaded until someone plays it again
+struct AnimClip
 {
-	AnimInstance()
-	{
-		RELEASE(this->next);
-	}
+	std::string file;
+	unsigned int resource = 0;
+};
 
-	Anim* anim;
+struct AnimInstance
+{
+	Anim* anim = nullptr;
+	//Reference held while the instance plays
+	unsigned int resource = 0;
 	unsigned int time = 0;
 	bool loop = true;
 
-	AnimInstance* next = nullptr;
+	unsigned int next = INVALID_ANIM_SLOT;
 	unsigned int blend_duration = 0;
 	unsigned int blend_time = 0;
+
+	unsigned int generation = 1;
+	bool used = false;
 };
 
 class ModuleAnimations : public Module
 {
 
-	typedef std::map<aiString, Anim*, LessString> AnimMap;
-	typedef std::vector<AnimInstance*> InstanceList;
+	typedef std::map<aiString, AnimClip, LessString> AnimMap;
+	typedef std::vector<AnimInstance> InstanceList;
 	typedef std::vector<unsigned int> HoleList;
 
 public:
 	ModuleAnimations();
 	~ModuleAnimations();
 
+	bool Init();
+	bool Start();
 	update_status Update(float dt);
 	bool CleanUp();
 	
 	void Load(const char* name, const char* file);
+	//Keeps the clip loaded while the handle is held, release it with ModuleResources::Release
+	unsigned int AcquireClip(const char* name);
 	unsigned int Play(const char* name, bool loop = false);
-	void Stop(unsigned int id);
-	void BlendTo(unsigned int id, const char* name, unsigned int blend_time);
+	void Stop(unsigned int handle);
+	void BlendTo(unsigned int handle, const char* name, unsigned int blend_time);
+	bool IsAlive(unsigned int handle) const;
+
+	bool GetTransform(unsigned int handle, const char* channel, float3& position, Quat& rotation) const;
 
-	bool GetTransform(unsigned int id, const char* channel, float3& position, Quat& rotation) const;
+	bool IsGPUSkinningAvailable() const { return GPU_SKINNING && gpu_skinning_supported; }
 
 private:
-	bool GetTransform(AnimInstance* instance, const char* channel, float3& position, Quat& rotation) const;
+	//Handle to the clip resource of the file with one more reference, loaded only if no one has it loaded
+	unsigned int LoadClip(const char* file) const;
+	Anim* Import(const char* file) const;
+	//Reads the clip written by the cooker, null if there is no cooked file for this version of the source
+	Anim* LoadCooked(const char* file) const;
+	bool GetTransform(const AnimInstance& instance, const char* channel, float3& position, Quat& rotation) const;
+
+	//INVALID_ANIM_SLOT once every index a handle can hold is in use
+	unsigned int AllocateSlot();
+	void ReleaseSlot(unsigned int slot);
+	unsigned int FindSlot(unsigned int handle) const;
 	float3& InterpFloat3(const float3& first, const float3& second, float lambda) const;
 	Quat& InterpQuaternion(const Quat& first, const Quat& second, float lambda) const;
 
 	void UpdateInstances(float dt);
 	void RecursiveUpdateAnimation(GameObject* game_object);
 
+public:
+	bool LOD_ENABLED = true;
+	float LOD_HALF_RATE_DISTANCE = 20.0f;
+	float LOD_QUARTER_RATE_DISTANCE = 50.0f;
+	unsigned int LOD_FAR_JOINT_DEPTH = 4;
+	bool LOD_INTERPOLATE = true;
+	bool PAUSE_CULLED = true;
+	bool GPU_SKINNING = true;
+
 private:
 	AnimMap animations;
 	InstanceList instances;
 	HoleList holes;
-	unsigned int anim_next_id = 0;
+	bool gpu_skinning_supported = false;
 };
 
 #endif // !MODULEANIMATION_H
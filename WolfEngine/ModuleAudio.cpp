@@ -2,6 +2,17 @@
 #include "Application.h"
 #include "ModuleAudio.h"
 #include "Bass.h"
+#include "FileSystem.h"
+
+//BASS copies the sample data, the file is only needed while it loads
+static HSAMPLE LoadSample(const char* path, DWORD max, DWORD flags)
+{
+	VirtualFile file;
+	if (!App->files->ReadFile(path, file))
+		return 0;
+
+	return BASS_SampleLoad(true, file.GetData(), 0, (DWORD)file.GetSize(), max, flags);
+}
 
 static const char* BASS_GetErrorString()
 {
@@ -63,7 +74,7 @@ bool ModuleAudio::Init()
 	APPLOG("Loading Audio Mixer");
 	
 	BASS_Init(-1, 44100, 0, 0, NULL);
-	HSAMPLE sample = BASS_SampleLoad(false, "Resources/Audio/batman.ogg", 0, 0, 1, BASS_SAMPLE_MONO);
+	HSAMPLE sample = LoadSample("Resources/Audio/batman.ogg", 1, BASS_SAMPLE_MONO);
 	//BASS_SetVolume(0);
 	HCHANNEL channel = BASS_SampleGetChannel(sample, FALSE);
 
@@ -95,7 +106,7 @@ unsigned int ModuleAudio::LoadFx(const char* path)
 	unsigned long ret = 0;
 
 	// WAV for samples
-	HSAMPLE sample = BASS_SampleLoad(false, path, 0, 0, 5, BASS_SAMPLE_OVER_VOL);
+	HSAMPLE sample = LoadSample(path, 5, BASS_SAMPLE_OVER_VOL);
 
 	if (sample == 0) 
 	{
@@ -118,8 +129,9 @@ void ModuleAudio::UnloadFx(unsigned long channel)
 	{
 		BASS_CHANNELINFO info;
 		BASS_ChannelGetInfo(channel, &info);
-		if (info.filename != nullptr)
-			BASS_SampleFree(channel);
+		//Samples are loaded from memory, they have no file name to tell them from streams
+		if (info.sample != 0)
+			BASS_SampleFree(info.sample);
 		else
 			BASS_StreamFree(channel);
 	}
@@ -6,6 +6,9 @@
 #include "ModuleTimeController.h"
 #include "Application.h"
 #include "ComponentCamera.h"
+#include "GameObject.h"
+#include "SpatialQuery.h"
+#include "Interface.h"
 #include "SDL/include/SDL.h"
 #include "JsonHandler.h"
 
@@ -96,6 +99,10 @@ update_status ModuleCamera::Update(float dt)
 		}
 
 		editor_camera->frustum->SetFrame(editor_camera->frustum->Pos() + translation, front, up);
+
+		//Clicks on the editor windows belong to them
+		if (App->input->GetMouseButtonDown(SDL_BUTTON_LEFT) == KEY_DOWN && !ImGui::GetIO().WantCaptureMouse)
+			PickGameObject(App->input->GetMousePosition());
 	}
 	
 	return UPDATE_CONTINUE;
@@ -174,6 +181,40 @@ bool ModuleCamera::InsideCulling(const AABB& box) const
 		return true;
 }
 
+const Frustum* ModuleCamera::GetCullingFrustum() const
+{
+	return rendering_camera->frustum_culling ? rendering_camera->frustum : nullptr;
+}
+
+float ModuleCamera::GetProjectedRadius(const Sphere& sphere) const
+{
+	float distance = sphere.pos.Distance(rendering_camera->frustum->Pos());
+	if (distance <= sphere.r)
+		return FLOAT_INF;
+
+	float half_fov = 0.5f * rendering_camera->frustum->VerticalFov();
+	return sphere.r * App->window->GetScreenHeight() / (2.0f * distance * tanf(half_fov));
+}
+
+void ModuleCamera::PickGameObject(const iPoint& mouse_position) const
+{
+	float x = 2.0f * mouse_position.x / App->window->GetScreenWidth() - 1.0f;
+	float y = 1.0f - 2.0f * mouse_position.y / App->window->GetScreenHeight();
+	Ray ray = editor_camera->frustum->UnProjectLineSegment(x, y).ToRay();
+
+	std::vector<SpatialHit> hits;
+	App->level->Raycast(ray, editor_camera->frustum->FarPlaneDistance(), 1, hits);
+
+	GameObject* previous = App->level->GetSelectedGameObject();
+	if (previous != nullptr)
+		previous->selected = false;
+
+	GameObject* picked = hits.empty() ? nullptr : hits[0].object;
+	if (picked != nullptr)
+		picked->selected = true;
+	App->level->SetSelectedGameObject(picked);
+}
+
 void ModuleCamera::SetupFrustum(ComponentCamera* camera)
 {
 	camera->SetPlaneDistances(NEARPLANE, FARPLANE);
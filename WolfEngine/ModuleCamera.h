@@ -3,6 +3,7 @@
 
 #include "Module.h"
 #include "Math.h"
+#include "Point.h"
 
 #define MODULE_CAMERA "ModuleCamera"
 #define CAMERA_SECTION "Config.Modules.EditorCamera"
@@ -35,8 +36,13 @@ public:
 	float3 GetPosition() const;
 
 	bool InsideCulling(const AABB& box) const;
+	const Frustum* GetCullingFrustum() const;
+	//Radius in pixels of the sphere on screen, infinite when the camera is inside it
+	float GetProjectedRadius(const Sphere& sphere) const;
 
 	void SetupFrustum(ComponentCamera* camera);
+	//Selects the object whose box the ray under the mouse hits first, or clears the selection
+	void PickGameObject(const iPoint& mouse_position) const;
 
 public:
 	ComponentCamera* editor_camera = nullptr;
@@ -1,5 +1,7 @@
 #include "Application.h"
 #include "ModuleTextures.h"
+#include "ModuleResources.h"
+#include "ModuleProgramShaders.h"
 #include "ModuleLevel.h"
 #include "GameObject.h"
 #include "OpenGL.h"
@@ -8,7 +10,24 @@
 #include <assimp/scene.h>
 #include "Math.h"
 #include "Primitive.h"
-#include "MyQuadTree.h"
+#include "LooseOctree.h"
+#include "AABBTree.h"
+#include "ModuleCamera.h"
+#include "ComponentCamera.h"
+#include "ComponentMesh.h"
+#include "ComponentMaterial.h"
+#include "ComponentTransform.h"
+#include "OcclusionBuffer.h"
+#include "StaticBatcher.h"
+#include "HLODBuilder.h"
+#include "MeshFile.h"
+#include "FileSystem.h"
+#include "ObjLoader.h"
+#include "JobSystem.h"
+#include "JsonHandler.h"
+#include "TimerUs.h"
+#include <algorithm>
+#include <map>
 
 #pragma comment(lib, "assimp/libx86/assimp-vc140-mt.lib")
 
@@ -24,13 +43,57 @@ bool ModuleLevel::Init()
 {
 	APPLOG("Init level.");
 
-	quadtree = new MyQuadTree(AABB(float3(-100, -20, -100), float3(100, 20, 100)));
+	if (App->parser->LoadObject(LEVEL_SECTION))
+	{
+		OCCLUSION_CULLING = App->parser->GetBool("OcclusionCulling");
+		OCCLUSION_WIDTH = App->parser->GetInt("OcclusionWidth");
+		OCCLUSION_HEIGHT = App->parser->GetInt("OcclusionHeight");
+		MAX_OCCLUDERS = App->parser->GetInt("MaxOccluders");
+		MAX_OCCLUDER_TRIANGLES = App->parser->GetInt("MaxOccluderTriangles");
+		OCCLUDER_MIN_SIZE = App->parser->GetFloat("OccluderMinSize");
+		PROXIMITY_CELL_SIZE = App->parser->GetFloat("ProximityCellSize");
+		STATIC_BATCH_CELL_SIZE = App->parser->GetFloat("StaticBatchCellSize");
+		STATIC_BATCH_ON_PLAY = App->parser->GetBool("StaticBatchOnPlay");
+		NATIVE_MESHES = App->parser->GetBool("NativeMeshes");
+		OBJ_LOADER = App->parser->GetBool("ObjLoader");
+		QUANTIZE_MESHES = App->parser->GetBool("QuantizeMeshes");
+		MESH_LOD = App->parser->GetBool("MeshLod");
+		MESH_LOD_PIXEL_ERROR = App->parser->GetFloat("MeshLodPixelError");
+		MESH_LOD_HYSTERESIS = App->parser->GetFloat("MeshLodHysteresis");
+		MESHLET_CULLING = App->parser->GetBool("MeshletCulling");
+		HLOD = App->parser->GetBool("HLOD");
+		HLOD_DISTANCE = App->parser->GetFloat("HLODDistance");
+		App->parser->UnloadObject();
+	}
+
+	occlusion_buffer = new OcclusionBuffer(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+	proximity_grid.SetCellSize(PROXIMITY_CELL_SIZE);
+	static_batcher = new StaticBatcher();
+	hlod_builder = new HLODBuilder();
+
+	//The root cell grows to enclose whatever gets inserted
+	octree = new LooseOctree();
+	aabb_tree = new AABBTree();
 
 	root = CreateGameObject("Root");
 
 	return true;
 }
 
+bool ModuleLevel::Start()
+{
+	if (QUANTIZE_MESHES && (GLEW_VERSION_3_0 || GLEW_ARB_half_float_vertex))
+	{
+		App->program_shaders->Load(QUANTIZED_MESH_PROGRAM, QUANTIZED_VERTEX_SHADER, FIXED_FRAGMENT_SHADER, nullptr, FIXED_LIGHTING_SHADER);
+		quantize_meshes_supported = App->program_shaders->HasProgram(QUANTIZED_MESH_PROGRAM);
+	}
+
+	if (QUANTIZE_MESHES && !quantize_meshes_supported)
+		APPLOG("Quantized meshes not available, vertex buffers stay in floats");
+
+	return true;
+}
+
 update_status ModuleLevel::PreUpdate(float dt)
 {
 	BROFILER_CATEGORY("ModuleLevel-PreUpdate", Profiler::Color::Blue);
@@ -38,6 +101,26 @@ update_status ModuleLevel::PreUpdate(float dt)
 	root->RecursiveUpdateTransforms();
 	root->RecursiveUpdateBoundingBox();
 
+	//Moved dynamic objects were queued while their boxes were recalculated
+	aabb_tree->Refit();
+
+	if (static_batches_dirty)
+	{
+		static_batches_dirty = false;
+		if (static_batcher->GetNumBatches() > 0)
+			static_batcher->Bake(root, STATIC_BATCH_CELL_SIZE);
+	}
+
+	//Boxes may have moved, the next proximity query rebuilds the grid
+	proximity_grid_built = false;
+
+	memcpy(last_lod_histogram, lod_histogram, sizeof(lod_histogram));
+	memset(lod_histogram, 0, sizeof(lod_histogram));
+	last_drawn_triangles = drawn_triangles;
+	drawn_triangles = 0;
+	last_submitted_triangles = submitted_triangles;
+	submitted_triangles = 0;
+
 	return UPDATE_CONTINUE;
 }
 
@@ -45,6 +128,11 @@ update_status ModuleLevel::Update(float dt)
 {
 	BROFILER_CATEGORY("ModuleLevel-Update", Profiler::Color::Red);
 
+	CullDynamicObjects();
+	UpdateOcclusion();
+
+	hlod_builder->Update(App->camera->GetPosition(), HLOD ? HLOD_DISTANCE : FLOAT_INF);
+
 	root->Update();
 
 	return UPDATE_CONTINUE;
@@ -54,9 +142,19 @@ bool ModuleLevel::CleanUp()
 {
 	APPLOG("Destroying GameObjects and clearing level.")
 
+	static_batcher->Clear(root);
+	RELEASE(static_batcher);
+	hlod_builder->Clear(root);
+	RELEASE(hlod_builder);
+
 	RELEASE(root);
 
-	RELEASE(quadtree);
+	RELEASE(octree);
+	RELEASE(aabb_tree);
+	RELEASE(occlusion_buffer);
+
+	if (occlusion_debug_texture != 0)
+		glDeleteTextures(1, &occlusion_debug_texture);
 
 	return true;
 }
@@ -76,6 +174,9 @@ void ModuleLevel::Draw() const
 			(*it)->Draw();
 	}
 
+	static_batcher->Draw();
+	hlod_builder->Draw();
+
 	if (canvas != nullptr && canvas->IsActive())
 		canvas->Draw();
 		
@@ -85,15 +186,18 @@ void ModuleLevel::DrawDebug() const
 {
 	BROFILER_CATEGORY("ModuleLevel-DebugDraw", Profiler::Color::GreenYellow);
 
-	if (draw_quadtree_structure)
-		quadtree->Draw();
+	if (draw_octree_structure)
+		octree->Draw();
 
-	std::vector<GameObject*> testObjects;
-	testObjects.clear();
+	if (draw_aabb_tree_structure)
+		aabb_tree->Draw();
 
-	quadtree->IntersectCandidates(testObjects, camera->bbox);
+	if (draw_static_batches)
+		static_batcher->DrawDebug();
+
+	if (draw_hlod_clusters)
+		hlod_builder->DrawDebug();
 
-	//for (std::vector<GameObject*>::const_iterator it = testObjects.begin(); it != testObjects.end(); ++it)
 	for (std::vector<GameObject*>::const_iterator it = root->childs.begin(); it != root->childs.end(); ++it)
 	{
 		if ((*it)->IsActive())
@@ -101,8 +205,6 @@ void ModuleLevel::DrawDebug() const
 			(*it)->DebugDraw();
 		}
 	}
-
-	testObjects.clear();
 }
 
 GameObject* ModuleLevel::CreateGameObject(const std::string& name, GameObject* parent, GameObject* root_object)
@@ -135,6 +237,155 @@ GameObject* ModuleLevel::CreateGameObject(const char* texture, const Primitive&
 }
 
 GameObject* ModuleLevel::ImportScene(const char* folder, const char* file, bool is_dynamic)
+{
+	BROFILER_CATEGORY("ModuleLevel-ImportScene", Profiler::Color::Orange);
+
+	TimerUs timer;
+	timer.Start();
+
+	std::string source_path = std::string(folder) + file;
+	std::string native_path = source_path + MESH_FILE_EXTENSION;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	bool has_source = App->files->GetFileStamp(source_path.c_str(), source_size, source_time);
+
+	GameObject* res = nullptr;
+	if (NATIVE_MESHES && has_source)
+		res = LoadNativeScene(native_path.c_str(), source_size, source_time, is_dynamic);
+
+	if (res != nullptr)
+	{
+		APPLOG("Loaded %s from %s in %llu us", file, native_path.c_str(), timer.GetTimeInUs());
+	}
+	else
+	{
+		//Anything the obj loader can't read still gets a chance with assimp
+		std::string extension = source_path.substr(MIN(source_path.find_last_of('.'), source_path.size()));
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (OBJ_LOADER && extension == ".obj")
+			res = ImportObjScene(folder, file, is_dynamic);
+
+		if (res != nullptr)
+		{
+			APPLOG("Imported %s with the obj loader in %llu us", file, timer.GetTimeInUs());
+		}
+		else
+		{
+			res = ImportAssimpScene(folder, file, is_dynamic);
+			if (res == nullptr)
+				return nullptr;
+
+			APPLOG("Imported %s with assimp in %llu us", file, timer.GetTimeInUs());
+		}
+
+		if (NATIVE_MESHES && has_source)
+			SaveNativeScene(native_path.c_str(), res, source_size, source_time);
+	}
+
+	res->LoadBones();
+	if (!is_dynamic)
+		res->hlod_source = source_path;
+
+	return res;
+}
+
+void ModuleLevel::BenchmarkImport(const char* folder, const char* file)
+{
+	std::string source_path = std::string(folder) + file;
+	std::string native_path = source_path + MESH_FILE_EXTENSION;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	if (!App->files->GetFileStamp(source_path.c_str(), source_size, source_time))
+		return;
+
+	//Textures stay cached by the first import, both paths only pay for the geometry
+	TimerUs timer;
+	timer.Start();
+	GameObject* scene = ImportAssimpScene(folder, file, false);
+	Uint64 assimp_us = timer.GetTimeInUs();
+	if (scene == nullptr)
+		return;
+
+	SaveNativeScene(native_path.c_str(), scene, source_size, source_time);
+	ReleaseRootChild(scene);
+
+	timer.Start();
+	scene = LoadNativeScene(native_path.c_str(), source_size, source_time, false);
+	Uint64 native_us = timer.GetTimeInUs();
+	if (scene == nullptr)
+		return;
+
+	ReleaseRootChild(scene);
+
+	APPLOG("Import benchmark (%s): assimp %llu us, native %llu us, %.1fx faster", file, assimp_us, native_us, (double)assimp_us / MAX(native_us, 1));
+}
+
+void ModuleLevel::BenchmarkObjLoader(const char* folder, const char* file)
+{
+	std::string path = std::string(folder) + file;
+
+	//Geometry only on every side, the meshes are neither optimized nor uploaded
+	TimerUs timer;
+	timer.Start();
+	ObjScene obj_scene;
+	if (!LoadObj(path.c_str(), obj_scene, App->jobs))
+		return;
+	Uint64 obj_us = timer.GetTimeInUs();
+
+	unsigned num_vertices = 0;
+	unsigned num_triangles = 0;
+	for (std::vector<ObjMesh>::const_iterator it = obj_scene.meshes.begin(); it != obj_scene.meshes.end(); ++it)
+	{
+		num_vertices += it->positions.size();
+		num_triangles += it->indices.size() / 3;
+	}
+
+	timer.Start();
+	const aiScene* scene = aiImportFileEx(path.c_str(), MESH_IMPORT_FLAGS, App->files->GetAssimpIO());
+	Uint64 assimp_us = timer.GetTimeInUs();
+	aiReleaseImport(scene);
+
+	timer.Start();
+	scene = aiImportFileEx(path.c_str(), aiProcess_Triangulate | aiProcess_JoinIdenticalVertices, App->files->GetAssimpIO());
+	Uint64 assimp_minimal_us = timer.GetTimeInUs();
+	aiReleaseImport(scene);
+
+	APPLOG("Obj benchmark (%s): %u meshes, %u vertices, %u triangles", file, obj_scene.meshes.size(), num_vertices, num_triangles);
+	APPLOG("Obj loader %llu us on %u threads, assimp %llu us (%.1fx), assimp triangulate and join only %llu us (%.1fx)", obj_us, App->jobs->GetNumWorkers() + 1,
+		assimp_us, (double)assimp_us / MAX(obj_us, 1), assimp_minimal_us, (double)assimp_minimal_us / MAX(obj_us, 1));
+}
+
+void ModuleLevel::BenchmarkReload(const char* folder, const char* file, unsigned iterations)
+{
+	unsigned long long cpu_memory = 0;
+	unsigned long long gpu_memory = 0;
+	TimerUs timer;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		timer.Start();
+		GameObject* scene = ImportScene(folder, file);
+		Uint64 load_us = timer.GetTimeInUs();
+		if (scene == nullptr)
+			return;
+
+		unsigned long long kept_copies = 0;
+		unsigned long long all_copies = 0;
+		SumMeshCopies(scene, kept_copies, all_copies);
+
+		App->resources->GetMemory(cpu_memory, gpu_memory);
+		ReleaseRootChild(scene);
+		APPLOG("Reload %u (%s): %llu us, resources %llu KB CPU, %llu KB GPU", i, file, load_us, cpu_memory / 1024, gpu_memory / 1024);
+		APPLOG("- Static mesh copies %llu KB, %llu KB if every mesh kept them", kept_copies / 1024, all_copies / 1024);
+	}
+
+	//Whatever only the released copies used is gone now instead of after the unload delay
+	unsigned unloaded = App->resources->UnloadUnused();
+	App->resources->GetMemory(cpu_memory, gpu_memory);
+	APPLOG("Unloaded %u resources, %llu KB CPU, %llu KB GPU left", unloaded, cpu_memory / 1024, gpu_memory / 1024);
+}
+
+GameObject* ModuleLevel::ImportAssimpScene(const char* folder, const char* file, bool is_dynamic)
 {
 	GameObject* res = nullptr;
 	aiString folder_path = aiString();
@@ -143,18 +394,181 @@ GameObject* ModuleLevel::ImportScene(const char* folder, const char* file, bool
 	aiString file_path = aiString(folder_path);
 	file_path.Append(file);
 
-	const aiScene* scene = aiImportFile(file_path.data, aiProcess_Triangulate | aiProcessPreset_TargetRealtime_MaxQuality);
+	const aiScene* scene = aiImportFileEx(file_path.data, MESH_IMPORT_FLAGS, App->files->GetAssimpIO());
 
 	if (scene != nullptr)
 	{
-		res = RecursiveLoadSceneNode(scene->mRootNode, scene, root, folder_path, nullptr, is_dynamic);
+		res = RecursiveLoadSceneNode(scene->mRootNode, scene, root, folder_path, file_path, nullptr, is_dynamic);
 	}
-	res->LoadBones();
 
 	aiReleaseImport(scene);
 	return res;
 }
 
+GameObject* ModuleLevel::ImportObjScene(const char* folder, const char* file, bool is_dynamic)
+{
+	std::string path = std::string(folder) + file;
+	ObjScene scene;
+	if (!LoadObj(path.c_str(), scene, App->jobs))
+		return nullptr;
+
+	aiString folder_path = aiString();
+	folder_path.Append(folder);
+
+	std::map<std::string, unsigned> group_meshes;
+	for (std::vector<ObjMesh>::const_iterator it = scene.meshes.begin(); it != scene.meshes.end(); ++it)
+		++group_meshes[it->name];
+
+	GameObject* res = CreateGameObject(file, root);
+	std::map<std::string, GameObject*> groups;
+	for (unsigned i = 0; i < scene.meshes.size(); ++i)
+	{
+		const ObjMesh& mesh = scene.meshes[i];
+		GameObject*& group = groups[mesh.name];
+		if (group == nullptr)
+			group = CreateGameObject(mesh.name, res, res);
+
+		//Groups with several materials get an object for each one
+		GameObject* mesh_object = group;
+		if (group_meshes[mesh.name] > 1)
+			mesh_object = CreateGameObject(mesh.name, group, res);
+
+		mesh_object->LoadMesh(mesh, path + "#" + std::to_string(i), is_dynamic);
+		if (mesh.material != OBJ_NO_MATERIAL)
+			mesh_object->LoadMaterial(scene.materials[mesh.material], folder_path);
+		else
+			mesh_object->CreateComponent(Component::Type::MATERIAL);
+	}
+
+	return res;
+}
+
+GameObject* ModuleLevel::LoadNativeScene(const char* path, unsigned long long source_size, unsigned long long source_time, bool is_dynamic)
+{
+	VirtualFile file;
+	if (!App->files->ReadFile(path, file))
+		return nullptr;
+
+	if (ValidateMeshFile(file.GetData(), file.GetSize(), source_size, source_time) == nullptr)
+	{
+		APPLOG("Mesh file %s is outdated, importing the source again", path);
+		return nullptr;
+	}
+
+	const char* data = file.GetData();
+	const MeshFileHeader* header = (const MeshFileHeader*)data;
+	const MeshFileNode* nodes = (const MeshFileNode*)(data + header->nodes_offset);
+	const MeshFileSubmesh* submeshes = (const MeshFileSubmesh*)(data + header->submeshes_offset);
+	const MeshFileMaterial* materials = (const MeshFileMaterial*)(data + header->materials_offset);
+
+	std::vector<GameObject*> objects;
+	objects.reserve(header->num_nodes);
+	for (unsigned i = 0; i < header->num_nodes; ++i)
+	{
+		const MeshFileNode& node = nodes[i];
+		GameObject* node_parent = node.parent >= 0 ? objects[node.parent] : root;
+		GameObject* game_object = CreateGameObject(data + node.name, node_parent, objects.empty() ? nullptr : objects[0]);
+		game_object->SetLocalTransform(float3(node.position), float3(node.scale), Quat(node.rotation));
+
+		if (node.submesh < header->num_submeshes)
+		{
+			//Submeshes are keyed by the native file, other instances of it map the same geometry
+			ComponentMesh* mesh = (ComponentMesh*)game_object->CreateComponent(Component::Type::MESH);
+			std::string source = std::string(path) + "#" + std::to_string(node.submesh);
+			bool shareable = !is_dynamic && submeshes[node.submesh].num_bones == 0;
+			if (!shareable || !mesh->LoadShared(source))
+			{
+				mesh->Load(submeshes[node.submesh], data, is_dynamic);
+				if (shareable)
+					mesh->Share(source);
+			}
+		}
+
+		if (node.material < header->num_materials)
+		{
+			ComponentMaterial* material = (ComponentMaterial*)game_object->CreateComponent(Component::Type::MATERIAL);
+			material->Load(materials[node.material], data);
+		}
+
+		objects.push_back(game_object);
+	}
+
+	return objects[0];
+}
+
+bool ModuleLevel::SaveNativeScene(const char* path, const GameObject* scene_root, unsigned long long source_size, unsigned long long source_time) const
+{
+	BROFILER_CATEGORY("ModuleLevel-SaveNativeScene", Profiler::Color::Orange);
+
+	MeshFileWriter writer;
+	RecursiveSaveSceneNode(scene_root, -1, writer);
+
+	return writer.Write(path, source_size, source_time);
+}
+
+void ModuleLevel::RecursiveSaveSceneNode(const GameObject* game_object, int parent, MeshFileWriter& writer) const
+{
+	MeshFileNode node;
+	node.name = AppendMeshFileString(writer.data, game_object->name);
+	node.parent = parent;
+
+	const ComponentTransform* transform = game_object->transform;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		node.position[i] = transform->GetPosition()[i];
+		node.scale[i] = transform->GetScale()[i];
+	}
+	memcpy(node.rotation, transform->GetRotation().ptr(), sizeof(node.rotation));
+
+	const ComponentMesh* mesh = (const ComponentMesh*)game_object->GetComponent(Component::Type::MESH);
+	if (mesh != nullptr)
+	{
+		MeshFileSubmesh submesh;
+		mesh->Save(submesh, writer.data);
+		node.submesh = writer.submeshes.size();
+		writer.submeshes.push_back(submesh);
+	}
+
+	const ComponentMaterial* material = (const ComponentMaterial*)game_object->GetComponent(Component::Type::MATERIAL);
+	if (material != nullptr)
+	{
+		MeshFileMaterial file_material;
+		material->Save(file_material, writer.data);
+		node.material = writer.materials.size();
+		writer.materials.push_back(file_material);
+	}
+
+	int index = writer.nodes.size();
+	writer.nodes.push_back(node);
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		RecursiveSaveSceneNode(*it, index, writer);
+}
+
+void ModuleLevel::ReleaseRootChild(GameObject* game_object)
+{
+	std::vector<GameObject*>::iterator it = std::find(root->childs.begin(), root->childs.end(), game_object);
+	if (it != root->childs.end())
+		root->childs.erase(it);
+
+	RELEASE(game_object);
+}
+
+void ModuleLevel::SumMeshCopies(const GameObject* game_object, unsigned long long& kept, unsigned long long& total) const
+{
+	const ComponentMesh* mesh = (const ComponentMesh*)game_object->GetComponent(Component::Type::MESH);
+	if (mesh != nullptr && !mesh->HasBones())
+	{
+		unsigned long long vertices_size = (unsigned long long)mesh->GetNumVertices() * sizeof(float3);
+		unsigned long long indices_size = (unsigned long long)mesh->GetNumIndices() * sizeof(unsigned);
+		total += vertices_size + indices_size;
+		kept += (mesh->GetVertices() != nullptr ? vertices_size : 0) + (mesh->GetIndices() != nullptr ? indices_size : 0);
+	}
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		SumMeshCopies(*it, kept, total);
+}
+
 GameObject* ModuleLevel::AddCamera()
 {
 	camera = CreateGameObject("Game Camera");
@@ -162,7 +576,7 @@ GameObject* ModuleLevel::AddCamera()
 	return camera;
 }
 
-GameObject* ModuleLevel::RecursiveLoadSceneNode(aiNode* scene_node, const aiScene* scene, GameObject* parent, const aiString& folder_path, GameObject* root_scene_object, bool is_dynamic)
+GameObject* ModuleLevel::RecursiveLoadSceneNode(aiNode* scene_node, const aiScene* scene, GameObject* parent, const aiString& folder_path, const aiString& file_path, GameObject* root_scene_object, bool is_dynamic)
 {
 	GameObject* new_object = CreateGameObject(scene_node->mName.data, parent, root_scene_object);
 	if (root_scene_object == nullptr)
@@ -186,34 +600,238 @@ GameObject* ModuleLevel::RecursiveLoadSceneNode(aiNode* scene_node, const aiScen
 		for (int i = 0; i < scene_node->mNumMeshes; i++)
 		{
 			mesh_object = CreateGameObject(scene_node->mName.data, new_object, root_scene_object);
-			mesh_object->LoadMesh(scene->mMeshes[scene_node->mMeshes[i]], scene, folder_path, is_dynamic);
+			mesh_object->LoadMesh(scene->mMeshes[scene_node->mMeshes[i]], scene, file_path, is_dynamic);
 			mesh_object->LoadMaterial(scene->mMeshes[scene_node->mMeshes[i]], scene, folder_path);
 		}
 	}
 	else if (scene_node->mNumMeshes == 1)
 	{
 		//Create mesh component on this object
-		new_object->LoadMesh(scene->mMeshes[scene_node->mMeshes[0]], scene, folder_path, is_dynamic);
+		new_object->LoadMesh(scene->mMeshes[scene_node->mMeshes[0]], scene, file_path, is_dynamic);
 		new_object->LoadMaterial(scene->mMeshes[scene_node->mMeshes[0]], scene, folder_path);
 	}
 
 	for (int i = 0; i < scene_node->mNumChildren; i++)
-		RecursiveLoadSceneNode(scene_node->mChildren[i], scene, new_object, folder_path, root_scene_object, is_dynamic);
+		RecursiveLoadSceneNode(scene_node->mChildren[i], scene, new_object, folder_path, file_path, root_scene_object, is_dynamic);
 	return new_object;
 }
 
-void ModuleLevel::InsertGameObjectQuadTree(GameObject * game_object)
+void ModuleLevel::InsertGameObjectSpatialIndex(GameObject* game_object)
+{
+	if (game_object->octree_entry != INVALID_OCTREE_INDEX || game_object->aabb_tree_leaf != INVALID_AABB_NODE)
+		UpdateGameObjectSpatialIndex(game_object);
+	else if (game_object->IsStatic())
+		game_object->octree_entry = octree->Insert(game_object, game_object->bbox);
+	else
+		game_object->aabb_tree_leaf = aabb_tree->Insert(game_object, game_object->bbox);
+}
+
+void ModuleLevel::UpdateGameObjectSpatialIndex(GameObject* game_object)
+{
+	if (game_object->octree_entry != INVALID_OCTREE_INDEX)
+		octree->Update(game_object->octree_entry, game_object->bbox);
+	else if (game_object->aabb_tree_leaf != INVALID_AABB_NODE)
+		aabb_tree->Update(game_object->aabb_tree_leaf, game_object->bbox);
+}
+
+void ModuleLevel::RemoveGameObjectSpatialIndex(GameObject* game_object)
+{
+	if (octree != nullptr && game_object->octree_entry != INVALID_OCTREE_INDEX)
+	{
+		octree->Remove(game_object->octree_entry);
+		game_object->octree_entry = INVALID_OCTREE_INDEX;
+	}
+
+	if (aabb_tree != nullptr && game_object->aabb_tree_leaf != INVALID_AABB_NODE)
+	{
+		aabb_tree->Remove(game_object->aabb_tree_leaf);
+		game_object->aabb_tree_leaf = INVALID_AABB_NODE;
+	}
+}
+
+void ModuleLevel::QueryFrustum(const Frustum& frustum, std::vector<GameObject*>& results, const SpatialFilter& filter) const
+{
+	FrustumQuery query(frustum, results, filter);
+	octree->Query(query);
+	aabb_tree->Query(query);
+}
+
+void ModuleLevel::QueryAABB(const AABB& primitive, std::vector<GameObject*>& results, const SpatialFilter& filter) const
+{
+	AABBQuery query(primitive, results, filter);
+	octree->Query(query);
+	aabb_tree->Query(query);
+}
+
+void ModuleLevel::QuerySphere(const Sphere& sphere, std::vector<GameObject*>& results, const SpatialFilter& filter) const
+{
+	SphereQuery query(sphere, results, filter);
+	octree->Query(query);
+	aabb_tree->Query(query);
+}
+
+void ModuleLevel::Raycast(const Ray& ray, float max_distance, unsigned max_hits, std::vector<SpatialHit>& hits, const SpatialFilter& filter) const
+{
+	BROFILER_CATEGORY("ModuleLevel-Raycast", Profiler::Color::Blue);
+
+	RayQuery query(ray, max_distance, max_hits, hits, filter);
+	octree->Query(query);
+	aabb_tree->Query(query);
+	query.Finish();
+}
+
+void ModuleLevel::QueryNearest(const float3& point, unsigned k, float max_distance, std::vector<SpatialHit>& hits, const SpatialFilter& filter) const
+{
+	BROFILER_CATEGORY("ModuleLevel-QueryNearest", Profiler::Color::Blue);
+
+	NearestQuery query(point, k, max_distance, hits, filter);
+	octree->Query(query);
+	aabb_tree->Query(query);
+	query.Finish();
+}
+
+void ModuleLevel::QueryObjectsNear(const float3& point, float radius, std::vector<GameObject*>& results, const SpatialFilter& filter) const
+{
+	if (!proximity_grid_built)
+		BuildProximityGrid();
+
+	//Grid objects are at most one cell from their center to any corner
+	std::vector<unsigned> candidates;
+	proximity_grid.QuerySphere(Sphere(point, radius + PROXIMITY_CELL_SIZE), candidates);
+
+	for (std::vector<unsigned>::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
+	{
+		GameObject* game_object = proximity_objects[*it];
+		if (game_object->bbox.Distance(point) <= radius && (!filter || filter(game_object)))
+			results.push_back(game_object);
+	}
+
+	for (std::vector<GameObject*>::const_iterator it = large_objects.begin(); it != large_objects.end(); ++it)
+		if ((*it)->bbox.Distance(point) <= radius && (!filter || filter(*it)))
+			results.push_back(*it);
+}
+
+void ModuleLevel::BuildProximityGrid() const
+{
+	BROFILER_CATEGORY("ModuleLevel-BuildProximityGrid", Profiler::Color::Blue);
+
+	proximity_objects.clear();
+	proximity_positions.clear();
+	large_objects.clear();
+
+	for (std::vector<GameObject*>::const_iterator it = root->childs.begin(); it != root->childs.end(); ++it)
+		CollectProximityObjects(*it);
+
+	proximity_grid.Build(proximity_positions.empty() ? nullptr : &proximity_positions[0], proximity_positions.size(), App->jobs);
+	proximity_grid_built = true;
+}
+
+void ModuleLevel::CollectProximityObjects(GameObject* game_object) const
+{
+	if (game_object->bbox.IsFinite())
+	{
+		if (game_object->bbox.HalfDiagonal().Length() <= PROXIMITY_CELL_SIZE)
+		{
+			proximity_objects.push_back(game_object);
+			proximity_positions.push_back(game_object->bbox.CenterPoint());
+		}
+		else
+			large_objects.push_back(game_object);
+	}
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		CollectProximityObjects(*it);
+}
+
+bool ModuleLevel::IsInsideDynamicCulling(const GameObject* game_object) const
 {
-	quadtree->Insert(game_object);
+	return !dynamic_culling || game_object->visible_frame == culling_frame;
+}
+
+void ModuleLevel::CullDynamicObjects()
+{
+	BROFILER_CATEGORY("ModuleLevel-CullDynamicObjects", Profiler::Color::Red);
+
+	//One tree traversal stamps every visible dynamic object for this frame
+	++culling_frame;
+	const Frustum* frustum = App->camera->GetCullingFrustum();
+	dynamic_culling = frustum != nullptr;
+	if (!dynamic_culling)
+		return;
+
+	visible_dynamic_objects.clear();
+	aabb_tree->IntersectCandidates(visible_dynamic_objects, *frustum);
+
+	for (std::vector<GameObject*>::iterator it = visible_dynamic_objects.begin(); it != visible_dynamic_objects.end(); ++it)
+		(*it)->visible_frame = culling_frame;
+}
+
+void ModuleLevel::BenchmarkOctree(unsigned num_objects) const
+{
+	const unsigned num_queries = 1000;
+	float world_half_size = 2.0f * sqrtf((float)num_objects);
+
+	LCG lcg(num_objects);
+	std::vector<AABB> boxes(num_objects);
+	std::vector<unsigned> entries(num_objects);
+	for (unsigned i = 0; i < num_objects; ++i)
+	{
+		float3 center = float3(lcg.Float(-world_half_size, world_half_size), lcg.Float(0.0f, 10.0f), lcg.Float(-world_half_size, world_half_size));
+		boxes[i].SetFromCenterAndSize(center, float3(lcg.Float(0.5f, 2.0f)));
+	}
+
+	LooseOctree tree;
+	TimerUs timer;
+
+	timer.Start();
+	for (unsigned i = 0; i < num_objects; ++i)
+		entries[i] = tree.Insert(nullptr, boxes[i]);
+	Uint64 insert_us = timer.GetTimeInUs();
+
+	for (unsigned i = 0; i < num_objects; ++i)
+		boxes[i].Translate(float3(lcg.Float(-0.5f, 0.5f), 0.0f, lcg.Float(-0.5f, 0.5f)));
+
+	timer.Start();
+	for (unsigned i = 0; i < num_objects; ++i)
+		tree.Update(entries[i], boxes[i]);
+	Uint64 move_us = timer.GetTimeInUs();
+
+	std::vector<GameObject*> candidates;
+	candidates.reserve(num_objects);
+	unsigned num_candidates = 0;
+
+	timer.Start();
+	for (unsigned i = 0; i < num_queries; ++i)
+	{
+		AABB query;
+		query.SetFromCenterAndSize(float3(lcg.Float(-world_half_size, world_half_size), 5.0f, lcg.Float(-world_half_size, world_half_size)), float3(20.0f));
+		candidates.clear();
+		tree.IntersectCandidates(candidates, query);
+		num_candidates += candidates.size();
+	}
+	Uint64 query_us = timer.GetTimeInUs();
+
+	APPLOG("Octree benchmark: %u objects, %u nodes", tree.GetNumObjects(), tree.GetNumNodes());
+	APPLOG("- Insert: %llu us (%.1f objects/ms)", insert_us, num_objects * 1000.0f / MAX(insert_us, 1));
+	APPLOG("- Move: %llu us (%.1f objects/ms)", move_us, num_objects * 1000.0f / MAX(move_us, 1));
+	APPLOG("- Query: %u AABB queries in %llu us, %u candidates", num_queries, query_us, num_candidates);
 }
 
 void ModuleLevel::OnPlay()
 {
 	root->RecursiveOnPlay();
+
+	LoadHLOD();
+
+	if (STATIC_BATCH_ON_PLAY)
+		BakeStaticBatches();
 }
 
 void ModuleLevel::OnStop()
 {
+	ClearStaticBatches();
+	ClearHLOD();
+
 	root->RecursiveOnStop();
 
 	root->RecursiveUpdateTransforms();
@@ -230,4 +848,141 @@ void ModuleLevel::GetGLError(const char* string) const
 		ret = false;
 	}
 
-}
\ No newline at end of file
+}
+
+bool ModuleLevel::IsOccluded(const AABB& box) const
+{
+	return occlusion_active && !occlusion_buffer->IsVisible(box);
+}
+
+void ModuleLevel::UpdateOcclusion()
+{
+	BROFILER_CATEGORY("ModuleLevel-UpdateOcclusion", Profiler::Color::Red);
+
+	TimerUs timer;
+	timer.Start();
+
+	occlusion_active = false;
+	num_occluders = 0;
+	occlusion_time = 0;
+
+	const Frustum* frustum = App->camera->GetCullingFrustum();
+	if (!OCCLUSION_CULLING || frustum == nullptr)
+		return;
+
+	//Large static meshes in view are the occluders, the ones covering more screen go first
+	float min_size = OCCLUDER_MIN_SIZE;
+	occluder_candidates.clear();
+	QueryFrustum(*frustum, occluder_candidates, [min_size](const GameObject* game_object)
+	{
+		const ComponentMesh* mesh = (const ComponentMesh*)game_object->GetComponent(Component::Type::MESH, true);
+		return game_object->IsStatic() && game_object->IsActive() && mesh != nullptr && !mesh->HasBones() &&
+			game_object->bbox.Size().MaxElement() >= min_size;
+	});
+
+	occluders.clear();
+	for (std::vector<GameObject*>::const_iterator it = occluder_candidates.begin(); it != occluder_candidates.end(); ++it)
+	{
+		SpatialHit occluder;
+		occluder.object = *it;
+		float distance = MAX((*it)->bbox.Distance(frustum->Pos()), 1.0f);
+		occluder.distance = -(*it)->bbox.SurfaceArea() / (distance * distance);
+		occluders.push_back(occluder);
+	}
+
+	std::sort(occluders.begin(), occluders.end());
+
+	occlusion_buffer->Begin(frustum->ViewProjMatrix());
+	for (std::vector<SpatialHit>::const_iterator it = occluders.begin(); it != occluders.end() && num_occluders < MAX_OCCLUDERS; ++it)
+	{
+		ComponentMesh* mesh = (ComponentMesh*)it->object->GetComponent(Component::Type::MESH, true);
+		if (occlusion_buffer->GetNumTriangles() + mesh->GetNumIndices() / 3 > MAX_OCCLUDER_TRIANGLES)
+			continue;
+
+		//Only meshes that end up as occluders keep their copies, read back the first frame they are used
+		mesh->KeepCpuCopies();
+
+		occlusion_buffer->AddOccluder(it->object->GetGlobalTransformMatrix(), mesh->GetVertices(), mesh->GetIndices(), mesh->GetNumIndices());
+		++num_occluders;
+	}
+
+	occlusion_buffer->Rasterize(App->jobs);
+	occlusion_active = num_occluders > 0;
+
+	if (draw_occlusion_buffer)
+		UpdateOcclusionDebugTexture();
+
+	occlusion_time = (unsigned)timer.GetTimeInUs();
+}
+
+void ModuleLevel::UpdateOcclusionDebugTexture()
+{
+	const Frustum* frustum = App->camera->GetCullingFrustum();
+	if (frustum == nullptr)
+		return;
+
+	occlusion_debug_pixels.resize(occlusion_buffer->GetWidth() * occlusion_buffer->GetHeight());
+	occlusion_buffer->GetDebugImage(&occlusion_debug_pixels[0], frustum->NearPlaneDistance(), frustum->FarPlaneDistance());
+
+	if (occlusion_debug_texture == 0)
+	{
+		glGenTextures(1, &occlusion_debug_texture);
+		glBindTexture(GL_TEXTURE_2D, occlusion_debug_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	else
+		glBindTexture(GL_TEXTURE_2D, occlusion_debug_texture);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, occlusion_buffer->GetWidth(), occlusion_buffer->GetHeight(), 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, &occlusion_debug_pixels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void ModuleLevel::BakeStaticBatches()
+{
+	//World positions are baked in, transforms must be current
+	root->RecursiveUpdateTransforms();
+	root->RecursiveUpdateBoundingBox();
+
+	static_batcher->Bake(root, STATIC_BATCH_CELL_SIZE);
+}
+
+void ModuleLevel::ClearStaticBatches()
+{
+	static_batcher->Clear(root);
+}
+
+void ModuleLevel::LoadHLOD()
+{
+	//Clusters take the boxes and scene root transforms as they are now
+	root->RecursiveUpdateTransforms();
+	root->RecursiveUpdateBoundingBox();
+
+	hlod_builder->Load(root);
+
+	if (static_batcher->GetNumBatches() > 0)
+		static_batcher->Bake(root, STATIC_BATCH_CELL_SIZE);
+}
+
+void ModuleLevel::ClearHLOD()
+{
+	hlod_builder->Clear(root);
+
+	if (static_batcher->GetNumBatches() > 0)
+		static_batcher->Bake(root, STATIC_BATCH_CELL_SIZE);
+}
+
+bool ModuleLevel::IsHLODProxied(int cluster) const
+{
+	return hlod_builder != nullptr && hlod_builder->IsProxied(cluster);
+}
+
+void ModuleLevel::ReportMeshDraw(unsigned lod, unsigned num_triangles, unsigned num_submitted_triangles)
+{
+	if (lod < MESH_LOD_MAX_LEVELS)
+		++lod_histogram[lod];
+	drawn_triangles += num_triangles;
+	submitted_triangles += num_submitted_triangles;
+}
@@ -2,8 +2,13 @@
 #define MODULELEVEL_H
 
 #define MODULE_LEVEL "ModuleLevel"
+#define LEVEL_SECTION "Config.Modules.Level"
 
 #include "Module.h"
+#include "Math.h"
+#include "SpatialQuery.h"
+#include "SpatialHashGrid.h"
+#include "MeshSimplifier.h"
 #include <vector>
 #include <string>
 
@@ -12,8 +17,13 @@ struct aiString;
 struct aiNode;
 
 class GameObject;
+struct MeshFileWriter;
 class ComponentCamera;
-class MyQuadTree;
+class LooseOctree;
+class AABBTree;
+class OcclusionBuffer;
+class StaticBatcher;
+class HLODBuilder;
 class Primitive;
 
 class ModuleLevel : public Module
@@ -23,6 +33,7 @@ public:
 	~ModuleLevel();
 
 	bool Init();
+	bool Start();
 	update_status PreUpdate(float dt);
 	update_status Update(float dt);
 	bool CleanUp();
@@ -34,7 +45,14 @@ public:
 	GameObject* CreateGameObject(const Primitive& primitive, const std::string& name = "GameObject", GameObject* parent = nullptr, GameObject* root_object = nullptr);
 	GameObject* CreateGameObject(const char* texture, const Primitive& primitive, const std::string& name = "GameObject", GameObject* parent = nullptr, GameObject* root_object = nullptr);
 
+	//Loads the native mesh file next to the source if it is up to date, otherwise imports with the obj loader
+	//or assimp and writes it. Static scenes remember their source to load the HLOD proxies WolfCooker baked for it.
 	GameObject* ImportScene(const char* folder, const char* file, bool is_dynamic = false);
+	void BenchmarkImport(const char* folder, const char* file);
+	//Parse time of the obj loader against assimp with the engine flags and with triangulation and welding only
+	void BenchmarkObjLoader(const char* folder, const char* file);
+	//Imports and releases the scene repeatedly, logging the resource memory after each load and the part of it in mesh copies
+	void BenchmarkReload(const char* folder, const char* file, unsigned iterations);
 
 	GameObject* AddCamera();
 
@@ -47,22 +65,142 @@ public:
 	void SetSelectedGameObject(GameObject* selected) { selected_gameobject = selected; }
 	GameObject* GetSelectedGameObject() const { return selected_gameobject; }
 
-	void InsertGameObjectQuadTree(GameObject * game_object);
+	//Static objects go to the octree, the rest to the dynamic AABB tree
+	void InsertGameObjectSpatialIndex(GameObject* game_object);
+	void UpdateGameObjectSpatialIndex(GameObject* game_object);
+	void RemoveGameObjectSpatialIndex(GameObject* game_object);
+	void BenchmarkOctree(unsigned num_objects) const;
+
+	//Scene queries over both indexes, results are appended to the caller buffers.
+	//Safe to call from several threads at once while the scene is not being modified.
+	void QueryFrustum(const Frustum& frustum, std::vector<GameObject*>& results, const SpatialFilter& filter = nullptr) const;
+	void QueryAABB(const AABB& primitive, std::vector<GameObject*>& results, const SpatialFilter& filter = nullptr) const;
+	void QuerySphere(const Sphere& sphere, std::vector<GameObject*>& results, const SpatialFilter& filter = nullptr) const;
+	//Hits against the object boxes sorted by distance, max_hits 0 returns every hit. The editor picks with it.
+	void Raycast(const Ray& ray, float max_distance, unsigned max_hits, std::vector<SpatialHit>& hits, const SpatialFilter& filter = nullptr) const;
+	void QueryNearest(const float3& point, unsigned k, float max_distance, std::vector<SpatialHit>& hits, const SpatialFilter& filter = nullptr) const;
+	//Objects whose box is within radius of the point, from a hash grid of the scene built on the first call of each frame.
+	//Main thread only, unlike the queries above.
+	void QueryObjectsNear(const float3& point, float radius, std::vector<GameObject*>& results, const SpatialFilter& filter = nullptr) const;
+
+	bool IsInsideDynamicCulling(const GameObject* game_object) const;
+	bool IsOccluded(const AABB& box) const;
+
+	void UpdateOcclusionDebugTexture();
+	unsigned GetOcclusionDebugTexture() const { return occlusion_debug_texture; }
+	unsigned GetNumOccluders() const { return num_occluders; }
+	const OcclusionBuffer* GetOcclusionBuffer() const { return occlusion_buffer; }
+	unsigned GetOcclusionTime() const { return occlusion_time; }
+
 	void OnPlay();
 	void OnStop();
 
+	void BakeStaticBatches();
+	void ClearStaticBatches();
+	//A batched object moved or changed, baked batches are rebuilt on the next PreUpdate
+	void InvalidateStaticBatches() { static_batches_dirty = true; }
+	const StaticBatcher* GetStaticBatcher() const { return static_batcher; }
+
+	//Cooked clusters of the static scenes, static batches are rebuilt if baked, they must not mix clusters
+	void LoadHLOD();
+	void ClearHLOD();
+	bool IsHLODProxied(int cluster) const;
+	const HLODBuilder* GetHLODBuilder() const { return hlod_builder; }
+
+	//Counted while drawing, read back the next frame
+	void ReportMeshDraw(unsigned lod, unsigned num_triangles, unsigned num_submitted_triangles);
+	const unsigned* GetMeshLodHistogram() const { return last_lod_histogram; }
+	unsigned GetDrawnTriangles() const { return last_drawn_triangles; }
+	//Triangles left after meshlet culling
+	unsigned GetSubmittedTriangles() const { return last_submitted_triangles; }
+	//Compressed vertex buffers need the program that decodes them and half float attributes
+	bool CanQuantizeMeshes() const { return quantize_meshes_supported; }
+
 private:
-	GameObject* RecursiveLoadSceneNode(aiNode* scene_node, const aiScene* scene, GameObject* parent, const aiString& folder_path, GameObject* root_scene_object, bool is_dynamic = false);
+	GameObject* ImportAssimpScene(const char* folder, const char* file, bool is_dynamic);
+	//A node per group with its meshes, as assimp builds obj scenes
+	GameObject* ImportObjScene(const char* folder, const char* file, bool is_dynamic);
+	GameObject* LoadNativeScene(const char* path, unsigned long long source_size, unsigned long long source_time, bool is_dynamic);
+	//Writes the hierarchy under scene_root as it was imported
+	bool SaveNativeScene(const char* path, const GameObject* scene_root, unsigned long long source_size, unsigned long long source_time) const;
+	void RecursiveSaveSceneNode(const GameObject* game_object, int parent, MeshFileWriter& writer) const;
+	void ReleaseRootChild(GameObject* game_object);
+	//Bytes of the static mesh positions and indices in RAM, and what they would take if every mesh kept them
+	void SumMeshCopies(const GameObject* game_object, unsigned long long& kept, unsigned long long& total) const;
+	GameObject* RecursiveLoadSceneNode(aiNode* scene_node, const aiScene* scene, GameObject* parent, const aiString& folder_path, const aiString& file_path, GameObject* root_scene_object, bool is_dynamic = false);
+
+	void CullDynamicObjects();
+	void UpdateOcclusion();
+	void BuildProximityGrid() const;
+	void CollectProximityObjects(GameObject* game_object) const;
 
 	void GetGLError(const char* string) const;
 
 public:
-	bool draw_quadtree_structure = false;
+	bool draw_octree_structure = false;
+	bool draw_aabb_tree_structure = false;
+	bool OCCLUSION_CULLING = true;
+	bool draw_occlusion_buffer = false;
+	bool draw_static_batches = false;
+	bool MESH_LOD = true;
+	float MESH_LOD_PIXEL_ERROR = 1.0f;
+	float MESH_LOD_HYSTERESIS = 0.2f;
+	bool MESHLET_CULLING = true;
+	bool HLOD = true;
+	float HLOD_DISTANCE = 1500.0f;
+	bool draw_hlod_clusters = false;
 
 private:
 	GameObject* root = nullptr;
 	GameObject* camera = nullptr;
-	MyQuadTree* quadtree = nullptr;
+	LooseOctree* octree = nullptr;
+	AABBTree* aabb_tree = nullptr;
+
+	std::vector<GameObject*> visible_dynamic_objects;
+	unsigned culling_frame = 0;
+	bool dynamic_culling = false;
+
+	OcclusionBuffer* occlusion_buffer = nullptr;
+	std::vector<GameObject*> occluder_candidates;
+	std::vector<SpatialHit> occluders;
+	bool occlusion_active = false;
+	unsigned num_occluders = 0;
+	//Microseconds spent building the occlusion buffer last frame
+	unsigned occlusion_time = 0;
+	unsigned occlusion_debug_texture = 0;
+	std::vector<unsigned char> occlusion_debug_pixels;
+
+	//Objects up to the cell size go in the grid by their center, bigger ones are tested one by one.
+	//Built by the first QueryObjectsNear of a frame, frames without proximity queries skip it.
+	mutable SpatialHashGrid proximity_grid;
+	mutable std::vector<GameObject*> proximity_objects;
+	mutable std::vector<float3> proximity_positions;
+	mutable std::vector<GameObject*> large_objects;
+	mutable bool proximity_grid_built = false;
+
+	StaticBatcher* static_batcher = nullptr;
+	bool static_batches_dirty = false;
+	HLODBuilder* hlod_builder = nullptr;
+
+	unsigned lod_histogram[MESH_LOD_MAX_LEVELS] = {};
+	unsigned last_lod_histogram[MESH_LOD_MAX_LEVELS] = {};
+	unsigned drawn_triangles = 0;
+	unsigned last_drawn_triangles = 0;
+	unsigned submitted_triangles = 0;
+	unsigned last_submitted_triangles = 0;
+
+	float PROXIMITY_CELL_SIZE = 4.0f;
+	float STATIC_BATCH_CELL_SIZE = 50.0f;
+	bool STATIC_BATCH_ON_PLAY = true;
+	bool QUANTIZE_MESHES = true;
+	bool quantize_meshes_supported = false;
+	bool NATIVE_MESHES = true;
+	bool OBJ_LOADER = true;
+	unsigned OCCLUSION_WIDTH = 256;
+	unsigned OCCLUSION_HEIGHT = 128;
+	unsigned MAX_OCCLUDERS = 16;
+	unsigned MAX_OCCLUDER_TRIANGLES = 20000;
+	float OCCLUDER_MIN_SIZE = 5.0f;
 
 	GameObject* selected_gameobject = nullptr;
 
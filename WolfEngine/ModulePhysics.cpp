@@ -201,14 +201,16 @@ btTriangleMesh* ModulePhysics::CreateTriangleMesh(Collider* collider)
 	std::vector<ComponentMesh*> meshes = collider->GetMeshes();
 	if (meshes.size() > 0)
 	{
+		std::vector<float3> vertex;
+		std::vector<unsigned> indices;
 		for (std::vector<ComponentMesh*>::iterator it = meshes.begin(); it != meshes.end(); ++it)
 		{
 			unsigned num_vertices = (*it)->GetNumVertices();
 			unsigned num_indices = (*it)->GetNumIndices();
 			unsigned num_triangles = num_indices / 3;
 
-			const float3* vertex = (*it)->GetVertices();
-			const unsigned* indices = (*it)->GetIndices();
+			(*it)->ReadVertices(vertex);
+			(*it)->ReadIndices(indices);
 
 			for (int i = 0; i < num_triangles; i++)
 			{
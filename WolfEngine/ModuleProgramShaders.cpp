@@ -1,5 +1,7 @@
 #include "ModuleProgramShaders.h"
 #include "OpenGL.h"
+#include "Application.h"
+#include "FileSystem.h"
 #include <string>
 #include <cstdio>
 
@@ -24,32 +26,31 @@ bool ModuleProgramShaders::CleanUp()
 	return true;
 }
 
-void ModuleProgramShaders::Load(const char * name, const char * vertex_shader, const char * fragment_shader)
+void ModuleProgramShaders::Load(const char * name, const char * vertex_shader, const char * fragment_shader, const char* feedback_varying, const char* vertex_library)
 {
 	unsigned int ret = 0;
 
 	aiString path = aiString();
 	path.Append(name);
 
-	FILE * vertex_file;
-	vertex_file = fopen(vertex_shader, "rb");
-	if (vertex_file == nullptr) {
-		APPLOG("Error opening file %s: %s\n", vertex_shader, strerror(errno));
+	VirtualFile vertex_file;
+	if (!App->files->ReadFile(vertex_shader, vertex_file)) {
+		APPLOG("Error opening file %s\n", vertex_shader);
 		return;
 	}
-	
-	fseek(vertex_file, 0, SEEK_END);
-	int vertex_file_size = ftell(vertex_file);
-	rewind(vertex_file);
-	char* buff_vertex = new char[vertex_file_size + 1];
-	fread(buff_vertex, sizeof(char), vertex_file_size, vertex_file);
-	buff_vertex[vertex_file_size] = '\0';
-	fclose(vertex_file);
 
-	int id_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(id_vertex_shader, 1, &buff_vertex, 0);
+	VirtualFile library_file;
+	if (vertex_library != nullptr && !App->files->ReadFile(vertex_library, library_file)) {
+		APPLOG("Error opening file %s\n", vertex_library);
+		return;
+	}
 
-	RELEASE_ARRAY(buff_vertex);
+	//The sources go with their lengths, the file data isn't null terminated
+	const char* buff_vertex[2] = { vertex_file.GetData(), library_file.GetData() };
+	GLint vertex_file_size[2] = { (GLint)vertex_file.GetSize(), (GLint)library_file.GetSize() };
+
+	int id_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(id_vertex_shader, vertex_library != nullptr ? 2 : 1, buff_vertex, vertex_file_size);
 
 	glCompileShader(id_vertex_shader);
 
@@ -75,26 +76,18 @@ void ModuleProgramShaders::Load(const char * name, const char * vertex_shader, c
 		return;
 	}
 
-	FILE * fragment_file;
-	fragment_file = fopen(fragment_shader, "rb");
-	if (fragment_file == nullptr) {
-		APPLOG("Error opening file %s: %s\n", fragment_shader, strerror(errno));
+	VirtualFile fragment_file;
+	if (!App->files->ReadFile(fragment_shader, fragment_file)) {
+		APPLOG("Error opening file %s\n", fragment_shader);
 		return;
 	}
 
-	fseek(fragment_file, 0, SEEK_END);
-	int fragment_file_size = ftell(fragment_file);
-	rewind(fragment_file);
-	char* buff_fragment = new char[fragment_file_size + 1];
-	fread(buff_fragment,sizeof(char), fragment_file_size, fragment_file);
-	buff_fragment[fragment_file_size] = '\0';
-	fclose(fragment_file);
+	const char* buff_fragment = fragment_file.GetData();
+	GLint fragment_file_size = (GLint)fragment_file.GetSize();
 
 	int id_fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
-	glShaderSource(id_fragment_shader, 1, &buff_fragment, 0);
-
-	RELEASE_ARRAY(buff_fragment);
+	glShaderSource(id_fragment_shader, 1, &buff_fragment, &fragment_file_size);
 
 	glCompileShader(id_fragment_shader);
 
@@ -130,6 +123,10 @@ void ModuleProgramShaders::Load(const char * name, const char * vertex_shader, c
 	glAttachShader(id_program, id_vertex_shader);
 	glAttachShader(id_program, id_fragment_shader);
 
+	//Captured outputs have to be declared before linking
+	if (feedback_varying != nullptr)
+		glTransformFeedbackVaryings(id_program, 1, &feedback_varying, GL_INTERLEAVED_ATTRIBS);
+
 	//Link our program
 	glLinkProgram(id_program);
 
@@ -185,6 +182,31 @@ int ModuleProgramShaders::GetUniformLocation(const char * name, const char* unif
 	}
 }
 
+int ModuleProgramShaders::GetAttribLocation(const char * name, const char* attrib)
+{
+	aiString path = aiString();
+	path.Append(name);
+
+	ProgramList::iterator it = programs.find(path);
+
+	if (it != programs.end())
+	{
+		return glGetAttribLocation(it->second, attrib);
+	}
+	else
+	{
+		return -1;
+	}
+}
+
+bool ModuleProgramShaders::HasProgram(const char * name) const
+{
+	aiString path = aiString();
+	path.Append(name);
+
+	return programs.find(path) != programs.end();
+}
+
 void ModuleProgramShaders::UseProgram(const char * name)
 {
 	aiString path = aiString();
@@ -2,6 +2,9 @@
 #define MODULEPROGRAMSHADERS_H
 
 #define MODULE_PROGRAM_SHADERS "ModuleProgramShaders"
+//Fixed pipeline lighting and texturing for programs that replace it, see the files for what they cover
+#define FIXED_LIGHTING_SHADER "Resources/Shaders/fixed_lighting_shader.txt"
+#define FIXED_FRAGMENT_SHADER "Resources/Shaders/fixed_fragment_shader.txt"
 
 #include "Module.h"
 #include <assimp/types.h>
@@ -25,9 +28,12 @@ public:
 	bool Init();
 	bool CleanUp();
 
-	void Load(const char* name, const char* vertex_shader, const char* fragment_shader);
+	//The vertex library is appended to the vertex shader source, for functions several programs share
+	void Load(const char* name, const char* vertex_shader, const char* fragment_shader, const char* feedback_varying = nullptr, const char* vertex_library = nullptr);
 	
+	bool HasProgram(const char* name) const;
 	int GetUniformLocation(const char* name, const char* uniform);
+	int GetAttribLocation(const char* name, const char* attrib);
 	void UseProgram(const char* name);
 	void UnuseProgram();
 
@@ -0,0 +1,230 @@
+#include "Application.h"
+#include "ModuleResources.h"
+#include "ResourceTexture.h"
+#include "ResourceMesh.h"
+#include "ResourceAnimation.h"
+#include "JsonHandler.h"
+
+ModuleResources::ModuleResources() : Module(MODULE_RESOURCES)
+{
+}
+
+ModuleResources::~ModuleResources()
+{
+}
+
+bool ModuleResources::Init()
+{
+	if (App->parser->LoadObject(RESOURCES_SECTION))
+	{
+		UNLOAD_DELAY_FRAMES = App->parser->GetInt("UnloadDelayFrames");
+		App->parser->UnloadObject();
+	}
+
+	slots.reserve(RESOURCES_RESERVE);
+	holes.reserve(RESOURCES_RESERVE);
+
+	return true;
+}
+
+update_status ModuleResources::PostUpdate(float dt)
+{
+	BROFILER_CATEGORY("ModuleResources-PostUpdate", Profiler::Color::Green);
+
+	//Unused resources wait a few frames, a level reloading them right away finds them still loaded
+	for (unsigned i = 0; i < slots.size(); ++i)
+	{
+		Resource* resource = slots[i].resource;
+		if (resource != nullptr && resource->references == 0 && ++resource->unused_frames >= UNLOAD_DELAY_FRAMES)
+			Unload(i);
+	}
+
+	return UPDATE_CONTINUE;
+}
+
+bool ModuleResources::CleanUp()
+{
+	unsigned referenced = 0;
+	for (unsigned i = 0; i < slots.size(); ++i)
+	{
+		if (slots[i].resource != nullptr)
+		{
+			if (slots[i].resource->references > 0)
+				++referenced;
+			Unload(i);
+		}
+	}
+
+	if (referenced > 0)
+		APPLOG("%u resources were still referenced on clean up", referenced);
+
+	slots.clear();
+	holes.clear();
+	keys.clear();
+
+	return true;
+}
+
+unsigned ModuleResources::Find(Resource::Type type, const std::string& source, const std::string& settings)
+{
+	KeyMap::const_iterator it = keys.find(GetKey(type, source, settings));
+	if (it == keys.end())
+		return INVALID_RESOURCE_HANDLE;
+
+	AddReference(it->second);
+	return it->second;
+}
+
+unsigned ModuleResources::Add(Resource* resource)
+{
+	unsigned slot = 0;
+	if (!holes.empty())
+	{
+		slot = holes.back();
+		holes.pop_back();
+	}
+	else
+	{
+		slot = slots.size();
+		slots.push_back(Slot());
+	}
+
+	resource->references = 1;
+	resource->unused_frames = 0;
+	slots[slot].resource = resource;
+
+	unsigned handle = (slots[slot].generation << RESOURCE_HANDLE_INDEX_BITS) | slot;
+	keys[GetKey(resource->GetType(), resource->GetSource(), resource->GetSettings())] = handle;
+
+	return handle;
+}
+
+void ModuleResources::AddAlias(unsigned handle, const std::string& source)
+{
+	unsigned slot = FindSlot(handle);
+	if (slot == INVALID_RESOURCE_SLOT)
+		return;
+
+	Resource* resource = slots[slot].resource;
+	std::string key = GetKey(resource->GetType(), source, resource->GetSettings());
+	keys[key] = handle;
+	slots[slot].aliases.push_back(key);
+}
+
+void ModuleResources::AddReference(unsigned handle)
+{
+	unsigned slot = FindSlot(handle);
+	if (slot != INVALID_RESOURCE_SLOT)
+	{
+		++slots[slot].resource->references;
+		slots[slot].resource->unused_frames = 0;
+	}
+}
+
+void ModuleResources::Release(unsigned handle)
+{
+	unsigned slot = FindSlot(handle);
+	if (slot != INVALID_RESOURCE_SLOT && slots[slot].resource->references > 0)
+	{
+		--slots[slot].resource->references;
+		slots[slot].resource->unused_frames = 0;
+	}
+}
+
+ResourceTexture* ModuleResources::GetTexture(unsigned handle) const
+{
+	return (ResourceTexture*)Get(handle, Resource::Type::TEXTURE);
+}
+
+ResourceMesh* ModuleResources::GetMesh(unsigned handle) const
+{
+	return (ResourceMesh*)Get(handle, Resource::Type::MESH);
+}
+
+ResourceAnimation* ModuleResources::GetAnimation(unsigned handle) const
+{
+	return (ResourceAnimation*)Get(handle, Resource::Type::ANIMATION);
+}
+
+unsigned ModuleResources::UnloadUnused()
+{
+	unsigned unloaded = 0;
+	for (unsigned i = 0; i < slots.size(); ++i)
+	{
+		if (slots[i].resource != nullptr && slots[i].resource->references == 0)
+		{
+			Unload(i);
+			++unloaded;
+		}
+	}
+
+	return unloaded;
+}
+
+void ModuleResources::GetResources(std::vector<const Resource*>& resources) const
+{
+	for (SlotList::const_iterator it = slots.begin(); it != slots.end(); ++it)
+		if (it->resource != nullptr)
+			resources.push_back(it->resource);
+}
+
+void ModuleResources::GetMemory(unsigned long long& cpu_memory, unsigned long long& gpu_memory) const
+{
+	cpu_memory = 0;
+	gpu_memory = 0;
+	for (SlotList::const_iterator it = slots.begin(); it != slots.end(); ++it)
+	{
+		if (it->resource != nullptr)
+		{
+			cpu_memory += it->resource->GetCPUMemory();
+			gpu_memory += it->resource->GetGPUMemory();
+		}
+	}
+}
+
+Resource* ModuleResources::Get(unsigned handle, Resource::Type type) const
+{
+	unsigned slot = FindSlot(handle);
+	if (slot == INVALID_RESOURCE_SLOT || slots[slot].resource->GetType() != type)
+		return nullptr;
+
+	return slots[slot].resource;
+}
+
+unsigned ModuleResources::FindSlot(unsigned handle) const
+{
+	unsigned slot = handle & RESOURCE_HANDLE_INDEX_MASK;
+	unsigned generation = handle >> RESOURCE_HANDLE_INDEX_BITS;
+
+	if (handle == INVALID_RESOURCE_HANDLE || slot >= slots.size() || slots[slot].resource == nullptr || slots[slot].generation != generation)
+		return INVALID_RESOURCE_SLOT;
+
+	return slot;
+}
+
+void ModuleResources::Unload(unsigned slot)
+{
+	Resource* resource = slots[slot].resource;
+	KeyMap::iterator it = keys.find(GetKey(resource->GetType(), resource->GetSource(), resource->GetSettings()));
+	if (it != keys.end() && (it->second & RESOURCE_HANDLE_INDEX_MASK) == slot)
+		keys.erase(it);
+	for (std::vector<std::string>::const_iterator alias = slots[slot].aliases.begin(); alias != slots[slot].aliases.end(); ++alias)
+	{
+		it = keys.find(*alias);
+		if (it != keys.end() && (it->second & RESOURCE_HANDLE_INDEX_MASK) == slot)
+			keys.erase(it);
+	}
+	slots[slot].aliases.clear();
+	RELEASE(slots[slot].resource);
+
+	//Handles to the unloaded resource go stale instead of reaching whatever reuses the slot
+	slots[slot].generation = (slots[slot].generation + 1) & RESOURCE_HANDLE_INDEX_MASK;
+	if (slots[slot].generation == 0)
+		slots[slot].generation = 1;
+	holes.push_back(slot);
+}
+
+std::string ModuleResources::GetKey(Resource::Type type, const std::string& source, const std::string& settings)
+{
+	return std::to_string(type) + ":" + source + "|" + settings;
+}
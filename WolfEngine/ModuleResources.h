@@ -0,0 +1,82 @@
+#ifndef MODULERESOURCES_H
+#define MODULERESOURCES_H
+
+#include "Module.h"
+#include "Resource.h"
+#include <map>
+#include <vector>
+#include <string>
+
+#define MODULE_RESOURCES "ModuleResources"
+#define RESOURCES_SECTION "Config.Modules.Resources"
+
+// Resource handles pack the slot index in the low bits and the slot generation in the high bits
+#define RESOURCE_HANDLE_INDEX_BITS 16
+#define RESOURCE_HANDLE_INDEX_MASK 0xFFFF
+#define INVALID_RESOURCE_HANDLE 0
+#define INVALID_RESOURCE_SLOT 0xFFFFFFFF
+#define RESOURCES_RESERVE 1024
+
+class ResourceTexture;
+class ResourceMesh;
+class ResourceAnimation;
+
+class ModuleResources : public Module
+{
+	struct Slot
+	{
+		Resource* resource = nullptr;
+		unsigned generation = 1;
+		//Keys of AddAlias, removed with the resource
+		std::vector<std::string> aliases;
+	};
+
+	typedef std::vector<Slot> SlotList;
+	typedef std::vector<unsigned> HoleList;
+	typedef std::map<std::string, unsigned> KeyMap;
+
+public:
+	ModuleResources();
+	~ModuleResources();
+
+	bool Init();
+	update_status PostUpdate(float dt);
+	bool CleanUp();
+
+	//Adds a reference to the resource loaded from the source with the same settings, INVALID_RESOURCE_HANDLE if there is none
+	unsigned Find(Resource::Type type, const std::string& source, const std::string& settings);
+	//Takes ownership of the resource, the returned handle holds its first reference
+	unsigned Add(Resource* resource);
+	//Another source Find returns the resource for, like a texture with the same content under another name
+	void AddAlias(unsigned handle, const std::string& source);
+	void AddReference(unsigned handle);
+	void Release(unsigned handle);
+
+	//Null if the handle is stale or belongs to another type of resource
+	ResourceTexture* GetTexture(unsigned handle) const;
+	ResourceMesh* GetMesh(unsigned handle) const;
+	ResourceAnimation* GetAnimation(unsigned handle) const;
+
+	//Deletes every resource without references now instead of after the unload delay
+	unsigned UnloadUnused();
+
+	void GetResources(std::vector<const Resource*>& resources) const;
+	void GetMemory(unsigned long long& cpu_memory, unsigned long long& gpu_memory) const;
+
+private:
+	Resource* Get(unsigned handle, Resource::Type type) const;
+	unsigned FindSlot(unsigned handle) const;
+	void Unload(unsigned slot);
+
+	static std::string GetKey(Resource::Type type, const std::string& source, const std::string& settings);
+
+public:
+	unsigned UNLOAD_DELAY_FRAMES = 120;
+
+private:
+	SlotList slots;
+	HoleList holes;
+	KeyMap keys;
+};
+
+#endif // !MODULERESOURCES_H
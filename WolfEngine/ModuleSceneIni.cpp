@@ -10,7 +10,6 @@
 #include "ModuleProgramShaders.h"
 #include "GameObject.h"
 #include "PanelInterface.h"
-#include "MyQuadTree.h"
 #include "Billboard.h"
 #include "ComponentParticleSystem.h"
 #include "ComponentRigidBody.h"
@@ -38,6 +37,7 @@ bool ModuleSceneIni::Start()
 	App->level->AddCamera();
 
 	GameObject* city = App->level->ImportScene("Resources/Models/street/", "Street.obj");
+	city->SetStatic(true);
 	city->LoadRigidBody(Collider::Type::MESH, ComponentRigidBody::MotionType::STATIC);
 
 	App->animations->Load("ArmyPilot_Idle", "Resources/Models/ArmyPilot/Animations/ArmyPilot_Idle.fbx");
@@ -8,7 +8,6 @@
 #include <string>
 
 class GameObject;
-class MyQuadTree;
 
 class ModuleSceneIni : public Module
 {
@@ -22,7 +21,6 @@ public:
 
 private:
 	std::vector<GameObject*> empty_game_objects;
-	MyQuadTree* quad_tree = nullptr;
 	GameObject* grass = nullptr;
 	GameObject* rain = nullptr;
 	GameObject* image = nullptr;
@@ -2,7 +2,14 @@
 #include "Application.h"
 #include "ModuleTextures.h"
 #include "ModuleRender.h"
+#include "ModuleResources.h"
+#include "ResourceTexture.h"
 #include "OpenGL.h"
+#include "FileSystem.h"
+#include "TextureFile.h"
+#include "TextureStreamer.h"
+#include "JsonHandler.h"
+#include <string>
 #include <IL\il.h>
 #include <IL\ilu.h>
 #include <IL\ilut.h>
@@ -28,56 +35,238 @@ bool ModuleTextures::Init()
 	iluInit();
 	ilutRenderer(ILUT_OPENGL);
 
+	if (App->parser->LoadObject(TEXTURES_SECTION))
+	{
+		STREAMING = App->parser->GetBool("Streaming");
+		STREAMING_BUDGET_MB = App->parser->GetInt("StreamingBudgetMB");
+		STREAMING_BASE_SIZE = App->parser->GetInt("StreamingBaseSize");
+		STREAMING_MAX_LOADS = App->parser->GetInt("StreamingMaxLoads");
+		STREAMING_MIP_BIAS = App->parser->GetFloat("StreamingMipBias");
+		App->parser->UnloadObject();
+	}
+
+	if (STREAMING)
+	{
+		streamer = new TextureStreamer((unsigned long long)STREAMING_BUDGET_MB * 1024 * 1024, STREAMING_BASE_SIZE, STREAMING_MAX_LOADS);
+		streamer->mip_bias = STREAMING_MIP_BIAS;
+	}
+
 	LoadCheckers();
-	texture_debug = LoadTexture(aiString("Resources/Lenna.png"));
+	texture_debug_resource = LoadTexture(aiString("Resources/Lenna.png"));
+	texture_debug = GetTextureId(texture_debug_resource);
 
 	return ret;
 }
 
+update_status ModuleTextures::PreUpdate(float dt)
+{
+	BROFILER_CATEGORY("ModuleTextures-PreUpdate", Profiler::Color::Blue);
+
+	//Draws of the last frame said which mips they need
+	if (streamer != nullptr)
+		streamer->Update();
+
+	return UPDATE_CONTINUE;
+}
+
 bool ModuleTextures::CleanUp()
 {
 	APPLOG("Freeing textures and Image library");
 
+	//Streamed textures keep the mips they have until ModuleResources deletes them
+	RELEASE(streamer);
+
+	//Loaded textures belong to ModuleResources, only the ones created here are deleted
+	App->resources->Release(texture_debug_resource);
+	glDeleteTextures(1, &texture_checkers);
+
 	ilShutDown();
 
 	return true;
 }
 
-unsigned int ModuleTextures::LoadTexture(const aiString& path)
+unsigned int ModuleTextures::LoadTexture(const aiString& path, bool streamed)
 {
-	unsigned int ret = 0;
+	streamed = streamed && streamer != nullptr;
+	const char* settings = streamed ? TEXTURE_STREAMED_SETTINGS : TEXTURE_SETTINGS;
+	unsigned int ret = App->resources->Find(Resource::Type::TEXTURE, path.data, settings);
+	if (ret != INVALID_RESOURCE_HANDLE)
+	{
+		APPLOG("Texture key %s already loaded with value %d", path.data, GetTextureId(ret));
+		return ret;
+	}
+
+	//Cooked textures with the same content share one upload whatever their names
+	VirtualFile cooked;
+	const TextureFileHeader* header = ReadCookedTexture(path, cooked);
+	std::string content_source;
+	if (header != nullptr)
+	{
+		char content_hash[20];
+		sprintf(content_hash, "#%016llx", header->content_hash);
+		content_source = content_hash;
 
-	TextureList::iterator it = textures.find(path);
+		ret = App->resources->Find(Resource::Type::TEXTURE, content_source, settings);
+		if (ret != INVALID_RESOURCE_HANDLE)
+		{
+			App->resources->AddAlias(ret, path.data);
+			APPLOG("Texture key %s has the same content as %s", path.data, App->resources->GetTexture(ret)->GetSource().c_str());
+			return ret;
+		}
+	}
+
+	ResourceTexture* texture = new ResourceTexture(path.data, settings);
+	if (header != nullptr)
+	{
+		//Streamed ones start with the coarse mips, the streamer reads the rest from the cooked file again
+		unsigned first_mip = 0;
+		if (streamed)
+		{
+			texture->cooked = *header;
+			texture->cooked_path = std::string(path.data) + TEXTURE_FILE_EXTENSION;
+			first_mip = streamer->GetBaseMip(*header);
+		}
 
-	if (it == textures.end())
+		UploadCookedTexture(*header, first_mip, cooked.GetData(), 0, *texture);
+		APPLOG("Load cooked texture key %s with value %d from mip %u", path.data, texture->id, first_mip);
+	}
+	else
 	{
+		//DevIL can't tell a tga from its content, the type comes from the extension
+		VirtualFile file;
 		ILuint imageId = ilGenImage();
 		ilBindImage(imageId);
-		ilLoadImage(path.data);
+		if (App->files->ReadFile(path.data, file))
+			ilLoadL(ilTypeFromExt(path.data), file.GetData(), (ILuint)file.GetSize());
+		else
+			APPLOG("Texture %s not found", path.data);
 
 		ILenum Error = ilGetError();
 		if (Error != IL_NO_ERROR)
 			APPLOG("Error %d: %s", Error, iluErrorString(Error));
 
-		ret = ilutGLBindTexImage();
-
-		textures[path] = ret;
+		texture->width = ilGetInteger(IL_IMAGE_WIDTH);
+		texture->height = ilGetInteger(IL_IMAGE_HEIGHT);
+		texture->gpu_size = (unsigned long long)texture->width * texture->height * ilGetInteger(IL_IMAGE_BYTES_PER_PIXEL);
+		texture->id = ilutGLBindTexImage();
 
 		Error = ilGetError();
 		if (Error != IL_NO_ERROR)
 			APPLOG("Error %d: %s", Error, iluErrorString(Error));
 
-		APPLOG("Load texture key %s with value %d", path.data, ret);
+		APPLOG("Load texture key %s with value %d", path.data, texture->id);
 
 		ilDeleteImage(imageId);
 	}
+
+	//Failed loads are kept too, the path isn't decoded again while something references it
+	ret = App->resources->Add(texture);
+	if (!content_source.empty())
+		App->resources->AddAlias(ret, content_source);
+	//Decoded sources have no mips on disk to stream
+	if (streamed && header != nullptr)
+		streamer->Add(ret, *texture);
+
+	return ret;
+}
+
+unsigned int ModuleTextures::GetTextureId(unsigned int handle) const
+{
+	const ResourceTexture* texture = App->resources->GetTexture(handle);
+	return texture != nullptr ? texture->id : 0;
+}
+
+void ModuleTextures::UseTexture(unsigned int handle, float screen_size) const
+{
+	ResourceTexture* texture = App->resources->GetTexture(handle);
+	if (texture != nullptr && texture->streamed)
+		streamer->Use(*texture, screen_size);
+}
+
+const TextureFileHeader* ModuleTextures::ReadCookedTexture(const aiString& path, VirtualFile& cooked) const
+{
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	if (!App->files->GetFileStamp(path.data, source_size, source_time))
+		return nullptr;
+
+	std::string cooked_path = std::string(path.data) + TEXTURE_FILE_EXTENSION;
+	if (!App->files->ReadFile(cooked_path.c_str(), cooked))
+		return nullptr;
+
+	const TextureFileHeader* header = ValidateTextureFile(cooked.GetData(), cooked.GetSize(), source_size, source_time);
+	if (header == nullptr)
+		return nullptr;
+
+	//Without the extensions the source is decoded instead
+	if ((header->format == TEXTURE_FORMAT_BC1 || header->format == TEXTURE_FORMAT_BC3) && !GLEW_EXT_texture_compression_s3tc)
+		return nullptr;
+	if (header->format == TEXTURE_FORMAT_BC5 && !GLEW_VERSION_3_0 && !GLEW_ARB_texture_compression_rgtc)
+		return nullptr;
+
+	return header;
+}
+
+void ModuleTextures::UploadCookedTexture(const TextureFileHeader& header, unsigned first_mip, const char* data, unsigned long long data_offset, ResourceTexture& texture) const
+{
+	texture.width = header.width;
+	texture.height = header.height;
+	texture.gpu_size = 0;
+
+	//Same wrap and filter ilutGLBindTexImage leaves, plus the cooked mips. Streamed textures keep their
+	//name when the mips change, batches and HLOD atlases hold it.
+	GLint previous_levels = 0;
+	if (texture.id == 0)
+	{
+		glGenTextures(1, &texture.id);
+		glBindTexture(GL_TEXTURE_2D, texture.id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
 	else
 	{
-		ret = textures[path];
-		APPLOG("Texture key %s already loaded with value %d", path.data, ret);
+		glBindTexture(GL_TEXTURE_2D, texture.id);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &previous_levels);
+		++previous_levels;
 	}
 
-	return ret;
+	unsigned num_levels = header.num_mips - first_mip;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, num_levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (unsigned i = 0; i < num_levels; ++i)
+	{
+		const TextureFileMip& mip = header.mips[first_mip + i];
+		const char* mip_data = data + (mip.offset - data_offset);
+		switch (header.format)
+		{
+		case TEXTURE_FORMAT_RGB8:
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGB, mip.width, mip.height, 0, GL_RGB, GL_UNSIGNED_BYTE, mip_data);
+			break;
+		case TEXTURE_FORMAT_RGBA8:
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip_data);
+			break;
+		case TEXTURE_FORMAT_BC1:
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, mip.width, mip.height, 0, mip.size, mip_data);
+			break;
+		case TEXTURE_FORMAT_BC3:
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, mip.width, mip.height, 0, mip.size, mip_data);
+			break;
+		case TEXTURE_FORMAT_BC5:
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RG_RGTC2, mip.width, mip.height, 0, mip.size, mip_data);
+			break;
+		}
+		texture.gpu_size += mip.size;
+	}
+
+	//Levels left from a longer chain would still hold memory
+	for (GLint i = num_levels; i < previous_levels; ++i)
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void ModuleTextures::LoadCheckers()
@@ -3,30 +3,45 @@
 
 #include "Module.h"
 #include <assimp/types.h>
-#include <map>
 
 #define MODULE_TEXTURES "ModuleTextures"
+#define TEXTURES_SECTION "Config.Modules.Textures"
+//Sampler state every loaded texture gets, part of the resource key
+#define TEXTURE_SETTINGS "repeat,linear"
+#define TEXTURE_STREAMED_SETTINGS "repeat,linear,streamed"
+
+class ResourceTexture;
+class VirtualFile;
+class TextureStreamer;
+struct TextureFileHeader;
 
 class ModuleTextures : public Module
 {
-	struct LessString
-	{
-		bool operator()(const aiString& left, const aiString& right) const
-		{
-			return ::strcmp(left.data, right.data) < 0;
-		}
-	};
-
 public:
 	ModuleTextures();
 	~ModuleTextures();
 	
 	bool Init();
+	update_status PreUpdate(float dt);
 	bool CleanUp();
 
-	unsigned int LoadTexture(const aiString& path);
+	//Handle to the texture resource with one more reference, loaded only if no one has it or a cooked texture with the same content.
+	//Streamed ones start with their base mips and get finer ones as UseTexture asks for them.
+	unsigned int LoadTexture(const aiString& path, bool streamed = false);
+	unsigned int GetTextureId(unsigned int handle) const;
+	//Size in pixels the texture is drawn at this frame, the streamer keeps the mips it needs
+	void UseTexture(unsigned int handle, float screen_size) const;
+
+	//Uploads the cooked mips from first_mip on as the GL texture levels, creating it if it has no id yet.
+	//Data holds the cooked file from data_offset on, or is null with the pixel buffer holding it bound.
+	void UploadCookedTexture(const TextureFileHeader& header, unsigned first_mip, const char* data, unsigned long long data_offset, ResourceTexture& texture) const;
+
+	//Null if streaming is disabled
+	TextureStreamer* GetStreamer() const { return streamer; }
 
 private:
+	//Cooked file for this version of the source in a format the driver takes, null if there is none
+	const TextureFileHeader* ReadCookedTexture(const aiString& path, VirtualFile& cooked) const;
 	void LoadCheckers();
 
 public:
@@ -34,8 +49,14 @@ public:
 	unsigned int texture_debug;
 
 private:
-	typedef std::map<aiString, unsigned int, LessString> TextureList;
-	TextureList textures;
+	unsigned int texture_debug_resource = 0;
+	TextureStreamer* streamer = nullptr;
+
+	bool STREAMING = true;
+	unsigned STREAMING_BUDGET_MB = 256;
+	unsigned STREAMING_BASE_SIZE = 64;
+	unsigned STREAMING_MAX_LOADS = 4;
+	float STREAMING_MIP_BIAS = 0.0f;
 };
 
 
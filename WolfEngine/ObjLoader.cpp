@@ -0,0 +1,631 @@
+#include "ObjLoader.h"
+#include "Globals.h"
+#include "Application.h"
+#include "FileSystem.h"
+#include "JobSystem.h"
+#include "MeshSimplifier.h"
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <climits>
+
+//Corner attribute the face doesn't give
+#define OBJ_NO_INDEX -1
+//Index 0 or one that resolves before the first element, rejected when the meshes are built
+#define OBJ_BAD_INDEX INT_MAX
+//Same name assimp gives faces before the first group
+#define OBJ_DEFAULT_GROUP "defaultobject"
+#define OBJ_NO_VERTEX 0xFFFFFFFF
+
+struct ObjCorner
+{
+	int position = OBJ_NO_INDEX;
+	int tex_coord = OBJ_NO_INDEX;
+	int normal = OBJ_NO_INDEX;
+
+	bool operator==(const ObjCorner& other) const { return position == other.position && tex_coord == other.tex_coord && normal == other.normal; }
+};
+
+static unsigned HashCorner(const ObjCorner& corner)
+{
+	unsigned hash = ((unsigned)corner.position * 73856093u) ^ ((unsigned)corner.tex_coord * 19349663u) ^ ((unsigned)corner.normal * 83492791u);
+	hash = (hash ^ (hash >> 16)) * 0x45d9f3bu;
+	return hash ^ (hash >> 16);
+}
+
+//Group or material switch, applies from the triangle on
+struct ObjStateChange
+{
+	unsigned triangle = 0;
+	bool is_material = false;
+	std::string name;
+};
+
+struct ObjChunk
+{
+	const char* begin = nullptr;
+	const char* end = nullptr;
+
+	std::vector<float3> positions;
+	std::vector<float3> normals;
+	std::vector<float2> tex_coords;
+	//Three per triangle, faces with more corners are split in fans
+	std::vector<ObjCorner> corners;
+	//Negative indices count back from the chunk elements, 3 * corner + attribute of the ones to move once the chunks before are known
+	std::vector<unsigned> relative;
+	std::vector<ObjStateChange> changes;
+	std::vector<std::string> libraries;
+
+	unsigned first_position = 0;
+	unsigned first_normal = 0;
+	unsigned first_tex_coord = 0;
+};
+
+//Triangles of one chunk going to one mesh
+struct ObjSegment
+{
+	unsigned chunk;
+	unsigned first_triangle;
+	unsigned last_triangle;
+};
+
+static const double powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static void SkipBlanks(const char*& text, const char* end)
+{
+	while (text < end && IsBlank(*text))
+		++text;
+}
+
+//Rest of the line without the blanks around it, names and file names can have spaces
+static std::string ParseName(const char* text, const char* end)
+{
+	SkipBlanks(text, end);
+	while (end > text && IsBlank(end[-1]))
+		--end;
+	return std::string(text, end);
+}
+
+//Sign, digits, fraction and exponent. Up to 19 significant digits are exact, which is more than a float holds.
+static float ParseFloat(const char*& text, const char* end)
+{
+	SkipBlanks(text, end);
+
+	bool negative = false;
+	if (text < end && (*text == '-' || *text == '+'))
+		negative = *text++ == '-';
+
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	for (; text < end && IsDigit(*text); ++text)
+	{
+		if (mantissa < 1000000000000000000ull)
+			mantissa = mantissa * 10 + (*text - '0');
+		else
+			++exponent;
+	}
+
+	if (text < end && *text == '.')
+	{
+		for (++text; text < end && IsDigit(*text); ++text)
+		{
+			if (mantissa < 1000000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*text - '0');
+				--exponent;
+			}
+		}
+	}
+
+	if (text < end && (*text == 'e' || *text == 'E'))
+	{
+		++text;
+		bool negative_exponent = false;
+		if (text < end && (*text == '-' || *text == '+'))
+			negative_exponent = *text++ == '-';
+
+		int value = 0;
+		for (; text < end && IsDigit(*text); ++text)
+			value = MIN(value * 10 + (*text - '0'), 1000);
+		exponent += negative_exponent ? -value : value;
+	}
+
+	double result = (double)mantissa;
+	if (exponent < 0)
+		result = exponent >= -22 ? result / powers_of_ten[-exponent] : result * pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 22 ? result * powers_of_ten[exponent] : result * pow(10.0, exponent);
+
+	return (float)(negative ? -result : result);
+}
+
+static bool ParseInt(const char*& text, const char* end, int& value)
+{
+	bool negative = false;
+	if (text < end && (*text == '-' || *text == '+'))
+		negative = *text++ == '-';
+
+	if (text == end || !IsDigit(*text))
+		return false;
+
+	value = 0;
+	for (; text < end && IsDigit(*text); ++text)
+		value = MIN(value * 10 + (*text - '0'), 100000000);
+	if (negative)
+		value = -value;
+
+	return true;
+}
+
+//1 based index or negative from the last element, to a 0 based index into the file or the chunk elements
+static int ResolveIndex(int index, unsigned num_elements, bool& relative)
+{
+	relative = index < 0;
+	if (index > 0)
+		return index - 1;
+	if (index < 0)
+		return (int)num_elements + index;
+	return OBJ_BAD_INDEX;
+}
+
+static void ParseFace(const char* text, const char* end, ObjChunk& chunk)
+{
+	ObjCorner first;
+	ObjCorner previous;
+	unsigned num_corners = 0;
+	unsigned relative[2];
+
+	while (true)
+	{
+		SkipBlanks(text, end);
+		if (text == end)
+			break;
+
+		//v, v/vt, v//vn or v/vt/vn
+		ObjCorner corner;
+		unsigned corner_relative = 0;
+		int* attributes[3] = { &corner.position, &corner.tex_coord, &corner.normal };
+		unsigned num_elements[3] = { (unsigned)chunk.positions.size(), (unsigned)chunk.tex_coords.size(), (unsigned)chunk.normals.size() };
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			int index = 0;
+			if (ParseInt(text, end, index))
+			{
+				bool is_relative = false;
+				*attributes[i] = ResolveIndex(index, num_elements[i], is_relative);
+				if (is_relative)
+					corner_relative |= 1 << i;
+			}
+
+			if (text == end || *text != '/')
+				break;
+			++text;
+		}
+
+		//Anything else on the line isn't a corner
+		if (text < end && !IsBlank(*text))
+			break;
+
+		if (num_corners == 0)
+		{
+			first = corner;
+			relative[0] = corner_relative;
+		}
+		else if (num_corners >= 2)
+		{
+			unsigned base = chunk.corners.size();
+			chunk.corners.push_back(first);
+			chunk.corners.push_back(previous);
+			chunk.corners.push_back(corner);
+
+			unsigned triangle_relative[3] = { relative[0], relative[1], corner_relative };
+			for (unsigned i = 0; i < 3; ++i)
+				for (unsigned j = 0; j < 3; ++j)
+					if (triangle_relative[i] & (1 << j))
+						chunk.relative.push_back(3 * (base + i) + j);
+		}
+
+		previous = corner;
+		relative[1] = corner_relative;
+		++num_corners;
+	}
+}
+
+static void ParseChunk(ObjChunk& chunk)
+{
+	const char* line = chunk.begin;
+	while (line < chunk.end)
+	{
+		const char* line_end = (const char*)memchr(line, '\n', chunk.end - line);
+		if (line_end == nullptr)
+			line_end = chunk.end;
+
+		const char* text = line;
+		SkipBlanks(text, line_end);
+		unsigned length = line_end - text;
+
+		if (length >= 2 && text[0] == 'v' && IsBlank(text[1]))
+		{
+			text += 2;
+			float3 position;
+			position.x = ParseFloat(text, line_end);
+			position.y = ParseFloat(text, line_end);
+			position.z = ParseFloat(text, line_end);
+			chunk.positions.push_back(position);
+		}
+		else if (length >= 3 && text[0] == 'v' && text[1] == 't' && IsBlank(text[2]))
+		{
+			text += 3;
+			float2 tex_coord;
+			tex_coord.x = ParseFloat(text, line_end);
+			tex_coord.y = ParseFloat(text, line_end);
+			chunk.tex_coords.push_back(tex_coord);
+		}
+		else if (length >= 3 && text[0] == 'v' && text[1] == 'n' && IsBlank(text[2]))
+		{
+			text += 3;
+			float3 normal;
+			normal.x = ParseFloat(text, line_end);
+			normal.y = ParseFloat(text, line_end);
+			normal.z = ParseFloat(text, line_end);
+			chunk.normals.push_back(normal);
+		}
+		else if (length >= 2 && text[0] == 'f' && IsBlank(text[1]))
+		{
+			ParseFace(text + 2, line_end, chunk);
+		}
+		else if (length >= 1 && (text[0] == 'g' || text[0] == 'o') && (length == 1 || IsBlank(text[1])))
+		{
+			ObjStateChange change;
+			change.triangle = chunk.corners.size() / 3;
+			change.name = ParseName(text + 1, line_end);
+			chunk.changes.push_back(change);
+		}
+		else if (length >= 7 && strncmp(text, "usemtl", 6) == 0 && IsBlank(text[6]))
+		{
+			ObjStateChange change;
+			change.triangle = chunk.corners.size() / 3;
+			change.is_material = true;
+			change.name = ParseName(text + 7, line_end);
+			chunk.changes.push_back(change);
+		}
+		else if (length >= 7 && strncmp(text, "mtllib", 6) == 0 && IsBlank(text[6]))
+		{
+			chunk.libraries.push_back(ParseName(text + 7, line_end));
+		}
+
+		line = line_end + 1;
+	}
+}
+
+static void ParseColor(const char* text, const char* end, float* color)
+{
+	for (unsigned i = 0; i < 3; ++i)
+		color[i] = ParseFloat(text, end);
+}
+
+static void LoadMtl(const char* path, std::vector<ObjMaterial>& materials)
+{
+	VirtualFile file;
+	if (!App->files->ReadFile(path, file))
+	{
+		APPLOG("Material library %s not found", path);
+		return;
+	}
+
+	ObjMaterial* material = nullptr;
+	const char* line = file.GetData();
+	const char* end = line + file.GetSize();
+	while (line < end)
+	{
+		const char* line_end = (const char*)memchr(line, '\n', end - line);
+		if (line_end == nullptr)
+			line_end = end;
+
+		const char* text = line;
+		SkipBlanks(text, line_end);
+		const char* key = text;
+		while (text < line_end && !IsBlank(*text))
+			++text;
+		std::string name(key, text);
+
+		if (name == "newmtl")
+		{
+			materials.push_back(ObjMaterial());
+			material = &materials.back();
+			material->name = ParseName(text, line_end);
+		}
+		else if (material != nullptr)
+		{
+			if (name == "Ka")
+				ParseColor(text, line_end, material->ambient);
+			else if (name == "Kd")
+				ParseColor(text, line_end, material->diffuse);
+			else if (name == "Ks")
+				ParseColor(text, line_end, material->specular);
+			else if (name == "Ns")
+				material->shininess = ParseFloat(text, line_end);
+			else if (name == "map_Kd")
+				material->diffuse_map = ParseName(text, line_end);
+		}
+
+		line = line_end + 1;
+	}
+}
+
+//Averages the face normals around every position, as assimp does for meshes without them
+static void GenerateSmoothNormals(ObjMesh& mesh)
+{
+	unsigned num_vertices = mesh.positions.size();
+	std::vector<unsigned> remap(num_vertices);
+	unsigned num_positions = WeldPositions(&mesh.positions[0], num_vertices, &remap[0]);
+
+	std::vector<float3> position_normals(num_positions, float3::zero);
+	for (unsigned i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const float3& a = mesh.positions[mesh.indices[i]];
+		const float3& b = mesh.positions[mesh.indices[i + 1]];
+		const float3& c = mesh.positions[mesh.indices[i + 2]];
+		float3 normal = (b - a).Cross(c - a);
+		if (normal.LengthSq() <= 0.0f)
+			continue;
+		normal.Normalize();
+
+		for (unsigned j = 0; j < 3; ++j)
+			position_normals[remap[mesh.indices[i + j]]] += normal;
+	}
+
+	mesh.normals.resize(num_vertices);
+	for (unsigned i = 0; i < num_vertices; ++i)
+	{
+		float3 normal = position_normals[remap[i]];
+		mesh.normals[i] = normal.LengthSq() > 0.0f ? normal.Normalized() : float3::unitY;
+	}
+}
+
+//Welds the corners of the mesh segments into vertices, false if one references an element that doesn't exist
+static bool BuildMesh(const std::vector<ObjChunk>& chunks, const std::vector<ObjSegment>& segments,
+	const std::vector<float3>& positions, const std::vector<float3>& normals, const std::vector<float2>& tex_coords, ObjMesh& mesh)
+{
+	unsigned num_corners = 0;
+	bool has_normals = false;
+	bool has_tex_coords = false;
+	for (std::vector<ObjSegment>::const_iterator it = segments.begin(); it != segments.end(); ++it)
+	{
+		const ObjChunk& chunk = chunks[it->chunk];
+		num_corners += 3 * (it->last_triangle - it->first_triangle);
+		for (unsigned i = 3 * it->first_triangle; i < 3 * it->last_triangle; ++i)
+		{
+			has_normals = has_normals || chunk.corners[i].normal != OBJ_NO_INDEX;
+			has_tex_coords = has_tex_coords || chunk.corners[i].tex_coord != OBJ_NO_INDEX;
+		}
+	}
+
+	//Open addressing with linear probing, at least twice the slots as corners keeps the probes short
+	unsigned num_slots = 1;
+	while (num_slots < 2 * num_corners)
+		num_slots <<= 1;
+	std::vector<unsigned> slots(num_slots, OBJ_NO_VERTEX);
+	std::vector<ObjCorner> vertex_corners;
+	vertex_corners.reserve(num_corners);
+	mesh.indices.reserve(num_corners);
+
+	for (std::vector<ObjSegment>::const_iterator it = segments.begin(); it != segments.end(); ++it)
+	{
+		const ObjChunk& chunk = chunks[it->chunk];
+		for (unsigned i = 3 * it->first_triangle; i < 3 * it->last_triangle; ++i)
+		{
+			const ObjCorner& corner = chunk.corners[i];
+			unsigned slot = HashCorner(corner) & (num_slots - 1);
+			while (slots[slot] != OBJ_NO_VERTEX && !(vertex_corners[slots[slot]] == corner))
+				slot = (slot + 1) & (num_slots - 1);
+
+			if (slots[slot] != OBJ_NO_VERTEX)
+			{
+				mesh.indices.push_back(slots[slot]);
+				continue;
+			}
+
+			slots[slot] = vertex_corners.size();
+			mesh.indices.push_back(slots[slot]);
+			vertex_corners.push_back(corner);
+
+			if (corner.position < 0 || corner.position >= (int)positions.size())
+				return false;
+			mesh.positions.push_back(positions[corner.position]);
+
+			//Corners without an attribute the rest of the mesh has get zero
+			if (has_normals)
+			{
+				if (corner.normal >= (int)normals.size() || corner.normal < OBJ_NO_INDEX)
+					return false;
+				mesh.normals.push_back(corner.normal == OBJ_NO_INDEX ? float3::zero : normals[corner.normal]);
+			}
+
+			if (has_tex_coords)
+			{
+				if (corner.tex_coord >= (int)tex_coords.size() || corner.tex_coord < OBJ_NO_INDEX)
+					return false;
+				mesh.tex_coords.push_back(corner.tex_coord == OBJ_NO_INDEX ? float2::zero : tex_coords[corner.tex_coord]);
+			}
+		}
+	}
+
+	if (!has_normals && !mesh.positions.empty())
+		GenerateSmoothNormals(mesh);
+
+	return true;
+}
+
+bool LoadObj(const char* path, ObjScene& scene, JobSystem* jobs)
+{
+	VirtualFile file;
+	if (!App->files->ReadFile(path, file))
+		return false;
+
+	//Chunks end after a line break so every line is parsed by a single job
+	std::vector<ObjChunk> chunks;
+	const char* data = file.GetData();
+	const char* end = data + file.GetSize();
+	for (const char* begin = data; begin < end;)
+	{
+		const char* chunk_end = begin + MIN((unsigned long long)OBJ_CHUNK_SIZE, (unsigned long long)(end - begin));
+		const char* line_end = chunk_end < end ? (const char*)memchr(chunk_end, '\n', end - chunk_end) : nullptr;
+		chunk_end = line_end != nullptr ? line_end + 1 : end;
+
+		chunks.push_back(ObjChunk());
+		chunks.back().begin = begin;
+		chunks.back().end = chunk_end;
+		begin = chunk_end;
+	}
+
+	RangeJob parse_job = [&chunks](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+			ParseChunk(chunks[i]);
+	};
+	if (jobs != nullptr)
+		jobs->ParallelFor(chunks.size(), 1, parse_job);
+	else
+		parse_job(0, chunks.size());
+
+	unsigned num_positions = 0;
+	unsigned num_normals = 0;
+	unsigned num_tex_coords = 0;
+	for (std::vector<ObjChunk>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+	{
+		it->first_position = num_positions;
+		it->first_normal = num_normals;
+		it->first_tex_coord = num_tex_coords;
+		num_positions += it->positions.size();
+		num_normals += it->normals.size();
+		num_tex_coords += it->tex_coords.size();
+	}
+
+	//Elements go to the file arrays and relative indices are moved by the elements of the chunks before
+	std::vector<float3> positions(num_positions);
+	std::vector<float3> normals(num_normals);
+	std::vector<float2> tex_coords(num_tex_coords);
+	RangeJob merge_job = [&](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+		{
+			ObjChunk& chunk = chunks[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.first_position);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.first_normal);
+			std::copy(chunk.tex_coords.begin(), chunk.tex_coords.end(), tex_coords.begin() + chunk.first_tex_coord);
+
+			unsigned offsets[3] = { chunk.first_position, chunk.first_tex_coord, chunk.first_normal };
+			for (std::vector<unsigned>::const_iterator it = chunk.relative.begin(); it != chunk.relative.end(); ++it)
+			{
+				ObjCorner& corner = chunk.corners[*it / 3];
+				int* attributes[3] = { &corner.position, &corner.tex_coord, &corner.normal };
+				int& index = *attributes[*it % 3];
+				index += offsets[*it % 3];
+				if (index < 0)
+					index = OBJ_BAD_INDEX;
+			}
+		}
+	};
+	if (jobs != nullptr)
+		jobs->ParallelFor(chunks.size(), 1, merge_job);
+	else
+		merge_job(0, chunks.size());
+
+	//Group and material carry over between chunks, every run of triangles goes to the mesh of its pair
+	std::vector<std::string> libraries;
+	std::map<std::pair<std::string, std::string>, unsigned> mesh_ids;
+	std::vector<std::string> mesh_materials;
+	std::vector<std::vector<ObjSegment> > mesh_segments;
+	std::string group = OBJ_DEFAULT_GROUP;
+	std::string material;
+	for (unsigned i = 0; i < chunks.size(); ++i)
+	{
+		const ObjChunk& chunk = chunks[i];
+		libraries.insert(libraries.end(), chunk.libraries.begin(), chunk.libraries.end());
+
+		unsigned first_triangle = 0;
+		for (unsigned j = 0; j <= chunk.changes.size(); ++j)
+		{
+			unsigned last_triangle = j < chunk.changes.size() ? chunk.changes[j].triangle : chunk.corners.size() / 3;
+			if (last_triangle > first_triangle)
+			{
+				std::pair<std::map<std::pair<std::string, std::string>, unsigned>::iterator, bool> result =
+					mesh_ids.insert(std::make_pair(std::make_pair(group, material), (unsigned)scene.meshes.size()));
+				if (result.second)
+				{
+					scene.meshes.push_back(ObjMesh());
+					scene.meshes.back().name = group;
+					mesh_materials.push_back(material);
+					mesh_segments.push_back(std::vector<ObjSegment>());
+				}
+
+				ObjSegment segment = { i, first_triangle, last_triangle };
+				mesh_segments[result.first->second].push_back(segment);
+				first_triangle = last_triangle;
+			}
+
+			if (j < chunk.changes.size())
+			{
+				const ObjStateChange& change = chunk.changes[j];
+				if (change.is_material)
+					material = change.name;
+				else
+					group = change.name.empty() ? OBJ_DEFAULT_GROUP : change.name;
+			}
+		}
+	}
+
+	std::vector<unsigned char> valid(scene.meshes.size(), 1);
+	RangeJob build_job = [&](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+			valid[i] = BuildMesh(chunks, mesh_segments[i], positions, normals, tex_coords, scene.meshes[i]);
+	};
+	if (jobs != nullptr)
+		jobs->ParallelFor(scene.meshes.size(), 1, build_job);
+	else
+		build_job(0, scene.meshes.size());
+
+	for (unsigned i = 0; i < scene.meshes.size(); ++i)
+	{
+		if (!valid[i])
+		{
+			APPLOG("Error loading %s: a face of %s references a missing element", path, scene.meshes[i].name.c_str());
+			scene.meshes.clear();
+			return false;
+		}
+	}
+
+	std::string folder(path);
+	folder = folder.substr(0, folder.find_last_of("/\\") + 1);
+	for (unsigned i = 0; i < libraries.size(); ++i)
+		if (std::find(libraries.begin(), libraries.begin() + i, libraries[i]) == libraries.begin() + i)
+			LoadMtl((folder + libraries[i]).c_str(), scene.materials);
+
+	for (unsigned i = 0; i < scene.meshes.size(); ++i)
+	{
+		for (unsigned j = 0; j < scene.materials.size(); ++j)
+		{
+			if (scene.materials[j].name == mesh_materials[i])
+			{
+				scene.meshes[i].material = j;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
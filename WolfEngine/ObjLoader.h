@@ -0,0 +1,49 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include "Math.h"
+#include <vector>
+#include <string>
+
+//Bytes of the file each parse job takes, rounded up to the next line end
+#define OBJ_CHUNK_SIZE (256 * 1024)
+#define OBJ_NO_MATERIAL -1
+
+class JobSystem;
+
+struct ObjMaterial
+{
+	std::string name;
+	float ambient[3] = { 1.0f, 1.0f, 1.0f };
+	float diffuse[3] = { 1.0f, 1.0f, 1.0f };
+	float specular[3] = { 1.0f, 1.0f, 1.0f };
+	float shininess = 0.0f;
+	//Relative to the folder of the obj file, empty if the material has no diffuse texture
+	std::string diffuse_map;
+};
+
+//Faces of one group using one material, triangulated and with a vertex per distinct position/uv/normal corner
+struct ObjMesh
+{
+	std::string name;
+	int material = OBJ_NO_MATERIAL;
+	std::vector<float3> positions;
+	//Empty when no face of the mesh has them, generated smooth when the file has no normals
+	std::vector<float3> normals;
+	std::vector<float2> tex_coords;
+	std::vector<unsigned> indices;
+};
+
+struct ObjScene
+{
+	//In order of first use in the file, a group with several materials gives consecutive meshes with its name
+	std::vector<ObjMesh> meshes;
+	std::vector<ObjMaterial> materials;
+};
+
+//Reads the obj file and the mtl files it references without assimp. The file is read in place and parsed in
+//chunks on the job system, the meshes are welded in parallel. jobs can be null to do everything here.
+//Returns false if the file can't be opened or a face references an element that doesn't exist.
+bool LoadObj(const char* path, ObjScene& scene, JobSystem* jobs);
+
+#endif // !OBJLOADER_H
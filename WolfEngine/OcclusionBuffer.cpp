@@ -0,0 +1,284 @@
+#include "OcclusionBuffer.h"
+#include "Globals.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+#define OCCLUSION_FAR_DEPTH 1.0f
+
+OcclusionBuffer::OcclusionBuffer(unsigned width, unsigned height)
+{
+	//Whole tiles keep the SIMD rows and the hierarchy aligned
+	tiles_x = MAX((width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE, 1u);
+	tiles_y = MAX((height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE, 1u);
+	this->width = tiles_x * OCCLUSION_TILE_SIZE;
+	this->height = tiles_y * OCCLUSION_TILE_SIZE;
+
+	depth = new float[this->width * this->height];
+	tile_depth = new float[tiles_x * tiles_y];
+
+	Begin(float4x4::identity);
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+	RELEASE_ARRAY(depth);
+	RELEASE_ARRAY(tile_depth);
+}
+
+void OcclusionBuffer::Begin(const float4x4& view_projection)
+{
+	this->view_projection = view_projection;
+	triangles.clear();
+
+	std::fill(depth, depth + width * height, OCCLUSION_FAR_DEPTH);
+	std::fill(tile_depth, tile_depth + tiles_x * tiles_y, OCCLUSION_FAR_DEPTH);
+}
+
+void OcclusionBuffer::AddOccluder(const float4x4& transform, const float3* vertices, const unsigned* indices, unsigned num_indices)
+{
+	float4x4 model_view_projection = view_projection * transform;
+
+	clip_vertices.clear();
+	for (unsigned i = 0; i < num_indices; ++i)
+		clip_vertices.push_back(model_view_projection * float4(vertices[indices[i]], 1.0f));
+
+	for (unsigned i = 0; i + 2 < num_indices; i += 3)
+	{
+		float x[3], y[3], z[3];
+		bool clipped = false;
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			const float4& clip = clip_vertices[i + j];
+
+			//Triangles crossing the near plane are dropped, an occluder can only hide less
+			if (clip.w <= 0.0f || clip.z < -clip.w)
+			{
+				clipped = true;
+				break;
+			}
+
+			x[j] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+			y[j] = (clip.y / clip.w * 0.5f + 0.5f) * height;
+			z[j] = clip.z / clip.w;
+		}
+
+		if (clipped || (z[0] > OCCLUSION_FAR_DEPTH && z[1] > OCCLUSION_FAR_DEPTH && z[2] > OCCLUSION_FAR_DEPTH))
+			continue;
+
+		//Occluders are drawn two sided, clockwise triangles are flipped
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area < 0.0f)
+		{
+			Swap(x[1], x[2]);
+			Swap(y[1], y[2]);
+			Swap(z[1], z[2]);
+			area = -area;
+		}
+
+		if (area < 1e-6f)
+			continue;
+
+		OcclusionTriangle triangle;
+		triangle.min_x = MAX((int)floorf(MIN(MIN(x[0], x[1]), x[2])), 0);
+		triangle.max_x = MIN((int)ceilf(MAX(MAX(x[0], x[1]), x[2])), (int)width - 1);
+		triangle.min_y = MAX((int)floorf(MIN(MIN(y[0], y[1]), y[2])), 0);
+		triangle.max_y = MIN((int)ceilf(MAX(MAX(y[0], y[1]), y[2])), (int)height - 1);
+		if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+			continue;
+
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			unsigned k = (j + 1) % 3;
+			triangle.edge_a[j] = y[j] - y[k];
+			triangle.edge_b[j] = x[k] - x[j];
+			triangle.edge_c[j] = -(triangle.edge_a[j] * x[j] + triangle.edge_b[j] * y[j]);
+		}
+
+		triangle.depth_a = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		triangle.depth_b = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+		triangle.depth_c = z[0] - triangle.depth_a * x[0] - triangle.depth_b * y[0];
+
+		triangles.push_back(triangle);
+	}
+}
+
+void OcclusionBuffer::Rasterize(JobSystem* jobs)
+{
+	if (triangles.empty())
+		return;
+
+	//Bands own whole tile rows so no two jobs write the same pixels
+	RangeJob job = [this](unsigned first, unsigned last) { RasterizeBand(first, last); };
+	if (jobs != nullptr)
+		jobs->ParallelFor(tiles_y, OCCLUSION_BAND_TILES, job);
+	else
+		job(0, tiles_y);
+}
+
+void OcclusionBuffer::RasterizeBand(unsigned first_tile_row, unsigned last_tile_row)
+{
+	int first_row = first_tile_row * OCCLUSION_TILE_SIZE;
+	int last_row = last_tile_row * OCCLUSION_TILE_SIZE;
+
+	for (std::vector<OcclusionTriangle>::const_iterator it = triangles.begin(); it != triangles.end(); ++it)
+		if (it->max_y >= first_row && it->min_y < last_row)
+			RasterizeTriangle(*it, MAX(it->min_y, first_row), MIN(it->max_y + 1, last_row));
+
+	UpdateTiles(first_tile_row, last_tile_row);
+}
+
+#ifdef OCCLUSION_SSE
+
+void OcclusionBuffer::RasterizeTriangle(const OcclusionTriangle& triangle, int first_row, int last_row)
+{
+	//Four pixel centers per step, rows start aligned to four pixels
+	int first_x = triangle.min_x & ~3;
+	__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 zero = _mm_setzero_ps();
+
+	__m128 edge_a0 = _mm_set1_ps(triangle.edge_a[0]);
+	__m128 edge_a1 = _mm_set1_ps(triangle.edge_a[1]);
+	__m128 edge_a2 = _mm_set1_ps(triangle.edge_a[2]);
+	__m128 depth_a = _mm_set1_ps(triangle.depth_a);
+
+	for (int y = first_row; y < last_row; ++y)
+	{
+		float center_y = y + 0.5f;
+		__m128 row_edge0 = _mm_set1_ps(triangle.edge_b[0] * center_y + triangle.edge_c[0]);
+		__m128 row_edge1 = _mm_set1_ps(triangle.edge_b[1] * center_y + triangle.edge_c[1]);
+		__m128 row_edge2 = _mm_set1_ps(triangle.edge_b[2] * center_y + triangle.edge_c[2]);
+		__m128 row_depth = _mm_set1_ps(triangle.depth_b * center_y + triangle.depth_c);
+
+		float* row = depth + y * width;
+		for (int x = first_x; x <= triangle.max_x; x += 4)
+		{
+			__m128 center_x = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a0, center_x), row_edge0), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a1, center_x), row_edge1), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a2, center_x), row_edge2), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 old_depth = _mm_loadu_ps(row + x);
+			__m128 new_depth = _mm_min_ps(old_depth, _mm_add_ps(_mm_mul_ps(depth_a, center_x), row_depth));
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+		}
+	}
+}
+
+#else
+
+void OcclusionBuffer::RasterizeTriangle(const OcclusionTriangle& triangle, int first_row, int last_row)
+{
+	for (int y = first_row; y < last_row; ++y)
+	{
+		float center_y = y + 0.5f;
+		float* row = depth + y * width;
+		for (int x = triangle.min_x; x <= triangle.max_x; ++x)
+		{
+			float center_x = x + 0.5f;
+			bool inside = true;
+			for (unsigned i = 0; i < 3 && inside; ++i)
+				inside = triangle.edge_a[i] * center_x + triangle.edge_b[i] * center_y + triangle.edge_c[i] >= 0.0f;
+
+			if (inside)
+				row[x] = MIN(row[x], triangle.depth_a * center_x + triangle.depth_b * center_y + triangle.depth_c);
+		}
+	}
+}
+
+#endif
+
+void OcclusionBuffer::UpdateTiles(unsigned first_tile_row, unsigned last_tile_row)
+{
+	for (unsigned tile_y = first_tile_row; tile_y < last_tile_row; ++tile_y)
+	{
+		for (unsigned tile_x = 0; tile_x < tiles_x; ++tile_x)
+		{
+			float farthest = -FLOAT_INF;
+			for (unsigned y = tile_y * OCCLUSION_TILE_SIZE; y < (tile_y + 1) * OCCLUSION_TILE_SIZE; ++y)
+			{
+				const float* row = depth + y * width + tile_x * OCCLUSION_TILE_SIZE;
+				for (unsigned x = 0; x < OCCLUSION_TILE_SIZE; ++x)
+					farthest = MAX(farthest, row[x]);
+			}
+
+			tile_depth[tile_y * tiles_x + tile_x] = farthest;
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const AABB& box) const
+{
+	if (!box.IsFinite())
+		return true;
+
+	float3 corners[8];
+	box.GetCornerPoints(corners);
+
+	float min_x = FLOAT_INF, min_y = FLOAT_INF, min_z = FLOAT_INF;
+	float max_x = -FLOAT_INF, max_y = -FLOAT_INF;
+	for (unsigned i = 0; i < 8; ++i)
+	{
+		float4 clip = view_projection * float4(corners[i], 1.0f);
+
+		//Boxes reaching the camera can't be tested on screen
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+			return true;
+
+		float inverse_w = 1.0f / clip.w;
+		min_x = MIN(min_x, clip.x * inverse_w);
+		max_x = MAX(max_x, clip.x * inverse_w);
+		min_y = MIN(min_y, clip.y * inverse_w);
+		max_y = MAX(max_y, clip.y * inverse_w);
+		min_z = MIN(min_z, clip.z * inverse_w);
+	}
+
+	int first_x = MAX((int)floorf((min_x * 0.5f + 0.5f) * width), 0);
+	int last_x = MIN((int)floorf((max_x * 0.5f + 0.5f) * width), (int)width - 1);
+	int first_y = MAX((int)floorf((min_y * 0.5f + 0.5f) * height), 0);
+	int last_y = MIN((int)floorf((max_y * 0.5f + 0.5f) * height), (int)height - 1);
+
+	//Off screen, frustum culling decides
+	if (first_x > last_x || first_y > last_y)
+		return true;
+
+	for (int tile_y = first_y / OCCLUSION_TILE_SIZE; tile_y <= last_y / OCCLUSION_TILE_SIZE; ++tile_y)
+	{
+		for (int tile_x = first_x / OCCLUSION_TILE_SIZE; tile_x <= last_x / OCCLUSION_TILE_SIZE; ++tile_x)
+		{
+			//Every pixel of the tile is closer than the box
+			if (tile_depth[tile_y * tiles_x + tile_x] < min_z)
+				continue;
+
+			int tile_first_x = MAX(first_x, tile_x * OCCLUSION_TILE_SIZE);
+			int tile_last_x = MIN(last_x, tile_x * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+			int tile_first_y = MAX(first_y, tile_y * OCCLUSION_TILE_SIZE);
+			int tile_last_y = MIN(last_y, tile_y * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+			for (int y = tile_first_y; y <= tile_last_y; ++y)
+				for (int x = tile_first_x; x <= tile_last_x; ++x)
+					if (depth[y * width + x] >= min_z)
+						return true;
+		}
+	}
+
+	return false;
+}
+
+void OcclusionBuffer::GetDebugImage(unsigned char* pixels, float near_plane, float far_plane) const
+{
+	//Normalized device depth is packed near 1, shown as logarithmic view distance instead
+	float scale = 1.0f / logf(far_plane / near_plane);
+	for (unsigned i = 0; i < width * height; ++i)
+	{
+		float distance = 2.0f * near_plane * far_plane / (far_plane + near_plane - depth[i] * (far_plane - near_plane));
+		float value = MIN(MAX(logf(distance / near_plane) * scale, 0.0f), 1.0f);
+		pixels[i] = (unsigned char)(255.0f * value);
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include "Math.h"
+#include <vector>
+
+//Tiles keep the farthest depth of their pixels for early rejection
+#define OCCLUSION_TILE_SIZE 8
+//Tile rows rasterised by each job
+#define OCCLUSION_BAND_TILES 2
+
+class JobSystem;
+
+//Screen space triangle ready for rasterisation
+struct OcclusionTriangle
+{
+	//Edge functions a * x + b * y + c, positive inside
+	float edge_a[3];
+	float edge_b[3];
+	float edge_c[3];
+
+	//Depth plane z = a * x + b * y + c
+	float depth_a = 0.0f;
+	float depth_b = 0.0f;
+	float depth_c = 0.0f;
+
+	int min_x = 0;
+	int max_x = 0;
+	int min_y = 0;
+	int max_y = 0;
+};
+
+//Low resolution depth buffer filled with occluder meshes on the CPU. Keeps the closest normalized
+//device depth per pixel, boxes behind every pixel they cover are occluded.
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer(unsigned width, unsigned height);
+	~OcclusionBuffer();
+
+	void Begin(const float4x4& view_projection);
+	void AddOccluder(const float4x4& transform, const float3* vertices, const unsigned* indices, unsigned num_indices);
+	//Rasterises the occluders in bands of tile rows on the job workers
+	void Rasterize(JobSystem* jobs);
+
+	bool IsVisible(const AABB& box) const;
+
+	//Depth as 8 bit grey, bottom row first
+	void GetDebugImage(unsigned char* pixels, float near_plane, float far_plane) const;
+
+	unsigned GetWidth() const { return width; }
+	unsigned GetHeight() const { return height; }
+	unsigned GetNumTriangles() const { return triangles.size(); }
+
+private:
+	void RasterizeBand(unsigned first_row, unsigned last_row);
+	void RasterizeTriangle(const OcclusionTriangle& triangle, int first_row, int last_row);
+	void UpdateTiles(unsigned first_tile_row, unsigned last_tile_row);
+
+private:
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned tiles_x = 0;
+	unsigned tiles_y = 0;
+
+	float4x4 view_projection = float4x4::identity;
+
+	float* depth = nullptr;
+	float* tile_depth = nullptr;
+
+	std::vector<OcclusionTriangle> triangles;
+	std::vector<float4> clip_vertices;
+};
+
+#endif // !OCCLUSIONBUFFER_H
\ No newline at end of file
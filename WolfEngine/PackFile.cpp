@@ -0,0 +1,210 @@
+#include "PackFile.h"
+#include "Compression.h"
+#include "MeshFile.h"
+#include "Globals.h"
+#include <cstring>
+#include <climits>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+std::string NormalizePackPath(const char* path)
+{
+	std::vector<std::string> parts;
+	std::string part;
+	for (const char* c = path;; ++c)
+	{
+		if (*c != '\0' && *c != '/' && *c != '\\')
+		{
+			part.push_back(*c >= 'A' && *c <= 'Z' ? *c - 'A' + 'a' : *c);
+			continue;
+		}
+
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (!part.empty() && part != ".")
+			parts.push_back(part);
+		part.clear();
+
+		if (*c == '\0')
+			break;
+	}
+
+	std::string result;
+	for (std::vector<std::string>::const_iterator it = parts.begin(); it != parts.end(); ++it)
+	{
+		if (!result.empty())
+			result.push_back('/');
+		result += *it;
+	}
+
+	return result;
+}
+
+unsigned long long HashPackPath(const std::string& normalized_path)
+{
+	unsigned long long hash = FNV_OFFSET_BASIS;
+	for (std::string::const_iterator it = normalized_path.begin(); it != normalized_path.end(); ++it)
+	{
+		hash ^= (unsigned char)*it;
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+bool PackFile::Open(const char* path)
+{
+	Close();
+	if (!file.Open(path))
+		return false;
+
+	const PackFileHeader* file_header = (const PackFileHeader*)file.GetData();
+	if (file.GetSize() < sizeof(PackFileHeader) || file_header->magic != PACK_FILE_MAGIC || file_header->version != PACK_FILE_VERSION ||
+		file_header->num_slots == 0 || (file_header->num_slots & (file_header->num_slots - 1)) != 0 ||
+		file_header->entries_offset + (unsigned long long)file_header->num_entries * sizeof(PackFileEntry) > file.GetSize() ||
+		file_header->slots_offset + (unsigned long long)file_header->num_slots * sizeof(unsigned) > file.GetSize())
+	{
+		APPLOG("Pack file %s is not valid", path);
+		file.Close();
+		return false;
+	}
+
+	header = file_header;
+	entries = (const PackFileEntry*)(file.GetData() + header->entries_offset);
+	slots = (const unsigned*)(file.GetData() + header->slots_offset);
+
+	return true;
+}
+
+void PackFile::Close()
+{
+	file.Close();
+	header = nullptr;
+	entries = nullptr;
+	slots = nullptr;
+}
+
+const PackFileEntry* PackFile::Find(const char* path) const
+{
+	if (header == nullptr)
+		return nullptr;
+
+	std::string normalized = NormalizePackPath(path);
+	unsigned long long hash = HashPackPath(normalized);
+	unsigned mask = header->num_slots - 1;
+	for (unsigned slot = (unsigned)hash & mask; slots[slot] != PACK_FILE_NONE; slot = (slot + 1) & mask)
+	{
+		const PackFileEntry& entry = entries[slots[slot]];
+		if (entry.hash == hash && normalized == GetName(entry))
+			return &entry;
+	}
+
+	return nullptr;
+}
+
+const char* PackFile::Read(const PackFileEntry& entry, std::vector<char>& buffer) const
+{
+	if ((entry.flags & PACK_ENTRY_STAMP_ONLY) != 0 || entry.offset + entry.stored_size > file.GetSize())
+		return nullptr;
+
+	const char* stored = file.GetData() + entry.offset;
+	if ((entry.flags & PACK_ENTRY_LZ4) == 0)
+		return stored;
+
+	buffer.resize(entry.size);
+	if (entry.size == 0 || !Lz4Decompress(stored, (unsigned)entry.stored_size, &buffer[0], (unsigned)entry.size))
+	{
+		APPLOG("Pack entry %s is damaged", GetName(entry));
+		return nullptr;
+	}
+
+	return &buffer[0];
+}
+
+PackFileWriter::PackFileWriter() : data(sizeof(PackFileHeader), 0)
+{
+}
+
+void PackFileWriter::Add(const std::string& path, const char* entry_data, unsigned long long stored_size, unsigned long long size, bool compressed,
+	unsigned long long source_size, unsigned long long source_time)
+{
+	PackFileEntry entry;
+	entry.flags = compressed ? PACK_ENTRY_LZ4 : 0;
+	entry.offset = (data.size() + PACK_FILE_ALIGNMENT - 1) / PACK_FILE_ALIGNMENT * PACK_FILE_ALIGNMENT;
+	entry.stored_size = stored_size;
+	entry.size = size;
+	entry.source_size = source_size;
+	entry.source_time = source_time;
+
+	//Stored entries start aligned, the cooked files inside are read in place like a mapped file
+	data.resize(entry.offset + stored_size, 0);
+	if (stored_size > 0)
+		memcpy(&data[entry.offset], entry_data, stored_size);
+
+	entries.push_back(entry);
+	names.push_back(NormalizePackPath(path.c_str()));
+}
+
+void PackFileWriter::AddStamp(const std::string& path, unsigned long long source_size, unsigned long long source_time)
+{
+	PackFileEntry entry;
+	entry.flags = PACK_ENTRY_STAMP_ONLY;
+	entry.source_size = source_size;
+	entry.source_time = source_time;
+
+	entries.push_back(entry);
+	names.push_back(NormalizePackPath(path.c_str()));
+}
+
+bool PackFileWriter::Write(const char* path)
+{
+	PackFileHeader header;
+	header.num_entries = entries.size();
+	header.num_slots = 1;
+	while (header.num_slots < 2 * header.num_entries)
+		header.num_slots <<= 1;
+
+	std::vector<unsigned> slots(header.num_slots, PACK_FILE_NONE);
+	for (unsigned i = 0; i < entries.size(); ++i)
+	{
+		entries[i].name = data.size();
+		data.insert(data.end(), names[i].c_str(), names[i].c_str() + names[i].size() + 1);
+		entries[i].hash = HashPackPath(names[i]);
+
+		unsigned slot = (unsigned)entries[i].hash & (header.num_slots - 1);
+		while (slots[slot] != PACK_FILE_NONE)
+		{
+			if (names[slots[slot]] == names[i])
+			{
+				APPLOG("Error writing %s: %s is added twice", path, names[i].c_str());
+				return false;
+			}
+			slot = (slot + 1) & (header.num_slots - 1);
+		}
+		slots[slot] = i;
+	}
+
+	header.entries_offset = (data.size() + PACK_FILE_ALIGNMENT - 1) / PACK_FILE_ALIGNMENT * PACK_FILE_ALIGNMENT;
+	data.resize(header.entries_offset + entries.size() * sizeof(PackFileEntry), 0);
+	if (!entries.empty())
+		memcpy(&data[header.entries_offset], &entries[0], entries.size() * sizeof(PackFileEntry));
+
+	header.slots_offset = data.size();
+	data.insert(data.end(), (const char*)&slots[0], (const char*)&slots[0] + slots.size() * sizeof(unsigned));
+	memcpy(&data[0], &header, sizeof(header));
+
+	return WriteCookedFile(path, data);
+}
+
+bool CompressPackData(const char* data, unsigned long long size, std::vector<char>& compressed)
+{
+	if (size == 0 || size > UINT_MAX - UINT_MAX / 255 - 16)
+		return false;
+
+	compressed.resize(Lz4CompressBound((unsigned)size));
+	unsigned compressed_size = Lz4Compress(data, (unsigned)size, &compressed[0]);
+	compressed.resize(compressed_size);
+
+	return compressed_size <= size * PACK_MAX_COMPRESSED_RATIO;
+}
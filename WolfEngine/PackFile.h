@@ -0,0 +1,95 @@
+#ifndef PACKFILE_H
+#define PACKFILE_H
+
+#include "MappedFile.h"
+#include <vector>
+#include <string>
+
+#define PACK_FILE_EXTENSION ".wpak"
+#define PACK_FILE_MAGIC 0x4B415057
+#define PACK_FILE_VERSION 1
+#define PACK_FILE_ALIGNMENT 16
+#define PACK_FILE_NONE 0xFFFFFFFF
+//Compressed entries are kept only if they are at most this fraction of the original
+#define PACK_MAX_COMPRESSED_RATIO 0.9f
+
+//Entry data is an LZ4 block
+#define PACK_ENTRY_LZ4 1
+//Only the stamp of the file is packed, for sources whose cooked files are in the pack
+#define PACK_ENTRY_STAMP_ONLY 2
+
+//Single file archive of the game folder: entry table, path hash table and the entry data, stored or
+//compressed. Every offset counts from the start of the file.
+struct PackFileHeader
+{
+	unsigned magic = PACK_FILE_MAGIC;
+	unsigned version = PACK_FILE_VERSION;
+	unsigned num_entries = 0;
+	//Power of two, entry index or PACK_FILE_NONE, probed linearly from the path hash
+	unsigned num_slots = 0;
+	unsigned long long entries_offset = 0;
+	unsigned long long slots_offset = 0;
+};
+
+struct PackFileEntry
+{
+	unsigned long long hash = 0;
+	//Normalized path, see NormalizePackPath
+	unsigned long long name = 0;
+	unsigned flags = 0;
+	unsigned padding = 0;
+	unsigned long long offset = 0;
+	unsigned long long stored_size = 0;
+	unsigned long long size = 0;
+	//Stamp of the file when it was packed, cooked files inside the pack are validated against it
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+};
+
+//Lower case with '/' separators and without "." or ".." parts, the key of every entry
+std::string NormalizePackPath(const char* path);
+unsigned long long HashPackPath(const std::string& normalized_path);
+
+//Read only view of a mapped pack, safe to use from several threads
+class PackFile
+{
+public:
+	bool Open(const char* path);
+	void Close();
+
+	//Null if the pack has no entry for the path
+	const PackFileEntry* Find(const char* path) const;
+	//Stored entries point into the mapping, compressed ones are decompressed into buffer.
+	//Null for stamp only entries or damaged data.
+	const char* Read(const PackFileEntry& entry, std::vector<char>& buffer) const;
+	const char* GetName(const PackFileEntry& entry) const { return file.GetData() + entry.name; }
+	unsigned GetNumEntries() const { return header != nullptr ? header->num_entries : 0; }
+	const PackFileEntry& GetEntry(unsigned index) const { return entries[index]; }
+
+private:
+	MappedFile file;
+	const PackFileHeader* header = nullptr;
+	const PackFileEntry* entries = nullptr;
+	const unsigned* slots = nullptr;
+};
+
+//Entry data is appended as it is added, the tables and the header are written at the end
+struct PackFileWriter
+{
+	PackFileWriter();
+
+	//Data is either the file as is or an LZ4 block of it made with CompressPackData
+	void Add(const std::string& path, const char* data, unsigned long long stored_size, unsigned long long size, bool compressed,
+		unsigned long long source_size, unsigned long long source_time);
+	void AddStamp(const std::string& path, unsigned long long source_size, unsigned long long source_time);
+	bool Write(const char* path);
+
+	std::vector<char> data;
+	std::vector<PackFileEntry> entries;
+	std::vector<std::string> names;
+};
+
+//LZ4 block of the data in compressed, false if it doesn't save enough to be worth decompressing
+bool CompressPackData(const char* data, unsigned long long size, std::vector<char>& compressed);
+
+#endif // !PACKFILE_H
@@ -6,6 +6,12 @@
 #include "ModuleTimeController.h"
 #include "ModuleRender.h"
 #include "ModuleLevel.h"
+#include "ModuleResources.h"
+#include "ModuleTextures.h"
+#include "OcclusionBuffer.h"
+#include "StaticBatcher.h"
+#include "HLODBuilder.h"
+#include "TextureStreamer.h"
 #include "ComponentCamera.h"
 #include "SDL\include\SDL.h"
 #include "Math.h"
@@ -117,7 +123,155 @@ void PanelConfiguration::Draw()
 
 		ImGui::Checkbox("Base plane", &App->renderer->draw_base_plane);
 
-		ImGui::Checkbox("Quadtree structure", &App->level->draw_quadtree_structure);
+		ImGui::Checkbox("Octree structure", &App->level->draw_octree_structure);
+		ImGui::Checkbox("AABB tree structure", &App->level->draw_aabb_tree_structure);
+
+		if (ImGui::Button("Benchmark octree 10k"))
+			App->level->BenchmarkOctree(10000);
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark octree 100k"))
+			App->level->BenchmarkOctree(100000);
+
+		if (ImGui::Button("Benchmark street import"))
+			App->level->BenchmarkImport("Resources/Models/street/", "Street.obj");
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark obj loader"))
+		{
+			App->level->BenchmarkObjLoader("Resources/Models/street/", "Street.obj");
+			App->level->BenchmarkObjLoader("Resources/Models/Batman/", "Batman.obj");
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Occlusion Culling"))
+	{
+		ImGui::Checkbox("Enabled", &App->level->OCCLUSION_CULLING);
+		const OcclusionBuffer* occlusion_buffer = App->level->GetOcclusionBuffer();
+		ImGui::Text("Occluders: %u (%u triangles)", App->level->GetNumOccluders(), occlusion_buffer->GetNumTriangles());
+		ImGui::Text("Build time: %u us", App->level->GetOcclusionTime());
+
+		ImGui::Checkbox("Show occlusion buffer", &App->level->draw_occlusion_buffer);
+		if (App->level->draw_occlusion_buffer && App->level->GetOcclusionDebugTexture() != 0)
+		{
+			//Flipped vertically, the buffer is stored bottom row first
+			float width = ImGui::GetContentRegionAvailWidth();
+			float height = width * occlusion_buffer->GetHeight() / occlusion_buffer->GetWidth();
+			ImGui::Image((ImTextureID)App->level->GetOcclusionDebugTexture(), ImVec2(width, height), ImVec2(0, 1), ImVec2(1, 0));
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Static Batching"))
+	{
+		const StaticBatcher* static_batcher = App->level->GetStaticBatcher();
+		ImGui::Text("Batches: %u (%u drawn)", static_batcher->GetNumBatches(), static_batcher->GetNumDrawnBatches());
+		ImGui::Text("Batched objects: %u", static_batcher->GetNumBatchedObjects());
+		ImGui::Checkbox("Draw batch bounds", &App->level->draw_static_batches);
+
+		if (ImGui::Button("Bake"))
+			App->level->BakeStaticBatches();
+		ImGui::SameLine();
+		if (ImGui::Button("Clear"))
+			App->level->ClearStaticBatches();
+	}
+
+	if (ImGui::CollapsingHeader("Mesh LOD"))
+	{
+		ImGui::Checkbox("Enabled##MeshLod", &App->level->MESH_LOD);
+		ImGui::SliderFloat("Pixel error", &App->level->MESH_LOD_PIXEL_ERROR, 0.1f, 10.0f);
+		ImGui::SliderFloat("Hysteresis", &App->level->MESH_LOD_HYSTERESIS, 0.0f, 0.9f);
+
+		const unsigned* histogram = App->level->GetMeshLodHistogram();
+		for (unsigned i = 0; i < MESH_LOD_MAX_LEVELS; ++i)
+			ImGui::Text("Level %u: %u meshes", i, histogram[i]);
+		ImGui::Text("Triangles drawn: %u", App->level->GetDrawnTriangles());
+	}
+
+	if (ImGui::CollapsingHeader("Meshlet Culling"))
+	{
+		ImGui::Checkbox("Enabled##Meshlets", &App->level->MESHLET_CULLING);
+		ImGui::Text("Triangles before culling: %u", App->level->GetDrawnTriangles());
+		ImGui::Text("Triangles submitted: %u", App->level->GetSubmittedTriangles());
+	}
+
+	if (ImGui::CollapsingHeader("HLOD"))
+	{
+		ImGui::Checkbox("Enabled##HLOD", &App->level->HLOD);
+		ImGui::SliderFloat("Proxy distance", &App->level->HLOD_DISTANCE, 100.0f, 5000.0f);
+
+		const HLODBuilder* hlod_builder = App->level->GetHLODBuilder();
+		ImGui::Text("Clusters: %u (%u objects)", hlod_builder->GetNumClusters(), hlod_builder->GetNumClusteredObjects());
+		ImGui::Text("Proxies: %u (%u drawn)", hlod_builder->GetNumProxied(), hlod_builder->GetNumDrawnProxies());
+		ImGui::Checkbox("Draw cluster bounds", &App->level->draw_hlod_clusters);
+
+		if (ImGui::Button("Load##HLOD"))
+			App->level->LoadHLOD();
+		ImGui::SameLine();
+		if (ImGui::Button("Clear##HLOD"))
+			App->level->ClearHLOD();
+	}
+
+	if (ImGui::CollapsingHeader("Texture Streaming"))
+	{
+		TextureStreamer* streamer = App->textures->GetStreamer();
+		if (streamer != nullptr)
+		{
+			int budget = (int)(streamer->budget / (1024 * 1024));
+			if (ImGui::SliderInt("Budget MB", &budget, 16, 2048))
+				streamer->budget = (unsigned long long)budget * 1024 * 1024;
+			ImGui::SliderFloat("Mip bias", &streamer->mip_bias, -2.0f, 4.0f);
+
+			float committed = streamer->GetCommittedMemory() / (1024.0f * 1024.0f);
+			char overlay[32];
+			sprintf_s(overlay, 32, "%.1f / %d MB", committed, budget);
+			ImGui::ProgressBar(committed / budget, ImVec2(-1.0f, 0.0f), overlay);
+			ImGui::Text("Textures: %u, loads in flight: %u, mips dropped: %u", streamer->GetNumTextures(), streamer->GetNumLoads(), streamer->GetNumEvictions());
+		}
+		else
+			ImGui::Text("Disabled in config.json");
+	}
+
+	if (ImGui::CollapsingHeader("Resources"))
+	{
+		unsigned long long cpu_memory = 0;
+		unsigned long long gpu_memory = 0;
+		App->resources->GetMemory(cpu_memory, gpu_memory);
+		ImGui::Text("Memory: %.2f MB CPU, %.2f MB GPU", cpu_memory / (1024.0f * 1024.0f), gpu_memory / (1024.0f * 1024.0f));
+
+		if (ImGui::Button("Unload unused"))
+			App->resources->UnloadUnused();
+		ImGui::SameLine();
+		if (ImGui::Button("Reload street x10"))
+			App->level->BenchmarkReload("Resources/Models/street/", "Street.obj", 10);
+
+		std::vector<const Resource*> resources;
+		App->resources->GetResources(resources);
+		const char* type_names[] = { "Texture", "Mesh", "Animation" };
+
+		ImGui::Columns(5, "Resources");
+		ImGui::Text("Source");
+		ImGui::NextColumn();
+		ImGui::Text("Type");
+		ImGui::NextColumn();
+		ImGui::Text("References");
+		ImGui::NextColumn();
+		ImGui::Text("CPU KB");
+		ImGui::NextColumn();
+		ImGui::Text("GPU KB");
+		ImGui::NextColumn();
+		ImGui::Separator();
+		for (std::vector<const Resource*>::const_iterator it = resources.begin(); it != resources.end(); ++it)
+		{
+			ImGui::Text("%s", (*it)->GetSource().c_str());
+			ImGui::NextColumn();
+			ImGui::Text("%s", type_names[(*it)->GetType()]);
+			ImGui::NextColumn();
+			ImGui::Text("%u", (*it)->references);
+			ImGui::NextColumn();
+			ImGui::Text("%.1f", (*it)->GetCPUMemory() / 1024.0f);
+			ImGui::NextColumn();
+			ImGui::Text("%.1f", (*it)->GetGPUMemory() / 1024.0f);
+			ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
 	}
 
 	if (ImGui::CollapsingHeader("Window"))
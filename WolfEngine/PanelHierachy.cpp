@@ -18,7 +18,8 @@ GameObject* PanelHierachy::DrawInterfaceHierachy()
 	BROFILER_CATEGORY("PanelHierarchy-Draw", Profiler::Color::Azure);
 
 	bool b = true;
-	static GameObject* ret = nullptr;
+	//Starts from the current selection, which picking in the scene may have changed
+	GameObject* ret = App->level->GetSelectedGameObject();
 	id = 0;
 
 	ImGui::SetNextWindowPos(ImVec2(0, 20));
@@ -0,0 +1,40 @@
+#ifndef RESOURCE_H
+#define RESOURCE_H
+
+#include <string>
+
+//Data shared by every component loaded from the same source with the same settings, owned by ModuleResources
+class Resource
+{
+public:
+	enum Type
+	{
+		TEXTURE = 0,
+		MESH,
+		ANIMATION,
+		COUNT
+	};
+
+public:
+	Resource(Type type, const std::string& source, const std::string& settings) : type(type), source(source), settings(settings) {}
+	virtual ~Resource() {}
+
+	Type GetType() const { return type; }
+	const std::string& GetSource() const { return source; }
+	const std::string& GetSettings() const { return settings; }
+
+	virtual unsigned long long GetCPUMemory() const = 0;
+	virtual unsigned long long GetGPUMemory() const = 0;
+
+public:
+	unsigned references = 0;
+	//Frames since the last reference was released, the resource is deleted once it reaches the unload delay
+	unsigned unused_frames = 0;
+
+private:
+	Type type;
+	std::string source;
+	std::string settings;
+};
+
+#endif // !RESOURCE_H
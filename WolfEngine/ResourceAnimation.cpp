@@ -0,0 +1,32 @@
+#include "ResourceAnimation.h"
+#include "ModuleAnimations.h"
+
+ResourceAnimation::ResourceAnimation(const std::string& source, const std::string& settings, Anim* anim) : Resource(Resource::Type::ANIMATION, source, settings), anim(anim)
+{
+}
+
+ResourceAnimation::~ResourceAnimation()
+{
+	for (NodeAnimMap::iterator it = anim->channels.begin(); it != anim->channels.end(); ++it)
+	{
+		RELEASE_ARRAY(it->second->positions);
+		RELEASE_ARRAY(it->second->rotations);
+		RELEASE(it->second);
+	}
+	anim->channels.clear();
+	RELEASE(anim);
+}
+
+unsigned long long ResourceAnimation::GetCPUMemory() const
+{
+	unsigned long long size = sizeof(ResourceAnimation) + sizeof(Anim);
+	for (NodeAnimMap::const_iterator it = anim->channels.begin(); it != anim->channels.end(); ++it)
+		size += sizeof(NodeAnim) + it->second->num_positions * sizeof(float3) + it->second->num_rotations * sizeof(Quat);
+
+	return size;
+}
+
+unsigned long long ResourceAnimation::GetGPUMemory() const
+{
+	return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef RESOURCEANIMATION_H
+#define RESOURCEANIMATION_H
+
+#include "Resource.h"
+
+struct Anim;
+
+class ResourceAnimation : public Resource
+{
+public:
+	ResourceAnimation(const std::string& source, const std::string& settings, Anim* anim);
+	~ResourceAnimation();
+
+	unsigned long long GetCPUMemory() const;
+	unsigned long long GetGPUMemory() const;
+
+public:
+	Anim* anim = nullptr;
+};
+
+#endif // !RESOURCEANIMATION_H
@@ -0,0 +1,61 @@
+#include "ResourceMesh.h"
+#include "Globals.h"
+#include "OpenGL.h"
+#include "VertexQuantization.h"
+
+ResourceMesh::ResourceMesh(const std::string& source, const std::string& settings) : Resource(Resource::Type::MESH, source, settings)
+{
+}
+
+ResourceMesh::~ResourceMesh()
+{
+	RELEASE_ARRAY(vertices);
+	RELEASE_ARRAY(normals);
+	RELEASE_ARRAY(tex_coords);
+	RELEASE_ARRAY(indices);
+
+	glDeleteBuffers(1, (GLuint*) &(buffer_id));
+	glDeleteBuffers(1, (GLuint*) &(indices_id));
+	for (unsigned i = 1; i < lods.size(); ++i)
+		glDeleteBuffers(1, (GLuint*) &(lods[i].indices_id));
+}
+
+unsigned long long ResourceMesh::GetCPUMemory() const
+{
+	//Only the copies that survived the upload
+	unsigned long long size = sizeof(ResourceMesh);
+	if (vertices != nullptr)
+		size += (unsigned long long)num_vertices * sizeof(float3);
+	if (normals != nullptr)
+		size += (unsigned long long)num_vertices * sizeof(float3);
+	if (tex_coords != nullptr)
+		size += (unsigned long long)num_vertices * sizeof(float2);
+	if (indices != nullptr)
+		size += (unsigned long long)num_indices * sizeof(unsigned);
+	size += meshlets.size() * sizeof(Meshlet);
+
+	return size;
+}
+
+unsigned long long ResourceMesh::GetGPUMemory() const
+{
+	unsigned long long size = (unsigned long long)num_vertices * GetVertexSize();
+	size += (unsigned long long)num_indices * GetIndexSize();
+	for (unsigned i = 1; i < lods.size(); ++i)
+		size += (unsigned long long)lods[i].num_indices * GetIndexSize();
+
+	return size;
+}
+
+unsigned ResourceMesh::GetVertexSize() const
+{
+	if (quantized)
+		return GetQuantizedVertexSize(has_normals, has_tex_coords);
+
+	return sizeof(float3) + (has_normals ? sizeof(float3) : 0) + (has_tex_coords ? sizeof(float2) : 0);
+}
+
+unsigned ResourceMesh::GetIndexSize() const
+{
+	return short_indices ? sizeof(unsigned short) : sizeof(unsigned);
+}
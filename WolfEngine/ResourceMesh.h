@@ -0,0 +1,52 @@
+#ifndef RESOURCEMESH_H
+#define RESOURCEMESH_H
+
+#include "Resource.h"
+#include "Math.h"
+#include "Meshlet.h"
+#include <vector>
+
+//Index buffer sharing the mesh vertices, error relative to half the bounding box diagonal
+struct MeshLod
+{
+	unsigned indices_id = 0;
+	unsigned num_indices = 0;
+	float error = 0.0f;
+};
+
+//Static geometry and its buffers, meshes that deform keep their own copy
+class ResourceMesh : public Resource
+{
+public:
+	ResourceMesh(const std::string& source, const std::string& settings);
+	~ResourceMesh();
+
+	unsigned long long GetCPUMemory() const;
+	unsigned long long GetGPUMemory() const;
+
+	unsigned GetVertexSize() const;
+	unsigned GetIndexSize() const;
+
+public:
+	unsigned buffer_id = 0;
+	unsigned indices_id = 0;
+	bool quantized = false;
+	float3 position_offset = float3::zero;
+	float3 position_scale = float3::one;
+	bool short_indices = false;
+
+	float3* vertices = nullptr;
+	float3* normals = nullptr;
+	float2* tex_coords = nullptr;
+	unsigned* indices = nullptr;
+	unsigned num_vertices = 0;
+	unsigned num_indices = 0;
+	bool has_normals = false;
+	bool has_tex_coords = false;
+
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	AABB bbox;
+};
+
+#endif // !RESOURCEMESH_H
@@ -0,0 +1,22 @@
+#include "ResourceTexture.h"
+#include "OpenGL.h"
+
+ResourceTexture::ResourceTexture(const std::string& source, const std::string& settings) : Resource(Resource::Type::TEXTURE, source, settings)
+{
+}
+
+ResourceTexture::~ResourceTexture()
+{
+	if (id != 0)
+		glDeleteTextures(1, &id);
+}
+
+unsigned long long ResourceTexture::GetCPUMemory() const
+{
+	return sizeof(ResourceTexture);
+}
+
+unsigned long long ResourceTexture::GetGPUMemory() const
+{
+	return gpu_size;
+}
@@ -0,0 +1,37 @@
+#ifndef RESOURCETEXTURE_H
+#define RESOURCETEXTURE_H
+
+#include "Resource.h"
+#include "TextureFile.h"
+
+class ResourceTexture : public Resource
+{
+public:
+	ResourceTexture(const std::string& source, const std::string& settings);
+	~ResourceTexture();
+
+	unsigned long long GetCPUMemory() const;
+	unsigned long long GetGPUMemory() const;
+
+public:
+	unsigned id = 0;
+	unsigned width = 0;
+	unsigned height = 0;
+	//Bytes of every mip level as uploaded
+	unsigned long long gpu_size = 0;
+
+	//Streamed textures only, see TextureStreamer
+	bool streamed = false;
+	std::string cooked_path;
+	TextureFileHeader cooked;
+	//Mips of the cooked chain at level 0 of the GL texture now, once the load in flight is done and the finest asked for this frame
+	unsigned resident_mip = 0;
+	unsigned target_mip = 0;
+	unsigned wanted_mip = 0;
+	//Coarsest mip, always resident
+	unsigned base_mip = 0;
+	unsigned last_used_frame = 0;
+	bool loading = false;
+};
+
+#endif // !RESOURCETEXTURE_H
@@ -0,0 +1,45 @@
+#include "Skeleton.h"
+#include "GameObject.h"
+#include "Brofiler/include/Brofiler.h"
+
+Skeleton::Skeleton(GameObject* root) : root(root)
+{
+}
+
+Skeleton::~Skeleton()
+{
+}
+
+unsigned Skeleton::AddJoint(GameObject* bone, const float4x4& bind)
+{
+	//Meshes bound to the same bone with the same offset share the palette entry
+	for (unsigned i = 0; i < joints.size(); ++i)
+		if (joints[i].bone == bone && joints[i].bind.Equals(bind))
+			return i;
+
+	SkeletonJoint joint;
+	joint.bone = bone;
+	joint.bind = bind;
+	joints.push_back(joint);
+	palette.push_back(float4x4::identity);
+	dirty = true;
+
+	return joints.size() - 1;
+}
+
+void Skeleton::UpdatePalette()
+{
+	if (!dirty)
+		return;
+
+	BROFILER_CATEGORY("Skeleton-UpdatePalette", Profiler::Color::Aqua);
+
+	float4x4 root_inverse = root->GetLocalTransformMatrix().Inverted();
+
+	for (unsigned i = 0; i < joints.size(); ++i)
+	{
+		palette[i] = root_inverse * joints[i].bone->GetGlobalTransformMatrix() * joints[i].bind;
+	}
+
+	dirty = false;
+}
@@ -0,0 +1,38 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include "Math.h"
+#include <vector>
+
+#define INVALID_JOINT 0xFFFFFFFF
+
+class GameObject;
+
+struct SkeletonJoint
+{
+	GameObject* bone = nullptr;
+	float4x4 bind = float4x4::identity;
+};
+
+class Skeleton
+{
+public:
+	Skeleton(GameObject* root);
+	~Skeleton();
+
+	unsigned AddJoint(GameObject* bone, const float4x4& bind);
+
+	void Invalidate() { dirty = true; }
+	void UpdatePalette();
+
+	unsigned GetNumJoints() const { return joints.size(); }
+	const float4x4* GetPalette() const { return palette.data(); }
+
+private:
+	GameObject* root = nullptr;
+	std::vector<SkeletonJoint> joints;
+	std::vector<float4x4> palette;
+	bool dirty = true;
+};
+
+#endif // !SKELETON_H
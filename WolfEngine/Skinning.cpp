@@ -0,0 +1,146 @@
+#include "Skinning.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define SKINNING_SSE
+#include <xmmintrin.h>
+#endif
+
+void VertexInfluences::Add(unsigned joint, float weight)
+{
+	//Keep the four heaviest influences, replacing the lightest one when full
+	unsigned lightest = 0;
+	for (unsigned i = 1; i < MAX_VERTEX_INFLUENCES; ++i)
+		if (weights[i] < weights[lightest])
+			lightest = i;
+
+	if (weight > weights[lightest])
+	{
+		joints[lightest] = joint;
+		weights[lightest] = weight;
+	}
+}
+
+void VertexInfluences::Normalize()
+{
+	float total = 0.0f;
+	for (unsigned i = 0; i < MAX_VERTEX_INFLUENCES; ++i)
+		total += weights[i];
+
+	if (total > 0.0f)
+	{
+		for (unsigned i = 0; i < MAX_VERTEX_INFLUENCES; ++i)
+			weights[i] /= total;
+	}
+}
+
+#ifdef SKINNING_SSE
+
+//Weighted sum of the first three rows of the influencing matrices
+static inline void BlendRows(const float4x4* matrices, const VertexInfluences& influence, __m128& row0, __m128& row1, __m128& row2)
+{
+	const float* m = matrices[influence.joints[0]].ptr();
+	__m128 w = _mm_set1_ps(influence.weights[0]);
+	row0 = _mm_mul_ps(_mm_loadu_ps(m), w);
+	row1 = _mm_mul_ps(_mm_loadu_ps(m + 4), w);
+	row2 = _mm_mul_ps(_mm_loadu_ps(m + 8), w);
+
+	for (unsigned i = 1; i < MAX_VERTEX_INFLUENCES; ++i)
+	{
+		if (influence.weights[i] <= 0.0f)
+			continue;
+
+		m = matrices[influence.joints[i]].ptr();
+		w = _mm_set1_ps(influence.weights[i]);
+		row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_loadu_ps(m), w));
+		row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+		row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+	}
+}
+
+static inline __m128 Cross(__m128 a, __m128 b)
+{
+	__m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline void StoreFloat3(float3& dst, __m128 value)
+{
+	float result[4];
+	_mm_storeu_ps(result, value);
+	dst.x = result[0];
+	dst.y = result[1];
+	dst.z = result[2];
+}
+
+void SkinVertices(const float4x4* palette, const VertexInfluences* influences,
+	const float3* vertices, const float3* normals, float3* dst_vertices, float3* dst_normals, unsigned first, unsigned last)
+{
+	for (unsigned i = first; i < last; ++i)
+	{
+		//Blend the matrices once and transpose them to columns so the transform needs no horizontal adds
+		__m128 col0, col1, col2, col3 = _mm_setzero_ps();
+		BlendRows(palette, influences[i], col0, col1, col2);
+		_MM_TRANSPOSE4_PS(col0, col1, col2, col3);
+
+		const float3& v = vertices[i];
+		__m128 position = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(v.x)), _mm_mul_ps(col1, _mm_set1_ps(v.y))),
+			_mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(v.z)), col3));
+		StoreFloat3(dst_vertices[i], position);
+
+		if (normals != nullptr)
+		{
+			//The columns of the cofactor matrix, with the sign of the determinant so mirrored joints keep them outwards
+			__m128 cofactor0 = Cross(col1, col2);
+			__m128 cofactor1 = Cross(col2, col0);
+			__m128 cofactor2 = Cross(col0, col1);
+			float determinant[4];
+			_mm_storeu_ps(determinant, _mm_mul_ps(col0, cofactor0));
+			determinant[0] += determinant[1] + determinant[2];
+			float sign = determinant[0] > 0.0f ? 1.0f : (determinant[0] < 0.0f ? -1.0f : 0.0f);
+
+			const float3& n = normals[i];
+			__m128 normal = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(cofactor0, _mm_set1_ps(n.x * sign)), _mm_mul_ps(cofactor1, _mm_set1_ps(n.y * sign))),
+				_mm_mul_ps(cofactor2, _mm_set1_ps(n.z * sign)));
+			StoreFloat3(dst_normals[i], normal);
+		}
+	}
+}
+
+#else
+
+void SkinVertices(const float4x4* palette, const VertexInfluences* influences,
+	const float3* vertices, const float3* normals, float3* dst_vertices, float3* dst_normals, unsigned first, unsigned last)
+{
+	for (unsigned i = first; i < last; ++i)
+	{
+		const VertexInfluences& influence = influences[i];
+		float4x4 skin = palette[influence.joints[0]] * influence.weights[0];
+
+		for (unsigned j = 1; j < MAX_VERTEX_INFLUENCES; ++j)
+		{
+			if (influence.weights[j] > 0.0f)
+				skin += palette[influence.joints[j]] * influence.weights[j];
+		}
+
+		dst_vertices[i] = skin.TransformPos(vertices[i]);
+		if (normals != nullptr)
+		{
+			//The columns of the cofactor matrix, with the sign of the determinant so mirrored joints keep them outwards
+			float3 col0 = skin.Col3(0);
+			float3 col1 = skin.Col3(1);
+			float3 col2 = skin.Col3(2);
+			float3 cofactor0 = col1.Cross(col2);
+			float determinant = col0.Dot(cofactor0);
+			float sign = determinant > 0.0f ? 1.0f : (determinant < 0.0f ? -1.0f : 0.0f);
+
+			const float3& n = normals[i];
+			dst_normals[i] = (cofactor0 * n.x + col2.Cross(col0) * n.y + col0.Cross(col1) * n.z) * sign;
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include "Math.h"
+
+#define MAX_VERTEX_INFLUENCES 4
+
+//Up to four joints per vertex, weights renormalised to add up to one. Unused slots have weight 0.
+struct VertexInfluences
+{
+	unsigned joints[MAX_VERTEX_INFLUENCES] = { 0, 0, 0, 0 };
+	float weights[MAX_VERTEX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	void Add(unsigned joint, float weight);
+	void Normalize();
+};
+
+//Static per vertex attributes of the GPU skinning path
+struct SkinAttributes
+{
+	unsigned char joints[MAX_VERTEX_INFLUENCES] = { 0, 0, 0, 0 };
+	float weights[MAX_VERTEX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+//Skins the vertices in [first, last), writing each one once into dst. normals/dst_normals may be null.
+//Normals take the cofactors of the blended matrix, like the skinning program, and aren't normalized.
+//Touches nothing outside the range, so disjoint ranges can run on different threads.
+void SkinVertices(const float4x4* palette, const VertexInfluences* influences,
+	const float3* vertices, const float3* normals, float3* dst_vertices, float3* dst_normals, unsigned first, unsigned last);
+
+#endif // !SKINNING_H
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "SpatialHashGrid.h"
+#include "Globals.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+SpatialHashGrid::SpatialHashGrid(float cell_size, unsigned num_buckets) : cell_size(cell_size)
+{
+	unsigned buckets = 1;
+	while (buckets < num_buckets)
+		buckets <<= 1;
+
+	bucket_mask = buckets - 1;
+	bucket_start.resize(buckets + 1, 0);
+}
+
+SpatialHashGrid::~SpatialHashGrid()
+{
+}
+
+void SpatialHashGrid::Build(const float3* positions, unsigned count, JobSystem* jobs)
+{
+	this->positions.assign(positions, positions + count);
+	point_buckets.resize(count);
+	sorted_indices.resize(count);
+	sorted_positions.resize(count);
+
+	//Hashing is independent per point and runs on the workers
+	RangeJob hash_job = [this](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; ++i)
+			point_buckets[i] = GetBucket(this->positions[i]);
+	};
+
+	if (jobs != nullptr && count > SPATIAL_HASH_GRAIN)
+		jobs->ParallelFor(count, SPATIAL_HASH_GRAIN, hash_job);
+	else
+		hash_job(0, count);
+
+	//Counting sort: histogram, exclusive prefix sum, then scatter
+	std::fill(bucket_start.begin(), bucket_start.end(), 0);
+	for (unsigned i = 0; i < count; ++i)
+		++bucket_start[point_buckets[i] + 1];
+
+	for (unsigned i = 1; i < bucket_start.size(); ++i)
+		bucket_start[i] += bucket_start[i - 1];
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		unsigned bucket = point_buckets[i];
+		unsigned slot = bucket_start[bucket]++;
+		sorted_indices[slot] = i;
+		sorted_positions[slot] = positions[i];
+	}
+
+	//The scatter advanced every start to the end of its bucket, shift them back
+	for (unsigned i = bucket_start.size() - 1; i > 0; --i)
+		bucket_start[i] = bucket_start[i - 1];
+	bucket_start[0] = 0;
+}
+
+void SpatialHashGrid::Clear()
+{
+	positions.clear();
+	point_buckets.clear();
+	sorted_indices.clear();
+	sorted_positions.clear();
+	std::fill(bucket_start.begin(), bucket_start.end(), 0);
+}
+
+void SpatialHashGrid::QueryAABB(const AABB& box, std::vector<unsigned>& results) const
+{
+	unsigned buckets[SPATIAL_HASH_MAX_QUERY_CELLS];
+	unsigned num_buckets = 0;
+	if (!CollectBuckets(box, buckets, num_buckets))
+	{
+		for (unsigned i = 0; i < positions.size(); ++i)
+			if (box.Contains(positions[i]))
+				results.push_back(i);
+		return;
+	}
+
+	for (unsigned i = 0; i < num_buckets; ++i)
+		for (unsigned slot = bucket_start[buckets[i]]; slot < bucket_start[buckets[i] + 1]; ++slot)
+			if (box.Contains(sorted_positions[slot]))
+				results.push_back(sorted_indices[slot]);
+}
+
+void SpatialHashGrid::QuerySphere(const Sphere& sphere, std::vector<unsigned>& results) const
+{
+	float radius_sq = sphere.r * sphere.r;
+
+	unsigned buckets[SPATIAL_HASH_MAX_QUERY_CELLS];
+	unsigned num_buckets = 0;
+	if (!CollectBuckets(sphere.MinimalEnclosingAABB(), buckets, num_buckets))
+	{
+		for (unsigned i = 0; i < positions.size(); ++i)
+			if (positions[i].DistanceSq(sphere.pos) <= radius_sq)
+				results.push_back(i);
+		return;
+	}
+
+	for (unsigned i = 0; i < num_buckets; ++i)
+		for (unsigned slot = bucket_start[buckets[i]]; slot < bucket_start[buckets[i] + 1]; ++slot)
+			if (sorted_positions[slot].DistanceSq(sphere.pos) <= radius_sq)
+				results.push_back(sorted_indices[slot]);
+}
+
+void SpatialHashGrid::QueryNeighbours(unsigned point, float radius, std::vector<unsigned>& results) const
+{
+	unsigned first_result = results.size();
+	QuerySphere(Sphere(positions[point], radius), results);
+
+	std::vector<unsigned>::iterator it = std::find(results.begin() + first_result, results.end(), point);
+	if (it != results.end())
+		results.erase(it);
+}
+
+void SpatialHashGrid::GetCellRange(const float3& position, unsigned& first, unsigned& last) const
+{
+	unsigned bucket = GetBucket(position);
+	first = bucket_start[bucket];
+	last = bucket_start[bucket + 1];
+}
+
+unsigned SpatialHashGrid::GetBucket(const float3& position) const
+{
+	return GetBucket((int)floorf(position.x / cell_size), (int)floorf(position.y / cell_size), (int)floorf(position.z / cell_size));
+}
+
+unsigned SpatialHashGrid::GetBucket(int x, int y, int z) const
+{
+	return (((unsigned)x * 73856093u) ^ ((unsigned)y * 19349663u) ^ ((unsigned)z * 83492791u)) & bucket_mask;
+}
+
+bool SpatialHashGrid::CollectBuckets(const AABB& box, unsigned* buckets, unsigned& num_buckets) const
+{
+	if (!box.IsFinite())
+		return false;
+
+	int min_x = (int)floorf(box.minPoint.x / cell_size), max_x = (int)floorf(box.maxPoint.x / cell_size);
+	int min_y = (int)floorf(box.minPoint.y / cell_size), max_y = (int)floorf(box.maxPoint.y / cell_size);
+	int min_z = (int)floorf(box.minPoint.z / cell_size), max_z = (int)floorf(box.maxPoint.z / cell_size);
+
+	float num_cells = (max_x - min_x + 1.0f) * (max_y - min_y + 1.0f) * (max_z - min_z + 1.0f);
+	if (num_cells > SPATIAL_HASH_MAX_QUERY_CELLS)
+		return false;
+
+	//Different cells can share a bucket, each bucket must only be visited once
+	num_buckets = 0;
+	for (int z = min_z; z <= max_z; ++z)
+		for (int y = min_y; y <= max_y; ++y)
+			for (int x = min_x; x <= max_x; ++x)
+			{
+				unsigned bucket = GetBucket(x, y, z);
+				if (std::find(buckets, buckets + num_buckets, bucket) == buckets + num_buckets)
+					buckets[num_buckets++] = bucket;
+			}
+
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef SPATIALHASHGRID_H
+#define SPATIALHASHGRID_H
+
+#include "Math.h"
+#include <vector>
+
+//Power of two, cells are folded into this many buckets
+#define SPATIAL_HASH_BUCKETS 4096
+//Queries spanning more cells than this test every point instead
+#define SPATIAL_HASH_MAX_QUERY_CELLS 64
+#define SPATIAL_HASH_GRAIN 4096
+
+class JobSystem;
+
+//Uniform grid over an unbounded space for many small moving points. Rebuilt from scratch every
+//time with a counting sort, the points of a bucket end up contiguous in the sorted arrays.
+class SpatialHashGrid
+{
+public:
+	SpatialHashGrid(float cell_size = 1.0f, unsigned num_buckets = SPATIAL_HASH_BUCKETS);
+	~SpatialHashGrid();
+
+	void SetCellSize(float cell_size) { this->cell_size = cell_size; }
+	float GetCellSize() const { return cell_size; }
+
+	void Build(const float3* positions, unsigned count, JobSystem* jobs = nullptr);
+	void Clear();
+
+	//Results are indices into the positions given to Build, appended to the caller buffer
+	void QueryAABB(const AABB& box, std::vector<unsigned>& results) const;
+	void QuerySphere(const Sphere& sphere, std::vector<unsigned>& results) const;
+	void QueryNeighbours(unsigned point, float radius, std::vector<unsigned>& results) const;
+
+	//Points of the bucket holding the cell at position, [first, last) in the sorted arrays
+	void GetCellRange(const float3& position, unsigned& first, unsigned& last) const;
+	const unsigned* GetSortedIndices() const { return sorted_indices.empty() ? nullptr : &sorted_indices[0]; }
+	const float3* GetSortedPositions() const { return sorted_positions.empty() ? nullptr : &sorted_positions[0]; }
+
+	unsigned GetNumPoints() const { return positions.size(); }
+
+private:
+	unsigned GetBucket(const float3& position) const;
+	unsigned GetBucket(int x, int y, int z) const;
+	//Distinct buckets covering the box, false if there are too many to be worth it
+	bool CollectBuckets(const AABB& box, unsigned* buckets, unsigned& num_buckets) const;
+
+private:
+	float cell_size = 1.0f;
+	unsigned bucket_mask = 0;
+
+	std::vector<float3> positions;
+	std::vector<unsigned> point_buckets;
+	//Start of each bucket in the sorted arrays, one extra entry closes the last bucket
+	std::vector<unsigned> bucket_start;
+	std::vector<unsigned> sorted_indices;
+	std::vector<float3> sorted_positions;
+};
+
+#endif // !SPATIALHASHGRID_H
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "SpatialQuery.h"
+#include "Globals.h"
+#include <algorithm>
+
+bool IsOutsideFrustum(const Frustum& frustum, const AABB& box)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		Plane plane = frustum.GetPlane(i);
+		float3 corner = float3(plane.normal.x >= 0.0f ? box.minPoint.x : box.maxPoint.x,
+			plane.normal.y >= 0.0f ? box.minPoint.y : box.maxPoint.y,
+			plane.normal.z >= 0.0f ? box.minPoint.z : box.maxPoint.z);
+
+		if (plane.SignedDistance(corner) > 0.0f)
+			return true;
+	}
+
+	return false;
+}
+
+void OverlapQuery::TestObject(GameObject* object, const AABB& box)
+{
+	if (Overlaps(box) && Accept(object))
+		results.push_back(object);
+}
+
+RayQuery::RayQuery(const Ray& ray, float max_distance, unsigned max_hits, std::vector<SpatialHit>& hits, const SpatialFilter& filter) :
+	SpatialQuery(filter), ray(ray), max_distance(max_distance), max_hits(max_hits), hits(hits), first_hit(hits.size())
+{
+}
+
+float RayQuery::TestBounds(const AABB& bounds) const
+{
+	float near_distance, far_distance;
+	if (!bounds.Intersects(ray, near_distance, far_distance) || near_distance > max_distance)
+		return -1.0f;
+
+	return MAX(near_distance, 0.0f);
+}
+
+void RayQuery::TestObject(GameObject* object, const AABB& box)
+{
+	float distance = TestBounds(box);
+	if (distance < 0.0f || !Accept(object))
+		return;
+
+	SpatialHit hit;
+	hit.object = object;
+	hit.distance = distance;
+
+	//Max-heap on the hits of this query, once full the furthest hit is replaced and bounds the search
+	hits.push_back(hit);
+	std::push_heap(hits.begin() + first_hit, hits.end());
+	if (max_hits > 0 && hits.size() - first_hit > max_hits)
+	{
+		std::pop_heap(hits.begin() + first_hit, hits.end());
+		hits.pop_back();
+	}
+
+	if (max_hits > 0 && hits.size() - first_hit == max_hits)
+		max_distance = hits[first_hit].distance;
+}
+
+void RayQuery::Finish()
+{
+	std::sort_heap(hits.begin() + first_hit, hits.end());
+}
+
+NearestQuery::NearestQuery(const float3& point, unsigned k, float max_distance, std::vector<SpatialHit>& hits, const SpatialFilter& filter) :
+	SpatialQuery(filter), point(point), k(k), max_distance(max_distance), hits(hits), first_hit(hits.size())
+{
+}
+
+float NearestQuery::TestBounds(const AABB& bounds) const
+{
+	float distance = bounds.Distance(point);
+	return distance <= max_distance ? distance : -1.0f;
+}
+
+void NearestQuery::TestObject(GameObject* object, const AABB& box)
+{
+	if (k == 0)
+		return;
+
+	float distance = TestBounds(box);
+	if (distance < 0.0f || !Accept(object))
+		return;
+
+	SpatialHit hit;
+	hit.object = object;
+	hit.distance = distance;
+
+	hits.push_back(hit);
+	std::push_heap(hits.begin() + first_hit, hits.end());
+	if (hits.size() - first_hit > k)
+	{
+		std::pop_heap(hits.begin() + first_hit, hits.end());
+		hits.pop_back();
+	}
+
+	if (hits.size() - first_hit == k)
+		max_distance = hits[first_hit].distance;
+}
+
+void NearestQuery::Finish()
+{
+	std::sort_heap(hits.begin() + first_hit, hits.end());
+}
@@ -0,0 +1,144 @@
+#ifndef SPATIALQUERY_H
+#define SPATIALQUERY_H
+
+#include "Math.h"
+#include <vector>
+#include <functional>
+
+class GameObject;
+
+//Returns false to skip the object
+typedef std::function<bool(const GameObject* object)> SpatialFilter;
+
+struct SpatialHit
+{
+	GameObject* object = nullptr;
+	float distance = 0.0f;
+
+	bool operator<(const SpatialHit& other) const { return distance < other.distance; }
+};
+
+//Conservative test: the box is out if its nearest corner to the inside lies in front of a plane
+bool IsOutsideFrustum(const Frustum& frustum, const AABB& box);
+
+//Visitor run by the spatial indexes. Queries only keep their own state and the indexes are read only
+//while traversed, so several queries can run at the same time from worker threads as long as the
+//scene is not being modified.
+class SpatialQuery
+{
+public:
+	SpatialQuery(const SpatialFilter& filter) : filter(filter) {}
+	virtual ~SpatialQuery() {}
+
+	//Distance used to order the traversal, negative to skip the node
+	virtual float TestBounds(const AABB& bounds) const = 0;
+	virtual void TestObject(GameObject* object, const AABB& box) = 0;
+
+	//Nodes further than this are pruned, queries with early-out shrink it while they run
+	virtual float GetMaxDistance() const { return FLOAT_INF; }
+
+protected:
+	bool Accept(const GameObject* object) const { return !filter || filter(object); }
+
+private:
+	const SpatialFilter& filter;
+};
+
+class OverlapQuery : public SpatialQuery
+{
+public:
+	OverlapQuery(std::vector<GameObject*>& results, const SpatialFilter& filter) : SpatialQuery(filter), results(results) {}
+
+	void TestObject(GameObject* object, const AABB& box);
+
+protected:
+	virtual bool Overlaps(const AABB& box) const = 0;
+
+private:
+	std::vector<GameObject*>& results;
+};
+
+class FrustumQuery : public OverlapQuery
+{
+public:
+	FrustumQuery(const Frustum& frustum, std::vector<GameObject*>& results, const SpatialFilter& filter) : OverlapQuery(results, filter), frustum(frustum) {}
+
+	float TestBounds(const AABB& bounds) const { return Overlaps(bounds) ? 0.0f : -1.0f; }
+
+protected:
+	bool Overlaps(const AABB& box) const { return !IsOutsideFrustum(frustum, box); }
+
+private:
+	const Frustum& frustum;
+};
+
+class AABBQuery : public OverlapQuery
+{
+public:
+	AABBQuery(const AABB& primitive, std::vector<GameObject*>& results, const SpatialFilter& filter) : OverlapQuery(results, filter), primitive(primitive) {}
+
+	float TestBounds(const AABB& bounds) const { return Overlaps(bounds) ? 0.0f : -1.0f; }
+
+protected:
+	bool Overlaps(const AABB& box) const { return primitive.Intersects(box); }
+
+private:
+	const AABB& primitive;
+};
+
+class SphereQuery : public OverlapQuery
+{
+public:
+	SphereQuery(const Sphere& sphere, std::vector<GameObject*>& results, const SpatialFilter& filter) : OverlapQuery(results, filter), sphere(sphere) {}
+
+	float TestBounds(const AABB& bounds) const { return Overlaps(bounds) ? 0.0f : -1.0f; }
+
+protected:
+	bool Overlaps(const AABB& box) const { return box.Intersects(sphere); }
+
+private:
+	const Sphere& sphere;
+};
+
+//Keeps the closest max_hits boxes hit by the ray, 0 keeps every hit
+class RayQuery : public SpatialQuery
+{
+public:
+	RayQuery(const Ray& ray, float max_distance, unsigned max_hits, std::vector<SpatialHit>& hits, const SpatialFilter& filter);
+
+	float TestBounds(const AABB& bounds) const;
+	void TestObject(GameObject* object, const AABB& box);
+	float GetMaxDistance() const { return max_distance; }
+
+	//Sorts the hits by distance and appends them to the caller buffer
+	void Finish();
+
+private:
+	const Ray& ray;
+	float max_distance;
+	unsigned max_hits;
+	std::vector<SpatialHit>& hits;
+	unsigned first_hit;
+};
+
+//Keeps the k objects whose boxes are closest to the point
+class NearestQuery : public SpatialQuery
+{
+public:
+	NearestQuery(const float3& point, unsigned k, float max_distance, std::vector<SpatialHit>& hits, const SpatialFilter& filter);
+
+	float TestBounds(const AABB& bounds) const;
+	void TestObject(GameObject* object, const AABB& box);
+	float GetMaxDistance() const { return max_distance; }
+
+	void Finish();
+
+private:
+	float3 point;
+	unsigned k;
+	float max_distance;
+	std::vector<SpatialHit>& hits;
+	unsigned first_hit;
+};
+
+#endif // !SPATIALQUERY_H
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "StaticBatcher.h"
+#include "Application.h"
+#include "ModuleCamera.h"
+#include "ModuleLevel.h"
+#include "ModuleRender.h"
+#include "ModuleProgramShaders.h"
+#include "ModuleTextures.h"
+#include "ModuleResources.h"
+#include "GameObject.h"
+#include "ComponentMesh.h"
+#include "ComponentMaterial.h"
+#include "Color.h"
+#include "OpenGL.h"
+#include "TimerUs.h"
+#include "Brofiler/include/Brofiler.h"
+#include <algorithm>
+
+//Objects with the same key end up in the same batch
+struct BatchKey
+{
+	unsigned material = 0;
+	bool has_normals = false;
+	bool has_tex_coords = false;
+	int hlod_cluster = -1;
+	int cell[3];
+	GameObject* object = nullptr;
+
+	bool operator<(const BatchKey& other) const
+	{
+		if (material != other.material)
+			return material < other.material;
+		if (has_normals != other.has_normals)
+			return has_normals < other.has_normals;
+		if (has_tex_coords != other.has_tex_coords)
+			return has_tex_coords < other.has_tex_coords;
+		if (hlod_cluster != other.hlod_cluster)
+			return hlod_cluster < other.hlod_cluster;
+		for (unsigned i = 0; i < 3; ++i)
+			if (cell[i] != other.cell[i])
+				return cell[i] < other.cell[i];
+		return false;
+	}
+};
+
+StaticBatcher::StaticBatcher()
+{
+}
+
+StaticBatcher::~StaticBatcher()
+{
+	Clear(nullptr);
+}
+
+void StaticBatcher::Bake(GameObject* root, float cell_size)
+{
+	BROFILER_CATEGORY("StaticBatcher-Bake", Profiler::Color::Blue);
+
+	TimerUs timer;
+	timer.Start();
+
+	Clear(root);
+
+	std::vector<GameObject*> objects;
+	CollectObjects(root, objects);
+
+	//Materials that draw the same share an index, the first one found is the one bound
+	std::vector<const ComponentMaterial*> materials;
+	std::vector<BatchKey> keys;
+	keys.reserve(objects.size());
+	for (std::vector<GameObject*>::const_iterator it = objects.begin(); it != objects.end(); ++it)
+	{
+		const ComponentMaterial* material = (const ComponentMaterial*)(*it)->GetComponent(Component::Type::MATERIAL);
+		const ComponentMesh* mesh = (const ComponentMesh*)(*it)->GetComponent(Component::Type::MESH);
+
+		BatchKey key;
+		key.object = *it;
+		key.has_normals = mesh->HasNormals() && material != nullptr;
+		key.has_tex_coords = mesh->HasTexCoords();
+		key.hlod_cluster = (*it)->hlod_cluster;
+
+		for (key.material = 0; key.material < materials.size(); ++key.material)
+		{
+			const ComponentMaterial* other = materials[key.material];
+			if (other == material || (other != nullptr && material != nullptr && material->IsBatchCompatible(*other)))
+				break;
+		}
+		if (key.material == materials.size())
+			materials.push_back(material);
+
+		float3 center = (*it)->bbox.CenterPoint();
+		for (unsigned i = 0; i < 3; ++i)
+			key.cell[i] = (int)floorf(center[i] / cell_size);
+
+		keys.push_back(key);
+	}
+
+	std::stable_sort(keys.begin(), keys.end());
+
+	std::vector<GameObject*> batch_objects;
+	for (unsigned first = 0; first < keys.size();)
+	{
+		unsigned last = first + 1;
+		while (last < keys.size() && !(keys[first] < keys[last]))
+			++last;
+
+		batch_objects.clear();
+		for (unsigned i = first; i < last; ++i)
+			batch_objects.push_back(keys[i].object);
+
+		StaticBatch* batch = new StaticBatch();
+		const ComponentMaterial* material = materials[keys[first].material];
+		if (material != nullptr)
+		{
+			batch->has_material = true;
+			material->GetDrawState(batch->material);
+			App->resources->AddReference(batch->material.texture_resource);
+		}
+		batch->has_normals = keys[first].has_normals;
+		batch->has_tex_coords = keys[first].has_tex_coords;
+		batch->hlod_cluster = keys[first].hlod_cluster;
+		BuildBatch(batch, &batch_objects[0], batch_objects.size());
+		batches.push_back(batch);
+
+		first = last;
+	}
+
+	num_batched_objects = objects.size();
+
+	APPLOG("Static batching: %u objects merged in %u batches in %llu us", num_batched_objects, batches.size(), timer.GetTimeInUs());
+}
+
+void StaticBatcher::Clear(GameObject* root)
+{
+	for (std::vector<StaticBatch*>::iterator it = batches.begin(); it != batches.end(); ++it)
+	{
+		glDeleteBuffers(1, (GLuint*) &((*it)->buffer_id));
+		glDeleteBuffers(1, (GLuint*) &((*it)->indices_id));
+		if ((*it)->has_material)
+			App->resources->Release((*it)->material.texture_resource);
+		RELEASE(*it);
+	}
+	batches.clear();
+
+	num_batched_objects = 0;
+	num_drawn_batches = 0;
+
+	//Objects are looked up again instead of kept, some may have been deleted since the bake
+	if (root != nullptr)
+		RecursiveClearBatched(root);
+}
+
+void StaticBatcher::Draw()
+{
+	BROFILER_CATEGORY("StaticBatcher-Draw", Profiler::Color::GreenYellow);
+
+	num_drawn_batches = 0;
+	for (std::vector<StaticBatch*>::const_iterator it = batches.begin(); it != batches.end(); ++it)
+	{
+		const StaticBatch* batch = *it;
+		if (App->level->IsHLODProxied(batch->hlod_cluster) || !App->camera->InsideCulling(batch->box) || App->level->IsOccluded(batch->box))
+			continue;
+
+		++num_drawn_batches;
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		if (batch->has_material)
+		{
+			ComponentMaterial::ApplyDrawState(batch->material);
+			//The batch covers more of the screen than the object its material came from
+			App->textures->UseTexture(batch->material.texture_resource, 2.0f * App->camera->GetProjectedRadius(batch->box.MinimalEnclosingSphere()));
+		}
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, batch->buffer_id);
+
+		glVertexPointer(3, GL_FLOAT, 0, NULL);
+		int offset = 3;
+
+		if (batch->has_normals)
+		{
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glEnable(GL_LIGHTING);
+			glNormalPointer(GL_FLOAT, 0, (char*)(offset * batch->num_vertices * sizeof(float)));
+			offset += 3;
+		}
+		else
+			glDisable(GL_LIGHTING);
+
+		if (batch->has_tex_coords)
+		{
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glTexCoordPointer(2, GL_FLOAT, 0, (char*)(offset * batch->num_vertices * sizeof(float)));
+		}
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indices_id);
+		glDrawElements(GL_TRIANGLES, batch->num_indices, GL_UNSIGNED_INT, NULL);
+
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		App->program_shaders->UnuseProgram();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void StaticBatcher::DrawDebug() const
+{
+	for (std::vector<StaticBatch*>::const_iterator it = batches.begin(); it != batches.end(); ++it)
+		App->renderer->debug_drawer->DrawBoundingBox((*it)->box, Colors::Aqua);
+}
+
+void StaticBatcher::CollectObjects(GameObject* game_object, std::vector<GameObject*>& objects) const
+{
+	if (!game_object->IsActive())
+		return;
+
+	if (game_object->IsStatic())
+	{
+		const ComponentMesh* mesh = (const ComponentMesh*)game_object->GetComponent(Component::Type::MESH);
+		const Component* material = game_object->GetComponent(Component::Type::MATERIAL);
+
+		//Skinned meshes move and inactive materials draw the checkers texture, neither can be merged
+		if (mesh != nullptr && mesh->IsActive() && !mesh->HasBones() && mesh->GetNumIndices() > 0 &&
+			(material == nullptr || material->IsActive()))
+			objects.push_back(game_object);
+	}
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		CollectObjects(*it, objects);
+}
+
+void StaticBatcher::BuildBatch(StaticBatch* batch, GameObject** objects, unsigned num_objects) const
+{
+	batch->box.SetNegativeInfinity();
+	batch->num_objects = num_objects;
+	for (unsigned i = 0; i < num_objects; ++i)
+	{
+		const ComponentMesh* mesh = (const ComponentMesh*)objects[i]->GetComponent(Component::Type::MESH);
+		batch->num_vertices += mesh->GetNumVertices();
+		batch->num_indices += mesh->GetNumIndices();
+		batch->box.Enclose(objects[i]->bbox);
+	}
+
+	//Same planar layout as the meshes: positions, then normals, then texture coordinates
+	unsigned float_dimension = 3 + (batch->has_normals ? 3 : 0) + (batch->has_tex_coords ? 2 : 0);
+	float* buffer = new float[float_dimension * batch->num_vertices];
+	float3* positions = (float3*)buffer;
+	float3* normals = (float3*)(buffer + 3 * batch->num_vertices);
+	float2* tex_coords = (float2*)(buffer + (batch->has_normals ? 6 : 3) * batch->num_vertices);
+	unsigned* indices = new unsigned[batch->num_indices];
+
+	//Static meshes may not keep CPU copies, their data is read back from the buffers
+	std::vector<float3> mesh_vertices;
+	std::vector<float3> mesh_normals;
+	std::vector<float2> mesh_tex_coords;
+	std::vector<unsigned> mesh_indices;
+
+	unsigned base_vertex = 0;
+	unsigned base_index = 0;
+	for (unsigned i = 0; i < num_objects; ++i)
+	{
+		const ComponentMesh* mesh = (const ComponentMesh*)objects[i]->GetComponent(Component::Type::MESH);
+		const float4x4& transform = objects[i]->GetGlobalTransformMatrix();
+		float3x3 normal_transform = transform.Float3x3Part().InverseTransposed();
+
+		mesh->ReadVertices(mesh_vertices);
+		mesh->ReadIndices(mesh_indices);
+		if (batch->has_normals)
+			mesh->ReadNormals(mesh_normals);
+		if (batch->has_tex_coords)
+			mesh->ReadTexCoords(mesh_tex_coords);
+
+		for (unsigned j = 0; j < mesh->GetNumVertices(); ++j)
+		{
+			positions[base_vertex + j] = transform.TransformPos(mesh_vertices[j]);
+			if (batch->has_normals)
+				normals[base_vertex + j] = (normal_transform * mesh_normals[j]).Normalized();
+			if (batch->has_tex_coords)
+				tex_coords[base_vertex + j] = mesh_tex_coords[j];
+		}
+
+		for (unsigned j = 0; j < mesh->GetNumIndices(); ++j)
+			indices[base_index + j] = base_vertex + mesh_indices[j];
+
+		base_vertex += mesh->GetNumVertices();
+		base_index += mesh->GetNumIndices();
+
+		objects[i]->batched = true;
+	}
+
+	glGenBuffers(1, (GLuint*) &(batch->buffer_id));
+	glBindBuffer(GL_ARRAY_BUFFER, batch->buffer_id);
+	glBufferData(GL_ARRAY_BUFFER, float_dimension * sizeof(float) * batch->num_vertices, buffer, GL_STATIC_DRAW);
+
+	glGenBuffers(1, (GLuint*) &(batch->indices_id));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indices_id);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * batch->num_indices, indices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	RELEASE_ARRAY(buffer);
+	RELEASE_ARRAY(indices);
+}
+
+void StaticBatcher::RecursiveClearBatched(GameObject* game_object) const
+{
+	game_object->batched = false;
+
+	for (std::vector<GameObject*>::const_iterator it = game_object->childs.begin(); it != game_object->childs.end(); ++it)
+		RecursiveClearBatched(*it);
+}
@@ -0,0 +1,57 @@
+#ifndef STATICBATCHER_H
+#define STATICBATCHER_H
+
+#include "Math.h"
+#include "ComponentMaterial.h"
+#include <vector>
+
+class GameObject;
+
+//Pre-transformed geometry of the static meshes sharing a material in one cell of the level
+struct StaticBatch
+{
+	//Copied at bake time with a reference to its texture, the component may be deleted before the batch
+	bool has_material = false;
+	MaterialDrawState material;
+	//Batches never span HLOD clusters, they hide with the cluster they belong to
+	int hlod_cluster = -1;
+	bool has_normals = false;
+	bool has_tex_coords = false;
+
+	AABB box;
+	unsigned buffer_id = 0;
+	unsigned indices_id = 0;
+	unsigned num_vertices = 0;
+	unsigned num_indices = 0;
+	unsigned num_objects = 0;
+};
+
+class StaticBatcher
+{
+public:
+	StaticBatcher();
+	~StaticBatcher();
+
+	//Merges the static meshes under root, the originals are flagged as batched and stop drawing
+	void Bake(GameObject* root, float cell_size);
+	void Clear(GameObject* root);
+
+	void Draw();
+	void DrawDebug() const;
+
+	unsigned GetNumBatches() const { return batches.size(); }
+	unsigned GetNumBatchedObjects() const { return num_batched_objects; }
+	unsigned GetNumDrawnBatches() const { return num_drawn_batches; }
+
+private:
+	void CollectObjects(GameObject* game_object, std::vector<GameObject*>& objects) const;
+	void BuildBatch(StaticBatch* batch, GameObject** objects, unsigned num_objects) const;
+	void RecursiveClearBatched(GameObject* game_object) const;
+
+private:
+	std::vector<StaticBatch*> batches;
+	unsigned num_batched_objects = 0;
+	unsigned num_drawn_batches = 0;
+};
+
+#endif // !STATICBATCHER_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "TextureFile.h"
+
+unsigned GetTextureMipSize(unsigned format, unsigned width, unsigned height)
+{
+	unsigned blocks = ((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+	case TEXTURE_FORMAT_RGB8:
+		return width * height * 3;
+	case TEXTURE_FORMAT_RGBA8:
+		return width * height * 4;
+	case TEXTURE_FORMAT_BC1:
+		return blocks * 8;
+	case TEXTURE_FORMAT_BC3:
+	case TEXTURE_FORMAT_BC5:
+		return blocks * 16;
+	default:
+		return 0;
+	}
+}
+
+bool IsCompressedTextureFormat(unsigned format)
+{
+	return format == TEXTURE_FORMAT_BC1 || format == TEXTURE_FORMAT_BC3 || format == TEXTURE_FORMAT_BC5;
+}
+
+const TextureFileHeader* ValidateTextureFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time)
+{
+	if (data == nullptr || size < sizeof(TextureFileHeader))
+		return nullptr;
+
+	const TextureFileHeader* header = (const TextureFileHeader*)data;
+	if (header->magic != TEXTURE_FILE_MAGIC || header->version != TEXTURE_FILE_VERSION ||
+		header->source_size != source_size || header->source_time != source_time)
+		return nullptr;
+
+	if (header->width == 0 || header->height == 0 || header->format > TEXTURE_FORMAT_BC5 || header->num_mips == 0 || header->num_mips > TEXTURE_FILE_MAX_MIPS)
+		return nullptr;
+
+	//Each level halves the one before, down to 1
+	unsigned width = header->width;
+	unsigned height = header->height;
+	for (unsigned i = 0; i < header->num_mips; ++i)
+	{
+		const TextureFileMip& mip = header->mips[i];
+		if (mip.width != width || mip.height != height || mip.size != GetTextureMipSize(header->format, width, height) ||
+			(unsigned long long)mip.offset + mip.size > size)
+			return nullptr;
+
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return header;
+}
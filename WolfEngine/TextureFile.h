@@ -0,0 +1,51 @@
+#ifndef TEXTUREFILE_H
+#define TEXTUREFILE_H
+
+#define TEXTURE_FILE_EXTENSION ".wtex"
+#define TEXTURE_FILE_MAGIC 0x58455457
+#define TEXTURE_FILE_VERSION 2
+//Enough for a 32768 texel side
+#define TEXTURE_FILE_MAX_MIPS 16
+
+//Formats of the mip data, BC ones are 4x4 blocks in rows like the texels
+#define TEXTURE_FORMAT_RGB8 0
+#define TEXTURE_FORMAT_RGBA8 1
+//Opaque color
+#define TEXTURE_FORMAT_BC1 2
+//Color with alpha
+#define TEXTURE_FORMAT_BC3 3
+//Two channels, for the X and Y of normal maps
+#define TEXTURE_FORMAT_BC5 4
+
+struct TextureFileMip
+{
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned offset = 0;
+	unsigned size = 0;
+};
+
+//Mip chain ready for glTexImage2D or glCompressedTexImage2D, level 0 first and rows bottom to top
+struct TextureFileHeader
+{
+	unsigned magic = TEXTURE_FILE_MAGIC;
+	unsigned version = TEXTURE_FILE_VERSION;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned format = TEXTURE_FORMAT_RGBA8;
+	unsigned num_mips = 0;
+	//Hash of the source file content, cooked textures with the same one are uploaded once
+	unsigned long long content_hash = 0;
+	TextureFileMip mips[TEXTURE_FILE_MAX_MIPS];
+};
+
+//Bytes of one mip level in the format
+unsigned GetTextureMipSize(unsigned format, unsigned width, unsigned height);
+bool IsCompressedTextureFormat(unsigned format);
+
+//Null if the file is not valid or was made from a different source
+const TextureFileHeader* ValidateTextureFile(const char* data, unsigned long long size, unsigned long long source_size, unsigned long long source_time);
+
+#endif // !TEXTUREFILE_H
@@ -0,0 +1,279 @@
+#include "TextureStreamer.h"
+#include "Application.h"
+#include "ModuleTextures.h"
+#include "ModuleResources.h"
+#include "ResourceTexture.h"
+#include "FileSystem.h"
+#include "TextureFile.h"
+#include "OpenGL.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static bool LessRecentlyUsed(const std::pair<unsigned, ResourceTexture*>& left, const std::pair<unsigned, ResourceTexture*>& right)
+{
+	return left.second->last_used_frame < right.second->last_used_frame;
+}
+
+static bool MoreMissingDetail(const std::pair<unsigned, ResourceTexture*>& left, const std::pair<unsigned, ResourceTexture*>& right)
+{
+	return left.second->target_mip - left.second->wanted_mip > right.second->target_mip - right.second->wanted_mip;
+}
+
+TextureStreamer::TextureStreamer(unsigned long long budget, unsigned base_size, unsigned max_loads) : budget(budget), base_size(base_size), max_loads(max_loads)
+{
+	loader = std::thread(&TextureStreamer::LoaderLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	loader.join();
+
+	//Textures with a load in flight keep the mips they have
+	for (std::vector<TextureStreamRequest*>::iterator it = requests.begin(); it != requests.end(); ++it)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, (*it)->pbo);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		free_pbos.push_back((*it)->pbo);
+		RELEASE(*it);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!free_pbos.empty())
+		glDeleteBuffers(free_pbos.size(), &free_pbos[0]);
+}
+
+unsigned TextureStreamer::GetBaseMip(const TextureFileHeader& header) const
+{
+	unsigned mip = 0;
+	while (mip + 1 < header.num_mips && MAX(header.mips[mip].width, header.mips[mip].height) > base_size)
+		++mip;
+
+	return mip;
+}
+
+void TextureStreamer::Add(unsigned handle, ResourceTexture& texture)
+{
+	texture.streamed = true;
+	texture.base_mip = GetBaseMip(texture.cooked);
+	texture.resident_mip = texture.base_mip;
+	texture.target_mip = texture.base_mip;
+	texture.wanted_mip = texture.base_mip;
+	texture.last_used_frame = frame;
+
+	handles.push_back(handle);
+}
+
+void TextureStreamer::Use(ResourceTexture& texture, float screen_size)
+{
+	//Assumes the texture covers the object once, the mip with about a texel per pixel is enough
+	float size = (float)MAX(texture.cooked.width, texture.cooked.height);
+	float level = log2f(size / MAX(screen_size, 1.0f)) + mip_bias;
+	unsigned mip = level > 0.0f ? MIN((unsigned)level, texture.base_mip) : 0;
+
+	texture.wanted_mip = MIN(texture.wanted_mip, mip);
+	texture.last_used_frame = frame;
+}
+
+void TextureStreamer::Update()
+{
+	FinishLoads();
+
+	//Textures unloaded by ModuleResources or that failed to stream drop out here
+	std::vector<StreamedTexture> textures;
+	committed = 0;
+	for (std::vector<unsigned>::iterator it = handles.begin(); it != handles.end();)
+	{
+		ResourceTexture* texture = App->resources->GetTexture(*it);
+		if (texture == nullptr || !texture->streamed)
+		{
+			it = handles.erase(it);
+			continue;
+		}
+
+		textures.push_back(StreamedTexture(*it, texture));
+		committed += GetChainSize(*texture, texture->target_mip);
+		++it;
+	}
+	std::stable_sort(textures.begin(), textures.end(), LessRecentlyUsed);
+
+	//Over the budget, like after lowering it: first what is off screen or sharper than needed, then anything
+	Evict(textures, budget, false);
+	Evict(textures, budget, true);
+
+	std::vector<StreamedTexture> missing_detail;
+	for (std::vector<StreamedTexture>::const_iterator it = textures.begin(); it != textures.end(); ++it)
+	{
+		if (!it->second->loading && it->second->last_used_frame == frame && it->second->wanted_mip < it->second->target_mip)
+			missing_detail.push_back(*it);
+	}
+	std::stable_sort(missing_detail.begin(), missing_detail.end(), MoreMissingDetail);
+
+	unsigned num_started = 0;
+	for (std::vector<StreamedTexture>::const_iterator it = missing_detail.begin(); it != missing_detail.end() && num_started < max_loads; ++it)
+	{
+		//One mip at a time, the texture sharpens while the rest streams in
+		ResourceTexture& texture = *it->second;
+		unsigned long long extra = texture.cooked.mips[texture.target_mip - 1].size;
+		if (committed + extra > budget && extra <= budget)
+			Evict(textures, budget - extra, false);
+		if (committed + extra > budget)
+			continue;
+
+		if (StartLoad(it->first, texture, texture.target_mip - 1))
+			++num_started;
+	}
+
+	for (std::vector<StreamedTexture>::const_iterator it = textures.begin(); it != textures.end(); ++it)
+		it->second->wanted_mip = it->second->base_mip;
+	++frame;
+}
+
+void TextureStreamer::FinishLoads()
+{
+	for (std::vector<TextureStreamRequest*>::iterator it = requests.begin(); it != requests.end();)
+	{
+		TextureStreamRequest* request = *it;
+		if (!request->loaded)
+		{
+			++it;
+			continue;
+		}
+
+		//The driver can lose a mapped buffer, on a display mode change for example
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, request->pbo);
+		bool uploaded = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE && request->read;
+
+		ResourceTexture* texture = App->resources->GetTexture(request->handle);
+		if (texture != nullptr)
+		{
+			//With the buffer bound the mip data is an offset into it
+			if (uploaded)
+			{
+				App->textures->UploadCookedTexture(texture->cooked, request->first_mip, nullptr, request->offset, *texture);
+				texture->resident_mip = request->first_mip;
+			}
+			else
+			{
+				APPLOG("Error streaming %s, keeping the mips it has", request->path.c_str());
+				texture->streamed = false;
+			}
+			texture->target_mip = texture->resident_mip;
+			texture->loading = false;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		free_pbos.push_back(request->pbo);
+		RELEASE(request);
+		it = requests.erase(it);
+	}
+}
+
+void TextureStreamer::Evict(std::vector<StreamedTexture>& textures, unsigned long long limit, bool visible)
+{
+	for (std::vector<StreamedTexture>::iterator it = textures.begin(); it != textures.end() && committed > limit; ++it)
+	{
+		ResourceTexture& texture = *it->second;
+		if (texture.loading)
+			continue;
+
+		//Textures on screen keep the mip they need until nothing else is left to drop
+		bool used = texture.last_used_frame == frame;
+		unsigned coarsest = used && !visible ? texture.wanted_mip : texture.base_mip;
+
+		unsigned mip = texture.target_mip;
+		unsigned long long freed = 0;
+		while (mip < coarsest && committed - freed > limit)
+			freed += texture.cooked.mips[mip++].size;
+
+		if (mip != texture.target_mip && StartLoad(it->first, texture, mip))
+			num_evictions += mip - texture.resident_mip;
+	}
+}
+
+bool TextureStreamer::StartLoad(unsigned handle, ResourceTexture& texture, unsigned first_mip)
+{
+	const TextureFileMip& last = texture.cooked.mips[texture.cooked.num_mips - 1];
+	TextureStreamRequest* request = new TextureStreamRequest();
+	request->handle = handle;
+	request->first_mip = first_mip;
+	request->path = texture.cooked_path;
+	request->source_size = texture.cooked.source_size;
+	request->source_time = texture.cooked.source_time;
+	request->offset = texture.cooked.mips[first_mip].offset;
+	request->size = last.offset + last.size - request->offset;
+
+	if (free_pbos.empty())
+	{
+		unsigned pbo = 0;
+		glGenBuffers(1, &pbo);
+		free_pbos.push_back(pbo);
+	}
+	request->pbo = free_pbos.back();
+	free_pbos.pop_back();
+
+	//New storage every time, the driver may still be reading the old one for an earlier upload
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, request->pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, request->size, nullptr, GL_STREAM_DRAW);
+	request->mapped = (char*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (request->mapped == nullptr)
+	{
+		free_pbos.push_back(request->pbo);
+		RELEASE(request);
+		return false;
+	}
+
+	committed = committed + GetChainSize(texture, first_mip) - GetChainSize(texture, texture.target_mip);
+	texture.target_mip = first_mip;
+	texture.loading = true;
+	requests.push_back(request);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(request);
+	}
+	wake.notify_one();
+
+	return true;
+}
+
+void TextureStreamer::LoaderLoop()
+{
+	while (true)
+	{
+		TextureStreamRequest* request = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return quit || !pending.empty(); });
+			if (quit)
+				return;
+			request = pending.front();
+			pending.pop_front();
+		}
+
+		//The cooked file may have been cooked again since the texture was loaded
+		VirtualFile file;
+		request->read = App->files->ReadFile(request->path.c_str(), file) &&
+			ValidateTextureFile(file.GetData(), file.GetSize(), request->source_size, request->source_time) != nullptr &&
+			request->offset + request->size <= file.GetSize();
+		if (request->read)
+			memcpy(request->mapped, file.GetData() + request->offset, (size_t)request->size);
+
+		request->loaded = true;
+	}
+}
+
+unsigned long long TextureStreamer::GetChainSize(const ResourceTexture& texture, unsigned first_mip)
+{
+	unsigned long long size = 0;
+	for (unsigned i = first_mip; i < texture.cooked.num_mips; ++i)
+		size += texture.cooked.mips[i].size;
+
+	return size;
+}
@@ -0,0 +1,92 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <utility>
+
+class ResourceTexture;
+struct TextureFileHeader;
+
+//Mip range of one streamed texture on its way to VRAM. The loader thread copies it from the cooked file
+//into a mapped pixel buffer and the main thread uploads it from there.
+struct TextureStreamRequest
+{
+	unsigned handle = 0;
+	unsigned first_mip = 0;
+	std::string path;
+	unsigned long long source_size = 0;
+	unsigned long long source_time = 0;
+	//Bytes of the cooked file from the first mip to the end of the chain
+	unsigned long long offset = 0;
+	unsigned long long size = 0;
+
+	unsigned pbo = 0;
+	char* mapped = nullptr;
+	bool read = false;
+	std::atomic<bool> loaded;
+
+	TextureStreamRequest() : loaded(false) {}
+};
+
+//Keeps streamed textures between their coarse base mips and the finest mip the draws ask for. Every change of the
+//resident mips, finer or coarser, goes through the loader thread and a pixel buffer, the GL texture name never changes.
+//Over the budget the least recently used textures lose their top mips first.
+class TextureStreamer
+{
+	typedef std::pair<unsigned, ResourceTexture*> StreamedTexture;
+
+public:
+	TextureStreamer(unsigned long long budget, unsigned base_size, unsigned max_loads);
+	~TextureStreamer();
+
+	//Coarsest mips every streamed texture keeps, the first that fit in the base size
+	unsigned GetBaseMip(const TextureFileHeader& header) const;
+	//Starts streaming a texture uploaded from its base mip, the finer ones come as draws need them
+	void Add(unsigned handle, ResourceTexture& texture);
+	//Marks the texture as used this frame at the given projected size in pixels
+	void Use(ResourceTexture& texture, float screen_size);
+	//Main thread, once a frame: uploads finished loads, enforces the budget and starts new loads
+	void Update();
+
+	unsigned long long GetCommittedMemory() const { return committed; }
+	unsigned GetNumTextures() const { return handles.size(); }
+	unsigned GetNumLoads() const { return requests.size(); }
+	unsigned GetNumEvictions() const { return num_evictions; }
+
+private:
+	void FinishLoads();
+	void Evict(std::vector<StreamedTexture>& textures, unsigned long long limit, bool visible);
+	bool StartLoad(unsigned handle, ResourceTexture& texture, unsigned first_mip);
+	void LoaderLoop();
+
+	static unsigned long long GetChainSize(const ResourceTexture& texture, unsigned first_mip);
+
+public:
+	unsigned long long budget = 0;
+	float mip_bias = 0.0f;
+
+private:
+	unsigned base_size = 0;
+	unsigned max_loads = 0;
+	unsigned frame = 0;
+	unsigned long long committed = 0;
+	unsigned num_evictions = 0;
+
+	std::vector<unsigned> handles;
+	std::vector<TextureStreamRequest*> requests;
+	std::vector<unsigned> free_pbos;
+
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<TextureStreamRequest*> pending;
+	bool quit = false;
+};
+
+#endif // !TEXTURESTREAMER_H
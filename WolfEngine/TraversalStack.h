@@ -0,0 +1,49 @@
+#ifndef TRAVERSALSTACK_H
+#define TRAVERSALSTACK_H
+
+#include <vector>
+#include <utility>
+
+//Depth first traversal stack for the spatial containers. The first SIZE nodes live on the call stack,
+//deeper or degenerate trees spill the rest to the heap instead of dropping subtrees.
+template<unsigned SIZE>
+struct TraversalStack
+{
+	unsigned nodes[SIZE];
+	float distances[SIZE];
+	unsigned size = 0;
+	std::vector<std::pair<unsigned, float>> overflow;
+
+	bool Empty() const { return size == 0 && overflow.empty(); }
+
+	void Push(unsigned node, float distance = 0.0f)
+	{
+		if (size < SIZE)
+		{
+			nodes[size] = node;
+			distances[size++] = distance;
+		}
+		else
+			overflow.push_back(std::pair<unsigned, float>(node, distance));
+	}
+
+	unsigned Pop(float* distance = nullptr)
+	{
+		//Nodes only spill while the array is full, so the spilled ones are always the latest pushed
+		if (!overflow.empty())
+		{
+			std::pair<unsigned, float> top = overflow.back();
+			overflow.pop_back();
+			if (distance != nullptr)
+				*distance = top.second;
+			return top.first;
+		}
+
+		--size;
+		if (distance != nullptr)
+			*distance = distances[size];
+		return nodes[size];
+	}
+};
+
+#endif // !TRAVERSALSTACK_H
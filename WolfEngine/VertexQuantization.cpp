@@ -0,0 +1,162 @@
+#include "VertexQuantization.h"
+#include "Globals.h"
+
+static short QuantizeSnorm(float value)
+{
+	value = MAX(-1.0f, MIN(value, 1.0f));
+	return (short)(value >= 0.0f ? value * QUANTIZATION_RANGE + 0.5f : value * QUANTIZATION_RANGE - 0.5f);
+}
+
+void EncodeOctahedral(const float3& normal, short* encoded)
+{
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (length == 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float x = normal.x / length;
+	float y = normal.y / length;
+	if (normal.z < 0.0f)
+	{
+		//The lower half folds over the diagonals of the square
+		float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = folded_x;
+		y = folded_y;
+	}
+
+	encoded[0] = QuantizeSnorm(x);
+	encoded[1] = QuantizeSnorm(y);
+}
+
+float3 DecodeOctahedral(const short* encoded)
+{
+	float x = MAX(encoded[0] / QUANTIZATION_RANGE, -1.0f);
+	float y = MAX(encoded[1] / QUANTIZATION_RANGE, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float unfolded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfolded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfolded_x;
+		y = unfolded_y;
+	}
+
+	return float3(x, y, z).Normalized();
+}
+
+unsigned short FloatToHalf(float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned short sign = (unsigned short)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned mantissa = bits & 0x7FFFFF;
+
+	//NaN stays NaN, infinity and overflow become infinity
+	if (((bits >> 23) & 0xFF) == 0xFF)
+		return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+	if (exponent >= 31)
+		return sign | 0x7C00;
+
+	//Denormals shift the implicit bit into the mantissa, anything smaller is zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		unsigned shift = 14 - exponent;
+		unsigned half_mantissa = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			++half_mantissa;
+		return sign | (unsigned short)half_mantissa;
+	}
+
+	//Rounding may carry into the exponent, which is still the right result
+	unsigned half = ((unsigned)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		++half;
+	return sign | (unsigned short)half;
+}
+
+float HalfToFloat(unsigned short value)
+{
+	unsigned sign = (unsigned)(value & 0x8000) << 16;
+	unsigned exponent = (value >> 10) & 0x1F;
+	unsigned mantissa = value & 0x3FF;
+
+	unsigned bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		//Denormal, normalized for the wider exponent
+		exponent = 127 - 15 + 1;
+		while ((mantissa & 0x400) == 0)
+		{
+			mantissa <<= 1;
+			--exponent;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void GetPositionQuantization(const AABB& box, float3& offset, float3& scale)
+{
+	offset = box.CenterPoint();
+	float3 half_size = box.HalfSize();
+	for (unsigned i = 0; i < 3; ++i)
+		scale[i] = half_size[i] > 0.0f ? half_size[i] / QUANTIZATION_RANGE : 1.0f;
+}
+
+unsigned GetQuantizedVertexSize(bool has_normals, bool has_tex_coords)
+{
+	return 4 * sizeof(short) + (has_normals ? 2 * sizeof(short) : 0) + (has_tex_coords ? 2 * sizeof(unsigned short) : 0);
+}
+
+void QuantizeVertices(const float3* vertices, const float3* normals, const float2* tex_coords, unsigned num_vertices,
+	const float3& offset, const float3& scale, std::vector<char>& stream)
+{
+	stream.resize(num_vertices * GetQuantizedVertexSize(normals != nullptr, tex_coords != nullptr));
+	if (num_vertices == 0)
+		return;
+
+	//The fourth short keeps every position 8 bytes, attributes off 4 byte boundaries are slow on most drivers
+	short* positions = (short*)&stream[0];
+	for (unsigned i = 0; i < num_vertices; ++i)
+	{
+		for (unsigned j = 0; j < 3; ++j)
+			positions[4 * i + j] = QuantizeSnorm((vertices[i][j] - offset[j]) / (scale[j] * QUANTIZATION_RANGE));
+		positions[4 * i + 3] = 1;
+	}
+
+	char* next = &stream[0] + num_vertices * 4 * sizeof(short);
+	if (normals != nullptr)
+	{
+		short* encoded = (short*)next;
+		for (unsigned i = 0; i < num_vertices; ++i)
+			EncodeOctahedral(normals[i], encoded + 2 * i);
+		next += num_vertices * 2 * sizeof(short);
+	}
+
+	if (tex_coords != nullptr)
+	{
+		unsigned short* halfs = (unsigned short*)next;
+		for (unsigned i = 0; i < num_vertices; ++i)
+		{
+			halfs[2 * i] = FloatToHalf(tex_coords[i].x);
+			halfs[2 * i + 1] = FloatToHalf(tex_coords[i].y);
+		}
+	}
+}
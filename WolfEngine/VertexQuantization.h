@@ -0,0 +1,29 @@
+#ifndef VERTEXQUANTIZATION_H
+#define VERTEXQUANTIZATION_H
+
+#include "Math.h"
+#include <vector>
+
+//Largest signed 16 bit value, both the position grid and the normalized normals use it
+#define QUANTIZATION_RANGE 32767.0f
+//16 bit indices can address the whole mesh
+#define MAX_SHORT_INDEX_VERTICES 65536
+
+//Unit vector folded onto the octahedron and unfolded onto a square, two snorm16 keep it within 0.05 degrees
+void EncodeOctahedral(const float3& normal, short* encoded);
+float3 DecodeOctahedral(const short* encoded);
+
+//IEEE half precision, round to nearest, values out of range become infinity
+unsigned short FloatToHalf(float value);
+float HalfToFloat(unsigned short value);
+
+//Positions are offset + quantized * scale, the grid spans the box with QUANTIZATION_RANGE steps per half extent
+void GetPositionQuantization(const AABB& box, float3& offset, float3& scale);
+
+//Planar like the float layout: positions as four shorts, octahedral normals as two shorts,
+//texture coordinates as two halfs. Normals and texture coordinates may be null.
+unsigned GetQuantizedVertexSize(bool has_normals, bool has_tex_coords);
+void QuantizeVertices(const float3* vertices, const float3* normals, const float2* tex_coords, unsigned num_vertices,
+	const float3& offset, const float3& scale, std::vector<char>& stream);
+
+#endif // !VERTEXQUANTIZATION_H